@@ -0,0 +1,209 @@
+/**
+ * @file lvgl_bench.c
+ *
+ * Rendering benchmark under scroll and drag load
+ *
+ * Creates a long scrollable list and drives it either with an input
+ * recording (LV_SIM_REPLAY_FILE) or, without a recording, with a
+ * scroll animation. The frame statistics are printed at the end,
+ * including the worst frame time and input to frame latency
+ *
+ * usage: lvgl_bench [backend]
+ *
+ * The backend defaults to HEADLESS, when replaying on HEADLESS the
+ * number of frames defaults to the length of the recording
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+
+#include "simulator_util.h"
+#include "simulator_settings.h"
+#include "driver_backends.h"
+#include "frame_stats.h"
+#include "boot_timing.h"
+#include "input_record.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of items of the list */
+#define BENCH_ITEM_CNT 200
+
+/* Frames rendered after the end of the recording */
+#define BENCH_TAIL_FRAMES 60
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void create_ui(bool animate);
+static void scroll_timer_cb(lv_timer_t *timer);
+static void set_headless_frames(const char *replay_file);
+static void print_summary(void);
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    char default_backend[] = "HEADLESS";
+    char *backend = argc > 1 ? argv[1] : default_backend;
+    const char *replay_file = getenv("LV_SIM_REPLAY_FILE");
+    uint64_t start;
+
+    boot_timing_init();
+
+    start = frame_stats_now_us();
+    lv_init();
+    boot_timing_add("lv_init", NULL, start);
+
+    settings.window_width = atoi(getenv_default("LV_SIM_WINDOW_WIDTH", "800"));
+    settings.window_height = atoi(getenv_default("LV_SIM_WINDOW_HEIGHT", "480"));
+
+    driver_backends_register();
+
+    if (!driver_backends_is_supported(backend)) {
+        fprintf(stderr, "Unsupported backend: %s\n", backend);
+        driver_backends_print_supported();
+        return EXIT_FAILURE;
+    }
+
+    if (replay_file != NULL && strcmp(backend, "HEADLESS") == 0) {
+        set_headless_frames(replay_file);
+    }
+
+    if (driver_backends_init_backend(backend) == -1) {
+        fprintf(stderr, "Failed to initialize the %s backend\n", backend);
+        return EXIT_FAILURE;
+    }
+
+    if (replay_file != NULL && driver_backends_init_backend("REPLAY") == -1) {
+        fprintf(stderr, "Failed to replay %s\n", replay_file);
+        return EXIT_FAILURE;
+    }
+
+    create_ui(replay_file == NULL);
+
+    /* Returns at the end of the replay or after the frames of the headless backend */
+    driver_backends_run_loop();
+
+    print_summary();
+    return EXIT_SUCCESS;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Create the list
+ *
+ * @param animate scroll the list periodically
+ */
+static void create_ui(bool animate)
+{
+    lv_obj_t *list = lv_list_create(lv_screen_active());
+    char text[32];
+    int i;
+
+    lv_obj_set_size(list, LV_PCT(100), LV_PCT(100));
+
+    for (i = 0; i < BENCH_ITEM_CNT; i++) {
+        if (i % 20 == 0) {
+            snprintf(text, sizeof(text), "Section %d", i / 20);
+            lv_list_add_text(list, text);
+        }
+
+        snprintf(text, sizeof(text), "Item %d", i);
+        lv_list_add_button(list, i % 2 ? LV_SYMBOL_FILE : LV_SYMBOL_DIRECTORY, text);
+    }
+
+    if (animate) {
+        lv_timer_create(scroll_timer_cb, 500, list);
+    }
+}
+
+/**
+ * Scroll the list by about one screen, back to the top at the end
+ *
+ * @param timer the LVGL timer
+ */
+static void scroll_timer_cb(lv_timer_t *timer)
+{
+    lv_obj_t *list = lv_timer_get_user_data(timer);
+
+    if (lv_obj_get_scroll_bottom(list) <= 0) {
+        lv_obj_scroll_to_y(list, 0, LV_ANIM_ON);
+    } else {
+        lv_obj_scroll_by(list, 0, -(int32_t)settings.window_height * 3 / 4, LV_ANIM_ON);
+    }
+}
+
+/**
+ * Size the headless run to the recording
+ *
+ * @description keeps LV_SIM_HEADLESS_FRAMES if it is set
+ * @param replay_file the recording
+ */
+static void set_headless_frames(const char *replay_file)
+{
+    uint32_t frame_ms = atoi(getenv_default("LV_SIM_HEADLESS_FRAME_MS", "16"));
+    bool fast = getenv_default("LV_SIM_REPLAY_FAST", "0")[0] == '1';
+    input_recording_t rec;
+    char frames[16];
+    uint32_t cnt;
+
+    if (getenv("LV_SIM_HEADLESS_FRAMES") != NULL || input_recording_load(replay_file, &rec) < 0) {
+        return;
+    }
+
+    if (frame_ms == 0) {
+        frame_ms = 1;
+    }
+
+    /* As fast as possible, one report is replayed per frame */
+    cnt = fast ? rec.report_cnt : (uint32_t)(rec.duration_us / 1000 / frame_ms);
+    input_recording_free(&rec);
+
+    snprintf(frames, sizeof(frames), "%u", cnt + BENCH_TAIL_FRAMES);
+    setenv("LV_SIM_HEADLESS_FRAMES", frames, 1);
+}
+
+/**
+ * Print the frame statistics
+ */
+static void print_summary(void)
+{
+    frame_stats_summary_t frame;
+    frame_stats_summary_t latency;
+
+    frame_stats_get(FRAME_STATS_FRAME, &frame);
+    frame_stats_get(FRAME_STATS_INPUT_LATENCY, &latency);
+
+    frame_stats_print();
+
+    fprintf(stdout, "bench frames=%u frame_p99_us=%u frame_max_us=%u "
+            "inputs=%u latency_p99_us=%u latency_max_us=%u\n",
+            frame.count, frame.p99_us, frame.max_us,
+            latency.count, latency.p99_us, latency.max_us);
+}
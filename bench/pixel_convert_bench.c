@@ -0,0 +1,230 @@
+/**
+ * @file pixel_convert_bench.c
+ *
+ * Microbenchmark of the pixel conversion and rotation kernels
+ *
+ * Runs every implementation supported by the CPU on a full screen
+ * buffer, checks that the output matches the scalar implementation
+ * and prints the throughput
+ *
+ * usage: pixel_convert_bench [width height iterations]
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixel_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    const char *name;
+    uint32_t flags;
+} bench_case_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static double now_s(void);
+static double run_convert(const pixel_convert_ops_t *ops, uint16_t *dst, const uint32_t *src,
+                          uint32_t w, uint32_t h, uint32_t iter, uint32_t flags);
+static double run_swap(const pixel_convert_ops_t *ops, uint16_t *dst, const uint16_t *src,
+                       uint32_t w, uint32_t h, uint32_t iter);
+static double run_rotate(const pixel_convert_ops_t *ops, void *dst, const void *src,
+                         uint32_t w, uint32_t h, uint32_t iter, uint32_t px_size, uint32_t rotation);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const bench_case_t cases[] = {
+    { "xrgb8888->rgb565", 0 },
+    { "xrgb8888->rgb565 dither", PIXEL_CONVERT_DITHER },
+    { "xrgb8888->rgb565 swapped", PIXEL_CONVERT_SWAP },
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    const pixel_convert_ops_t *ops;
+    const pixel_convert_ops_t *ref = pixel_convert_get_ops_by_index(0);
+    uint32_t w = 1920;
+    uint32_t h = 1080;
+    uint32_t iter = 100;
+    uint32_t *src;
+    uint16_t *src16;
+    uint16_t *dst;
+    uint16_t *expected;
+    uint32_t *rot_dst;
+    uint32_t *rot_expected;
+    uint32_t px_size;
+    size_t n;
+    double t;
+    double t_ref;
+    uint32_t i, c;
+    int ret = EXIT_SUCCESS;
+
+    if (argc == 4) {
+        w = strtoul(argv[1], NULL, 10);
+        h = strtoul(argv[2], NULL, 10);
+        iter = strtoul(argv[3], NULL, 10);
+    }
+
+    n = (size_t)w * h;
+    src = malloc(n * sizeof(uint32_t));
+    src16 = malloc(n * sizeof(uint16_t));
+    dst = malloc(n * sizeof(uint16_t));
+    expected = malloc(n * sizeof(uint16_t));
+    rot_dst = malloc(n * sizeof(uint32_t));
+    rot_expected = malloc(n * sizeof(uint32_t));
+
+    if (src == NULL || src16 == NULL || dst == NULL || expected == NULL ||
+        rot_dst == NULL || rot_expected == NULL || iter == 0) {
+        fprintf(stderr, "Invalid parameters\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for (i = 0; i < n; i++) {
+        src[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        src16[i] = (uint16_t)src[i];
+    }
+
+    printf("%ux%u, %u iterations\n", w, h, iter);
+
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        printf("%s\n", cases[c].name);
+        t_ref = run_convert(ref, expected, src, w, h, iter, cases[c].flags);
+
+        for (i = 0; (ops = pixel_convert_get_ops_by_index(i)) != NULL; i++) {
+            t = (i == 0) ? t_ref : run_convert(ops, dst, src, w, h, iter, cases[c].flags);
+
+            if (i != 0 && memcmp(dst, expected, n * sizeof(uint16_t)) != 0) {
+                printf("  %-8s MISMATCH\n", ops->name);
+                ret = EXIT_FAILURE;
+                continue;
+            }
+
+            printf("  %-8s %8.1f Mpx/s  x%.2f\n", ops->name,
+                   (double)n * iter / t / 1e6, t_ref / t);
+        }
+    }
+
+    printf("rgb565 byte swap\n");
+    t_ref = run_swap(ref, expected, src16, w, h, iter);
+
+    for (i = 0; (ops = pixel_convert_get_ops_by_index(i)) != NULL; i++) {
+        t = (i == 0) ? t_ref : run_swap(ops, dst, src16, w, h, iter);
+
+        if (i != 0 && memcmp(dst, expected, n * sizeof(uint16_t)) != 0) {
+            printf("  %-8s MISMATCH\n", ops->name);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        printf("  %-8s %8.1f Mpx/s  x%.2f\n", ops->name,
+               (double)n * iter / t / 1e6, t_ref / t);
+    }
+
+    for (px_size = 2; px_size <= 4; px_size += 2) {
+        printf("rotate 90 %u bpp\n", px_size * 8);
+        t_ref = run_rotate(ref, rot_expected, src, w, h, iter, px_size, 90);
+
+        for (i = 0; (ops = pixel_convert_get_ops_by_index(i)) != NULL; i++) {
+            t = (i == 0) ? t_ref : run_rotate(ops, rot_dst, src, w, h, iter, px_size, 90);
+
+            if (i != 0 && memcmp(rot_dst, rot_expected, n * px_size) != 0) {
+                printf("  %-8s MISMATCH\n", ops->name);
+                ret = EXIT_FAILURE;
+                continue;
+            }
+
+            printf("  %-8s %8.1f Mpx/s  x%.2f\n", ops->name,
+                   (double)n * iter / t / 1e6, t_ref / t);
+        }
+    }
+
+    free(src);
+    free(src16);
+    free(dst);
+    free(expected);
+    free(rot_dst);
+    free(rot_expected);
+
+    return ret;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double run_convert(const pixel_convert_ops_t *ops, uint16_t *dst, const uint32_t *src,
+                          uint32_t w, uint32_t h, uint32_t iter, uint32_t flags)
+{
+    double start = now_s();
+    uint32_t i, y;
+
+    for (i = 0; i < iter; i++) {
+        for (y = 0; y < h; y++) {
+            ops->xrgb8888_to_rgb565(dst + (size_t)y * w, src + (size_t)y * w, w, flags, 0, y);
+        }
+    }
+
+    return now_s() - start;
+}
+
+static double run_swap(const pixel_convert_ops_t *ops, uint16_t *dst, const uint16_t *src,
+                       uint32_t w, uint32_t h, uint32_t iter)
+{
+    double start = now_s();
+    uint32_t i, y;
+
+    for (i = 0; i < iter; i++) {
+        for (y = 0; y < h; y++) {
+            ops->rgb565_swap(dst + (size_t)y * w, src + (size_t)y * w, w);
+        }
+    }
+
+    return now_s() - start;
+}
+
+/**
+ * Rotate the full screen, like a flush of a fully damaged frame
+ */
+static double run_rotate(const pixel_convert_ops_t *ops, void *dst, const void *src,
+                         uint32_t w, uint32_t h, uint32_t iter, uint32_t px_size, uint32_t rotation)
+{
+    double start = now_s();
+    uint32_t i;
+
+    for (i = 0; i < iter; i++) {
+        pixel_convert_rotate(ops, dst, h * px_size, src, w * px_size, px_size,
+                             0, 0, w, h, w, h, rotation);
+    }
+
+    return now_s() - start;
+}
@@ -20,25 +20,44 @@
 #include <lvgl/demos/lv_demos.h>
 #include <lvgl/driver_backends.h>
 #include <lvgl/simulator_settings.h>
+#include <lvgl/frame_stats.h>
+#include <lvgl/boot_timing.h>
 
 extern simulator_settings_t settings;
 
 int main(int argc, char **argv)
 {
+    uint64_t start;
+
+    /* Start the startup report before anything else, see LV_SIM_BOOT_TIMING */
+    boot_timing_init();
 
     /* Initialize LVGL. */
+    start = frame_stats_now_us();
     lv_init();
+    boot_timing_add("lv_init", NULL, start);
 
     settings.window_width = 800;
     settings.window_height = 480;
 
-    /* Initialize the configured default backend */
+    /* Initialize the default backend of the installed library, LV_SIM_BACKENDS
+     * selects the first one that works from a list i.e LV_SIM_BACKENDS=DRM,FBDEV,HEADLESS */
     driver_backends_register();
-    if (driver_backends_init_backend("WAYLAND") == -1) {
-        fprintf(stderr, "Failed to initialize wayland backend\n");
+    if (driver_backends_init_display(NULL) == -1) {
+        fprintf(stderr, "Failed to initialize a display backend\n");
         exit(EXIT_FAILURE);
     }
 
+    /* A second display, i.e a status panel, LV_SIM_BACKENDS_1=FBDEV */
+    if (getenv("LV_SIM_BACKENDS_1") != NULL) {
+        if (driver_backends_init_display(NULL) == -1) {
+            fprintf(stderr, "Failed to initialize the second display\n");
+        } else {
+            lv_label_set_text(lv_label_create(lv_display_get_screen_active(
+                                  driver_backends_get_display(1))), "Display 1");
+        }
+    }
+
     /*Create a Demo*/
     lv_demo_widgets();
     lv_demo_widgets_start_slideshow();
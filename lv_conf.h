@@ -38,8 +38,10 @@
  * - LV_STDLIB_MICROPYTHON: MicroPython implementation
  * - LV_STDLIB_RTTHREAD:    RT-Thread implementation
  * - LV_STDLIB_CUSTOM:      Implement the functions externally
- */
-#define LV_USE_STDLIB_MALLOC    LV_STDLIB_CLIB
+ * Can be overridden by the build system, see LV_PORT_SLAB_ALLOC in CMakeLists.txt */
+#ifndef LV_USE_STDLIB_MALLOC
+    #define LV_USE_STDLIB_MALLOC    LV_STDLIB_CLIB
+#endif
 
 /** Possible values
  * - LV_STDLIB_BUILTIN:     LVGL's built in implementation
@@ -105,8 +107,11 @@
  * - LV_OS_WINDOWS
  * - LV_OS_MQX
  * - LV_OS_SDL2
- * - LV_OS_CUSTOM */
-#define LV_USE_OS   LV_OS_NONE
+ * - LV_OS_CUSTOM
+ * Can be overridden by the build system, see LV_PORT_THREADS in CMakeLists.txt */
+#ifndef LV_USE_OS
+    #define LV_USE_OS   LV_OS_NONE
+#endif
 
 #if LV_USE_OS == LV_OS_CUSTOM
     #define LV_OS_CUSTOM_INCLUDE <stdint.h>
@@ -190,8 +195,11 @@
 
     /** Set number of draw units.
      *  - > 1 requires operating system to be enabled in `LV_USE_OS`.
-     *  - > 1 means multiple threads will render the screen in parallel. */
-    #define LV_DRAW_SW_DRAW_UNIT_CNT    1
+     *  - > 1 means multiple threads will render the screen in parallel.
+     *  Can be overridden by the build system, see LV_PORT_THREADS in CMakeLists.txt */
+    #ifndef LV_DRAW_SW_DRAW_UNIT_CNT
+        #define LV_DRAW_SW_DRAW_UNIT_CNT    1
+    #endif
 
     /** Use Arm-2D to accelerate software (sw) rendering. */
     #define LV_USE_DRAW_ARM2D_SYNC      0
@@ -359,8 +367,11 @@
     #define LV_USE_DRAW_DMA2D_INTERRUPT 0
 #endif
 
-/** Draw using cached OpenGLES textures. Requires LV_USE_OPENGLES */
-#define LV_USE_DRAW_OPENGLES 0
+/** Draw using cached OpenGLES textures. Requires LV_USE_OPENGLES
+ *  Can be overridden by the build system, see LV_PORT_DRAW_OPENGLES in CMakeLists.txt */
+#ifndef LV_USE_DRAW_OPENGLES
+    #define LV_USE_DRAW_OPENGLES 0
+#endif
 
 #if LV_USE_DRAW_OPENGLES
     #define LV_DRAW_OPENGLES_TEXTURE_CACHE_COUNT 64
@@ -913,9 +924,9 @@
 #endif
 
 /** API for memory-mapped file access. */
-#define LV_USE_FS_MEMFS 0
+#define LV_USE_FS_MEMFS 1
 #if LV_USE_FS_MEMFS
-    #define LV_FS_MEMFS_LETTER '\0'     /**< Set an upper-case driver-identifier letter for this driver (e.g. 'A'). */
+    #define LV_FS_MEMFS_LETTER 'M'     /**< Set an upper-case driver-identifier letter for this driver (e.g. 'A'). */
 #endif
 
 /** API for LittleFs. */
@@ -0,0 +1,266 @@
+/**
+ * @file asset_bundle.c
+ *
+ * Memory mapped bundle of pre-converted images and fonts
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lvgl/lvgl.h"
+
+#include "asset_bundle.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+struct _asset_bundle_t {
+    uint8_t *map;
+    size_t map_size;
+    const asset_bundle_header_t *header;
+    const asset_bundle_entry_t *entries;
+    lv_image_dsc_t *images;     /* One per entry, only set for the images */
+    lv_font_t **fonts;          /* One per entry, loaded on demand */
+};
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static bool check_entry(const asset_bundle_t *bundle, const asset_bundle_entry_t *entry);
+static int find_entry(const asset_bundle_t *bundle, const char *name, asset_bundle_type_t type);
+static int compare_name(const void *key, const void *entry);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+asset_bundle_t *asset_bundle_open(const char *path)
+{
+    asset_bundle_t *bundle;
+    const asset_bundle_entry_t *entry;
+    lv_image_dsc_t *img;
+    struct stat st;
+    uint32_t i;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LV_LOG_ERROR("Failed to open %s", path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(asset_bundle_header_t)) {
+        LV_LOG_ERROR("%s is not an asset bundle", path);
+        close(fd);
+        return NULL;
+    }
+
+    bundle = calloc(1, sizeof(asset_bundle_t));
+    LV_ASSERT_NULL(bundle);
+
+    /* The mapping outlives the descriptor */
+    bundle->map_size = st.st_size;
+    bundle->map = mmap(NULL, bundle->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (bundle->map == MAP_FAILED) {
+        LV_LOG_ERROR("Failed to map %s", path);
+        free(bundle);
+        return NULL;
+    }
+
+    bundle->header = (const asset_bundle_header_t *)bundle->map;
+    bundle->entries = (const asset_bundle_entry_t *)(bundle->header + 1);
+
+    if (memcmp(bundle->header->magic, ASSET_BUNDLE_MAGIC, 4) != 0 ||
+        bundle->header->version != ASSET_BUNDLE_VERSION ||
+        sizeof(asset_bundle_header_t) + (size_t)bundle->header->entry_cnt *
+        sizeof(asset_bundle_entry_t) > bundle->map_size) {
+        LV_LOG_ERROR("%s is not a valid asset bundle", path);
+        asset_bundle_close(bundle);
+        return NULL;
+    }
+
+    if (bundle->header->color_depth != LV_COLOR_DEPTH) {
+        LV_LOG_WARN("%s was converted for a color depth of %u, the images are converted when drawn",
+                    path, bundle->header->color_depth);
+    }
+
+    if (bundle->header->stride_align % LV_DRAW_BUF_STRIDE_ALIGN != 0) {
+        LV_LOG_WARN("%s was converted with a stride alignment of %u instead of %u",
+                    path, bundle->header->stride_align, LV_DRAW_BUF_STRIDE_ALIGN);
+    }
+
+    bundle->images = calloc(bundle->header->entry_cnt, sizeof(lv_image_dsc_t));
+    bundle->fonts = calloc(bundle->header->entry_cnt, sizeof(lv_font_t *));
+    LV_ASSERT_NULL(bundle->images);
+    LV_ASSERT_NULL(bundle->fonts);
+
+    for (i = 0; i < bundle->header->entry_cnt; i++) {
+        entry = &bundle->entries[i];
+
+        if (!check_entry(bundle, entry)) {
+            LV_LOG_ERROR("%s: invalid entry %u", path, i);
+            asset_bundle_close(bundle);
+            return NULL;
+        }
+
+        if (entry->type != ASSET_BUNDLE_IMAGE) {
+            continue;
+        }
+
+        img = &bundle->images[i];
+        img->header.magic = LV_IMAGE_HEADER_MAGIC;
+        img->header.cf = entry->cf;
+        img->header.w = entry->width;
+        img->header.h = entry->height;
+        img->header.stride = entry->stride;
+        img->data_size = entry->size;
+        img->data = bundle->map + entry->offset;
+    }
+
+    /* Start reading ahead, the first screen uses most of the bundle */
+    madvise(bundle->map, bundle->map_size, MADV_WILLNEED);
+
+    LV_LOG_INFO("Mapped %u assets from %s", bundle->header->entry_cnt, path);
+    return bundle;
+}
+
+void asset_bundle_close(asset_bundle_t *bundle)
+{
+    uint32_t i;
+
+    if (bundle->images != NULL) {
+        for (i = 0; i < bundle->header->entry_cnt; i++) {
+            if (bundle->fonts[i] != NULL) {
+                lv_binfont_destroy(bundle->fonts[i]);
+            }
+
+            if (bundle->images[i].data != NULL) {
+                lv_image_cache_drop(&bundle->images[i]);
+            }
+        }
+    }
+
+    munmap(bundle->map, bundle->map_size);
+    free(bundle->images);
+    free(bundle->fonts);
+    free(bundle);
+}
+
+const lv_image_dsc_t *asset_bundle_get_image(asset_bundle_t *bundle, const char *name)
+{
+    int i = find_entry(bundle, name, ASSET_BUNDLE_IMAGE);
+
+    return i < 0 ? NULL : &bundle->images[i];
+}
+
+lv_font_t *asset_bundle_get_font(asset_bundle_t *bundle, const char *name)
+{
+    const asset_bundle_entry_t *entry;
+    int i = find_entry(bundle, name, ASSET_BUNDLE_FONT);
+
+    if (i < 0) {
+        return NULL;
+    }
+
+    if (bundle->fonts[i] == NULL) {
+#if LV_USE_FS_MEMFS
+        entry = &bundle->entries[i];
+
+        /* The glyphs are parsed from the mapping, no file is read */
+        bundle->fonts[i] = lv_binfont_create_from_buffer(bundle->map + entry->offset,
+                                                         (uint32_t)entry->size);
+        if (bundle->fonts[i] == NULL) {
+            LV_LOG_ERROR("Failed to load the font %s", name);
+        }
+#else
+        LV_UNUSED(entry);
+        LV_LOG_ERROR("Loading the font %s requires LV_USE_FS_MEMFS", name);
+#endif
+    }
+
+    return bundle->fonts[i];
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Check that an entry lies within the bundle
+ *
+ * @param bundle the bundle
+ * @param entry the entry
+ * @return true if the entry is valid
+ */
+static bool check_entry(const asset_bundle_t *bundle, const asset_bundle_entry_t *entry)
+{
+    uint32_t bpp;
+
+    if (memchr(entry->name, '\0', ASSET_BUNDLE_NAME_MAX) == NULL ||
+        entry->offset % ASSET_BUNDLE_DATA_ALIGN != 0 ||
+        entry->offset > bundle->map_size || entry->size > bundle->map_size - entry->offset) {
+        return false;
+    }
+
+    if (entry->type == ASSET_BUNDLE_IMAGE) {
+        bpp = lv_color_format_get_size(entry->cf);
+        if (bpp == 0 || entry->stride < (uint64_t)entry->width * bpp ||
+            entry->size < (uint64_t)entry->stride * entry->height) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Find an entry by name
+ *
+ * @return the index of the entry or -1
+ */
+static int find_entry(const asset_bundle_t *bundle, const char *name, asset_bundle_type_t type)
+{
+    const asset_bundle_entry_t *entry;
+
+    entry = bsearch(name, bundle->entries, bundle->header->entry_cnt,
+                    sizeof(asset_bundle_entry_t), compare_name);
+
+    if (entry == NULL || entry->type != (uint32_t)type) {
+        return -1;
+    }
+
+    return (int)(entry - bundle->entries);
+}
+
+/**
+ * Compare a name to the name of an entry
+ */
+static int compare_name(const void *key, const void *entry)
+{
+    return strcmp(key, ((const asset_bundle_entry_t *)entry)->name);
+}
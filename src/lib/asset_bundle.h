@@ -0,0 +1,120 @@
+/**
+ * @file asset_bundle.h
+ *
+ * Memory mapped bundle of pre-converted images and fonts
+ *
+ * The bundle is created on the host with lv_asset_pack (tools/),
+ * the images are stored in the color format of the display with the
+ * stride LVGL expects, and the fonts as LVGL binary fonts. At runtime
+ * the bundle is mapped read-only: the images are drawn directly from
+ * the page cache without decoding and the pages are shared between
+ * the processes using the same bundle. The fonts are not zero-copy,
+ * lv_binfont_create_from_buffer() parses them into heap allocations
+ *
+ * Layout: asset_bundle_header_t, the entries sorted by name, then the
+ * data of each entry aligned to ASSET_BUNDLE_DATA_ALIGN bytes
+ */
+
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define ASSET_BUNDLE_MAGIC "LVAB"
+#define ASSET_BUNDLE_VERSION 1
+
+#define ASSET_BUNDLE_NAME_MAX 48
+
+/* Alignment of the data of the entries in the file, and in memory */
+#define ASSET_BUNDLE_DATA_ALIGN 64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    ASSET_BUNDLE_IMAGE = 0,
+    ASSET_BUNDLE_FONT,          /* LVGL binary font, lv_font_conv --format bin */
+} asset_bundle_type_t;
+
+/* All fields are little endian */
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t entry_cnt;
+    uint32_t color_depth;       /* LV_COLOR_DEPTH the images were converted for */
+    uint32_t stride_align;      /* LV_DRAW_BUF_STRIDE_ALIGN the images were converted for */
+} asset_bundle_header_t;
+
+typedef struct {
+    char name[ASSET_BUNDLE_NAME_MAX];   /* Null terminated */
+    uint32_t type;                      /* asset_bundle_type_t */
+    uint32_t cf;                        /* lv_color_format_t of an image */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t reserved;
+    uint64_t offset;                    /* From the start of the file */
+    uint64_t size;
+} asset_bundle_entry_t;
+
+typedef struct _asset_bundle_t asset_bundle_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Map a bundle
+ * @param path the path of the bundle
+ * @return the bundle or NULL on error
+ */
+asset_bundle_t *asset_bundle_open(const char *path);
+
+/**
+ * @brief Unmap a bundle
+ * @description the images and fonts of the bundle must no longer be in use
+ * @param bundle the bundle
+ */
+void asset_bundle_close(asset_bundle_t *bundle);
+
+/**
+ * @brief Get an image of a bundle
+ * @param bundle the bundle
+ * @param name the name of the image
+ * @return the image descriptor, to use as lv_image_set_src source, or NULL if not found
+ */
+const lv_image_dsc_t *asset_bundle_get_image(asset_bundle_t *bundle, const char *name);
+
+/**
+ * @brief Get a font of a bundle
+ * @description the font is loaded on the first call into memory owned by
+ * the font, requires LV_USE_FS_MEMFS
+ * @param bundle the bundle
+ * @param name the name of the font
+ * @return the font or NULL if not found
+ */
+lv_font_t *asset_bundle_get_font(asset_bundle_t *bundle, const char *name);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*ASSET_BUNDLE_H*/
@@ -0,0 +1,236 @@
+/**
+ * @file async_flush.c
+ *
+ * Asynchronous flush of a display
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lvgl/lvgl.h"
+
+#include "backends.h"
+#include "async_flush.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_display_t *disp;
+    lv_display_flush_cb_t flush_cb;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    lv_area_t area;         /* The area of the pending flush */
+    uint8_t *px_map;
+    bool pending;           /* A flush is queued or running */
+    bool quit;
+} async_flush_ctx_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static async_flush_ctx_t *get_ctx(lv_display_t *disp);
+static void async_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void async_flush_wait_cb(lv_display_t *disp);
+static void *worker_thread(void *arg);
+static void delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static async_flush_ctx_t *ctxs[BACKEND_MAX_DISPLAYS];
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int async_flush_attach(lv_display_t *disp, lv_display_flush_cb_t flush_cb)
+{
+    async_flush_ctx_t *ctx;
+    int slot;
+
+    for (slot = 0; slot < BACKEND_MAX_DISPLAYS && ctxs[slot] != NULL; slot++);
+
+    if (slot == BACKEND_MAX_DISPLAYS) {
+        LV_LOG_ERROR("No asynchronous flush slot left");
+        return -1;
+    }
+
+    ctx = calloc(1, sizeof(async_flush_ctx_t));
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    ctx->disp = disp;
+    ctx->flush_cb = flush_cb;
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->cond, NULL);
+
+    if (pthread_create(&ctx->thread, NULL, worker_thread, ctx) != 0) {
+        LV_LOG_ERROR("Failed to start the flush worker");
+        pthread_cond_destroy(&ctx->cond);
+        pthread_mutex_destroy(&ctx->lock);
+        free(ctx);
+        return -1;
+    }
+
+    ctxs[slot] = ctx;
+
+    lv_display_set_flush_cb(disp, async_flush_cb);
+    lv_display_set_flush_wait_cb(disp, async_flush_wait_cb);
+    lv_display_add_event_cb(disp, delete_cb, LV_EVENT_DELETE, ctx);
+
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the context of a display
+ *
+ * @param disp the display
+ * @return the context or NULL
+ */
+static async_flush_ctx_t *get_ctx(lv_display_t *disp)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (ctxs[i] != NULL && ctxs[i]->disp == disp) {
+            return ctxs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Queue the flush of an area
+ *
+ * @description returns immediately, the previous flush was
+ * already waited for by LVGL
+ */
+static void async_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    async_flush_ctx_t *ctx = get_ctx(disp);
+
+    pthread_mutex_lock(&ctx->lock);
+
+    while (ctx->pending) {
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    }
+
+    ctx->area = *area;
+    ctx->px_map = px_map;
+    ctx->pending = true;
+
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * Wait for the pending flush
+ *
+ * @note called by LVGL before reusing a draw buffer
+ * @param disp the display
+ */
+static void async_flush_wait_cb(lv_display_t *disp)
+{
+    async_flush_ctx_t *ctx = get_ctx(disp);
+
+    pthread_mutex_lock(&ctx->lock);
+
+    while (ctx->pending) {
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * Run the queued flushes
+ *
+ * @param arg the context
+ * @return NULL
+ */
+static void *worker_thread(void *arg)
+{
+    async_flush_ctx_t *ctx = arg;
+    lv_area_t area;
+    uint8_t *px_map;
+
+    pthread_mutex_lock(&ctx->lock);
+
+    while (true) {
+        while (!ctx->pending && !ctx->quit) {
+            pthread_cond_wait(&ctx->cond, &ctx->lock);
+        }
+
+        if (!ctx->pending) {
+            break;
+        }
+
+        area = ctx->area;
+        px_map = ctx->px_map;
+        pthread_mutex_unlock(&ctx->lock);
+
+        /* Signals lv_display_flush_ready() */
+        ctx->flush_cb(ctx->disp, &area, px_map);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->pending = false;
+        pthread_cond_broadcast(&ctx->cond);
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+
+    return NULL;
+}
+
+/**
+ * Stop the worker when the display is deleted
+ *
+ * @description the pending flush is completed first
+ * @param e the delete event of the display
+ */
+static void delete_cb(lv_event_t *e)
+{
+    async_flush_ctx_t *ctx = lv_event_get_user_data(e);
+    int i;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->quit = true;
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+
+    pthread_join(ctx->thread, NULL);
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (ctxs[i] == ctx) {
+            ctxs[i] = NULL;
+        }
+    }
+
+    pthread_cond_destroy(&ctx->cond);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
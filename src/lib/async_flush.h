@@ -0,0 +1,62 @@
+/**
+ * @file async_flush.h
+ *
+ * Asynchronous flush of a display
+ *
+ * The flush callback of the backend runs on a worker thread, LVGL
+ * returns from the flush immediately and renders the next area into
+ * the other draw buffer while the pixels are copied and converted.
+ * The flush callback signals lv_display_flush_ready() from the worker
+ * as usual, LVGL waits for it through the flush wait callback before
+ * reusing a buffer.
+ *
+ * At most one flush is in flight, LVGL never starts a flush before the
+ * previous one is ready. The flush callback must not call other LVGL
+ * functions than lv_display_flush_ready() and lv_display_flush_is_last()
+ */
+
+#ifndef ASYNC_FLUSH_H
+#define ASYNC_FLUSH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Run the flush callback of a display on a worker thread
+ * @description replaces the flush callback and the flush wait callback of
+ * the display, the worker is stopped when the display is deleted.
+ * Call before adding the delete event callback that releases the
+ * resources used by the flush callback, so that the worker is stopped first
+ * @param disp the display
+ * @param flush_cb the flush callback of the backend
+ * @return 0 on success, -1 on error, the display is left unchanged
+ */
+int async_flush_attach(lv_display_t *disp, lv_display_flush_cb_t flush_cb);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*ASYNC_FLUSH_H*/
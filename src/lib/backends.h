@@ -18,11 +18,18 @@ extern "C" {
 /*********************
  *      INCLUDES
  *********************/
+#include <stdint.h>
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Maximum number of displays active at once, i.e a main panel and a status panel */
+#define BACKEND_MAX_DISPLAYS 4
+
+/* Returned by an indev initialization function waiting for its device to be plugged */
+#define BACKEND_INDEV_PENDING ((lv_indev_t *)-1)
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -36,10 +43,11 @@ typedef void (*run_loop_t)(void);
 typedef struct {
     display_init_t init_display; /* The display creation/initialization function */
     run_loop_t run_loop;         /* The run loop of the driver handle */
-    lv_display_t *display;       /* The LVGL display that was created */
+    lv_display_t *display;       /* The LVGL display that was created last */
 } display_backend_t;
 
-/* Prototype for the initialization of an indev driver backend */
+/* Prototype for the initialization of an indev driver backend,
+ * returns NULL on error or BACKEND_INDEV_PENDING while waiting for the device */
 typedef lv_indev_t *(*indev_init_t)(lv_display_t *display);
 
 /* Represents an indev driver backend */
@@ -80,9 +88,28 @@ int backend_init_sdl(backend_t *backend);
 int backend_init_glfw3(backend_t *backend);
 int backend_init_wayland(backend_t *backend);
 int backend_init_x11(backend_t *backend);
+int backend_init_headless(backend_t *backend);
 
 /* Input device driver backends */
 int backend_init_evdev(backend_t *backend);
+int backend_init_replay(backend_t *backend);
+
+/**
+ * @brief Read a setting of the display being initialized
+ * @description for the display n, added after the first one, NAME_<n>
+ * takes precedence over NAME, i.e LV_LINUX_DRM_CONNECTOR_1
+ * @param name the name of the environment variable
+ * @param default_val returned if neither is set
+ * @return the value
+ */
+const char *backend_getenv(const char *name, const char *default_val);
+
+/**
+ * @brief Get the index of the display being initialized
+ * @description valid while the display or an input device is initialized
+ * @return 0 for the first display
+ */
+uint32_t backend_display_index(void);
 
 /**********************
  *      MACROS
@@ -0,0 +1,279 @@
+/**
+ * @file boot_timing.c
+ *
+ * Startup time report
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lvgl/lvgl.h"
+
+#include "simulator_util.h"
+#include "frame_stats.h"
+#include "boot_timing.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define BOOT_TIMING_MAX_STAGES 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    char name[48];
+    uint64_t start_us;      /* Since the exec of the process */
+    uint64_t dur_us;
+} boot_stage_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static uint64_t exec_time_us(void);
+static void add_stage(const char *name, uint64_t start_us, uint64_t dur_us);
+static void display_event_cb(lv_event_t *e);
+static void log_report(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static bool enabled;
+static bool done;           /* The report was logged */
+static uint64_t origin_us;  /* The exec of the process, on the clock of frame_stats_now_us */
+static uint64_t init_us;    /* The call of boot_timing_init, at the top of main */
+static uint64_t last_end_us;
+
+static boot_stage_t stages[BOOT_TIMING_MAX_STAGES];
+static uint32_t stage_cnt;
+
+static lv_display_t *first_disp;
+static uint64_t frame_start;
+static uint64_t flush_start;
+static uint64_t flush_time;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void boot_timing_init(void)
+{
+    if (enabled || done) {
+        return;
+    }
+
+    if (getenv_default("LV_SIM_BOOT_TIMING", "1")[0] == '0') {
+        done = true;
+        return;
+    }
+
+    enabled = true;
+    init_us = frame_stats_now_us();
+    origin_us = exec_time_us();
+
+    add_stage("exec to main", origin_us, init_us - origin_us);
+}
+
+void boot_timing_add(const char *stage, const char *name, uint64_t start_us)
+{
+    char full[48];
+
+    if (!enabled || done) {
+        return;
+    }
+
+    snprintf(full, sizeof(full), "%s%s%s", stage, name != NULL ? " " : "",
+             name != NULL ? name : "");
+    add_stage(full, start_us, frame_stats_now_us() - start_us);
+}
+
+void boot_timing_add_since_last(const char *stage)
+{
+    if (!enabled || done) {
+        return;
+    }
+
+    boot_timing_add(stage, NULL, last_end_us);
+}
+
+void boot_timing_attach(lv_display_t *disp)
+{
+    if (!enabled || done || first_disp != NULL) {
+        return;
+    }
+
+    first_disp = disp;
+
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_READY, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_FINISH, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_WAIT_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_WAIT_FINISH, NULL);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the time of the exec of the process
+ *
+ * @description the start time in /proc/self/stat is in clock ticks
+ * since the boot, it is moved to the clock of frame_stats_now_us.
+ * It is only as precise as a clock tick, usually 10 ms
+ * @return the time of the exec or the time of boot_timing_init if it's unknown
+ */
+static uint64_t exec_time_us(void)
+{
+    uint64_t now = init_us;
+    unsigned long long start_ticks;
+    struct timespec boot;
+    uint64_t since_boot;
+    uint64_t start_boot;
+    char buf[1024];
+    const char *p;
+    size_t len;
+    FILE *f;
+    int i;
+
+    f = fopen("/proc/self/stat", "r");
+    if (f == NULL) {
+        return now;
+    }
+
+    len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+
+    /* The name of the command can contain spaces, the fields follow the last parenthesis */
+    p = strrchr(buf, ')');
+    if (p == NULL || clock_gettime(CLOCK_BOOTTIME, &boot) < 0) {
+        return now;
+    }
+
+    /* The start time is the 22nd field, the 20th after the name */
+    for (i = 0; i < 20 && p != NULL; i++) {
+        p = strchr(p + 1, ' ');
+    }
+
+    if (p == NULL || sscanf(p, "%llu", &start_ticks) != 1) {
+        return now;
+    }
+
+    since_boot = (uint64_t)boot.tv_sec * 1000000ULL + (uint64_t)boot.tv_nsec / 1000ULL;
+    start_boot = (uint64_t)start_ticks * 1000000ULL / (uint64_t)sysconf(_SC_CLK_TCK);
+
+    if (start_boot > since_boot || since_boot - start_boot > now) {
+        return now;
+    }
+
+    return now - (since_boot - start_boot);
+}
+
+/**
+ * Append a stage to the report
+ *
+ * @param name the name of the stage
+ * @param start_us the start of the stage, from frame_stats_now_us
+ * @param dur_us the duration of the stage
+ */
+static void add_stage(const char *name, uint64_t start_us, uint64_t dur_us)
+{
+    boot_stage_t *s;
+
+    if (stage_cnt == BOOT_TIMING_MAX_STAGES) {
+        return;
+    }
+
+    s = &stages[stage_cnt++];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->start_us = start_us - origin_us;
+    s->dur_us = dur_us;
+
+    last_end_us = start_us + dur_us;
+}
+
+/**
+ * Time the first frame
+ *
+ * @description the flush time includes the waits for the flush,
+ * the render time is the rest of the frame
+ * @param e the render or flush event
+ */
+static void display_event_cb(lv_event_t *e)
+{
+    uint64_t now = frame_stats_now_us();
+
+    if (done) {
+        return;
+    }
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_RENDER_START:
+        frame_start = now;
+        flush_time = 0;
+        break;
+    case LV_EVENT_FLUSH_START:
+    case LV_EVENT_FLUSH_WAIT_START:
+        flush_start = now;
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        flush_time += now - flush_start;
+        break;
+    case LV_EVENT_RENDER_READY:
+        if (frame_start == 0) {
+            break;
+        }
+
+        /* The flushes are interleaved with the rendering, reported as if they followed it */
+        add_stage("first render", frame_start, now - frame_start - LV_MIN(flush_time, now - frame_start));
+        add_stage("first flush", now - flush_time, flush_time);
+        log_report();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Log the stages of the startup
+ *
+ * @description the time of the first pixel is the end of the first frame.
+ * The exec is only known to a clock tick, the times since main are exact
+ */
+static void log_report(void)
+{
+    uint64_t now = frame_stats_now_us();
+    uint64_t end = now - origin_us;
+    uint32_t i;
+
+    LV_LOG_USER("Startup timing (us since exec, exec known to %ld us):", 1000000L / sysconf(_SC_CLK_TCK));
+
+    for (i = 0; i < stage_cnt; i++) {
+        LV_LOG_USER("  %-40s %10llu at %10llu", stages[i].name,
+                    (unsigned long long)stages[i].dur_us, (unsigned long long)stages[i].start_us);
+    }
+
+    LV_LOG_USER("First frame flushed %.1f ms after exec, %.1f ms after main",
+                (double)end / 1000.0, (double)(now - init_us) / 1000.0);
+
+    done = true;
+}
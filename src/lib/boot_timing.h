@@ -0,0 +1,82 @@
+/**
+ * @file boot_timing.h
+ *
+ * Startup time report
+ *
+ * The stages of the startup are timed, from the exec of the process to
+ * the first frame on the first display: the time until main, lv_init,
+ * the application until the backends are registered, the registration of each
+ * backend that is used, the initialization of each display and input
+ * device (including the discovery of the devices), and the rendering and
+ * flushing of the first frame. The report is logged once the first frame
+ * was flushed, unless LV_SIM_BOOT_TIMING is set to 0
+ *
+ * The exec time comes from /proc/self/stat and is only known to a clock
+ * tick (10 ms with USER_HZ 100), the other stages use the monotonic clock
+ */
+
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Start the report, call it at the top of main
+ * @description the start time of the process is read from /proc/self/stat,
+ * the time since then is recorded as the first stage. Called again by
+ * driver_backends_register if main didn't, does nothing if called again
+ */
+void boot_timing_init(void);
+
+/**
+ * @brief Record a stage of the startup
+ * @description ignored once the report was logged
+ * @param stage the name of the stage, i.e "display"
+ * @param name the name of the backend or NULL
+ * @param start_us the start of the stage, from frame_stats_now_us
+ */
+void boot_timing_add(const char *stage, const char *name, uint64_t start_us);
+
+/**
+ * @brief Record the time since the end of the previous stage as a stage
+ * @param stage the name of the stage, i.e "application"
+ */
+void boot_timing_add_since_last(const char *stage);
+
+/**
+ * @brief Time the first frame of a display and log the report after it
+ * @description only the first display attached is timed
+ * @param disp the display
+ */
+void boot_timing_attach(lv_display_t *disp);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*BOOT_TIMING_H*/
@@ -0,0 +1,188 @@
+/**
+ * @file damage.c
+ *
+ * Damage region tracking
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+#include "damage.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Merge two rectangles if the union adds less than 1/4 of extra pixels */
+#define DAMAGE_MERGE_WASTE_DIV 4
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void area_union(lv_area_t *res, const lv_area_t *a, const lv_area_t *b);
+static uint32_t area_size(const lv_area_t *a);
+static bool should_merge(const lv_area_t *a, const lv_area_t *b);
+static void remove_rect(damage_t *damage, uint32_t idx);
+static void merge_closest(damage_t *damage);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void damage_reset(damage_t *damage)
+{
+    damage->count = 0;
+}
+
+void damage_add(damage_t *damage, const lv_area_t *area)
+{
+    lv_area_t cur = *area;
+    bool merged;
+    uint32_t i;
+
+    if (cur.x2 < cur.x1 || cur.y2 < cur.y1) {
+        return;
+    }
+
+    /* Grow the new rectangle until it can't absorb any other one */
+    do {
+        merged = false;
+        for (i = 0; i < damage->count; i++) {
+            if (should_merge(&cur, &damage->rects[i])) {
+                area_union(&cur, &cur, &damage->rects[i]);
+                remove_rect(damage, i);
+                merged = true;
+                break;
+            }
+        }
+    } while (merged);
+
+    if (damage->count == DAMAGE_MAX_RECTS) {
+        merge_closest(damage);
+    }
+
+    damage->rects[damage->count++] = cur;
+}
+
+void damage_add_all(damage_t *dst, const damage_t *src)
+{
+    uint32_t i;
+
+    for (i = 0; i < src->count; i++) {
+        damage_add(dst, &src->rects[i]);
+    }
+}
+
+uint32_t damage_get_size(const damage_t *damage)
+{
+    uint32_t size = 0;
+    uint32_t i;
+
+    for (i = 0; i < damage->count; i++) {
+        size += area_size(&damage->rects[i]);
+    }
+
+    return size;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void area_union(lv_area_t *res, const lv_area_t *a, const lv_area_t *b)
+{
+    res->x1 = LV_MIN(a->x1, b->x1);
+    res->y1 = LV_MIN(a->y1, b->y1);
+    res->x2 = LV_MAX(a->x2, b->x2);
+    res->y2 = LV_MAX(a->y2, b->y2);
+}
+
+static uint32_t area_size(const lv_area_t *a)
+{
+    return (uint32_t)(a->x2 - a->x1 + 1) * (uint32_t)(a->y2 - a->y1 + 1);
+}
+
+/**
+ * Decide if two rectangles are worth merging
+ *
+ * @description a rectangle containing the other is always merged,
+ * otherwise the bounding box may only add a small amount of pixels
+ * that were not damaged
+ */
+static bool should_merge(const lv_area_t *a, const lv_area_t *b)
+{
+    lv_area_t u;
+    uint32_t parts;
+    uint32_t total;
+
+    area_union(&u, a, b);
+    total = area_size(&u);
+    parts = area_size(a) + area_size(b);
+
+    if (total <= area_size(a) || total <= area_size(b)) {
+        return true;
+    }
+
+    return total <= parts + parts / DAMAGE_MERGE_WASTE_DIV;
+}
+
+static void remove_rect(damage_t *damage, uint32_t idx)
+{
+    damage->count--;
+    damage->rects[idx] = damage->rects[damage->count];
+}
+
+/**
+ * Make room in a full list
+ *
+ * @description merges the pair of rectangles whose
+ * bounding box adds the least amount of pixels
+ */
+static void merge_closest(damage_t *damage)
+{
+    uint32_t best_i = 0;
+    uint32_t best_j = 1;
+    uint32_t best_cost = UINT32_MAX;
+    uint32_t cost;
+    lv_area_t u;
+    uint32_t i, j;
+
+    for (i = 0; i < damage->count; i++) {
+        for (j = i + 1; j < damage->count; j++) {
+            area_union(&u, &damage->rects[i], &damage->rects[j]);
+            cost = area_size(&u) - area_size(&damage->rects[i]) - area_size(&damage->rects[j]);
+
+            /* Overlapping rectangles underflow - they are the best candidates */
+            if (cost > area_size(&u)) {
+                cost = 0;
+            }
+
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+
+    area_union(&damage->rects[best_i], &damage->rects[best_i], &damage->rects[best_j]);
+    remove_rect(damage, best_j);
+}
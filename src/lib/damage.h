@@ -0,0 +1,94 @@
+/**
+ * @file damage.h
+ *
+ * Damage region tracking
+ *
+ * Collects the areas invalidated during a frame into a short list
+ * of rectangles, overlapping or nearby areas are merged so that
+ * a backend only has to copy each changed pixel once
+ */
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Maximum number of rectangles tracked per frame */
+#define DAMAGE_MAX_RECTS 16
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_area_t rects[DAMAGE_MAX_RECTS];
+    uint32_t count;
+} damage_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Empty the damage list
+ * @param damage the damage list
+ */
+void damage_reset(damage_t *damage);
+
+/**
+ * @brief Add an area to the damage list
+ * @description the area is merged with the existing rectangles
+ * if the union doesn't cover much more pixels than the parts,
+ * when the list is full the two closest rectangles are merged
+ * @param damage the damage list
+ * @param area the area to add
+ */
+void damage_add(damage_t *damage, const lv_area_t *area);
+
+/**
+ * @brief Add all the rectangles of a damage list to another one
+ * @param dst the damage list to extend
+ * @param src the damage list to add
+ */
+void damage_add_all(damage_t *dst, const damage_t *src);
+
+/**
+ * @brief Get the number of pixels covered by the damage list
+ * @param damage the damage list
+ * @return the number of pixels, overlaps are counted once per rectangle
+ */
+uint32_t damage_get_size(const damage_t *damage);
+
+/**
+ * @brief Check if a damage list is empty
+ * @param damage the damage list
+ * @return true if nothing was damaged
+ */
+static inline bool damage_is_empty(const damage_t *damage)
+{
+    return damage->count == 0;
+}
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*DAMAGE_H*/
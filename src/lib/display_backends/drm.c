@@ -9,6 +9,20 @@
  * - Move to a separate file
  *   2025 EDGEMTech Ltd.
  *
+ * - Add page flip mode using atomic KMS commits
+ *
+ * - Export the draw buffers of the page flip mode as DMA-BUFs
+ *
+ * - Blank the display by deactivating the CRTC when idle
+ *
+ * - Rotate the damaged areas into the buffers of the page flip mode
+ *
+ * - Re-initialize the display backend on connector hotplug
+ *
+ * - Drive several connectors of a card, one display per connector
+ *
+ * - Share the exported buffers with the frame export consumers
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -19,33 +33,160 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_LINUX_DRM
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <drm_fourcc.h>
+
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../driver_backends.h"
+#include "../event_loop.h"
+#include "../drm_export.h"
+#include "../damage.h"
+#include "../pixel_convert.h"
+#include "../frame_governor.h"
+#include "../rt_sched.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* The number of buffers used in page flip mode - LVGL swaps between two draw buffers */
+#define DRM_BUFFER_COUNT 2
+
+#if LV_COLOR_DEPTH == 16
+#define DRM_FOURCC DRM_FORMAT_RGB565
+#define DRM_BPP    16
+#else
+#define DRM_FOURCC DRM_FORMAT_XRGB8888
+#define DRM_BPP    32
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+typedef struct {
+    uint32_t handle;
+    uint32_t pitch;
+    uint32_t fb_id;
+    uint64_t size;
+    uint8_t *map;
+    int dmabuf_fd;          /* PRIME export of the buffer, -1 if unavailable */
+} drm_buffer_t;
+
+/* Property IDs used by the atomic commits */
+typedef struct {
+    uint32_t conn_crtc_id;
+    uint32_t crtc_mode_id;
+    uint32_t crtc_active;
+    uint32_t plane_fb_id;
+    uint32_t plane_crtc_id;
+    uint32_t plane_src_x;
+    uint32_t plane_src_y;
+    uint32_t plane_src_w;
+    uint32_t plane_src_h;
+    uint32_t plane_crtc_x;
+    uint32_t plane_crtc_y;
+    uint32_t plane_crtc_w;
+    uint32_t plane_crtc_h;
+} drm_props_t;
+
+typedef struct {
+    int fd;
+    uint32_t conn_id;
+    uint32_t crtc_id;
+    uint32_t plane_id;
+    uint32_t plane_type;    /* DRM_PLANE_TYPE_PRIMARY or DRM_PLANE_TYPE_OVERLAY */
+    uint32_t mode_blob_id;
+    drmModeModeInfo mode;
+    drm_props_t props;
+    drm_buffer_t buffers[DRM_BUFFER_COUNT];
+    int front;              /* Index of the buffer being scanned out */
+    int pending;            /* Index of the buffer waiting for the flip, -1 if none */
+    bool modeset_done;
+    lv_display_t *disp;
+    uint32_t rotation;      /* Clockwise rotation applied when copying, 0 to render directly */
+    uint8_t *shadow;        /* Draw buffer of a rotated panel */
+    uint32_t shadow_stride;
+    const pixel_convert_ops_t *convert;
+    damage_t damage;        /* Areas flushed during the current frame */
+    damage_t prev_damage;   /* Areas of the previous frame, missing from the back buffer */
+    int uevent_fd;          /* Kernel uevents, signal the connector hotplugs */
+    bool reinit_pending;
+    uint32_t index;         /* Index of the display, see backend_display_index */
+} drm_ctx_t;
+
+/* A card opened by the page flip mode, only the DRM master can modeset,
+ * the displays of the connectors of a card share its file descriptor */
+typedef struct {
+    char path[64];
+    int fd;
+    uint32_t refcnt;
+} drm_card_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 static void run_loop_drm(void);
 static lv_display_t *init_drm(void);
 
+static lv_display_t *init_drm_page_flip(const char *device);
+static int drm_open_card(const char *device);
+static void drm_close_card(int fd);
+static drm_ctx_t *drm_get_ctx(lv_display_t *disp);
+static bool drm_is_used(drm_ctx_t *ctx, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id);
+static bool drm_connector_matches(drmModeConnectorPtr conn, const char *name);
+static int drm_setup_pipe(drm_ctx_t *ctx);
+static bool drm_plane_matches(drm_ctx_t *ctx, drmModePlanePtr plane, uint32_t crtc_mask);
+static int drm_find_props(drm_ctx_t *ctx);
+static uint32_t drm_get_prop_id(int fd, uint32_t obj_id, uint32_t obj_type, const char *name);
+static int drm_create_buffer(drm_ctx_t *ctx, drm_buffer_t *buf);
+static void drm_destroy_buffer(drm_ctx_t *ctx, drm_buffer_t *buf);
+static int drm_commit(drm_ctx_t *ctx, int idx);
+static void drm_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void drm_rotate_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void drm_rotate_damage(drm_ctx_t *ctx, const damage_t *damage, int idx);
+static void drm_flush_wait_cb(lv_display_t *disp);
+static void drm_wait_flip(drm_ctx_t *ctx);
+static int drm_blank_cb(lv_display_t *disp, bool blank);
+static void drm_event_cb(int fd, uint32_t events, void *user_data);
+static void drm_page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                                  unsigned int tv_usec, void *user_data);
+static int drm_open_uevents(void);
+static void drm_uevent_cb(int fd, uint32_t events, void *user_data);
+static bool drm_connector_changed(drm_ctx_t *ctx);
+static void drm_reinit_async_cb(void *user_data);
+static void drm_delete_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 static char *backend_name = "DRM";
 
+/* The displays in page flip mode, their buffers can be exported */
+static drm_ctx_t *page_flip_ctxs[BACKEND_MAX_DISPLAYS];
+
+static drm_card_t cards[BACKEND_MAX_DISPLAYS];
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
 /**********************
  *      MACROS
  **********************/
@@ -75,6 +216,43 @@ int backend_init_drm(backend_t *backend)
     return 0;
 }
 
+int drm_export_get_buffers(lv_display_t *disp, drm_dmabuf_t *bufs, int max)
+{
+    drm_ctx_t *ctx = drm_get_ctx(disp);
+    int i;
+
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < DRM_BUFFER_COUNT && i < max; i++) {
+        if (ctx->buffers[i].dmabuf_fd < 0) {
+            return -1;
+        }
+
+        bufs[i].fd = ctx->buffers[i].dmabuf_fd;
+        bufs[i].width = ctx->mode.hdisplay;
+        bufs[i].height = ctx->mode.vdisplay;
+        bufs[i].stride = ctx->buffers[i].pitch;
+        bufs[i].offset = 0;
+        bufs[i].fourcc = DRM_FOURCC;
+        bufs[i].modifier = DRM_FORMAT_MOD_LINEAR;
+    }
+
+    return i;
+}
+
+int drm_export_get_front(lv_display_t *disp)
+{
+    drm_ctx_t *ctx = drm_get_ctx(disp);
+
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    return ctx->pending != -1 ? ctx->pending : ctx->front;
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
@@ -82,36 +260,1106 @@ int backend_init_drm(backend_t *backend)
 /**
  * Initialize the DRM display driver
  *
+ * @description if LV_LINUX_DRM_ATOMIC is set to 1, the page flip mode
+ * is used and falls back to the LVGL DRM driver if the device doesn't
+ * support atomic modesetting.
+ * LV_LINUX_DRM_CONNECTOR selects the connector by ID or name, i.e HDMI-A-1
  * @return the LVGL display
  */
 static lv_display_t *init_drm(void)
 {
-    const char *device = getenv_default("LV_LINUX_DRM_CARD", "/dev/dri/card0");
-    lv_display_t * disp = lv_linux_drm_create();
+    const char *device = backend_getenv("LV_LINUX_DRM_CARD", "/dev/dri/card0");
+    const char *atomic = backend_getenv("LV_LINUX_DRM_ATOMIC", "0");
+    const char *connector = backend_getenv("LV_LINUX_DRM_CONNECTOR", NULL);
+    int64_t conn_id = -1;
+    char *end;
+    lv_display_t * disp;
+
+    if (atomic[0] == '1') {
+        disp = init_drm_page_flip(device);
+
+        if (disp != NULL) {
+            return disp;
+        }
+
+        LV_LOG_WARN("Atomic page flip mode unavailable, falling back to the DRM driver");
+    }
+
+    /* Nothing is exported here, with LV_LINUX_DRM_USE_EGL the driver uploads each frame */
+    disp = lv_linux_drm_create();
 
     if (disp == NULL) {
         return NULL;
     }
 
-    lv_linux_drm_set_file(disp, device, -1);
+    if (connector != NULL) {
+        conn_id = strtol(connector, &end, 10);
+
+        if (*end != '\0') {
+            LV_LOG_WARN("The DRM driver only selects connectors by ID, using the first one");
+            conn_id = -1;
+        }
+    }
+
+    lv_linux_drm_set_file(disp, device, conn_id);
+
+    /* Rotated by LVGL after rendering, the whole frame is rotated */
+    lv_display_set_rotation(disp, settings.rotation / 90);
 
     return disp;
 }
 
+/**
+ * Create a display that presents through atomic page flips
+ *
+ * @description LVGL renders directly into two dumb buffers, each frame
+ * is presented with a non-blocking atomic commit and the next frame is
+ * started once the page flip completion event is received.
+ * The buffers are exported as DMA-BUFs, see drm_export.h.
+ * They are put on the primary plane, or on an overlay plane
+ * if LV_LINUX_DRM_PLANE is set to overlay.
+ * On a rotated panel, LVGL renders at the rotated resolution into a
+ * shadow buffer and the damaged areas are rotated into the back buffer.
+ * Each display drives a connector of the card not used by the others
+ * @param device the path of the DRM card
+ * @return the LVGL display or NULL on failure
+ */
+static lv_display_t *init_drm_page_flip(const char *device)
+{
+    drm_ctx_t *ctx;
+    lv_display_t *disp;
+    int i;
+
+    ctx = calloc(1, sizeof(drm_ctx_t));
+    LV_ASSERT_NULL(ctx);
+
+    ctx->pending = -1;
+    ctx->uevent_fd = -1;
+    ctx->index = backend_display_index();
+    ctx->plane_type = strcmp(backend_getenv("LV_LINUX_DRM_PLANE", "primary"), "overlay") == 0 ?
+                      DRM_PLANE_TYPE_OVERLAY : DRM_PLANE_TYPE_PRIMARY;
+
+    for (i = 0; i < DRM_BUFFER_COUNT; i++) {
+        ctx->buffers[i].dmabuf_fd = -1;
+    }
+
+    ctx->fd = drm_open_card(device);
+
+    if (ctx->fd < 0) {
+        free(ctx);
+        return NULL;
+    }
+
+    if (drm_setup_pipe(ctx) < 0 || drm_find_props(ctx) < 0) {
+        goto err_close;
+    }
+
+    for (i = 0; i < DRM_BUFFER_COUNT; i++) {
+        if (drm_create_buffer(ctx, &ctx->buffers[i]) < 0) {
+            goto err_buffers;
+        }
+    }
+
+    if (drmModeCreatePropertyBlob(ctx->fd, &ctx->mode, sizeof(ctx->mode),
+                                  &ctx->mode_blob_id) < 0) {
+        LV_LOG_ERROR("Failed to create the mode blob");
+        goto err_buffers;
+    }
+
+    /* Perform the modeset with the first buffer */
+    if (drm_commit(ctx, 0) < 0) {
+        goto err_blob;
+    }
+
+    drm_wait_flip(ctx);
+
+    ctx->rotation = settings.rotation;
+
+    if (ctx->rotation == 90 || ctx->rotation == 270) {
+        disp = lv_display_create(ctx->mode.vdisplay, ctx->mode.hdisplay);
+    } else {
+        disp = lv_display_create(ctx->mode.hdisplay, ctx->mode.vdisplay);
+    }
+
+    if (disp == NULL) {
+        goto err_blob;
+    }
+
+    ctx->disp = disp;
+    page_flip_ctxs[ctx->index] = ctx;
+    lv_display_set_driver_data(disp, ctx);
+    lv_display_set_flush_wait_cb(disp, drm_flush_wait_cb);
+
+    if (ctx->rotation != 0) {
+        ctx->convert = pixel_convert_get_ops();
+        ctx->shadow_stride = lv_display_get_horizontal_resolution(disp) * (DRM_BPP / 8);
+        ctx->shadow = malloc((size_t)ctx->shadow_stride * lv_display_get_vertical_resolution(disp));
+
+        if (ctx->shadow == NULL) {
+            ctx->disp = NULL;
+            page_flip_ctxs[ctx->index] = NULL;
+            lv_display_delete(disp);
+            goto err_blob;
+        }
+
+        lv_display_set_flush_cb(disp, drm_rotate_flush_cb);
+        lv_display_set_buffers_with_stride(disp, ctx->shadow, NULL,
+                                           ctx->shadow_stride * lv_display_get_vertical_resolution(disp),
+                                           ctx->shadow_stride, LV_DISPLAY_RENDER_MODE_DIRECT);
+    } else {
+        /* The modeset scans out the front buffer, the first frame is rendered into the back one */
+        lv_display_set_flush_cb(disp, drm_flush_cb);
+        lv_display_set_buffers_with_stride(disp, ctx->buffers[1 - ctx->front].map,
+                                           ctx->buffers[ctx->front].map,
+                                           ctx->buffers[0].size, ctx->buffers[0].pitch,
+                                           LV_DISPLAY_RENDER_MODE_DIRECT);
+    }
+
+    ctx->uevent_fd = drm_open_uevents();
+    if (ctx->uevent_fd >= 0 && event_loop_add_fd(ctx->uevent_fd, EPOLLIN, drm_uevent_cb, ctx) < 0) {
+        close(ctx->uevent_fd);
+        ctx->uevent_fd = -1;
+    }
+
+    if (ctx->uevent_fd < 0) {
+        LV_LOG_WARN("Connector hotplugs are not monitored");
+    }
+
+    lv_display_add_event_cb(disp, drm_delete_cb, LV_EVENT_DELETE, ctx);
+
+    frame_governor_set_blank_cb(disp, drm_blank_cb);
+
+    LV_LOG_USER("DRM page flip mode on connector %u, %ux%u@%u, rotated by %u", ctx->conn_id,
+                ctx->mode.hdisplay, ctx->mode.vdisplay, ctx->mode.vrefresh, ctx->rotation);
+
+    return disp;
+
+err_blob:
+    drmModeDestroyPropertyBlob(ctx->fd, ctx->mode_blob_id);
+err_buffers:
+    for (i = 0; i < DRM_BUFFER_COUNT; i++) {
+        drm_destroy_buffer(ctx, &ctx->buffers[i]);
+    }
+err_close:
+    drm_close_card(ctx->fd);
+    free(ctx);
+    return NULL;
+}
 
 /**
- * The run loop of the DRM driver
+ * Open a DRM card for atomic modesetting
+ *
+ * @description a card already opened by another display is shared,
+ * its events are dispatched by the event loop to the displays that commit
+ * @param device the path of the DRM card
+ * @return the file descriptor or -1 on error
  */
-static void run_loop_drm(void)
+static int drm_open_card(const char *device)
+{
+    drm_card_t *card = NULL;
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (cards[i].refcnt > 0 && strcmp(cards[i].path, device) == 0) {
+            cards[i].refcnt++;
+            return cards[i].fd;
+        }
+
+        if (cards[i].refcnt == 0 && card == NULL) {
+            card = &cards[i];
+        }
+    }
+
+    if (card == NULL) {
+        return -1;
+    }
+
+    card->fd = open(device, O_RDWR | O_CLOEXEC);
+
+    if (card->fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", device, strerror(errno));
+        return -1;
+    }
+
+    if (drmSetClientCap(card->fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) < 0 ||
+        drmSetClientCap(card->fd, DRM_CLIENT_CAP_ATOMIC, 1) < 0) {
+        LV_LOG_WARN("%s doesn't support atomic modesetting", device);
+        close(card->fd);
+        return -1;
+    }
+
+    if (event_loop_add_fd(card->fd, EPOLLIN, drm_event_cb, NULL) < 0) {
+        LV_LOG_WARN("DRM events are only handled while waiting for a flush");
+    }
+
+    snprintf(card->path, sizeof(card->path), "%s", device);
+    card->refcnt = 1;
+    return card->fd;
+}
+
+/**
+ * Release a DRM card
+ *
+ * @description the card is closed once no display uses it
+ * @param fd the file descriptor returned by drm_open_card
+ */
+static void drm_close_card(int fd)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (cards[i].refcnt > 0 && cards[i].fd == fd && --cards[i].refcnt == 0) {
+            event_loop_remove_fd(fd);
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Get the context of a display in page flip mode
+ *
+ * @param disp the display
+ * @return the context or NULL
+ */
+static drm_ctx_t *drm_get_ctx(lv_display_t *disp)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (page_flip_ctxs[i] != NULL && page_flip_ctxs[i]->disp == disp) {
+            return page_flip_ctxs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Check if a KMS object is driven by another display
+ *
+ * @param ctx the DRM context
+ * @param conn_id a connector ID or 0
+ * @param crtc_id a CRTC ID or 0
+ * @param plane_id a plane ID or 0
+ * @return true if another display of the card uses one of the objects
+ */
+static bool drm_is_used(drm_ctx_t *ctx, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id)
+{
+    drm_ctx_t *other;
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        other = page_flip_ctxs[i];
+
+        if (other == NULL || other == ctx || other->fd != ctx->fd) {
+            continue;
+        }
+
+        if ((conn_id != 0 && other->conn_id == conn_id) ||
+            (crtc_id != 0 && other->crtc_id == crtc_id) ||
+            (plane_id != 0 && other->plane_id == plane_id)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Check if a connector is the one selected with LV_LINUX_DRM_CONNECTOR
+ *
+ * @param conn the connector
+ * @param name the ID or name of the connector i.e HDMI-A-1, NULL for any
+ * @return true if the connector matches
+ */
+static bool drm_connector_matches(drmModeConnectorPtr conn, const char *name)
+{
+    const char *type_name;
+    char conn_name[32];
+    char *end;
+    unsigned long id;
+
+    if (name == NULL) {
+        return true;
+    }
+
+    id = strtoul(name, &end, 10);
+    if (*end == '\0') {
+        return id == conn->connector_id;
+    }
+
+    type_name = drmModeGetConnectorTypeName(conn->connector_type);
+    if (type_name == NULL) {
+        return false;
+    }
+
+    snprintf(conn_name, sizeof(conn_name), "%s-%u", type_name, conn->connector_type_id);
+    return strcmp(conn_name, name) == 0;
+}
+
+/**
+ * Select the connector, CRTC, mode and primary plane
+ *
+ * @param ctx the DRM context
+ * @return 0 on success, -1 on error
+ */
+static int drm_setup_pipe(drm_ctx_t *ctx)
+{
+    drmModeResPtr res;
+    drmModeConnectorPtr conn = NULL;
+    drmModeEncoderPtr enc;
+    drmModePlaneResPtr planes;
+    drmModePlanePtr plane;
+    const char *conn_name = backend_getenv("LV_LINUX_DRM_CONNECTOR", NULL);
+    uint32_t crtc_mask = 0;
+    uint32_t i, j;
+    int k;
+
+    res = drmModeGetResources(ctx->fd);
+    if (res == NULL) {
+        LV_LOG_ERROR("drmModeGetResources failed");
+        return -1;
+    }
+
+    /* First connected connector with at least one mode, not driven by another display */
+    for (k = 0; k < res->count_connectors; k++) {
+        conn = drmModeGetConnector(ctx->fd, res->connectors[k]);
+        if (conn != NULL && conn->connection == DRM_MODE_CONNECTED && conn->count_modes > 0 &&
+            !drm_is_used(ctx, conn->connector_id, 0, 0) && drm_connector_matches(conn, conn_name)) {
+            break;
+        }
+        drmModeFreeConnector(conn);
+        conn = NULL;
+    }
+
+    if (conn == NULL) {
+        LV_LOG_ERROR("No connected connector %s found", conn_name != NULL ? conn_name : "");
+        drmModeFreeResources(res);
+        return -1;
+    }
+
+    ctx->conn_id = conn->connector_id;
+    ctx->mode = conn->modes[0];
+
+    for (k = 0; k < conn->count_modes; k++) {
+        if (conn->modes[k].type & DRM_MODE_TYPE_PREFERRED) {
+            ctx->mode = conn->modes[k];
+            break;
+        }
+    }
+
+    /* Use the CRTC already driving the connector if any */
+    enc = drmModeGetEncoder(ctx->fd, conn->encoder_id);
+    if (enc != NULL) {
+        if (!drm_is_used(ctx, 0, enc->crtc_id, 0)) {
+            ctx->crtc_id = enc->crtc_id;
+        }
+        drmModeFreeEncoder(enc);
+    }
+
+    for (k = 0; k < conn->count_encoders && ctx->crtc_id == 0; k++) {
+        enc = drmModeGetEncoder(ctx->fd, conn->encoders[k]);
+        if (enc == NULL) {
+            continue;
+        }
+        for (j = 0; j < (uint32_t)res->count_crtcs; j++) {
+            if ((enc->possible_crtcs & (1U << j)) && !drm_is_used(ctx, 0, res->crtcs[j], 0)) {
+                ctx->crtc_id = res->crtcs[j];
+                break;
+            }
+        }
+        drmModeFreeEncoder(enc);
+    }
+
+    for (j = 0; j < (uint32_t)res->count_crtcs; j++) {
+        if (res->crtcs[j] == ctx->crtc_id) {
+            crtc_mask = 1U << j;
+        }
+    }
+
+    drmModeFreeConnector(conn);
+    drmModeFreeResources(res);
+
+    if (ctx->crtc_id == 0) {
+        LV_LOG_ERROR("No CRTC available for the connector");
+        return -1;
+    }
+
+    /* Find a plane of the requested type for the CRTC */
+    planes = drmModeGetPlaneResources(ctx->fd);
+    if (planes == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < planes->count_planes && ctx->plane_id == 0; i++) {
+        plane = drmModeGetPlane(ctx->fd, planes->planes[i]);
+        if (plane == NULL) {
+            continue;
+        }
+
+        if (!drm_is_used(ctx, 0, 0, plane->plane_id) && drm_plane_matches(ctx, plane, crtc_mask)) {
+            ctx->plane_id = plane->plane_id;
+        }
+        drmModeFreePlane(plane);
+    }
+
+    drmModeFreePlaneResources(planes);
+
+    if (ctx->plane_id == 0) {
+        LV_LOG_ERROR("No %s plane found for CRTC %u",
+                     ctx->plane_type == DRM_PLANE_TYPE_OVERLAY ? "overlay" : "primary",
+                     ctx->crtc_id);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Check if a plane can display the draw buffers
+ *
+ * @param ctx the DRM context
+ * @param plane the plane
+ * @param crtc_mask the bit of the CRTC in possible_crtcs
+ * @return true if the plane has the requested type, is usable
+ * with the CRTC and supports the pixel format of the buffers
+ */
+static bool drm_plane_matches(drm_ctx_t *ctx, drmModePlanePtr plane, uint32_t crtc_mask)
+{
+    drmModeObjectPropertiesPtr props;
+    drmModePropertyPtr prop;
+    bool type_ok = false;
+    bool format_ok = false;
+    uint32_t j;
+
+    if ((plane->possible_crtcs & crtc_mask) == 0) {
+        return false;
+    }
+
+    for (j = 0; j < plane->count_formats; j++) {
+        if (plane->formats[j] == DRM_FOURCC) {
+            format_ok = true;
+            break;
+        }
+    }
+
+    props = drmModeObjectGetProperties(ctx->fd, plane->plane_id, DRM_MODE_OBJECT_PLANE);
+    for (j = 0; props != NULL && j < props->count_props; j++) {
+        prop = drmModeGetProperty(ctx->fd, props->props[j]);
+        if (prop != NULL && strcmp(prop->name, "type") == 0 &&
+            props->prop_values[j] == ctx->plane_type) {
+            type_ok = true;
+        }
+        drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+
+    return type_ok && format_ok;
+}
+
+/**
+ * Lookup the IDs of the properties used by the atomic commits
+ *
+ * @param ctx the DRM context
+ * @return 0 on success, -1 if a property is missing
+ */
+static int drm_find_props(drm_ctx_t *ctx)
+{
+    drm_props_t *p = &ctx->props;
+    int fd = ctx->fd;
+
+    p->conn_crtc_id = drm_get_prop_id(fd, ctx->conn_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID");
+    p->crtc_mode_id = drm_get_prop_id(fd, ctx->crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID");
+    p->crtc_active = drm_get_prop_id(fd, ctx->crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE");
+    p->plane_fb_id = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID");
+    p->plane_crtc_id = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID");
+    p->plane_src_x = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X");
+    p->plane_src_y = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y");
+    p->plane_src_w = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W");
+    p->plane_src_h = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H");
+    p->plane_crtc_x = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X");
+    p->plane_crtc_y = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y");
+    p->plane_crtc_w = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W");
+    p->plane_crtc_h = drm_get_prop_id(fd, ctx->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H");
+
+    if (p->conn_crtc_id == 0 || p->crtc_mode_id == 0 || p->crtc_active == 0 ||
+        p->plane_fb_id == 0 || p->plane_crtc_id == 0 ||
+        p->plane_src_x == 0 || p->plane_src_y == 0 || p->plane_src_w == 0 || p->plane_src_h == 0 ||
+        p->plane_crtc_x == 0 || p->plane_crtc_y == 0 || p->plane_crtc_w == 0 || p->plane_crtc_h == 0) {
+        LV_LOG_ERROR("Missing KMS properties for atomic commits");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the ID of a KMS object property
+ *
+ * @param fd the DRM file descriptor
+ * @param obj_id the ID of the object
+ * @param obj_type the type of the object DRM_MODE_OBJECT_*
+ * @param name the name of the property
+ * @return the property ID or 0 if not found
+ */
+static uint32_t drm_get_prop_id(int fd, uint32_t obj_id, uint32_t obj_type, const char *name)
+{
+    drmModeObjectPropertiesPtr props;
+    drmModePropertyPtr prop;
+    uint32_t id = 0;
+    uint32_t i;
+
+    props = drmModeObjectGetProperties(fd, obj_id, obj_type);
+    if (props == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < props->count_props && id == 0; i++) {
+        prop = drmModeGetProperty(fd, props->props[i]);
+        if (prop != NULL && strcmp(prop->name, name) == 0) {
+            id = prop->prop_id;
+        }
+        drmModeFreeProperty(prop);
+    }
+
+    drmModeFreeObjectProperties(props);
+    return id;
+}
+
+/**
+ * Allocate a dumb buffer, add it as a framebuffer and map it
+ *
+ * @param ctx the DRM context
+ * @param buf the buffer to initialize
+ * @return 0 on success, -1 on error
+ */
+static int drm_create_buffer(drm_ctx_t *ctx, drm_buffer_t *buf)
+{
+    struct drm_mode_create_dumb creq;
+    struct drm_mode_map_dumb mreq;
+    uint32_t handles[4] = {0};
+    uint32_t pitches[4] = {0};
+    uint32_t offsets[4] = {0};
+    void *map;
+
+    memset(&creq, 0, sizeof(creq));
+    creq.width = ctx->mode.hdisplay;
+    creq.height = ctx->mode.vdisplay;
+    creq.bpp = DRM_BPP;
+
+    if (drmIoctl(ctx->fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0) {
+        LV_LOG_ERROR("Failed to create dumb buffer: %s", strerror(errno));
+        return -1;
+    }
+
+    buf->handle = creq.handle;
+    buf->pitch = creq.pitch;
+    buf->size = creq.size;
+
+    handles[0] = buf->handle;
+    pitches[0] = buf->pitch;
+
+    if (drmModeAddFB2(ctx->fd, creq.width, creq.height, DRM_FOURCC,
+                      handles, pitches, offsets, &buf->fb_id, 0) < 0) {
+        LV_LOG_ERROR("drmModeAddFB2 failed: %s", strerror(errno));
+        goto err;
+    }
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.handle = buf->handle;
+
+    if (drmIoctl(ctx->fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0) {
+        goto err;
+    }
+
+    map = mmap(NULL, buf->size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, mreq.offset);
+    if (map == MAP_FAILED) {
+        LV_LOG_ERROR("Failed to map dumb buffer: %s", strerror(errno));
+        goto err;
+    }
+
+    buf->map = map;
+
+    /* Faults the buffer in with one call instead of a fault per page in the memset */
+    rt_sched_prefault(buf->map, buf->size);
+    memset(buf->map, 0, buf->size);
+
+    /* Not fatal - the buffer can still be scanned out */
+    if (drmPrimeHandleToFD(ctx->fd, buf->handle, DRM_CLOEXEC | DRM_RDWR, &buf->dmabuf_fd) < 0) {
+        LV_LOG_WARN("Failed to export the buffer as a DMA-BUF: %s", strerror(errno));
+        buf->dmabuf_fd = -1;
+    }
+
+    return 0;
+
+err:
+    drm_destroy_buffer(ctx, buf);
+    return -1;
+}
+
+/**
+ * Release a dumb buffer
+ *
+ * @param ctx the DRM context
+ * @param buf the buffer to release, can be partially initialized
+ */
+static void drm_destroy_buffer(drm_ctx_t *ctx, drm_buffer_t *buf)
+{
+    struct drm_mode_destroy_dumb dreq;
+
+    if (buf->dmabuf_fd >= 0) {
+        close(buf->dmabuf_fd);
+    }
+
+    if (buf->map != NULL) {
+        munmap(buf->map, buf->size);
+    }
+
+    if (buf->fb_id != 0) {
+        drmModeRmFB(ctx->fd, buf->fb_id);
+    }
+
+    if (buf->handle != 0) {
+        memset(&dreq, 0, sizeof(dreq));
+        dreq.handle = buf->handle;
+        drmIoctl(ctx->fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+    }
+
+    memset(buf, 0, sizeof(*buf));
+    buf->dmabuf_fd = -1;
+}
+
+/**
+ * Present a buffer with a non-blocking atomic commit
+ *
+ * @description the first commit also performs the modeset
+ * @param ctx the DRM context
+ * @param idx the index of the buffer to scan out
+ * @return 0 on success, -1 on error
+ */
+static int drm_commit(drm_ctx_t *ctx, int idx)
+{
+    drmModeAtomicReqPtr req;
+    drm_props_t *p = &ctx->props;
+    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK;
+    uint32_t w = ctx->mode.hdisplay;
+    uint32_t h = ctx->mode.vdisplay;
+    int ret;
+
+    req = drmModeAtomicAlloc();
+    if (req == NULL) {
+        return -1;
+    }
+
+    if (!ctx->modeset_done) {
+        flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+        drmModeAtomicAddProperty(req, ctx->conn_id, p->conn_crtc_id, ctx->crtc_id);
+        drmModeAtomicAddProperty(req, ctx->crtc_id, p->crtc_mode_id, ctx->mode_blob_id);
+        drmModeAtomicAddProperty(req, ctx->crtc_id, p->crtc_active, 1);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_crtc_id, ctx->crtc_id);
+
+        /* Source coordinates are in 16.16 fixed point */
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_src_x, 0);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_src_y, 0);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_src_w, (uint64_t)w << 16);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_src_h, (uint64_t)h << 16);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_crtc_x, 0);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_crtc_y, 0);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_crtc_w, w);
+        drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_crtc_h, h);
+    }
+
+    drmModeAtomicAddProperty(req, ctx->plane_id, p->plane_fb_id, ctx->buffers[idx].fb_id);
+
+    ret = drmModeAtomicCommit(ctx->fd, req, flags, ctx);
+    drmModeAtomicFree(req);
+
+    if (ret < 0) {
+        LV_LOG_ERROR("Atomic commit failed: %s", strerror(errno));
+        return -1;
+    }
+
+    ctx->modeset_done = true;
+    ctx->pending = idx;
+    return 0;
+}
+
+/**
+ * Flush callback of the page flip mode
+ *
+ * @description LVGL renders directly into the dumb buffers, on the
+ * last area of the frame the buffer is committed. flush ready is only
+ * signaled once the page flip completed, so that LVGL never renders
+ * into the buffer that is being scanned out.
+ * The refresh timer is paused until then, which aligns the rendering
+ * of the next frame to the vertical blanking
+ */
+static void drm_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    drm_ctx_t *ctx = lv_display_get_driver_data(disp);
+    int idx;
+
+    LV_UNUSED(area);
+
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    idx = (px_map == ctx->buffers[0].map) ? 0 : 1;
+
+    if (drm_commit(ctx, idx) < 0) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    lv_timer_pause(lv_display_get_refr_timer(disp));
+}
+
+/**
+ * Flush callback of the page flip mode on a rotated panel
+ *
+ * @description on the last area of the frame, the damaged areas are
+ * rotated into the back buffer and it is committed. The back buffer was
+ * last drawn two frames ago, the areas of the previous frame are copied too
+ */
+static void drm_rotate_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    drm_ctx_t *ctx = lv_display_get_driver_data(disp);
+    int idx;
+
+    LV_UNUSED(px_map);
+
+    damage_add(&ctx->damage, area);
+
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    /* flush ready of the previous frame was signaled by its flip, nothing is pending */
+    idx = 1 - ctx->front;
+
+    drm_rotate_damage(ctx, &ctx->damage, idx);
+    drm_rotate_damage(ctx, &ctx->prev_damage, idx);
+
+    ctx->prev_damage = ctx->damage;
+    damage_reset(&ctx->damage);
+
+    if (drm_commit(ctx, idx) < 0) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    lv_timer_pause(lv_display_get_refr_timer(disp));
+}
+
+/**
+ * Rotate areas of the shadow buffer into a dumb buffer
+ *
+ * @param ctx the DRM context
+ * @param damage the areas in display coordinates
+ * @param idx the index of the destination buffer
+ */
+static void drm_rotate_damage(drm_ctx_t *ctx, const damage_t *damage, int idx)
+{
+    const lv_area_t *a;
+    const uint8_t *src;
+    uint32_t px_size = DRM_BPP / 8;
+    uint32_t i;
+
+    for (i = 0; i < damage->count; i++) {
+        a = &damage->rects[i];
+        src = ctx->shadow + (size_t)a->y1 * ctx->shadow_stride + (size_t)a->x1 * px_size;
+
+        pixel_convert_rotate(ctx->convert, ctx->buffers[idx].map, ctx->buffers[idx].pitch,
+                             src, ctx->shadow_stride, px_size, a->x1, a->y1,
+                             lv_area_get_width(a), lv_area_get_height(a),
+                             lv_display_get_horizontal_resolution(ctx->disp),
+                             lv_display_get_vertical_resolution(ctx->disp), ctx->rotation);
+    }
+}
+
+/**
+ * Wait for the flip of the previous frame
+ *
+ * @note called by LVGL before reusing a draw buffer
+ * @param disp the display
+ */
+static void drm_flush_wait_cb(lv_display_t *disp)
+{
+    drm_wait_flip(lv_display_get_driver_data(disp));
+}
+
+/**
+ * Block until the pending page flip completes
+ *
+ * @param ctx the DRM context
+ */
+static void drm_wait_flip(drm_ctx_t *ctx)
+{
+    struct pollfd pfd;
+
+    pfd.fd = ctx->fd;
+    pfd.events = POLLIN;
+
+    while (ctx->pending != -1) {
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            break;
+        }
+        drm_event_cb(ctx->fd, EPOLLIN, ctx);
+    }
+}
+
+/**
+ * Blank or unblank the display
+ *
+ * @description the CRTC is deactivated, the equivalent of DPMS off with
+ * atomic modesetting, the mode and the planes are restored by a full
+ * modeset of the front buffer
+ * @note called by the frame governor
+ * @param disp the display
+ * @param blank true to turn the display off
+ * @return 0 on success, -1 on error
+ */
+static int drm_blank_cb(lv_display_t *disp, bool blank)
+{
+    drm_ctx_t *ctx = lv_display_get_driver_data(disp);
+    drmModeAtomicReqPtr req;
+    int ret;
+
+    drm_wait_flip(ctx);
+
+    if (!blank) {
+        ctx->modeset_done = false;
+        if (drm_commit(ctx, ctx->front) < 0) {
+            return -1;
+        }
+
+        drm_wait_flip(ctx);
+        return 0;
+    }
+
+    req = drmModeAtomicAlloc();
+    if (req == NULL) {
+        return -1;
+    }
+
+    drmModeAtomicAddProperty(req, ctx->crtc_id, ctx->props.crtc_active, 0);
+    ret = drmModeAtomicCommit(ctx->fd, req, DRM_MODE_ATOMIC_ALLOW_MODESET, NULL);
+    drmModeAtomicFree(req);
+
+    if (ret < 0) {
+        LV_LOG_ERROR("Failed to deactivate the CRTC: %s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Dispatch the DRM events
+ *
+ * @note called from the event loop or while waiting for the flip
+ */
+static void drm_event_cb(int fd, uint32_t events, void *user_data)
+{
+    drmEventContext evctx;
+
+    LV_UNUSED(events);
+
+    memset(&evctx, 0, sizeof(evctx));
+    evctx.version = 2;
+    evctx.page_flip_handler = drm_page_flip_handler;
+
+    /* The user data passed to the handler is the one of the commit */
+    LV_UNUSED(user_data);
+    drmHandleEvent(fd, &evctx);
+}
+
+/**
+ * Page flip completion handler
+ *
+ * @description the pending buffer is now scanned out and the previous
+ * front buffer can be rendered into, start the next frame right away
+ */
+static void drm_page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+                                  unsigned int tv_usec, void *user_data)
+{
+    drm_ctx_t *ctx = user_data;
+
+    LV_UNUSED(fd);
+    LV_UNUSED(sequence);
+    LV_UNUSED(tv_sec);
+    LV_UNUSED(tv_usec);
+
+    ctx->front = ctx->pending;
+    ctx->pending = -1;
+
+    if (ctx->disp == NULL) {
+        /* Initial modeset */
+        return;
+    }
+
+    lv_display_flush_ready(ctx->disp);
+    frame_governor_resume(ctx->disp);
+}
+
+/**
+ * Open a socket receiving the kernel uevents
+ *
+ * @return the socket or -1 on error
+ */
+static int drm_open_uevents(void)
+{
+    struct sockaddr_nl addr;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;     /* Kernel events, udev rebroadcasts on group 2 */
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Handle the hotplug uevents of the DRM devices
+ *
+ * @description the message is a list of null terminated KEY=value strings,
+ * if the connector was unplugged or its mode changed the backend is
+ * re-initialized from the timer handler of LVGL, outside of the rendering
+ */
+static void drm_uevent_cb(int fd, uint32_t events, void *user_data)
 {
-    uint32_t idle_time;
+    drm_ctx_t *ctx = user_data;
+    char buf[2048];
+    bool drm = false;
+    bool hotplug = false;
+    ssize_t len;
+    ssize_t i;
 
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    LV_UNUSED(events);
+
+    while ((len = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        buf[len] = '\0';
+
+        for (i = 0; i < len; i += strlen(buf + i) + 1) {
+            if (strcmp(buf + i, "SUBSYSTEM=drm") == 0) {
+                drm = true;
+            } else if (strcmp(buf + i, "HOTPLUG=1") == 0) {
+                hotplug = true;
+            }
+        }
+    }
+
+    if (!drm || !hotplug || ctx->reinit_pending || !drm_connector_changed(ctx)) {
+        return;
     }
+
+    LV_LOG_USER("DRM connector %u changed, re-initializing the display", ctx->conn_id);
+    ctx->reinit_pending = true;
+    lv_async_call(drm_reinit_async_cb, (void *)(uintptr_t)ctx->index);
+}
+
+/**
+ * Check if the connector was unplugged or its preferred mode changed
+ *
+ * @param ctx the DRM context
+ * @return true if the display must be re-initialized
+ */
+static bool drm_connector_changed(drm_ctx_t *ctx)
+{
+    drmModeConnectorPtr conn = drmModeGetConnector(ctx->fd, ctx->conn_id);
+    bool changed = true;
+    int k;
+
+    if (conn == NULL) {
+        return true;
+    }
+
+    if (conn->connection == DRM_MODE_CONNECTED) {
+        for (k = 0; k < conn->count_modes; k++) {
+            if (conn->modes[k].type & DRM_MODE_TYPE_PREFERRED) {
+                changed = conn->modes[k].hdisplay != ctx->mode.hdisplay ||
+                          conn->modes[k].vdisplay != ctx->mode.vdisplay;
+                break;
+            }
+        }
+
+        if (k == conn->count_modes) {
+            changed = false;
+        }
+    }
+
+    drmModeFreeConnector(conn);
+    return changed;
+}
+
+/**
+ * Re-initialize the display backend
+ *
+ * @note called by the LVGL timer handler, the display can be deleted
+ * @param user_data the index of the display
+ */
+static void drm_reinit_async_cb(void *user_data)
+{
+    if (driver_backends_reinit_display((uintptr_t)user_data, NULL) < 0) {
+        LV_LOG_ERROR("Failed to re-initialize the display");
+    }
+}
+
+/**
+ * Release the page flip mode when the display is deleted
+ *
+ * @note the display is deleted when the backend is re-initialized
+ * @param e the delete event of the display
+ */
+static void drm_delete_cb(lv_event_t *e)
+{
+    drm_ctx_t *ctx = lv_event_get_user_data(e);
+    int i;
+
+    /* The flip completion must not signal the deleted display */
+    ctx->disp = NULL;
+    drm_wait_flip(ctx);
+
+    if (ctx->uevent_fd >= 0) {
+        event_loop_remove_fd(ctx->uevent_fd);
+        close(ctx->uevent_fd);
+    }
+
+    for (i = 0; i < DRM_BUFFER_COUNT; i++) {
+        drm_destroy_buffer(ctx, &ctx->buffers[i]);
+    }
+
+    drmModeDestroyPropertyBlob(ctx->fd, ctx->mode_blob_id);
+    drm_close_card(ctx->fd);
+
+    if (page_flip_ctxs[ctx->index] == ctx) {
+        page_flip_ctxs[ctx->index] = NULL;
+    }
+
+    free(ctx->shadow);
+    free(ctx);
+}
+
+/**
+ * The run loop of the DRM driver
+ */
+static void run_loop_drm(void)
+{
+    /* Sleep until an input event, a wakeup or the next LVGL timer is due */
+    event_loop_run(NULL);
 }
 
 #endif /*#if LV_USE_LINUX_DRM*/
@@ -8,6 +8,22 @@
  * Move to a separate file
  * 2025 EDGEMTech Ltd.
  *
+ * Add the damage tracking flush path, with page flipping
+ * through FBIOPAN_DISPLAY when supported by the driver
+ * and pixel format conversion of the damaged areas
+ *
+ * Blank the display with FBIOBLANK when idle
+ *
+ * Rotate the damaged areas while copying them to the framebuffer
+ *
+ * Support one display per framebuffer device
+ *
+ * Render in stripes sized to a cache budget
+ *
+ * Flush asynchronously on a worker thread
+ *
+ * Prefault the mapping of the framebuffer at init
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -18,20 +34,64 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_LINUX_FBDEV
 #include "../simulator_util.h"
+#include "../simulator_settings.h"
 #include "../backends.h"
+#include "../event_loop.h"
+#include "../damage.h"
+#include "../pixel_convert.h"
+#include "../frame_governor.h"
+#include "../async_flush.h"
+#include "../rt_sched.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Number of stripe buffers, one is rendered while the other is flushed */
+#define FBDEV_STRIPE_BUFFERS 2
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+/* State of the damage tracking flush path */
+typedef struct {
+    int fd;
+    struct fb_var_screeninfo vinfo;
+    struct fb_fix_screeninfo finfo;
+    uint8_t *fb_map;            /* The mapped framebuffer memory */
+    size_t fb_size;
+    uint32_t px_size;           /* Bytes per pixel of the framebuffer */
+    lv_color_format_t fb_cf;    /* Color format of the framebuffer */
+    lv_color_format_t render_cf; /* Color format LVGL renders in */
+    uint32_t render_px_size;
+    uint32_t convert_flags;     /* PIXEL_CONVERT_* flags applied when copying */
+    const pixel_convert_ops_t *convert;
+    uint32_t page_size;         /* Size of one page in pan mode */
+    bool pan;                   /* Two pages are flipped with FBIOPAN_DISPLAY */
+    uint8_t *shadow;            /* Draw buffer in copy mode */
+    uint8_t *shadow2;           /* Second draw buffer in copy mode, when flushing asynchronously */
+    uint32_t shadow_stride;
+    uint32_t width;             /* Resolution LVGL renders at, before the rotation */
+    uint32_t height;
+    uint32_t rotation;          /* Clockwise rotation applied when copying */
+    uint8_t *scratch;           /* Converted area before its rotation, if converting */
+    uint8_t *stripes[FBDEV_STRIPE_BUFFERS]; /* Draw buffers in stripe mode */
+    uint32_t stripe_lines;      /* Height of a full width stripe, 0 if not rendering in stripes */
+    damage_t damage;            /* Areas flushed during the current frame */
+} fbdev_ctx_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
@@ -39,12 +99,42 @@
 static lv_display_t *init_fbdev(void);
 static void run_loop_fbdev(void);
 
+static lv_display_t *init_fbdev_damage(const char *device);
+static lv_color_format_t fbdev_color_format(const struct fb_var_screeninfo *vinfo);
+static bool fbdev_enable_pan(fbdev_ctx_t *ctx);
+static void fbdev_pan_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void fbdev_copy_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void fbdev_stripe_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static uint32_t fbdev_stripe_lines(fbdev_ctx_t *ctx);
+static void fbdev_copy_damage(fbdev_ctx_t *ctx, const uint8_t *buf);
+static void fbdev_rotate_damage(fbdev_ctx_t *ctx, const uint8_t *buf);
+static void fbdev_copy_area(fbdev_ctx_t *ctx, const lv_area_t *a,
+                            const uint8_t *src, uint32_t src_stride);
+static void fbdev_rotate_area(fbdev_ctx_t *ctx, const lv_area_t *a,
+                              const uint8_t *src, uint32_t src_stride);
+static void fbdev_copy_row(fbdev_ctx_t *ctx, uint8_t *dst, const uint8_t *src,
+                           uint32_t n, uint32_t x, uint32_t y);
+static int fbdev_blank_cb(lv_display_t *disp, bool blank);
+static void fbdev_delete_cb(lv_event_t *e);
+static void fbdev_device_delete_cb(lv_event_t *e);
+
 /**********************
  *  STATIC VARIABLES
  **********************/
 
 static char *backend_name = "FBDEV";
 
+/* The framebuffer device of each display, blanked with FBIOBLANK */
+static struct {
+    lv_display_t *disp;
+    const char *device;
+} fbdev_devices[BACKEND_MAX_DISPLAYS];
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
 /**********************
  *      MACROS
  **********************/
@@ -81,36 +171,624 @@ int backend_init_fbdev(backend_t *backend)
 /**
  * Initialize the fbdev driver
  *
+ * @description if LV_LINUX_FBDEV_DAMAGE is set to 1, a stripe cache budget is set
+ * or the panel is rotated, the damage tracking flush path of the backend is used
+ * instead of the LVGL fbdev driver
  * @return the LVGL display
  */
 static lv_display_t *init_fbdev(void)
 {
-    const char *device = getenv_default("LV_LINUX_FBDEV_DEVICE", "/dev/fb0");
-    lv_display_t *disp = lv_linux_fbdev_create();
+    const char *device = backend_getenv("LV_LINUX_FBDEV_DEVICE", "/dev/fb0");
+    const char *damage = backend_getenv("LV_LINUX_FBDEV_DAMAGE", "0");
+    const char *stripe = backend_getenv("LV_LINUX_FBDEV_STRIPE_CACHE", "0");
+    lv_display_t *disp = NULL;
+    uint32_t idx = backend_display_index();
+
+    if (damage[0] == '1' || parse_size(stripe) != 0 || settings.rotation != 0) {
+        disp = init_fbdev_damage(device);
+
+        if (disp == NULL) {
+            LV_LOG_WARN("Damage tracking unavailable, falling back to the fbdev driver");
+        }
+    }
 
     if (disp == NULL) {
+        disp = lv_linux_fbdev_create();
+
+        if (disp == NULL) {
+            return NULL;
+        }
+
+        lv_linux_fbdev_set_file(disp, device);
+
+        /* Rotated by LVGL after rendering, the whole frame is rotated */
+        lv_display_set_rotation(disp, settings.rotation / 90);
+    }
+
+    fbdev_devices[idx].disp = disp;
+    fbdev_devices[idx].device = device;
+    lv_display_add_event_cb(disp, fbdev_device_delete_cb, LV_EVENT_DELETE, &fbdev_devices[idx]);
+
+    frame_governor_set_blank_cb(disp, fbdev_blank_cb);
+
+    return disp;
+}
+
+/**
+ * Create a display using the damage tracking flush path
+ *
+ * @description if the driver accepts a virtual resolution twice the
+ * height of the screen, LVGL renders directly into the two pages and
+ * each frame is presented with a single FBIOPAN_DISPLAY.
+ * Otherwise LVGL renders into a shadow buffer, the areas of the frame
+ * are merged into a damage list and only these are copied to the framebuffer.
+ * When the framebuffer is RGB565 and LV_COLOR_DEPTH is 32, the areas are
+ * converted while being copied, with optional ordered dithering.
+ * A rotated panel always uses the copy mode, LVGL renders at the rotated
+ * resolution and only the damaged areas are rotated into the framebuffer.
+ * With a stripe cache budget (LV_LINUX_FBDEV_STRIPE_CACHE), LVGL renders
+ * into two small buffers that stay in the cache instead, each area
+ * is copied (or rotated) to the framebuffer as soon as it is rendered.
+ * With LV_LINUX_FBDEV_ASYNC=1 the flush callback runs on a worker thread,
+ * LVGL renders into the other buffer meanwhile, the copy mode then
+ * allocates a second shadow buffer
+ * @param device the path of the framebuffer device
+ * @return the LVGL display or NULL on failure
+ */
+static lv_display_t *init_fbdev_damage(const char *device)
+{
+    fbdev_ctx_t *ctx;
+    lv_display_t *disp;
+    lv_display_flush_cb_t flush_cb;
+    bool async = backend_getenv("LV_LINUX_FBDEV_ASYNC", "0")[0] == '1';
+    uint32_t w;
+    uint32_t h;
+
+    ctx = calloc(1, sizeof(fbdev_ctx_t));
+    LV_ASSERT_NULL(ctx);
+
+    ctx->fd = open(device, O_RDWR | O_CLOEXEC);
+    if (ctx->fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", device, strerror(errno));
+        free(ctx);
         return NULL;
     }
 
-    lv_linux_fbdev_set_file(disp, device);
+    if (ioctl(ctx->fd, FBIOGET_VSCREENINFO, &ctx->vinfo) < 0 ||
+        ioctl(ctx->fd, FBIOGET_FSCREENINFO, &ctx->finfo) < 0) {
+        LV_LOG_ERROR("Failed to query %s: %s", device, strerror(errno));
+        goto err_close;
+    }
+
+    ctx->fb_cf = fbdev_color_format(&ctx->vinfo);
+    if (ctx->fb_cf == LV_COLOR_FORMAT_UNKNOWN) {
+        LV_LOG_ERROR("Unsupported framebuffer depth: %u bpp", ctx->vinfo.bits_per_pixel);
+        goto err_close;
+    }
+
+    ctx->render_cf = ctx->fb_cf;
+    ctx->convert = pixel_convert_get_ops();
+
+    if (ctx->fb_cf == LV_COLOR_FORMAT_RGB565) {
+#if LV_COLOR_DEPTH == 32
+        ctx->render_cf = LV_COLOR_FORMAT_XRGB8888;
+
+        if (backend_getenv("LV_LINUX_FBDEV_DITHER", "0")[0] == '1') {
+            ctx->convert_flags |= PIXEL_CONVERT_DITHER;
+        }
+#endif
+        if (backend_getenv("LV_LINUX_FBDEV_SWAP_BYTES", "0")[0] == '1') {
+            ctx->convert_flags |= PIXEL_CONVERT_SWAP;
+        }
+    }
+
+    ctx->px_size = ctx->vinfo.bits_per_pixel / 8;
+    ctx->render_px_size = lv_color_format_get_size(ctx->render_cf);
+    ctx->page_size = ctx->finfo.line_length * ctx->vinfo.yres;
+    ctx->rotation = settings.rotation;
+
+    if (ctx->rotation != 0 && ctx->px_size != 2 && ctx->px_size != 4) {
+        LV_LOG_ERROR("Rotation requires a 16 or 32 bpp framebuffer");
+        goto err_close;
+    }
+
+    if (ctx->rotation == 90 || ctx->rotation == 270) {
+        w = ctx->vinfo.yres;
+        h = ctx->vinfo.xres;
+    } else {
+        w = ctx->vinfo.xres;
+        h = ctx->vinfo.yres;
+    }
+
+    ctx->width = w;
+    ctx->height = h;
+
+    ctx->stripe_lines = fbdev_stripe_lines(ctx);
+
+    /* LVGL can only render into the pages if no conversion or rotation is needed */
+    if (ctx->render_cf == ctx->fb_cf && ctx->convert_flags == 0 && ctx->rotation == 0 &&
+        ctx->stripe_lines == 0) {
+        ctx->pan = fbdev_enable_pan(ctx);
+    }
+    ctx->fb_size = ctx->finfo.smem_len;
+
+    ctx->fb_map = mmap(NULL, ctx->fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, 0);
+    if (ctx->fb_map == MAP_FAILED) {
+        LV_LOG_ERROR("Failed to map %s: %s", device, strerror(errno));
+        goto err_close;
+    }
+
+    /* The first flush would otherwise take a page fault per page of the framebuffer */
+    rt_sched_prefault(ctx->fb_map, ctx->fb_size);
+
+    disp = lv_display_create(w, h);
+    if (disp == NULL) {
+        goto err_unmap;
+    }
+
+    lv_display_set_color_format(disp, ctx->render_cf);
+    lv_display_set_driver_data(disp, ctx);
+
+    if (ctx->stripe_lines != 0) {
+        uint32_t stripe_stride = lv_draw_buf_width_to_stride(w, ctx->render_cf);
+        uint32_t stripe_size = stripe_stride * ctx->stripe_lines;
+        bool convert;
+        int i;
+
+        for (i = 0; i < FBDEV_STRIPE_BUFFERS; i++) {
+            ctx->stripes[i] = malloc(stripe_size);
+        }
+
+        /* An area of a stripe is converted into the scratch buffer before its rotation */
+        convert = ctx->rotation != 0 && (ctx->render_cf != ctx->fb_cf || ctx->convert_flags != 0);
+
+        /* A narrow area has more rows than stripe_lines, but never more pixels than a stripe buffer */
+        if (convert) {
+            ctx->scratch = malloc((size_t)(stripe_size / ctx->render_px_size) * ctx->px_size);
+        }
+
+        if (ctx->stripes[0] == NULL || ctx->stripes[1] == NULL || (convert && ctx->scratch == NULL)) {
+            lv_display_delete(disp);
+            goto err_stripes;
+        }
+
+        /* Partial mode fills a buffer with as many rows of an area as fit */
+        flush_cb = fbdev_stripe_flush_cb;
+        lv_display_set_buffers_with_stride(disp, ctx->stripes[0], ctx->stripes[1], stripe_size,
+                                           stripe_stride, LV_DISPLAY_RENDER_MODE_PARTIAL);
+        LV_LOG_USER("fbdev %ux%u, rendering in stripes of %u lines (2 x %u bytes), rotated by %u",
+                    w, h, ctx->stripe_lines, stripe_size, ctx->rotation);
+    } else if (ctx->pan) {
+        /* The first page is scanned out, the first frame is rendered into the hidden one */
+        flush_cb = fbdev_pan_flush_cb;
+        lv_display_set_buffers_with_stride(disp, ctx->fb_map + ctx->page_size, ctx->fb_map,
+                                           ctx->page_size, ctx->finfo.line_length,
+                                           LV_DISPLAY_RENDER_MODE_DIRECT);
+        LV_LOG_USER("fbdev %ux%u, page flipping with FBIOPAN_DISPLAY", w, h);
+    } else {
+        ctx->shadow_stride = w * ctx->render_px_size;
+        ctx->shadow = malloc(ctx->shadow_stride * h);
+
+        /* A single buffer would be rendered into while the worker copies it */
+        if (async && ctx->shadow != NULL) {
+            ctx->shadow2 = malloc(ctx->shadow_stride * h);
+
+            if (ctx->shadow2 == NULL) {
+                free(ctx->shadow);
+                ctx->shadow = NULL;
+            }
+        }
+
+        /* The kernels rotate the pixels as they are, converted areas go through a scratch buffer */
+        if (ctx->rotation != 0 && (ctx->render_cf != ctx->fb_cf || ctx->convert_flags != 0)) {
+            ctx->scratch = malloc((size_t)w * h * ctx->px_size);
+
+            if (ctx->scratch == NULL) {
+                free(ctx->shadow);
+                free(ctx->shadow2);
+                ctx->shadow = NULL;
+            }
+        }
+
+        if (ctx->shadow == NULL) {
+            free(ctx->scratch);
+            lv_display_delete(disp);
+            goto err_unmap;
+        }
+
+        flush_cb = fbdev_copy_flush_cb;
+        lv_display_set_buffers_with_stride(disp, ctx->shadow, ctx->shadow2,
+                                           ctx->shadow_stride * h, ctx->shadow_stride,
+                                           LV_DISPLAY_RENDER_MODE_DIRECT);
+        LV_LOG_USER("fbdev %ux%u, copying damaged areas rotated by %u (%s kernels)",
+                    w, h, ctx->rotation, ctx->convert->name);
+    }
+
+    lv_display_set_flush_cb(disp, flush_cb);
+
+    /* Attached first, the worker is stopped before the context is released */
+    if (async) {
+        if (async_flush_attach(disp, flush_cb) < 0) {
+            LV_LOG_WARN("Flushing synchronously");
+        } else {
+            LV_LOG_USER("fbdev flushing on a worker thread");
+        }
+    }
+
+    lv_display_add_event_cb(disp, fbdev_delete_cb, LV_EVENT_DELETE, ctx);
 
     return disp;
+
+err_stripes:
+    free(ctx->stripes[0]);
+    free(ctx->stripes[1]);
+    free(ctx->scratch);
+err_unmap:
+    munmap(ctx->fb_map, ctx->fb_size);
+err_close:
+    close(ctx->fd);
+    free(ctx);
+    return NULL;
 }
 
 /**
- * The run loop of the fbdev driver
+ * Get the LVGL color format matching the framebuffer depth
+ *
+ * @param vinfo the variable screen info
+ * @return the color format or LV_COLOR_FORMAT_UNKNOWN
  */
-static void run_loop_fbdev(void)
+static lv_color_format_t fbdev_color_format(const struct fb_var_screeninfo *vinfo)
+{
+    switch (vinfo->bits_per_pixel) {
+    case 16:
+        return LV_COLOR_FORMAT_RGB565;
+    case 24:
+        return LV_COLOR_FORMAT_RGB888;
+    case 32:
+        return LV_COLOR_FORMAT_XRGB8888;
+    default:
+        return LV_COLOR_FORMAT_UNKNOWN;
+    }
+}
+
+/**
+ * Try to set up two pages in the framebuffer memory
+ *
+ * @description the virtual resolution is doubled if it isn't already
+ * and the driver must accept panning to the second page
+ * @param ctx the fbdev context
+ * @return true if page flipping can be used
+ */
+static bool fbdev_enable_pan(fbdev_ctx_t *ctx)
+{
+    struct fb_var_screeninfo vinfo = ctx->vinfo;
+
+    if (ctx->finfo.smem_len < 2 * ctx->page_size || ctx->finfo.ypanstep == 0) {
+        return false;
+    }
+
+    if (vinfo.yres_virtual < 2 * vinfo.yres) {
+        vinfo.yres_virtual = 2 * vinfo.yres;
+
+        if (ioctl(ctx->fd, FBIOPUT_VSCREENINFO, &vinfo) < 0 ||
+            ioctl(ctx->fd, FBIOGET_VSCREENINFO, &vinfo) < 0 ||
+            vinfo.yres_virtual < 2 * vinfo.yres) {
+            return false;
+        }
+
+        /* The line length can change with the virtual resolution */
+        ioctl(ctx->fd, FBIOGET_FSCREENINFO, &ctx->finfo);
+        ctx->page_size = ctx->finfo.line_length * vinfo.yres;
+    }
+
+    vinfo.yoffset = 0;
+    if (ioctl(ctx->fd, FBIOPAN_DISPLAY, &vinfo) < 0) {
+        return false;
+    }
+
+    ctx->vinfo = vinfo;
+    return true;
+}
+
+/**
+ * Flush callback of the page flipping mode
+ *
+ * @description LVGL renders into the hidden page and keeps
+ * both pages in sync, the last area of the frame pans the display
+ */
+static void fbdev_pan_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
 {
-    uint32_t idle_time;
+    fbdev_ctx_t *ctx = lv_display_get_driver_data(disp);
+    uint32_t zero = 0;
 
-    /* Handle LVGL tasks */
-    while (true) {
+    LV_UNUSED(area);
 
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    if (lv_display_flush_is_last(disp)) {
+        ctx->vinfo.yoffset = (px_map == ctx->fb_map) ? 0 : ctx->vinfo.yres;
+
+        /* Waiting for the vertical sync is optional - not all drivers implement it */
+        ioctl(ctx->fd, FBIO_WAITFORVSYNC, &zero);
+
+        if (ioctl(ctx->fd, FBIOPAN_DISPLAY, &ctx->vinfo) < 0) {
+            LV_LOG_WARN("FBIOPAN_DISPLAY failed: %s", strerror(errno));
+        }
     }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Flush callback of the copy mode
+ *
+ * @description the areas of the frame are accumulated and
+ * copied once the last area was rendered
+ */
+static void fbdev_copy_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    fbdev_ctx_t *ctx = lv_display_get_driver_data(disp);
+
+    damage_add(&ctx->damage, area);
+
+    /* In direct mode px_map is the start of the flushed shadow buffer */
+    if (lv_display_flush_is_last(disp)) {
+        if (ctx->rotation != 0) {
+            fbdev_rotate_damage(ctx, px_map);
+        } else {
+            fbdev_copy_damage(ctx, px_map);
+        }
+        damage_reset(&ctx->damage);
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Flush callback of the stripe mode
+ *
+ * @description an area is copied as soon as it was rendered, with
+ * LV_LINUX_FBDEV_ASYNC=1 LVGL renders the next stripe into the other
+ * buffer meanwhile. The rows of an area are packed in the buffer
+ */
+static void fbdev_stripe_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    fbdev_ctx_t *ctx = lv_display_get_driver_data(disp);
+    uint32_t stride = lv_draw_buf_width_to_stride(lv_area_get_width(area), ctx->render_cf);
+
+    if (ctx->rotation != 0) {
+        fbdev_rotate_area(ctx, area, px_map, stride);
+    } else {
+        fbdev_copy_area(ctx, area, px_map, stride);
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Get the height of the stripes
+ *
+ * @description the two stripe buffers share the cache budget
+ * (LV_LINUX_FBDEV_STRIPE_CACHE with an optional K or M suffix),
+ * each holds as many full width lines as half of the budget
+ * @param ctx the fbdev context
+ * @return the number of lines, 0 if no budget is set
+ */
+static uint32_t fbdev_stripe_lines(fbdev_ctx_t *ctx)
+{
+    uint32_t budget = parse_size(backend_getenv("LV_LINUX_FBDEV_STRIPE_CACHE", "0"));
+    uint32_t lines;
+
+    if (budget == 0) {
+        return 0;
+    }
+
+    lines = budget / FBDEV_STRIPE_BUFFERS / lv_draw_buf_width_to_stride(ctx->width, ctx->render_cf);
+
+    if (lines == 0) {
+        LV_LOG_WARN("Stripe cache budget of %u bytes is below two lines, using 1 line", budget);
+        lines = 1;
+    }
+
+    return LV_MIN(lines, ctx->height);
+}
+
+/**
+ * Copy the damaged rectangles from the shadow buffer to the framebuffer
+ *
+ * @param ctx the fbdev context
+ * @param buf the flushed shadow buffer
+ */
+static void fbdev_copy_damage(fbdev_ctx_t *ctx, const uint8_t *buf)
+{
+    const lv_area_t *a;
+    uint32_t i;
+
+    for (i = 0; i < ctx->damage.count; i++) {
+        a = &ctx->damage.rects[i];
+        fbdev_copy_area(ctx, a,
+                        buf + (size_t)a->y1 * ctx->shadow_stride +
+                        (size_t)a->x1 * ctx->render_px_size,
+                        ctx->shadow_stride);
+    }
+}
+
+/**
+ * Rotate the damaged rectangles from the shadow buffer into the framebuffer
+ *
+ * @param ctx the fbdev context
+ * @param buf the flushed shadow buffer
+ */
+static void fbdev_rotate_damage(fbdev_ctx_t *ctx, const uint8_t *buf)
+{
+    const lv_area_t *a;
+    uint32_t i;
+
+    for (i = 0; i < ctx->damage.count; i++) {
+        a = &ctx->damage.rects[i];
+        fbdev_rotate_area(ctx, a,
+                          buf + (size_t)a->y1 * ctx->shadow_stride +
+                          (size_t)a->x1 * ctx->render_px_size,
+                          ctx->shadow_stride);
+    }
+}
+
+/**
+ * Copy a rectangle to the framebuffer
+ *
+ * @param ctx the fbdev context
+ * @param a the rectangle in screen coordinates
+ * @param src the first pixel of the rectangle
+ * @param src_stride the stride of the source in bytes
+ */
+static void fbdev_copy_area(fbdev_ctx_t *ctx, const lv_area_t *a,
+                            const uint8_t *src, uint32_t src_stride)
+{
+    uint8_t *dst;
+    uint32_t fb_stride = ctx->finfo.line_length;
+    uint32_t len = (uint32_t)(a->x2 - a->x1 + 1);
+    int32_t y;
+
+    dst = ctx->fb_map + (size_t)(a->y1 + ctx->vinfo.yoffset) * fb_stride +
+          (size_t)(ctx->vinfo.xoffset + a->x1) * ctx->px_size;
+
+    for (y = a->y1; y <= a->y2; y++) {
+        fbdev_copy_row(ctx, dst, src, len, a->x1, y);
+        src += src_stride;
+        dst += fb_stride;
+    }
+}
+
+/**
+ * Rotate a rectangle into the framebuffer
+ *
+ * @description the rows of a rectangle that needs a conversion are
+ * converted into the scratch buffer first, then the rectangle is rotated
+ * @param ctx the fbdev context
+ * @param a the rectangle in display coordinates, before the rotation
+ * @param src the first pixel of the rectangle
+ * @param src_stride the stride of the source in bytes
+ */
+static void fbdev_rotate_area(fbdev_ctx_t *ctx, const lv_area_t *a,
+                              const uint8_t *src, uint32_t src_stride)
+{
+    const uint8_t *row;
+    uint8_t *fb;
+    uint32_t w = (uint32_t)(a->x2 - a->x1 + 1);
+    uint32_t h = (uint32_t)(a->y2 - a->y1 + 1);
+    int32_t y;
+
+    fb = ctx->fb_map + (size_t)ctx->vinfo.yoffset * ctx->finfo.line_length +
+         (size_t)ctx->vinfo.xoffset * ctx->px_size;
+
+    if (ctx->scratch != NULL) {
+        row = src;
+
+        for (y = a->y1; y <= a->y2; y++) {
+            fbdev_copy_row(ctx, ctx->scratch + (size_t)(y - a->y1) * w * ctx->px_size,
+                           row, w, a->x1, y);
+            row += src_stride;
+        }
+
+        src = ctx->scratch;
+        src_stride = w * ctx->px_size;
+    }
+
+    pixel_convert_rotate(ctx->convert, fb, ctx->finfo.line_length, src, src_stride,
+                         ctx->px_size, a->x1, a->y1, w, h, ctx->width, ctx->height,
+                         ctx->rotation);
+}
+
+/**
+ * Copy a row of pixels to the framebuffer
+ *
+ * @param ctx the fbdev context
+ * @param dst the destination in the framebuffer
+ * @param src the source in the draw buffer
+ * @param n the number of pixels
+ * @param x the screen column of the first pixel
+ * @param y the screen row
+ */
+static void fbdev_copy_row(fbdev_ctx_t *ctx, uint8_t *dst, const uint8_t *src,
+                           uint32_t n, uint32_t x, uint32_t y)
+{
+    if (ctx->render_cf == LV_COLOR_FORMAT_XRGB8888 && ctx->fb_cf == LV_COLOR_FORMAT_RGB565) {
+        ctx->convert->xrgb8888_to_rgb565((uint16_t *)dst, (const uint32_t *)src, n,
+                                         ctx->convert_flags, x, y);
+    } else if (ctx->convert_flags & PIXEL_CONVERT_SWAP) {
+        ctx->convert->rgb565_swap((uint16_t *)dst, (const uint16_t *)src, n);
+    } else {
+        memcpy(dst, src, n * ctx->px_size);
+    }
+}
+
+/**
+ * Blank or unblank the framebuffer
+ *
+ * @note called by the frame governor, works with both flush paths
+ * @param disp the display
+ * @param blank true to power the display down
+ * @return 0 on success, -1 on error
+ */
+static int fbdev_blank_cb(lv_display_t *disp, bool blank)
+{
+    const char *device = NULL;
+    int fd;
+    int ret;
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (fbdev_devices[i].disp == disp) {
+            device = fbdev_devices[i].device;
+        }
+    }
+
+    fd = device != NULL ? open(device, O_RDWR | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        return -1;
+    }
+
+    ret = ioctl(fd, FBIOBLANK, blank ? FB_BLANK_POWERDOWN : FB_BLANK_UNBLANK);
+    close(fd);
+
+    return ret < 0 ? -1 : 0;
+}
+
+/**
+ * Release the framebuffer when the display is deleted
+ *
+ * @note the display is deleted when the backend is re-initialized
+ * @param e the delete event of the display
+ */
+static void fbdev_delete_cb(lv_event_t *e)
+{
+    fbdev_ctx_t *ctx = lv_event_get_user_data(e);
+
+    munmap(ctx->fb_map, ctx->fb_size);
+    close(ctx->fd);
+    free(ctx->shadow);
+    free(ctx->shadow2);
+    free(ctx->stripes[0]);
+    free(ctx->stripes[1]);
+    free(ctx->scratch);
+    free(ctx);
+}
+
+/**
+ * Forget the device of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void fbdev_device_delete_cb(lv_event_t *e)
+{
+    memset(lv_event_get_user_data(e), 0, sizeof(fbdev_devices[0]));
+}
+
+/**
+ * The run loop of the fbdev driver
+ */
+static void run_loop_fbdev(void)
+{
+    /* Sleep until an input event, a wakeup or the next LVGL timer is due */
+    event_loop_run(NULL);
 }
 
 #endif /*LV_USE_LINUX_FBDEV*/
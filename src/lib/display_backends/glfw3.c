@@ -8,6 +8,8 @@
  * Move to a separate file
  * 2025 EDGEMTech Ltd.
  *
+ * Stream the dirty areas to the texture through a ring of mapped PBOs
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -19,32 +21,69 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_GLFW
+#include <GL/glew.h>
+
+#include "lvgl/src/display/lv_display_private.h"
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../event_loop.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Frames in flight, the CPU writes a PBO while the GPU reads the others */
+#define PBO_RING_SIZE 3
+
+/* Longest wait for the GPU to release a PBO */
+#define PBO_FENCE_TIMEOUT_NS 1000000000ull
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+typedef struct {
+    GLuint id;
+    uint8_t *map;                   /* Persistent mapping, NULL if mapped per area */
+    GLsync fence;                   /* Signaled once the GPU read the last frame */
+} pbo_t;
+
+/* The streaming upload of a texture display */
+typedef struct {
+    lv_display_t *disp;
+    GLuint texture;
+    uint32_t stride;
+    size_t size;
+    pbo_t pbos[PBO_RING_SIZE];
+    uint32_t cur;
+    bool frame_started;
+    lv_display_flush_cb_t texture_flush_cb;
+} pbo_ring_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 static void run_loop_glfw3(void);
 static lv_display_t *init_glfw3(void);
+static void pbo_ring_create(lv_display_t *disp, GLuint texture);
+static void pbo_ring_destroy(pbo_ring_t *ring);
+static void pbo_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void pbo_wait(pbo_t *pbo);
+static void pbo_delete_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 static char *backend_name = "GLFW";
 
+static pbo_ring_t *rings[BACKEND_MAX_DISPLAYS];
+
 /**********************
  *  EXTERNAL VARIABLES
  **********************/
@@ -122,6 +161,13 @@ static lv_display_t *init_glfw3(void)
     lv_image_set_src(cursor_obj, &mouse_cursor_icon);
     lv_indev_set_cursor(mouse, cursor_obj);
 
+#if !LV_USE_DRAW_OPENGLES
+    /* The software rendered frames are uploaded by the CPU */
+    if (getenv_default("LV_SIM_GLFW_PBO", "1")[0] == '1') {
+        pbo_ring_create(disp_texture, disp_texture_id);
+    }
+#endif
+
     return disp_texture;
 }
 
@@ -130,15 +176,248 @@ static lv_display_t *init_glfw3(void)
  */
 void run_loop_glfw3(void)
 {
-    uint32_t idle_time;
+    /* Sleep until an input event, a wakeup or the next LVGL timer is due */
+    event_loop_run(NULL);
+}
+
+/**
+ * Stream the frames of a texture display through PBOs
+ *
+ * @description replaces the flush callback of the texture display, which
+ * uploads the whole frame with a blocking glTexImage2D. The dirty areas are
+ * copied to a PBO and uploaded from it with glTexSubImage2D, the copy is
+ * the only work of the CPU. The ring holds PBO_RING_SIZE buffers guarded by
+ * fences, the PBO of the next frame is normally released by the GPU already.
+ * The PBOs are persistently mapped with GL 4.4 or ARB_buffer_storage,
+ * otherwise each area is mapped unsynchronized
+ * @param disp the texture display
+ * @param texture the texture of the display
+ */
+static void pbo_ring_create(lv_display_t *disp, GLuint texture)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    lv_color_format_t cf = lv_display_get_color_format(disp);
+    int32_t hor_res = lv_display_get_horizontal_resolution(disp);
+    int32_t ver_res = lv_display_get_vertical_resolution(disp);
+    bool persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    pbo_ring_t *ring;
+    uint32_t slot;
+    uint32_t i;
 
-    /* Handle LVGL tasks */
-    while (true) {
+    /* glMapBufferRange is needed by both mapping modes */
+    if (!GLEW_VERSION_2_1 || !GLEW_ARB_sync || !(GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range) ||
+        lv_color_format_get_size(cf) != 4) {
+        LV_LOG_WARN("PBO streaming unavailable, uploading whole frames");
+        return;
+    }
 
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    for (slot = 0; slot < BACKEND_MAX_DISPLAYS && rings[slot] != NULL; slot++);
+    if (slot == BACKEND_MAX_DISPLAYS) {
+        return;
     }
+
+    ring = calloc(1, sizeof(pbo_ring_t));
+    if (ring == NULL) {
+        return;
+    }
+
+    ring->disp = disp;
+    ring->texture = texture;
+    ring->stride = lv_draw_buf_width_to_stride(hor_res, cf);
+    ring->size = (size_t)ring->stride * ver_res;
+    ring->texture_flush_cb = disp->flush_cb;
+
+    /* The areas are uploaded into the texture allocated once */
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, hor_res, ver_res, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (i = 0; i < PBO_RING_SIZE; i++) {
+        glGenBuffers(1, &ring->pbos[i].id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->pbos[i].id);
+
+        if (persistent) {
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ring->size, NULL, flags);
+            ring->pbos[i].map = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ring->size, flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, ring->size, NULL, GL_STREAM_DRAW);
+        }
+
+        if (persistent && ring->pbos[i].map == NULL) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            LV_LOG_WARN("Failed to map the PBOs, uploading whole frames");
+            pbo_ring_destroy(ring);
+            return;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    rings[slot] = ring;
+    lv_display_set_flush_cb(disp, pbo_flush_cb);
+    lv_display_add_event_cb(disp, pbo_delete_cb, LV_EVENT_DELETE, ring);
+
+    LV_LOG_USER("Streaming %dx%d frames through %d PBOs%s", hor_res, ver_res,
+                PBO_RING_SIZE, persistent ? ", persistently mapped" : "");
+}
+
+/**
+ * Free the PBOs of a ring
+ *
+ * @param ring the ring
+ */
+static void pbo_ring_destroy(pbo_ring_t *ring)
+{
+    uint32_t i;
+
+    for (i = 0; i < PBO_RING_SIZE; i++) {
+        if (ring->pbos[i].fence != NULL) {
+            glDeleteSync(ring->pbos[i].fence);
+        }
+
+        if (ring->pbos[i].map != NULL) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->pbos[i].id);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+
+        if (ring->pbos[i].id != 0) {
+            glDeleteBuffers(1, &ring->pbos[i].id);
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (rings[i] == ring) {
+            rings[i] = NULL;
+        }
+    }
+
+    free(ring);
+}
+
+/**
+ * Upload a dirty area of the texture display
+ *
+ * @note called by LVGL for each area of the frame
+ * @param disp the texture display
+ * @param area the area in screen coordinates
+ * @param px_map the pixels of the area, the whole frame in direct mode
+ */
+static void pbo_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    pbo_ring_t *ring = NULL;
+    uint32_t bpp = 4;
+    uint32_t width = lv_area_get_width(area);
+    uint32_t height = lv_area_get_height(area);
+    uint32_t src_stride;
+    size_t offset;
+    uint8_t *dst;
+    pbo_t *pbo;
+    uint32_t i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (rings[i] != NULL && rings[i]->disp == disp) {
+            ring = rings[i];
+        }
+    }
+
+    LV_ASSERT_NULL(ring);
+    pbo = &ring->pbos[ring->cur];
+
+    if (!ring->frame_started) {
+        pbo_wait(pbo);
+        ring->frame_started = true;
+    }
+
+    /* The PBO has the layout of the frame, the offset is also the one of the texture */
+    offset = (size_t)area->y1 * ring->stride + (size_t)area->x1 * bpp;
+
+    if (disp->render_mode == LV_DISPLAY_RENDER_MODE_PARTIAL) {
+        src_stride = lv_draw_buf_width_to_stride(width, lv_display_get_color_format(disp));
+    } else {
+        src_stride = ring->stride;
+        px_map += offset;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->id);
+
+    if (pbo->map != NULL) {
+        dst = pbo->map + offset;
+    } else {
+        /* The fence was waited for, the GPU doesn't read this PBO */
+        dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset,
+                               (size_t)(height - 1) * ring->stride + width * bpp,
+                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    if (dst != NULL) {
+        for (i = 0; i < height; i++) {
+            memcpy(dst + (size_t)i * ring->stride, px_map + (size_t)i * src_stride, width * bpp);
+        }
+
+        if (pbo->map == NULL) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, ring->texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, ring->stride / bpp);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, area->x1, area->y1, width, height,
+                        GL_BGRA, GL_UNSIGNED_BYTE, (const void *)(uintptr_t)offset);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (lv_display_flush_is_last(disp)) {
+        pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ring->cur = (ring->cur + 1) % PBO_RING_SIZE;
+        ring->frame_started = false;
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Wait until the GPU read a PBO
+ *
+ * @description only blocks if the GPU is more than PBO_RING_SIZE - 1
+ * frames behind
+ * @param pbo the PBO about to be written
+ */
+static void pbo_wait(pbo_t *pbo)
+{
+    GLenum ret;
+
+    if (pbo->fence == NULL) {
+        return;
+    }
+
+    ret = glClientWaitSync(pbo->fence, 0, 0);
+
+    if (ret == GL_TIMEOUT_EXPIRED) {
+        LV_LOG_TRACE("Waiting for the GPU to release a PBO");
+        glClientWaitSync(pbo->fence, GL_SYNC_FLUSH_COMMANDS_BIT, PBO_FENCE_TIMEOUT_NS);
+    }
+
+    glDeleteSync(pbo->fence);
+    pbo->fence = NULL;
+}
+
+/**
+ * Free the PBOs of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void pbo_delete_cb(lv_event_t *e)
+{
+    pbo_ring_t *ring = lv_event_get_user_data(e);
+
+    /* The texture display deletes the texture on its own */
+    lv_display_set_flush_cb(ring->disp, ring->texture_flush_cb);
+    pbo_ring_destroy(ring);
 }
 
 #endif /*#if LV_USE_GLFW*/
@@ -0,0 +1,371 @@
+/**
+ * @file headless.c
+ *
+ * Offscreen display used to benchmark the rendering
+ *
+ * LVGL renders into a buffer in memory, the tick is advanced by a fixed
+ * step for each frame instead of following the real time, so that
+ * animations produce the same frames on every run, regardless of the
+ * speed of the machine
+ *
+ * With LV_SIM_HEADLESS_FRAMES=0 the display runs in real time on the
+ * event loop instead, as the only sink of the exported frames
+ * (LV_SIM_FRAME_EXPORT)
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "lvgl/lvgl.h"
+#include "../simulator_util.h"
+#include "../simulator_settings.h"
+#include "../backends.h"
+#include "../event_loop.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Maximum number of frames that can be selected with LV_SIM_HEADLESS_DUMP */
+#define HEADLESS_MAX_DUMPS 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint8_t *buf;               /* The frame, rendered in direct mode */
+    uint32_t stride;
+    uint32_t frame_cnt;         /* Number of frames to run, 0 to run in real time */
+    uint32_t frame_ms;          /* Tick increment per frame */
+    uint32_t rendered;          /* Number of frames where something was rendered */
+    uint64_t pixels;            /* Number of pixels flushed */
+    uint32_t dumps[HEADLESS_MAX_DUMPS];
+    uint32_t dump_cnt;
+    const char *dump_dir;
+} headless_ctx_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static lv_display_t *init_headless(void);
+static void run_loop_headless(void);
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static uint32_t tick_cb(void);
+static void parse_dumps(const char *list);
+static bool dump_frame(uint32_t frame);
+static double elapsed_s(const struct timespec *start, const struct timespec *end);
+static void delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static char *backend_name = "HEADLESS";
+
+static headless_ctx_t ctx;
+
+/* The virtual time in ms */
+static uint32_t tick;
+
+/**********************
+ *  EXTERNAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Register the backend
+ *
+ * @param backend the backend descriptor
+ * @description configures the descriptor
+ */
+int backend_init_headless(backend_t *backend)
+{
+    LV_ASSERT_NULL(backend);
+
+    backend->handle->display = malloc(sizeof(display_backend_t));
+    LV_ASSERT_NULL(backend->handle->display);
+
+    backend->handle->display->init_display = init_headless;
+    backend->handle->display->run_loop = run_loop_headless;
+    backend->name = backend_name;
+    backend->type = BACKEND_DISPLAY;
+
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Initialize the headless display
+ *
+ * @description the size of the display is the size of the simulator window
+ * @return the LVGL display or NULL on failure
+ */
+static lv_display_t *init_headless(void)
+{
+    lv_display_t *disp;
+    lv_color_format_t cf;
+
+    /* The virtual tick is global, it can't follow two displays */
+    if (ctx.buf != NULL) {
+        LV_LOG_ERROR("Only one headless display is supported");
+        return NULL;
+    }
+
+    ctx.frame_cnt = atoi(getenv_default("LV_SIM_HEADLESS_FRAMES", "300"));
+    ctx.frame_ms = atoi(getenv_default("LV_SIM_HEADLESS_FRAME_MS", "16"));
+    ctx.dump_dir = getenv_default("LV_SIM_HEADLESS_DUMP_DIR", ".");
+    parse_dumps(getenv_default("LV_SIM_HEADLESS_DUMP", ""));
+
+    if (ctx.frame_ms == 0) {
+        ctx.frame_ms = 1;
+    }
+
+    disp = lv_display_create(settings.window_width, settings.window_height);
+    if (disp == NULL) {
+        return NULL;
+    }
+
+    cf = lv_display_get_color_format(disp);
+    ctx.stride = settings.window_width * lv_color_format_get_size(cf);
+    ctx.buf = malloc((size_t)ctx.stride * settings.window_height);
+
+    if (ctx.buf == NULL) {
+        LV_LOG_ERROR("Failed to allocate the frame buffer");
+        lv_display_delete(disp);
+        return NULL;
+    }
+
+    lv_display_set_buffers_with_stride(disp, ctx.buf, NULL,
+                                       ctx.stride * settings.window_height, ctx.stride,
+                                       LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(disp, flush_cb);
+    lv_display_add_event_cb(disp, delete_cb, LV_EVENT_DELETE, NULL);
+
+    /* Frames must not depend on the time it takes to render them */
+    if (ctx.frame_cnt > 0) {
+        lv_tick_set_cb(tick_cb);
+    }
+
+    return disp;
+}
+
+/**
+ * Render the configured number of frames as fast as possible
+ *
+ * @description prints the throughput and returns,
+ * runs the event loop if no number of frames is set
+ */
+static void run_loop_headless(void)
+{
+    struct timespec start;
+    struct timespec end;
+    struct timespec dump_start;
+    double dump_time = 0;
+    double elapsed;
+    uint32_t frame;
+
+    if (ctx.frame_cnt == 0) {
+        event_loop_run(NULL);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (frame = 0; frame < ctx.frame_cnt; frame++) {
+        tick += ctx.frame_ms;
+
+        lv_lock();
+        lv_timer_handler();
+        lv_unlock();
+
+        /* Writing the frames is not part of the measurement */
+        clock_gettime(CLOCK_MONOTONIC, &dump_start);
+        if (dump_frame(frame)) {
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            dump_time += elapsed_s(&dump_start, &end);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = elapsed_s(&start, &end) - dump_time;
+
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+
+    fprintf(stdout, "headless frames=%u rendered=%u time=%.3fs fps=%.1f mpx_per_s=%.2f\n",
+            ctx.frame_cnt, ctx.rendered, elapsed, ctx.rendered / elapsed,
+            (double)ctx.pixels / elapsed / 1e6);
+}
+
+/**
+ * Count the flushed pixels
+ *
+ * @param disp the LVGL display
+ * @param area the area that was rendered
+ * @param px_map unused, the frame is in the draw buffer
+ */
+static void flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    LV_UNUSED(px_map);
+
+    ctx.pixels += lv_area_get_size(area);
+
+    if (lv_display_flush_is_last(disp)) {
+        ctx.rendered++;
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Get the virtual time
+ *
+ * @return the time in ms
+ */
+static uint32_t tick_cb(void)
+{
+    return tick;
+}
+
+/**
+ * Parse the list of frames to dump
+ *
+ * @param list the frame numbers separated by a comma i.e "0,100,299"
+ */
+static void parse_dumps(const char *list)
+{
+    char *end;
+    long v;
+
+    while (*list != '\0' && ctx.dump_cnt < HEADLESS_MAX_DUMPS) {
+        v = strtol(list, &end, 10);
+        if (end == list || v < 0) {
+            LV_LOG_WARN("Invalid LV_SIM_HEADLESS_DUMP entry: %s", list);
+            return;
+        }
+
+        ctx.dumps[ctx.dump_cnt++] = (uint32_t)v;
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+/**
+ * Write the frame to a binary PPM file if it was selected
+ *
+ * @param frame the frame number
+ * @return true if the frame was written
+ */
+static bool dump_frame(uint32_t frame)
+{
+    char path[256];
+    lv_color_format_t cf = lv_display_get_color_format(lv_display_get_default());
+    uint32_t w = settings.window_width;
+    uint32_t h = settings.window_height;
+    uint8_t *rgb;
+    uint8_t *src;
+    uint16_t c;
+    uint32_t x;
+    uint32_t y;
+    uint32_t i;
+    FILE *f;
+
+    for (i = 0; i < ctx.dump_cnt; i++) {
+        if (ctx.dumps[i] == frame) {
+            break;
+        }
+    }
+
+    if (i == ctx.dump_cnt) {
+        return false;
+    }
+
+    rgb = malloc((size_t)w * 3);
+    if (rgb == NULL) {
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "%s/frame_%05u.ppm", ctx.dump_dir, frame);
+    f = fopen(path, "wb");
+
+    if (f == NULL) {
+        LV_LOG_ERROR("Failed to open %s: %s", path, strerror(errno));
+        free(rgb);
+        return false;
+    }
+
+    fprintf(f, "P6\n%u %u\n255\n", w, h);
+
+    for (y = 0; y < h; y++) {
+        src = ctx.buf + (size_t)y * ctx.stride;
+
+        for (x = 0; x < w; x++) {
+            if (cf == LV_COLOR_FORMAT_RGB565) {
+                c = ((uint16_t *)src)[x];
+                rgb[x * 3 + 0] = (uint8_t)(((c >> 11) & 0x1F) * 255 / 31);
+                rgb[x * 3 + 1] = (uint8_t)(((c >> 5) & 0x3F) * 255 / 63);
+                rgb[x * 3 + 2] = (uint8_t)((c & 0x1F) * 255 / 31);
+            } else {
+                /* RGB888 and XRGB8888 are stored as B, G, R */
+                i = x * lv_color_format_get_size(cf);
+                rgb[x * 3 + 0] = src[i + 2];
+                rgb[x * 3 + 1] = src[i + 1];
+                rgb[x * 3 + 2] = src[i + 0];
+            }
+        }
+
+        fwrite(rgb, 3, w, f);
+    }
+
+    fclose(f);
+    free(rgb);
+
+    LV_LOG_USER("Frame %u written to %s", frame, path);
+    return true;
+}
+
+/**
+ * Get the time between two timestamps
+ *
+ * @return the time in seconds
+ */
+static double elapsed_s(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Release the frame buffer when the display is deleted
+ *
+ * @note the display is deleted when the backend is re-initialized
+ */
+static void delete_cb(lv_event_t *e)
+{
+    LV_UNUSED(e);
+
+    free(ctx.buf);
+    ctx.buf = NULL;
+    ctx.dump_cnt = 0;
+}
@@ -8,6 +8,12 @@
  * - Move to a separate file
  *   2025 EDGEMTech Ltd.
  *
+ * - Present with vsync from a streaming texture updated with the
+ *   damaged areas, sleep in SDL_WaitEventTimeout
+ *
+ * - Read the input devices periodically while a button or a key is held,
+ *   for the long presses and the key repeat
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -18,21 +24,59 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_SDL
+#include LV_SDL_INCLUDE_PATH
+
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../event_loop.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Key presses and releases queued between two reads of the keypad */
+#define SDL_KEY_QUEUE_LEN 16
+
+/* Height of the partial draw buffer, in fractions of the window */
+#define SDL_BUF_FRACTION 10
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+typedef struct {
+    uint32_t key;
+    bool pressed;
+} sdl_key_t;
+
+/* The window presented by the port */
+typedef struct {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    void *buf;
+    lv_display_t *disp;
+    lv_indev_t *pointer;
+    lv_indev_t *keypad;
+    lv_indev_t *wheel;
+    lv_point_t point;
+    bool pressed;
+    int16_t wheel_diff;
+    bool wheel_pressed;
+    sdl_key_t keys[SDL_KEY_QUEUE_LEN];
+    uint32_t key_head;
+    uint32_t key_cnt;
+    uint32_t last_key;              /* Reported again while held */
+    bool key_pressed;
+    lv_timer_t *hold_timer;         /* Reads the input devices while held */
+} sdl_present_t;
+
 /**********************
  *  EXTERNAL VARIABLES
  **********************/
@@ -43,6 +87,21 @@ extern simulator_settings_t settings;
  **********************/
 static void run_loop_sdl(void);
 static lv_display_t *init_sdl(void);
+static lv_display_t *sdl_present_create(int32_t hor_res, int32_t ver_res);
+static void sdl_present_destroy(sdl_present_t *p);
+static void sdl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static uint32_t sdl_handler(void);
+static void sdl_wait_cb(int32_t timeout);
+static void sdl_wake_cb(void);
+static void sdl_handle_event(sdl_present_t *p, SDL_Event *ev);
+static void sdl_queue_key(sdl_present_t *p, uint32_t key, bool pressed);
+static uint32_t sdl_map_key(SDL_Keycode sym);
+static void sdl_pointer_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void sdl_keypad_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void sdl_wheel_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void sdl_update_hold(sdl_present_t *p);
+static void sdl_hold_timer_cb(lv_timer_t *timer);
+static void sdl_delete_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
@@ -50,6 +109,12 @@ static lv_display_t *init_sdl(void);
 
 static char *backend_name = "SDL";
 
+/* SDL events are read from a single queue, only one window is presented */
+static sdl_present_t *present;
+
+/* Pushed by event_loop_wakeup */
+static uint32_t wake_event = (uint32_t)-1;
+
 /**********************
  *      MACROS
  **********************/
@@ -85,12 +150,24 @@ int backend_init_sdl(backend_t *backend)
 /**
  * Initialize the SDL display driver
  *
+ * @description the window is presented by the port unless LV_SIM_SDL_PRESENT
+ * is set to 0, then the LVGL driver is used
  * @return the LVGL display
  */
 static lv_display_t *init_sdl(void)
 {
     lv_display_t *disp;
 
+    if (present != NULL) {
+        /* The LVGL driver would consume the events of the window */
+        LV_LOG_ERROR("Only one SDL window can be presented by the port");
+        return NULL;
+    }
+
+    if (getenv_default("LV_SIM_SDL_PRESENT", "1")[0] == '1') {
+        return sdl_present_create(settings.window_width, settings.window_height);
+    }
+
     disp = lv_sdl_window_create(settings.window_width, settings.window_height);
 
     if (disp == NULL) {
@@ -105,13 +182,448 @@ static lv_display_t *init_sdl(void)
  */
 static void run_loop_sdl(void)
 {
-    uint32_t idle_time;
+    if (present != NULL) {
+        /* Sleep in SDL_WaitEventTimeout until an SDL event or the next LVGL timer */
+        event_loop_run(sdl_handler);
+        return;
+    }
+
+    /* Sleep until an input event, a wakeup or the next LVGL timer is due */
+    event_loop_run(NULL);
+}
+
+/**
+ * Create a window presented by the port
+ *
+ * @description LVGL renders in partial mode, each area is copied into the
+ * locked rectangle of a streaming texture. After the last area the texture
+ * is presented, with LV_SIM_SDL_VSYNC the present waits for the vertical
+ * blank so that the frame rate matches the one of a panel. The run loop
+ * sleeps in SDL_WaitEventTimeout until the next LVGL timer, the input
+ * devices are read as their events arrive
+ * @param hor_res the width of the window
+ * @param ver_res the height of the window
+ * @return the LVGL display or NULL on error
+ */
+static lv_display_t *sdl_present_create(int32_t hor_res, int32_t ver_res)
+{
+    bool vsync = getenv_default("LV_SIM_SDL_VSYNC", "1")[0] == '1';
+    lv_color_format_t cf = LV_COLOR_DEPTH == 16 ? LV_COLOR_FORMAT_RGB565 : LV_COLOR_FORMAT_XRGB8888;
+    /* RGB888 is the XRGB8888 layout of SDL2, the padding byte is not an alpha channel */
+    uint32_t format = LV_COLOR_DEPTH == 16 ? SDL_PIXELFORMAT_RGB565 : SDL_PIXELFORMAT_RGB888;
+    uint32_t buf_size;
+    sdl_present_t *p;
+    lv_group_t *g;
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        LV_LOG_ERROR("SDL_Init failed: %s", SDL_GetError());
+        return NULL;
+    }
+
+    p = calloc(1, sizeof(sdl_present_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->window = SDL_CreateWindow("LVGL Simulator", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                 hor_res, ver_res,
+                                 settings.fullscreen ? SDL_WINDOW_FULLSCREEN : 0);
+    if (p->window == NULL) {
+        LV_LOG_ERROR("Failed to create the SDL window: %s", SDL_GetError());
+        sdl_present_destroy(p);
+        return NULL;
+    }
+
+    p->renderer = SDL_CreateRenderer(p->window, -1, SDL_RENDERER_ACCELERATED |
+                                     (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
+    if (p->renderer == NULL) {
+        LV_LOG_WARN("No accelerated renderer, using the software one");
+        p->renderer = SDL_CreateRenderer(p->window, -1, SDL_RENDERER_SOFTWARE);
+    }
+
+    if (p->renderer != NULL) {
+        p->texture = SDL_CreateTexture(p->renderer, format, SDL_TEXTUREACCESS_STREAMING,
+                                       hor_res, ver_res);
+    }
+
+    /* The texture covers the window, it is copied without blending */
+    if (p->texture != NULL) {
+        SDL_SetTextureBlendMode(p->texture, SDL_BLENDMODE_NONE);
+    }
+
+    buf_size = lv_draw_buf_width_to_stride(hor_res, cf) *
+               LV_MAX(ver_res / SDL_BUF_FRACTION, 1);
+    p->buf = malloc(buf_size);
 
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    if (wake_event == (uint32_t)-1) {
+        wake_event = SDL_RegisterEvents(1);
     }
+
+    if (p->texture == NULL || p->buf == NULL || wake_event == (uint32_t)-1) {
+        LV_LOG_ERROR("Failed to create the SDL texture: %s", SDL_GetError());
+        sdl_present_destroy(p);
+        return NULL;
+    }
+
+    p->disp = lv_display_create(hor_res, ver_res);
+    lv_display_set_color_format(p->disp, cf);
+    lv_display_set_buffers(p->disp, p->buf, NULL, buf_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_flush_cb(p->disp, sdl_flush_cb);
+    lv_display_set_driver_data(p->disp, p);
+    lv_display_add_event_cb(p->disp, sdl_delete_cb, LV_EVENT_DELETE, p);
+
+    p->pointer = lv_indev_create();
+    lv_indev_set_type(p->pointer, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(p->pointer, sdl_pointer_read_cb);
+
+    p->keypad = lv_indev_create();
+    lv_indev_set_type(p->keypad, LV_INDEV_TYPE_KEYPAD);
+    lv_indev_set_read_cb(p->keypad, sdl_keypad_read_cb);
+
+    p->wheel = lv_indev_create();
+    lv_indev_set_type(p->wheel, LV_INDEV_TYPE_ENCODER);
+    lv_indev_set_read_cb(p->wheel, sdl_wheel_read_cb);
+
+    lv_indev_set_driver_data(p->pointer, p);
+    lv_indev_set_driver_data(p->keypad, p);
+    lv_indev_set_driver_data(p->wheel, p);
+    lv_indev_set_display(p->pointer, p->disp);
+    lv_indev_set_display(p->keypad, p->disp);
+    lv_indev_set_display(p->wheel, p->disp);
+
+    /* Read when the SDL events arrive, and periodically while held */
+    lv_indev_set_mode(p->pointer, LV_INDEV_MODE_EVENT);
+    lv_indev_set_mode(p->keypad, LV_INDEV_MODE_EVENT);
+    lv_indev_set_mode(p->wheel, LV_INDEV_MODE_EVENT);
+
+    p->hold_timer = lv_timer_create(sdl_hold_timer_cb, LV_DEF_REFR_PERIOD, p);
+    lv_timer_pause(p->hold_timer);
+
+    g = lv_group_create();
+    lv_group_set_default(g);
+    lv_indev_set_group(p->keypad, g);
+    lv_indev_set_group(p->wheel, g);
+
+    present = p;
+    event_loop_set_wait_cb(sdl_wait_cb, sdl_wake_cb);
+
+    LV_LOG_USER("Presenting with a streaming texture%s", vsync ? ", vsync" : "");
+    return p->disp;
+}
+
+/**
+ * Free the SDL resources of the window
+ *
+ * @param p the presented window
+ */
+static void sdl_present_destroy(sdl_present_t *p)
+{
+    if (p->texture != NULL) {
+        SDL_DestroyTexture(p->texture);
+    }
+
+    if (p->renderer != NULL) {
+        SDL_DestroyRenderer(p->renderer);
+    }
+
+    if (p->window != NULL) {
+        SDL_DestroyWindow(p->window);
+    }
+
+    free(p->buf);
+    free(p);
+}
+
+/**
+ * Copy a damaged area to the texture
+ *
+ * @note called by LVGL for each area of the frame
+ * @param disp the display
+ * @param area the area in screen coordinates
+ * @param px_map the pixels of the area
+ */
+static void sdl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    sdl_present_t *p = lv_display_get_driver_data(disp);
+    int32_t width = lv_area_get_width(area);
+    int32_t height = lv_area_get_height(area);
+    uint32_t stride = lv_draw_buf_width_to_stride(width, lv_display_get_color_format(disp));
+    uint32_t row = width * lv_color_format_get_size(lv_display_get_color_format(disp));
+    SDL_Rect rect = { area->x1, area->y1, width, height };
+    uint8_t *pixels;
+    int pitch;
+    int32_t y;
+
+    /* Only the locked rectangle is written, it doesn't keep the previous pixels */
+    if (SDL_LockTexture(p->texture, &rect, (void **)&pixels, &pitch) == 0) {
+        for (y = 0; y < height; y++) {
+            memcpy(pixels + (size_t)y * pitch, px_map + (size_t)y * stride, row);
+        }
+
+        SDL_UnlockTexture(p->texture);
+    }
+
+    if (lv_display_flush_is_last(disp)) {
+        SDL_RenderCopy(p->renderer, p->texture, NULL, NULL);
+        /* Blocks until the vertical blank with vsync */
+        SDL_RenderPresent(p->renderer);
+    }
+
+    lv_display_flush_ready(disp);
+}
+
+/**
+ * Process the SDL events, then run the LVGL tasks
+ *
+ * @note called by the event loop
+ * @return the time in ms until the next LVGL timer
+ */
+static uint32_t sdl_handler(void)
+{
+    SDL_Event ev;
+
+    while (present != NULL && SDL_PollEvent(&ev)) {
+        sdl_handle_event(present, &ev);
+    }
+
+    return lv_timer_handler();
+}
+
+/**
+ * Sleep until an SDL event or the timeout
+ *
+ * @description the event is left in the queue for sdl_handler
+ * @param timeout the timeout in ms, -1 to wait for an event
+ */
+static void sdl_wait_cb(int32_t timeout)
+{
+    if (timeout < 0) {
+        SDL_WaitEvent(NULL);
+    } else {
+        SDL_WaitEventTimeout(NULL, timeout);
+    }
+}
+
+/**
+ * Interrupt sdl_wait_cb
+ *
+ * @note called by event_loop_wakeup from any thread
+ */
+static void sdl_wake_cb(void)
+{
+    SDL_Event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = wake_event;
+    SDL_PushEvent(&ev);
+}
+
+/**
+ * Handle an SDL event
+ *
+ * @param p the presented window
+ * @param ev the event
+ */
+static void sdl_handle_event(sdl_present_t *p, SDL_Event *ev)
+{
+    uint32_t key;
+
+    switch (ev->type) {
+    case SDL_MOUSEMOTION:
+        p->point.x = ev->motion.x;
+        p->point.y = ev->motion.y;
+        lv_indev_read(p->pointer);
+        break;
+
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        p->point.x = ev->button.x;
+        p->point.y = ev->button.y;
+
+        if (ev->button.button == SDL_BUTTON_LEFT) {
+            p->pressed = ev->type == SDL_MOUSEBUTTONDOWN;
+            lv_indev_read(p->pointer);
+        } else if (ev->button.button == SDL_BUTTON_MIDDLE) {
+            p->wheel_pressed = ev->type == SDL_MOUSEBUTTONDOWN;
+            lv_indev_read(p->wheel);
+        }
+        break;
+
+    case SDL_MOUSEWHEEL:
+        p->wheel_diff -= ev->wheel.y;
+        lv_indev_read(p->wheel);
+        break;
+
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        /* The characters come with SDL_TEXTINPUT */
+        key = sdl_map_key(ev->key.keysym.sym);
+        if (key != 0) {
+            sdl_queue_key(p, key, ev->type == SDL_KEYDOWN);
+        }
+        break;
+
+    case SDL_TEXTINPUT:
+        if ((uint8_t)ev->text.text[0] >= 0x20 && (uint8_t)ev->text.text[0] < 0x80) {
+            sdl_queue_key(p, (uint8_t)ev->text.text[0], true);
+            sdl_queue_key(p, (uint8_t)ev->text.text[0], false);
+        }
+        break;
+
+    case SDL_WINDOWEVENT:
+        if (ev->window.event == SDL_WINDOWEVENT_EXPOSED) {
+            /* Repaint from the texture, nothing is rendered */
+            SDL_RenderCopy(p->renderer, p->texture, NULL, NULL);
+            SDL_RenderPresent(p->renderer);
+        }
+        break;
+
+    case SDL_QUIT:
+        event_loop_quit();
+        break;
+
+    default:
+        break;
+    }
+
+    sdl_update_hold(p);
+}
+
+static void sdl_queue_key(sdl_present_t *p, uint32_t key, bool pressed)
+{
+    uint32_t idx;
+
+    if (p->key_cnt == SDL_KEY_QUEUE_LEN) {
+        return;
+    }
+
+    idx = (p->key_head + p->key_cnt++) % SDL_KEY_QUEUE_LEN;
+    p->keys[idx].key = key;
+    p->keys[idx].pressed = pressed;
+    lv_indev_read(p->keypad);
+}
+
+/**
+ * Map an SDL key to a LVGL key
+ *
+ * @param sym the SDL key
+ * @return the LVGL key, 0 if not mapped
+ */
+static uint32_t sdl_map_key(SDL_Keycode sym)
+{
+    switch (sym) {
+    case SDLK_UP:           return LV_KEY_UP;
+    case SDLK_DOWN:         return LV_KEY_DOWN;
+    case SDLK_LEFT:         return LV_KEY_LEFT;
+    case SDLK_RIGHT:        return LV_KEY_RIGHT;
+    case SDLK_RETURN:
+    case SDLK_KP_ENTER:     return LV_KEY_ENTER;
+    case SDLK_BACKSPACE:    return LV_KEY_BACKSPACE;
+    case SDLK_ESCAPE:       return LV_KEY_ESC;
+    case SDLK_DELETE:       return LV_KEY_DEL;
+    case SDLK_HOME:         return LV_KEY_HOME;
+    case SDLK_END:          return LV_KEY_END;
+    case SDLK_TAB:
+        return (SDL_GetModState() & KMOD_SHIFT) ? LV_KEY_PREV : LV_KEY_NEXT;
+    default:
+        return 0;
+    }
+}
+
+static void sdl_pointer_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    sdl_present_t *p = lv_indev_get_driver_data(indev);
+
+    data->point = p->point;
+    data->state = p->pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static void sdl_keypad_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    sdl_present_t *p = lv_indev_get_driver_data(indev);
+    sdl_key_t *k;
+
+    if (p->key_cnt > 0) {
+        k = &p->keys[p->key_head];
+        p->key_head = (p->key_head + 1) % SDL_KEY_QUEUE_LEN;
+        p->key_cnt--;
+
+        p->last_key = k->key;
+        p->key_pressed = k->pressed;
+    }
+
+    /* The last key is reported while held, LVGL repeats it */
+    data->key = p->last_key;
+    data->state = p->key_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->continue_reading = p->key_cnt > 0;
+}
+
+static void sdl_wheel_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    sdl_present_t *p = lv_indev_get_driver_data(indev);
+
+    data->enc_diff = p->wheel_diff;
+    data->state = p->wheel_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    p->wheel_diff = 0;
+}
+
+/**
+ * Start or stop the periodic reads
+ *
+ * @description in event mode LVGL only reads an input device when an
+ * SDL event arrives, a press held still would never become a long press
+ * @param p the presented window
+ */
+static void sdl_update_hold(sdl_present_t *p)
+{
+    if (p->pressed || p->wheel_pressed || p->key_pressed || p->key_cnt > 0) {
+        lv_timer_resume(p->hold_timer);
+    } else {
+        lv_timer_pause(p->hold_timer);
+    }
+}
+
+/**
+ * Read the input devices that are held
+ *
+ * @param timer the hold timer
+ */
+static void sdl_hold_timer_cb(lv_timer_t *timer)
+{
+    sdl_present_t *p = lv_timer_get_user_data(timer);
+
+    if (p->pressed) {
+        lv_indev_read(p->pointer);
+    }
+
+    if (p->wheel_pressed) {
+        lv_indev_read(p->wheel);
+    }
+
+    if (p->key_pressed || p->key_cnt > 0) {
+        lv_indev_read(p->keypad);
+    }
+
+    sdl_update_hold(p);
+}
+
+/**
+ * Close the window of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void sdl_delete_cb(lv_event_t *e)
+{
+    sdl_present_t *p = lv_event_get_user_data(e);
+
+    lv_timer_delete(p->hold_timer);
+    lv_indev_delete(p->pointer);
+    lv_indev_delete(p->keypad);
+    lv_indev_delete(p->wheel);
+
+    event_loop_set_wait_cb(NULL, NULL);
+    present = NULL;
+
+    sdl_present_destroy(p);
 }
 #endif /*#if LV_USE_SDL*/
@@ -8,6 +8,8 @@
  * - Move to a seperate file
  *   2025 EDGEMTech Ltd.
  *
+ * - Sleep on the Wayland display fd in the shared event loop
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -18,12 +20,14 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_WAYLAND
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../event_loop.h"
 
 /*********************
  *      DEFINES
@@ -38,12 +42,17 @@
  **********************/
 static lv_display_t *init_wayland(void);
 static void run_loop_wayland(void);
+static uint32_t wayland_handler(void);
+static void wayland_ready_cb(int fd, uint32_t events, void *user_data);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 static char *backend_name = "WAYLAND";
 
+/* The connection is shared by the windows */
+static bool fd_watched;
+
 /**********************
  *  EXTERNAL VARIABLES
  **********************/
@@ -109,25 +118,42 @@ static lv_display_t *init_wayland(void)
     lv_indev_set_group(lv_wayland_get_keyboard(disp), g);
     lv_indev_set_group(lv_wayland_get_pointeraxis(disp), g);
 
+    if (!fd_watched && lv_wayland_get_fd() >= 0) {
+        fd_watched = event_loop_add_fd(lv_wayland_get_fd(), EPOLLIN,
+                                       wayland_ready_cb, NULL) == 0;
+    }
+
     return disp;
 
 }
 
 /**
- * The run loop of the DRM driver
+ * The run loop of the Wayland driver
  *
- * @note Currently, the wayland driver calls lv_timer_handler internaly
- * The wayland driver needs to be re-written to match the other backends
+ * @description the loop sleeps on the display fd, so it wakes up for the
+ * frame callbacks, the buffer releases and the input of the compositor
+ * instead of polling. The driver requests a frame callback with each
+ * flush, the next frame is then rendered as soon as the compositor asks
+ * for it and nothing wakes the loop while the window is hidden
+ * @note the wayland driver calls lv_timer_handler internaly
  */
 static void run_loop_wayland(void)
 {
-
     uint32_t idle_time;
 
+    if (fd_watched) {
+        event_loop_run(wayland_handler);
+        return;
+    }
+
+    LV_LOG_WARN("The Wayland display fd can't be watched, polling");
+
     /* Handle LVGL tasks */
     while (true) {
 
+        lv_lock();
         idle_time = lv_wayland_timer_handler();
+        lv_unlock();
 
         if(idle_time != 0) {
             usleep(idle_time * 1000);
@@ -140,4 +166,42 @@ static void run_loop_wayland(void)
     }
 }
 
+/**
+ * Run the LVGL tasks and the Wayland dispatch
+ *
+ * @note called by the event loop
+ * @return the time in ms until the next LVGL timer
+ */
+static uint32_t wayland_handler(void)
+{
+    /* Reads and dispatches the events, then flushes the requests */
+    uint32_t idle_time = lv_wayland_timer_handler();
+
+    /* Run until the last window closes */
+    if (!lv_wayland_window_is_open(NULL)) {
+        event_loop_quit();
+    }
+
+    return idle_time;
+}
+
+/**
+ * Wake up the run loop on Wayland events
+ *
+ * @description the events are read by lv_wayland_timer_handler, which
+ * runs right after this callback
+ * @note called from the event loop
+ */
+static void wayland_ready_cb(int fd, uint32_t events, void *user_data)
+{
+    LV_UNUSED(user_data);
+
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        LV_LOG_ERROR("Lost the connection to the compositor");
+        event_loop_remove_fd(fd);
+        fd_watched = false;
+        event_loop_quit();
+    }
+}
+
 #endif /*#if LV_USE_WAYLAND*/
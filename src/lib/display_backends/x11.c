@@ -8,6 +8,12 @@
  * Move to a separate file
  * 2025 EDGEMTech Ltd.
  *
+ * Present with MIT-SHM images or XPutImage of the damaged areas,
+ * the X connection is watched by the event loop
+ *
+ * Read the input devices periodically while a button or a key is held,
+ * for the long presses and the key repeat
+ *
  * Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
  */
@@ -19,21 +25,68 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/epoll.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XShm.h>
+
 #include "../simulator_util.h"
 #include "../simulator_settings.h"
 #include "../backends.h"
+#include "../event_loop.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Key presses and releases queued between two reads of the keypad */
+#define X11_KEY_QUEUE_LEN 16
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+typedef struct {
+    uint32_t key;
+    bool pressed;
+} x11_key_t;
+
+/* A window presented by the port */
+typedef struct {
+    Display *dpy;
+    Window win;
+    GC gc;
+    Atom wm_delete;
+    bool shm;
+    int completion_type;            /* Event type of XShmCompletionEvent */
+    XShmSegmentInfo segs[2];
+    XImage *images[2];              /* The draw buffers of LVGL */
+    XImage *front;                  /* Last presented image, repainted on Expose */
+    uint32_t pending;               /* XShmPutImage not completed */
+    lv_display_t *disp;
+    lv_indev_t *pointer;
+    lv_indev_t *keypad;
+    lv_indev_t *wheel;
+    lv_point_t point;
+    bool pressed;
+    int16_t wheel_diff;
+    bool wheel_pressed;
+    x11_key_t keys[X11_KEY_QUEUE_LEN];
+    uint32_t key_head;
+    uint32_t key_cnt;
+    uint32_t last_key;              /* Reported again while held */
+    bool key_pressed;
+    lv_timer_t *hold_timer;         /* Reads the input devices while held */
+} x11_window_t;
+
 /**********************
  *  EXTERNAL VARIABLES
  **********************/
@@ -44,12 +97,32 @@ extern simulator_settings_t settings;
  **********************/
 static lv_display_t *init_x11(void);
 static void run_loop_x11(void);
+static lv_display_t *x11_window_create(int32_t hor_res, int32_t ver_res);
+static bool x11_create_images(x11_window_t *w, int32_t hor_res, int32_t ver_res);
+static void x11_destroy_images(x11_window_t *w);
+static int x11_shm_error_handler(Display *dpy, XErrorEvent *err);
+static void x11_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void x11_flush_wait_cb(lv_display_t *disp);
+static Bool x11_is_completion(Display *dpy, XEvent *ev, XPointer arg);
+static void x11_fd_cb(int fd, uint32_t events, void *user_data);
+static void x11_handle_event(x11_window_t *w, XEvent *ev);
+static uint32_t x11_map_key(XKeyEvent *ev);
+static void x11_pointer_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void x11_keypad_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void x11_wheel_read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void x11_update_hold(x11_window_t *w);
+static void x11_hold_timer_cb(lv_timer_t *timer);
+static void x11_delete_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 static char *backend_name = "X11";
 
+/* Only one window is presented by the port, the others by LVGL */
+static x11_window_t *window;
+static bool shm_failed;
+
 /**********************
  *      MACROS
  **********************/
@@ -85,6 +158,9 @@ int backend_init_x11(backend_t *backend)
 /**
  * Initialize the X11 display driver
  *
+ * @description the window is presented by the port unless LV_SIM_X11_PRESENT
+ * is set to 0, the LVGL driver is used for the other windows and when
+ * the color depth isn't 32 bits
  * @return the LVGL display
  */
 static lv_display_t *init_x11(void)
@@ -92,11 +168,20 @@ static lv_display_t *init_x11(void)
     lv_display_t *disp;
     LV_IMG_DECLARE(mouse_cursor_icon);
 
+    if (LV_COLOR_DEPTH == 32 && window == NULL &&
+        getenv_default("LV_SIM_X11_PRESENT", "1")[0] == '1') {
+
+        disp = x11_window_create(settings.window_width, settings.window_height);
+        if (disp != NULL) {
+            return disp;
+        }
+
+        LV_LOG_WARN("Falling back to the LVGL X11 driver");
+    }
+
     disp = lv_x11_window_create("LVGL simulator",
            settings.window_width , settings.window_height);
 
-    disp = lv_display_get_default();
-
     if (disp == NULL) {
         return NULL;
     }
@@ -111,14 +196,551 @@ static lv_display_t *init_x11(void)
  */
 void run_loop_x11(void)
 {
-    uint32_t idle_time;
+    /* Sleep until an input event, a wakeup or the next LVGL timer is due */
+    event_loop_run(NULL);
+}
+
+/**
+ * Create a window presented by the port
+ *
+ * @description LVGL renders in direct mode into two XImages. With MIT-SHM
+ * the images live in shared memory segments and only the damaged areas
+ * are presented with XShmPutImage, the server reads the pixels without a
+ * copy through the socket. The next frame is drawn once the server
+ * reported the completion of the previous one. Without MIT-SHM, i.e. on
+ * a remote display, the damaged areas are sent with XPutImage.
+ * The connection fd is watched by the event loop, the input devices are
+ * read when an event arrives instead of being polled
+ * @param hor_res the width of the window
+ * @param ver_res the height of the window
+ * @return the LVGL display or NULL on error
+ */
+static lv_display_t *x11_window_create(int32_t hor_res, int32_t ver_res)
+{
+    x11_window_t *w;
+    lv_group_t *g;
+
+    w = calloc(1, sizeof(x11_window_t));
+    if (w == NULL) {
+        return NULL;
+    }
+
+    w->dpy = XOpenDisplay(NULL);
+    if (w->dpy == NULL) {
+        LV_LOG_ERROR("Failed to open the X display");
+        free(w);
+        return NULL;
+    }
+
+    w->win = XCreateSimpleWindow(w->dpy, DefaultRootWindow(w->dpy), 0, 0, hor_res, ver_res,
+                                 0, BlackPixel(w->dpy, DefaultScreen(w->dpy)),
+                                 BlackPixel(w->dpy, DefaultScreen(w->dpy)));
+    XStoreName(w->dpy, w->win, "LVGL simulator");
+    XSelectInput(w->dpy, w->win, ExposureMask | KeyPressMask | KeyReleaseMask |
+                 ButtonPressMask | ButtonReleaseMask | PointerMotionMask);
+
+    w->wm_delete = XInternAtom(w->dpy, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(w->dpy, w->win, &w->wm_delete, 1);
+    w->gc = XCreateGC(w->dpy, w->win, 0, NULL);
+
+    if (!x11_create_images(w, hor_res, ver_res) ||
+        event_loop_add_fd(ConnectionNumber(w->dpy), EPOLLIN, x11_fd_cb, w) < 0) {
+        x11_destroy_images(w);
+        XFreeGC(w->dpy, w->gc);
+        XDestroyWindow(w->dpy, w->win);
+        XCloseDisplay(w->dpy);
+        free(w);
+        return NULL;
+    }
+
+    w->disp = lv_display_create(hor_res, ver_res);
+    lv_display_set_buffers(w->disp, w->images[0]->data, w->images[1]->data,
+                           w->images[0]->bytes_per_line * ver_res,
+                           LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_flush_cb(w->disp, x11_flush_cb);
+    lv_display_set_flush_wait_cb(w->disp, x11_flush_wait_cb);
+    lv_display_set_driver_data(w->disp, w);
+    lv_display_add_event_cb(w->disp, x11_delete_cb, LV_EVENT_DELETE, w);
+
+    w->pointer = lv_indev_create();
+    lv_indev_set_type(w->pointer, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(w->pointer, x11_pointer_read_cb);
+
+    w->keypad = lv_indev_create();
+    lv_indev_set_type(w->keypad, LV_INDEV_TYPE_KEYPAD);
+    lv_indev_set_read_cb(w->keypad, x11_keypad_read_cb);
+
+    w->wheel = lv_indev_create();
+    lv_indev_set_type(w->wheel, LV_INDEV_TYPE_ENCODER);
+    lv_indev_set_read_cb(w->wheel, x11_wheel_read_cb);
+
+    lv_indev_set_driver_data(w->pointer, w);
+    lv_indev_set_driver_data(w->keypad, w);
+    lv_indev_set_driver_data(w->wheel, w);
+    lv_indev_set_display(w->pointer, w->disp);
+    lv_indev_set_display(w->keypad, w->disp);
+    lv_indev_set_display(w->wheel, w->disp);
+
+    /* Read when the X events arrive, and periodically while held */
+    lv_indev_set_mode(w->pointer, LV_INDEV_MODE_EVENT);
+    lv_indev_set_mode(w->keypad, LV_INDEV_MODE_EVENT);
+    lv_indev_set_mode(w->wheel, LV_INDEV_MODE_EVENT);
+
+    w->hold_timer = lv_timer_create(x11_hold_timer_cb, LV_DEF_REFR_PERIOD, w);
+    lv_timer_pause(w->hold_timer);
+
+    g = lv_group_create();
+    lv_group_set_default(g);
+    lv_indev_set_group(w->keypad, g);
+    lv_indev_set_group(w->wheel, g);
+
+    XMapWindow(w->dpy, w->win);
+    XFlush(w->dpy);
+
+    window = w;
+
+    LV_LOG_USER("Presenting with %s", w->shm ? "MIT-SHM" : "XPutImage");
+    return w->disp;
+}
+
+/**
+ * Create the draw buffers of a window
+ *
+ * @description shared memory images if the server supports MIT-SHM
+ * and can attach the segments, client memory images otherwise
+ * @param w the window
+ * @param hor_res the width of the window
+ * @param ver_res the height of the window
+ * @return true on success
+ */
+static bool x11_create_images(x11_window_t *w, int32_t hor_res, int32_t ver_res)
+{
+    int screen = DefaultScreen(w->dpy);
+    Visual *visual = DefaultVisual(w->dpy, screen);
+    int depth = DefaultDepth(w->dpy, screen);
+    XErrorHandler prev_handler;
+    size_t size;
+    uint32_t i;
 
-    /* Handle LVGL tasks */
-    while (true) {
-        /* Returns the time to the next timer execution */
-        idle_time = lv_timer_handler();
-        usleep(idle_time * 1000);
+    if (depth != 24 && depth != 32) {
+        LV_LOG_WARN("Unsupported X visual depth %d", depth);
+        return false;
     }
+
+    w->shm = XShmQueryExtension(w->dpy) && getenv_default("LV_SIM_X11_SHM", "1")[0] == '1';
+    w->completion_type = XShmGetEventBase(w->dpy) + ShmCompletion;
+
+    for (i = 0; i < 2 && w->shm; i++) {
+        w->images[i] = XShmCreateImage(w->dpy, visual, depth, ZPixmap, NULL,
+                                       &w->segs[i], hor_res, ver_res);
+        if (w->images[i] == NULL) {
+            w->shm = false;
+            break;
+        }
+
+        size = (size_t)w->images[i]->bytes_per_line * ver_res;
+        w->segs[i].shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+        w->segs[i].shmaddr = w->segs[i].shmid < 0 ? (char *)-1 : shmat(w->segs[i].shmid, NULL, 0);
+
+        if (w->segs[i].shmaddr == (char *)-1) {
+            /* A segment that is never attached would outlive the process */
+            if (w->segs[i].shmid >= 0) {
+                shmctl(w->segs[i].shmid, IPC_RMID, NULL);
+            }
+            w->shm = false;
+            break;
+        }
+
+        w->images[i]->data = w->segs[i].shmaddr;
+        w->segs[i].readOnly = True;
+
+        /* Fails with BadAccess if the server can't map the segment, i.e. over the network */
+        shm_failed = false;
+        prev_handler = XSetErrorHandler(x11_shm_error_handler);
+        XShmAttach(w->dpy, &w->segs[i]);
+        XSync(w->dpy, False);
+        XSetErrorHandler(prev_handler);
+
+        /* The segment is freed once both sides detached */
+        shmctl(w->segs[i].shmid, IPC_RMID, NULL);
+
+        if (shm_failed) {
+            w->segs[i].shmid = -1;
+            w->shm = false;
+        }
+    }
+
+    if (w->shm) {
+        return true;
+    }
+
+    x11_destroy_images(w);
+
+    for (i = 0; i < 2; i++) {
+        w->images[i] = XCreateImage(w->dpy, visual, depth, ZPixmap, 0, NULL, hor_res, ver_res, 32, 0);
+        if (w->images[i] == NULL) {
+            return false;
+        }
+
+        w->images[i]->data = malloc((size_t)w->images[i]->bytes_per_line * ver_res);
+        if (w->images[i]->data == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Free the draw buffers of a window
+ *
+ * @param w the window
+ */
+static void x11_destroy_images(x11_window_t *w)
+{
+    uint32_t i;
+
+    for (i = 0; i < 2; i++) {
+        if (w->images[i] == NULL) {
+            continue;
+        }
+
+        if (w->images[i]->data == w->segs[i].shmaddr && w->segs[i].shmaddr != NULL) {
+            if (w->segs[i].shmid >= 0 && w->segs[i].shmaddr != (char *)-1) {
+                XShmDetach(w->dpy, &w->segs[i]);
+            }
+            if (w->segs[i].shmaddr != (char *)-1) {
+                shmdt(w->segs[i].shmaddr);
+            }
+            w->images[i]->data = NULL;
+        }
+
+        /* Frees the data of the client memory images too */
+        XDestroyImage(w->images[i]);
+        w->images[i] = NULL;
+    }
+
+    memset(w->segs, 0, sizeof(w->segs));
+    w->front = NULL;
+}
+
+static int x11_shm_error_handler(Display *dpy, XErrorEvent *err)
+{
+    LV_UNUSED(dpy);
+    LV_UNUSED(err);
+
+    shm_failed = true;
+    return 0;
+}
+
+/**
+ * Present a damaged area
+ *
+ * @note called by LVGL for each area of the frame
+ * @param disp the display
+ * @param area the area in screen coordinates
+ * @param px_map the draw buffer
+ */
+static void x11_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    x11_window_t *w = lv_display_get_driver_data(disp);
+    XImage *img = px_map == (uint8_t *)w->images[0]->data ? w->images[0] : w->images[1];
+
+    if (w->shm) {
+        XShmPutImage(w->dpy, w->win, w->gc, img, area->x1, area->y1, area->x1, area->y1,
+                     lv_area_get_width(area), lv_area_get_height(area), True);
+        w->pending++;
+    } else {
+        XPutImage(w->dpy, w->win, w->gc, img, area->x1, area->y1, area->x1, area->y1,
+                  lv_area_get_width(area), lv_area_get_height(area));
+    }
+
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    w->front = img;
+    XFlush(w->dpy);
+
+    /* Otherwise ready once the server read the segments, see x11_handle_event */
+    if (!w->shm) {
+        lv_display_flush_ready(disp);
+    }
+}
+
+/**
+ * Wait for the server to read the previous frame
+ *
+ * @note called by LVGL before drawing into a buffer being presented
+ * @param disp the display
+ */
+static void x11_flush_wait_cb(lv_display_t *disp)
+{
+    x11_window_t *w = lv_display_get_driver_data(disp);
+    XEvent ev;
+
+    while (w->pending > 0) {
+        XIfEvent(w->dpy, &ev, x11_is_completion, (XPointer)w);
+        w->pending--;
+    }
+
+    /* The other events read meanwhile are queued by Xlib, the fd isn't readable anymore */
+    if (XEventsQueued(w->dpy, QueuedAlready) > 0) {
+        event_loop_wakeup();
+    }
+}
+
+static Bool x11_is_completion(Display *dpy, XEvent *ev, XPointer arg)
+{
+    x11_window_t *w = (x11_window_t *)arg;
+
+    LV_UNUSED(dpy);
+    return ev->type == w->completion_type;
+}
+
+/**
+ * Process the X events
+ *
+ * @note called from the event loop
+ */
+static void x11_fd_cb(int fd, uint32_t events, void *user_data)
+{
+    x11_window_t *w = user_data;
+    XEvent ev;
+
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        LV_LOG_ERROR("Lost the connection to the X server");
+        event_loop_remove_fd(fd);
+        event_loop_quit();
+        return;
+    }
+
+    while (XPending(w->dpy) > 0) {
+        XNextEvent(w->dpy, &ev);
+        x11_handle_event(w, &ev);
+    }
+}
+
+/**
+ * Handle an X event
+ *
+ * @param w the window
+ * @param ev the event
+ */
+static void x11_handle_event(x11_window_t *w, XEvent *ev)
+{
+    uint32_t key;
+    uint32_t idx;
+
+    if (ev->type == w->completion_type) {
+        if (w->pending > 0 && --w->pending == 0) {
+            lv_display_flush_ready(w->disp);
+        }
+        return;
+    }
+
+    switch (ev->type) {
+    case Expose:
+        /* Repaint from the last frame, nothing is rendered */
+        if (w->front != NULL && ev->xexpose.count == 0) {
+            if (w->shm) {
+                XShmPutImage(w->dpy, w->win, w->gc, w->front, 0, 0, 0, 0,
+                             w->front->width, w->front->height, False);
+            } else {
+                XPutImage(w->dpy, w->win, w->gc, w->front, 0, 0, 0, 0,
+                          w->front->width, w->front->height);
+            }
+            XFlush(w->dpy);
+        }
+        break;
+
+    case MotionNotify:
+        w->point.x = ev->xmotion.x;
+        w->point.y = ev->xmotion.y;
+        lv_indev_read(w->pointer);
+        break;
+
+    case ButtonPress:
+    case ButtonRelease:
+        w->point.x = ev->xbutton.x;
+        w->point.y = ev->xbutton.y;
+
+        if (ev->xbutton.button == Button1) {
+            w->pressed = ev->type == ButtonPress;
+            lv_indev_read(w->pointer);
+        } else if (ev->xbutton.button == Button2) {
+            w->wheel_pressed = ev->type == ButtonPress;
+            lv_indev_read(w->wheel);
+        } else if (ev->type == ButtonPress &&
+                   (ev->xbutton.button == Button4 || ev->xbutton.button == Button5)) {
+            w->wheel_diff += ev->xbutton.button == Button4 ? -1 : 1;
+            lv_indev_read(w->wheel);
+        }
+        x11_update_hold(w);
+        break;
+
+    case KeyPress:
+    case KeyRelease:
+        key = x11_map_key(&ev->xkey);
+
+        if (key != 0 && w->key_cnt < X11_KEY_QUEUE_LEN) {
+            idx = (w->key_head + w->key_cnt++) % X11_KEY_QUEUE_LEN;
+            w->keys[idx].key = key;
+            w->keys[idx].pressed = ev->type == KeyPress;
+            lv_indev_read(w->keypad);
+        }
+        x11_update_hold(w);
+        break;
+
+    case ClientMessage:
+        if ((Atom)ev->xclient.data.l[0] == w->wm_delete) {
+            event_loop_quit();
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Map an X key to a LVGL key
+ *
+ * @param ev the key event
+ * @return the LVGL key or the character, 0 if not mapped
+ */
+static uint32_t x11_map_key(XKeyEvent *ev)
+{
+    KeySym keysym;
+    char buf[8];
+    int len;
+
+    len = XLookupString(ev, buf, sizeof(buf), &keysym, NULL);
+
+    switch (keysym) {
+    case XK_Up:         return LV_KEY_UP;
+    case XK_Down:       return LV_KEY_DOWN;
+    case XK_Left:       return LV_KEY_LEFT;
+    case XK_Right:      return LV_KEY_RIGHT;
+    case XK_Return:
+    case XK_KP_Enter:   return LV_KEY_ENTER;
+    case XK_BackSpace:  return LV_KEY_BACKSPACE;
+    case XK_Escape:     return LV_KEY_ESC;
+    case XK_Delete:     return LV_KEY_DEL;
+    case XK_Home:       return LV_KEY_HOME;
+    case XK_End:        return LV_KEY_END;
+    case XK_Tab:        return LV_KEY_NEXT;
+    case XK_ISO_Left_Tab: return LV_KEY_PREV;
+    default:
+        break;
+    }
+
+    return len == 1 && (uint8_t)buf[0] >= 0x20 ? (uint8_t)buf[0] : 0;
+}
+
+static void x11_pointer_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    x11_window_t *w = lv_indev_get_driver_data(indev);
+
+    data->point = w->point;
+    data->state = w->pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static void x11_keypad_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    x11_window_t *w = lv_indev_get_driver_data(indev);
+    x11_key_t *k;
+
+    if (w->key_cnt > 0) {
+        k = &w->keys[w->key_head];
+        w->key_head = (w->key_head + 1) % X11_KEY_QUEUE_LEN;
+        w->key_cnt--;
+
+        w->last_key = k->key;
+        w->key_pressed = k->pressed;
+    }
+
+    /* The last key is reported while held, LVGL repeats it */
+    data->key = w->last_key;
+    data->state = w->key_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->continue_reading = w->key_cnt > 0;
+}
+
+static void x11_wheel_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    x11_window_t *w = lv_indev_get_driver_data(indev);
+
+    data->enc_diff = w->wheel_diff;
+    data->state = w->wheel_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    w->wheel_diff = 0;
+}
+
+/**
+ * Start or stop the periodic reads
+ *
+ * @description in event mode LVGL only reads an input device when an
+ * X event arrives, a press held still would never become a long press
+ * @param w the window
+ */
+static void x11_update_hold(x11_window_t *w)
+{
+    if (w->pressed || w->wheel_pressed || w->key_pressed || w->key_cnt > 0) {
+        lv_timer_resume(w->hold_timer);
+    } else {
+        lv_timer_pause(w->hold_timer);
+    }
+}
+
+/**
+ * Read the input devices that are held
+ *
+ * @param timer the hold timer
+ */
+static void x11_hold_timer_cb(lv_timer_t *timer)
+{
+    x11_window_t *w = lv_timer_get_user_data(timer);
+
+    if (w->pressed) {
+        lv_indev_read(w->pointer);
+    }
+
+    if (w->wheel_pressed) {
+        lv_indev_read(w->wheel);
+    }
+
+    if (w->key_pressed || w->key_cnt > 0) {
+        lv_indev_read(w->keypad);
+    }
+
+    x11_update_hold(w);
+}
+
+/**
+ * Close the window of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void x11_delete_cb(lv_event_t *e)
+{
+    x11_window_t *w = lv_event_get_user_data(e);
+
+    lv_timer_delete(w->hold_timer);
+    lv_indev_delete(w->pointer);
+    lv_indev_delete(w->keypad);
+    lv_indev_delete(w->wheel);
+
+    event_loop_remove_fd(ConnectionNumber(w->dpy));
+    x11_destroy_images(w);
+    XFreeGC(w->dpy, w->gc);
+    XDestroyWindow(w->dpy, w->win);
+    XCloseDisplay(w->dpy);
+
+    if (window == w) {
+        window = NULL;
+    }
+
+    free(w);
 }
 
 #endif /*#if LV_USE_X11*/
@@ -17,13 +17,25 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 
 #include "lvgl/lvgl.h"
+#include "lvgl/src/core/lv_obj_private.h"
+#include "lvgl/src/display/lv_display_private.h"
 
 #include "simulator_util.h"
 #include "simulator_settings.h"
 #include "driver_backends.h"
+#include "render_threads.h"
+#include "frame_stats.h"
+#include "slab_alloc.h"
+#include "image_cache.h"
+#include "frame_governor.h"
+#include "event_loop.h"
+#include "boot_timing.h"
+#include "frame_export.h"
+#include "rt_sched.h"
 
 #include "backends.h"
 
@@ -31,6 +43,9 @@
  *      DEFINES
  *********************/
 
+/* Longest list of display backends, i.e LV_SIM_BACKENDS=DRM,FBDEV,HEADLESS */
+#define BACKEND_LIST_MAX 128
+
 /* Catch configuration errors at compile time - checks if no backend was selected */
 #if LV_USE_SDL == 0 && \
     LV_USE_WAYLAND == 0 && \
@@ -42,59 +57,127 @@
 #error Unsupported configuration - Please select at least one graphics backend in lv_conf.h
 #endif
 
+/* The static build binds the only display backend enabled in lv_conf.h */
+#if LV_PORT_STATIC_BACKEND
+#if LV_USE_SDL + LV_USE_WAYLAND + LV_USE_LINUX_DRM + LV_USE_GLFW + LV_USE_X11 + LV_USE_LINUX_FBDEV != 1
+#error LV_PORT_STATIC_BACKEND requires exactly one graphics backend in lv_conf.h
+#endif
+#endif
+
+/* The static build has no name table, the backends are bound by their type */
+#if LV_PORT_STATIC_BACKEND
+#define BACKEND_ENTRY(name, type, init) { type, init }
+#else
+#define BACKEND_ENTRY(name, type, init) { name, type, init }
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+/* A compiled-in backend, its descriptor is created when it is first used */
+typedef struct {
+#if !LV_PORT_STATIC_BACKEND
+    const char *name;
+#endif
+    backend_type_t type;
+    backend_init_t init;
+} backend_entry_t;
+
+/* An active display and the backend that created it */
+typedef struct {
+    backend_t *backend;
+    lv_display_t *display;
+    lv_display_t *parked;           /* Holds the screens while the backend is re-initialized */
+    char parked_backend[BACKEND_LIST_MAX];
+    run_loop_t parked_run_loop;
+} display_slot_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 
+static void read_display_settings(void);
+static backend_t *get_backend(int i);
+static backend_t *find_backend(const char *name, backend_type_t type);
+static int find_free_slot(void);
+static int init_display(backend_t *b, uint32_t idx);
+static int init_display_list(const char *backend_list, uint32_t idx);
+static int init_indev(backend_t *b, lv_display_t *disp);
+static void move_screens(lv_display_t *dst, lv_display_t *src);
+static void display_delete_cb(lv_event_t *e);
+
 /**********************
  *  STATIC VARIABLES
  **********************/
 
 /* The default backend is the one that will end up at index 0
  * To add support for a new driver backend add the declaration
- * and append an entry to the available_backends array
+ * and append an entry to the available_backends array,
+ * the name must be the one set by the init function.
+ * The static build only has the display backend and EVDEV
  */
-backend_init_t available_backends[] = {
+static const backend_entry_t available_backends[] = {
 
 #if LV_USE_LINUX_FBDEV
-    backend_init_fbdev,
+    BACKEND_ENTRY("FBDEV", BACKEND_DISPLAY, backend_init_fbdev),
 #endif
 
 #if LV_USE_LINUX_DRM
-    backend_init_drm,
+    BACKEND_ENTRY("DRM", BACKEND_DISPLAY, backend_init_drm),
 #endif
 
 #if LV_USE_SDL
-    backend_init_sdl,
+    BACKEND_ENTRY("SDL", BACKEND_DISPLAY, backend_init_sdl),
 #endif
 
 #if LV_USE_WAYLAND
-    backend_init_wayland,
+    BACKEND_ENTRY("WAYLAND", BACKEND_DISPLAY, backend_init_wayland),
 #endif
 
 #if LV_USE_X11
-    backend_init_x11,
+    BACKEND_ENTRY("X11", BACKEND_DISPLAY, backend_init_x11),
 #endif
 
 #if LV_USE_GLFW
-    backend_init_glfw3,
+    BACKEND_ENTRY("GLFW", BACKEND_DISPLAY, backend_init_glfw3),
+#endif
+
+#if !LV_PORT_STATIC_BACKEND
+    /* Offscreen benchmark display - never the default */
+    BACKEND_ENTRY("HEADLESS", BACKEND_DISPLAY, backend_init_headless),
 #endif
 
 #if LV_USE_EVDEV
-    backend_init_evdev,
+    BACKEND_ENTRY("EVDEV", BACKEND_INDEV, backend_init_evdev),
+#endif
+
+#if !LV_PORT_STATIC_BACKEND
+    /* Replay of recorded input events */
+    BACKEND_ENTRY("REPLAY", BACKEND_INDEV, backend_init_replay),
 #endif
-    NULL    /* Sentinel */
+    BACKEND_ENTRY(NULL, BACKEND_DISPLAY, NULL)    /* Sentinel */
 };
 
-/* Contains the backend descriptors */
-static backend_t *backends[sizeof(available_backends) / sizeof(available_backends[0])];
+#define BACKEND_CNT (sizeof(available_backends) / sizeof(available_backends[0]))
+
+/* Contains the descriptors of the backends that were used */
+static backend_t *backends[BACKEND_CNT];
+static backend_t backend_descs[BACKEND_CNT];
+static backend_handle_t backend_handles[BACKEND_CNT];
+
+/* Set by driver_backends_register */
+static bool registered;
+
+/* The active displays, the first one is the default display
+ * and its backend provides the run loop */
+static display_slot_t displays[BACKEND_MAX_DISPLAYS];
+
+/* Index of the display being initialized, selects the settings read by backend_getenv */
+static uint32_t init_index;
 
-/* Set once the user selects a backend - or it is set to the default backend */
-static backend_t *sel_display_backend = NULL;
+/* The run loop returned to start the one of another backend */
+static bool restart_run_loop;
 
 /**********************
  *  GLOBAL VARIABLES
@@ -112,107 +195,251 @@ simulator_settings_t settings;
 
 void driver_backends_register(void)
 {
-    int i;
-    backend_init_t init_backend;
-    backend_t *b;
+    uint64_t start;
 
-    i = 0;
-    if (backends[i] != NULL) {
+    if (registered) {
         /* backends are already registered - leave */
         return;
     }
 
-    while ((init_backend = available_backends[i]) != NULL) {
+    /* The descriptors are allocated by get_backend, only for the backends that are used */
+    registered = true;
+    boot_timing_init();
+    boot_timing_add_since_last("application");
 
-        b = malloc(sizeof(backend_t));
-        LV_ASSERT_NULL(b);
+    /* Before the draw buffers are allocated by the display backends */
+    rt_sched_lock_memory();
 
-        b->handle = malloc(sizeof(backend_handle_t));
+    /* The draw units were created by lv_init */
+    start = frame_stats_now_us();
+    render_threads_init();
+    boot_timing_add("render threads", NULL, start);
 
-        init_backend = available_backends[i];
-        LV_ASSERT_NULL(init_backend);
-
-        init_backend(b);
-        backends[i] = b;
-        i++;
-    }
+    start = frame_stats_now_us();
+    frame_stats_init();
+    image_cache_init();
+    boot_timing_add("statistics and image cache", NULL, start);
 }
 
 int driver_backends_init_backend(char *backend_name)
 {
     backend_t *b;
-    int i;
-    display_backend_t *dispb;
-    indev_backend_t *indevb;
+    int idx;
+    char var[64];
+    lv_display_t *disp;
 
-    if (backends[0] == NULL) {
+    if (!registered) {
         LV_LOG_ERROR("Please call driver_backends_register first");
         return -1;
     }
 
+#if LV_PORT_STATIC_BACKEND
+    /* The display backend is bound at compile time, the other names are the input devices */
     if (backend_name == NULL) {
+        b = get_backend(0);
+    } else if ((b = find_backend(backend_name, BACKEND_INDEV)) == NULL) {
+        b = get_backend(0);
+
+        if (strcasecmp(b->name, backend_name) != 0) {
+            LV_LOG_ERROR("Unsupported backend: %s - the static build only has %s",
+                         backend_name, b->name);
+            return -1;
+        }
+    }
+#else
+    const char *name = backend_name;
+    int i;
+
+    if (name == NULL) {
 
         /*
          * Set default display backend - which is the first defined
          * item in available_backends array
          */
-        LV_ASSERT_NULL(backends[0]);
-        b = backends[0];
+        if (available_backends[0].type != BACKEND_DISPLAY) {
+            LV_LOG_ERROR("The default backend: %s is not a display driver backend",
+                         available_backends[0].name);
+            return -1;
+        }
+
+        name = available_backends[0].name;
+    }
 
-        if (b->type != BACKEND_DISPLAY) {
-            LV_LOG_ERROR("The default backend: %s is not a display driver backend", b->name);
+    /* Check if such a backend exists */
+    for (i = 0; available_backends[i].name != NULL; i++) {
+        if (strcmp(available_backends[i].name, name) == 0) {
+            break;
+        }
+    }
+
+    if (available_backends[i].name == NULL) {
+        return 0;
+    }
+
+    b = get_backend(i);
+#endif
+
+    if (b->type == BACKEND_DISPLAY) {
+        /* Initialize the display, each call adds one */
+
+        idx = find_free_slot();
+        if (idx < 0 || init_display(b, idx) < 0) {
             return -1;
         }
 
-        backend_name = backends[0]->name;
+        /* Decode the first images while the UI is created */
+        image_cache_start_prewarm();
+        return 0;
     }
 
-    i = 0;
-    while ((b = backends[i]) != NULL) {
+    /* Initialize input device, on the display selected with LV_SIM_<NAME>_DISPLAY */
+    snprintf(var, sizeof(var), "LV_SIM_%s_DISPLAY", b->name);
+    disp = driver_backends_get_display(atoi(getenv_default(var, "0")));
 
-        /* Check if such a backend exists */
-        if (strcmp(b->name, backend_name) == 0) {
+    /* The display driver backend - has to be initialized first */
+    if (disp == NULL) {
+        LV_LOG_ERROR("Failed to init indev backend: %s - display needs to be initialized",
+                     b->name);
+        return -1;
+    }
+
+    return driver_backends_init_indev(b->name, disp);
+}
+
+int driver_backends_init_display(const char *backend_list)
+{
+    const char *env;
+    int idx;
+
+    if (!registered) {
+        LV_LOG_ERROR("Please call driver_backends_register first");
+        return -1;
+    }
 
-            if (b->type == BACKEND_DISPLAY) {
-                /* Initialize the display */
+    idx = find_free_slot();
+    if (idx < 0) {
+        return -1;
+    }
 
-                dispb = b->handle->display;
-                LV_ASSERT_NULL(dispb->init_display);
-                dispb->display = dispb->init_display();
+    /* LV_SIM_BACKENDS_<n> selects the backends of the additional displays */
+    init_index = idx;
+    env = backend_getenv("LV_SIM_BACKENDS", NULL);
+    init_index = 0;
 
-                if (dispb->display == NULL) {
-                    LV_LOG_ERROR("Failed to init display with %s backend", b->name);
-                    return -1;
-                }
+    if (env != NULL) {
+        backend_list = env;
+    }
 
-                sel_display_backend = b;
-                LV_LOG_INFO("Initialized %s display backend", b->name);
-                break;
+    if (backend_list == NULL) {
+        return driver_backends_init_backend(NULL);
+    }
 
-            } else if (b->type == BACKEND_INDEV) {
-                /* Initialize input device */
+    if (init_display_list(backend_list, idx) < 0) {
+        return -1;
+    }
 
-                indevb = b->handle->indev;
-                LV_ASSERT_NULL(indevb->init_indev);
+    image_cache_start_prewarm();
+    return 0;
+}
 
-                /* The display driver backend - has to be initialized first */
-                if (sel_display_backend == NULL) {
-                    LV_LOG_ERROR(
-                        "Failed to init indev backend: %s - display needs to be initialized",
-                        b->name);
-                    return -1;
-                }
+lv_display_t *driver_backends_get_display(uint32_t index)
+{
+    if (index >= BACKEND_MAX_DISPLAYS) {
+        return NULL;
+    }
 
-                LV_LOG_INFO("Initialized %s indev backend", b->name);
+    return displays[index].display;
+}
 
-                dispb = sel_display_backend->handle->display;
+int driver_backends_init_indev(const char *backend_name, lv_display_t *disp)
+{
+    backend_t *b;
 
-                LV_ASSERT_NULL(dispb->display);
-                indevb->init_indev(dispb->display);
-                break;
-            }
+    if (!registered) {
+        LV_LOG_ERROR("Please call driver_backends_register first");
+        return -1;
+    }
+
+    b = find_backend(backend_name, BACKEND_INDEV);
+    if (b == NULL) {
+        LV_LOG_ERROR("Unsupported indev backend: %s", backend_name);
+        return -1;
+    }
+
+    if (disp == NULL) {
+        disp = displays[0].display;
+    }
+
+    if (disp == NULL) {
+        LV_LOG_ERROR("Failed to init indev backend: %s - display needs to be initialized",
+                     b->name);
+        return -1;
+    }
+
+    return init_indev(b, disp);
+}
+
+int driver_backends_reinit_display(uint32_t index, const char *backend_list)
+{
+    display_slot_t *slot;
+    display_backend_t *dispb;
+    lv_display_t *disp;
+
+    if (index >= BACKEND_MAX_DISPLAYS) {
+        return -1;
+    }
+
+    slot = &displays[index];
+
+    if (slot->parked == NULL) {
+        if (slot->display == NULL) {
+            LV_LOG_ERROR("No display backend to re-initialize");
+            return -1;
         }
-        i++;
+
+        dispb = slot->backend->handle->display;
+        disp = slot->display;
+
+        /* Tear down the current backend first, it can own the device the next one opens */
+        slot->parked = lv_display_create(lv_display_get_horizontal_resolution(disp),
+                                         lv_display_get_vertical_resolution(disp));
+        if (slot->parked == NULL) {
+            return -1;
+        }
+
+        lv_timer_pause(lv_display_get_refr_timer(slot->parked));
+        move_screens(slot->parked, disp);
+
+        snprintf(slot->parked_backend, sizeof(slot->parked_backend), "%s", slot->backend->name);
+        slot->parked_run_loop = dispb->run_loop;
+
+        /* Releases the slot */
+        lv_display_delete(disp);
+    }
+
+    if (backend_list == NULL) {
+        init_index = index;
+        backend_list = backend_getenv("LV_SIM_BACKENDS", slot->parked_backend);
+        init_index = 0;
+    }
+
+    if (init_display_list(backend_list, index) < 0) {
+        LV_LOG_ERROR("The screens are kept until the next re-initialization");
+        return -1;
+    }
+
+    move_screens(slot->display, slot->parked);
+    lv_display_delete(slot->parked);
+    slot->parked = NULL;
+
+    if (index == 0) {
+        lv_display_set_default(slot->display);
+    }
+
+    if (index == 0 && slot->backend->handle->display->run_loop != slot->parked_run_loop) {
+        /* Returns to driver_backends_run_loop which enters the new one */
+        restart_run_loop = true;
+        event_loop_quit();
     }
 
     return 0;
@@ -221,22 +448,28 @@ int driver_backends_init_backend(char *backend_name)
 int driver_backends_print_supported(void)
 {
     int i;
-    backend_t *b;
 
-    i = 0;
-    if (backends[i] == NULL) {
+    if (!registered) {
         LV_LOG_ERROR("Please call driver_backends_register first");
         return -1;
     }
 
-    b = backends[i];
+#if LV_PORT_STATIC_BACKEND
+    /* The names are the ones set by the init functions */
+    fprintf(stdout, "Default backend: %s\n", get_backend(0)->name);
+    fprintf(stdout, "Supported backends: ");
 
-    fprintf(stdout, "Default backend: %s\n", b->name);
+    for (i = 0; available_backends[i].init != NULL; i++) {
+        fprintf(stdout, "%s ", get_backend(i)->name);
+    }
+#else
+    fprintf(stdout, "Default backend: %s\n", available_backends[0].name);
     fprintf(stdout, "Supported backends: ");
 
-    while ((b = backends[i++]) != NULL) {
-        fprintf(stdout, "%s ", b->name);
+    for (i = 0; available_backends[i].name != NULL; i++) {
+        fprintf(stdout, "%s ", available_backends[i].name);
     }
+#endif
 
     fprintf(stdout, "\n");
     return 0;
@@ -246,20 +479,27 @@ int driver_backends_print_supported(void)
 int driver_backends_is_supported(char *backend_name)
 {
     char c;
-    backend_t *b;
     char *name = backend_name;
-    int i = 0;
+    int i;
 
     while ((c = *backend_name) != '\0') {
         *backend_name = toupper(c);
         backend_name++;
     }
 
-    while ((b = backends[i++]) != NULL) {
-        if (strcmp(b->name, name) == 0) {
+#if LV_PORT_STATIC_BACKEND
+    for (i = 0; available_backends[i].init != NULL; i++) {
+        if (strcmp(get_backend(i)->name, name) == 0) {
             return 1;
         }
     }
+#else
+    for (i = 0; available_backends[i].name != NULL; i++) {
+        if (strcmp(available_backends[i].name, name) == 0) {
+            return 1;
+        }
+    }
+#endif
 
     return 0;
 }
@@ -268,17 +508,422 @@ void driver_backends_run_loop(void)
 {
     display_backend_t *dispb;
 
-    if (sel_display_backend != NULL && sel_display_backend->handle->display != NULL) {
+    if (displays[0].backend == NULL) {
+        LV_LOG_ERROR("No backend has been selected - initialize the backend first");
+        return;
+    }
 
-        dispb = sel_display_backend->handle->display;
+    /* The timers of the other displays are run by the loop of the first one */
+    do {
+        restart_run_loop = false;
+        dispb = displays[0].backend->handle->display;
         dispb->run_loop();
+    } while (restart_run_loop && displays[0].backend != NULL);
+}
 
-    } else {
-        LV_LOG_ERROR("No backend has been selected - initialize the backend first");
+const char *backend_getenv(const char *name, const char *default_val)
+{
+    char indexed[64];
+    const char *value;
+
+    if (init_index > 0) {
+        snprintf(indexed, sizeof(indexed), "%s_%u", name, init_index);
+        value = getenv(indexed);
+
+        if (value != NULL) {
+            return value;
+        }
     }
+
+    return getenv_default(name, default_val);
+}
+
+uint32_t backend_display_index(void)
+{
+    return init_index;
 }
 
 /**********************
  *   STATIC FUNCTIONS
  **********************/
 
+/**
+ * Apply the settings of the display being initialized
+ *
+ * @description LV_SIM_ROTATION overrides the rotation set by the application,
+ * the display backends apply it when flushing. The additional displays
+ * take their size from LV_SIM_WINDOW_WIDTH_<n> and LV_SIM_WINDOW_HEIGHT_<n>
+ */
+static void read_display_settings(void)
+{
+    const char *rotation = backend_getenv("LV_SIM_ROTATION", NULL);
+    char var[64];
+    const char *value;
+
+    if (rotation != NULL) {
+        settings.rotation = atoi(rotation);
+    }
+
+    if (settings.rotation % 90 != 0 || settings.rotation >= 360) {
+        LV_LOG_WARN("Invalid rotation: %u, must be 0, 90, 180 or 270", settings.rotation);
+        settings.rotation = 0;
+    }
+
+    if (init_index == 0) {
+        /* Already applied by the application */
+        return;
+    }
+
+    snprintf(var, sizeof(var), "LV_SIM_WINDOW_WIDTH_%u", init_index);
+    if ((value = getenv(var)) != NULL) {
+        settings.window_width = atoi(value);
+    }
+
+    snprintf(var, sizeof(var), "LV_SIM_WINDOW_HEIGHT_%u", init_index);
+    if ((value = getenv(var)) != NULL) {
+        settings.window_height = atoi(value);
+    }
+}
+
+/**
+ * Get the descriptor of a backend
+ *
+ * @description the descriptor is allocated and initialized on the first use
+ * @param i the index of the backend in available_backends
+ * @return the descriptor
+ */
+static backend_t *get_backend(int i)
+{
+    const backend_entry_t *entry = &available_backends[i];
+    uint64_t start;
+    backend_t *b;
+
+    if (backends[i] != NULL) {
+        return backends[i];
+    }
+
+    start = frame_stats_now_us();
+
+    b = &backend_descs[i];
+    b->handle = &backend_handles[i];
+
+    entry->init(b);
+#if LV_PORT_STATIC_BACKEND
+    LV_ASSERT(b->type == entry->type);
+#else
+    LV_ASSERT(b->type == entry->type && strcmp(b->name, entry->name) == 0);
+#endif
+
+    backends[i] = b;
+    boot_timing_add("register", b->name, start);
+
+    return b;
+}
+
+/**
+ * Find a backend by name
+ *
+ * @param name the name of the backend, case insensitive
+ * @param type the type of the backend
+ * @return the backend or NULL
+ */
+static backend_t *find_backend(const char *name, backend_type_t type)
+{
+    int i;
+
+#if LV_PORT_STATIC_BACKEND
+    /* The names are the ones set by the init functions */
+    for (i = 0; available_backends[i].init != NULL; i++) {
+        if (available_backends[i].type == type && strcasecmp(get_backend(i)->name, name) == 0) {
+            return get_backend(i);
+        }
+    }
+
+    return NULL;
+#else
+    for (i = 0; available_backends[i].name != NULL; i++) {
+        if (available_backends[i].type == type && strcasecmp(available_backends[i].name, name) == 0) {
+            return get_backend(i);
+        }
+    }
+
+    return NULL;
+#endif
+}
+
+/**
+ * Find the slot of the next display
+ *
+ * @return the index of the slot or -1 if all displays are in use
+ */
+static int find_free_slot(void)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (displays[i].display == NULL && displays[i].parked == NULL) {
+            return i;
+        }
+    }
+
+    LV_LOG_ERROR("Too many displays, at most %d can be active", BACKEND_MAX_DISPLAYS);
+    return -1;
+}
+
+/**
+ * Initialize a display backend into a slot
+ *
+ * @description the settings read by the backend are the ones of the slot,
+ * see backend_getenv. LV_SIM_REFR_PERIOD(_<n>) sets the period of the
+ * refresh timer of the display, LV_SIM_FRAME_EXPORT(_<n>) exports its frames
+ * @param b the backend
+ * @param idx the index of the slot
+ * @return 0 on success, -1 on error
+ */
+static int init_display(backend_t *b, uint32_t idx)
+{
+    display_backend_t *dispb = b->handle->display;
+    simulator_settings_t app_settings = settings;
+    lv_display_t *disp;
+    const char *period;
+    const char *export;
+    uint64_t start;
+
+    LV_ASSERT_NULL(dispb->init_display);
+
+    init_index = idx;
+    read_display_settings();
+
+    start = frame_stats_now_us();
+    disp = dispb->init_display();
+
+    LV_LOG_USER("Probed %s display backend in %.1f ms", b->name,
+                (double)(frame_stats_now_us() - start) / 1000.0);
+    boot_timing_add("display", b->name, start);
+
+    period = backend_getenv("LV_SIM_REFR_PERIOD", NULL);
+    export = backend_getenv("LV_SIM_FRAME_EXPORT", NULL);
+
+    /* The governor reads the settings of the slot and the period of the refresh timer */
+    if (disp != NULL) {
+        if (period != NULL && lv_display_get_refr_timer(disp) != NULL) {
+            lv_timer_set_period(lv_display_get_refr_timer(disp), atoi(period));
+        }
+
+        frame_governor_attach(disp);
+    }
+
+    init_index = 0;
+
+    /* The overrides of this display must not leak into the next one */
+    if (idx > 0) {
+        settings = app_settings;
+    }
+
+    if (disp == NULL) {
+        LV_LOG_ERROR("Failed to init display with %s backend", b->name);
+        return -1;
+    }
+
+    frame_stats_attach(disp);
+    slab_alloc_attach(disp);
+    boot_timing_attach(disp);
+
+    /* Wraps the flush callback set by the backend, the display works without it */
+    if (frame_export_attach(disp, export) < 0) {
+        LV_LOG_WARN("The frames of display %u are not exported", idx);
+    }
+
+    dispb->display = disp;
+    displays[idx].backend = b;
+    displays[idx].display = disp;
+    lv_display_add_event_cb(disp, display_delete_cb, LV_EVENT_DELETE, &displays[idx]);
+
+    LV_LOG_INFO("Initialized %s display backend as display %u", b->name, idx);
+    return 0;
+}
+
+/**
+ * Initialize the first display backend of a list that succeeds
+ *
+ * @note the static build ignores the list
+ * @param backend_list comma separated names, i.e DRM,FBDEV,HEADLESS
+ * @param idx the index of the slot
+ * @return 0 on success, -1 if none could be initialized
+ */
+static int init_display_list(const char *backend_list, uint32_t idx)
+{
+#if LV_PORT_STATIC_BACKEND
+    /* The list isn't parsed, the only display backend is the default one */
+    LV_UNUSED(backend_list);
+
+    return init_display(get_backend(0), idx);
+#else
+    char list[BACKEND_LIST_MAX];
+    char *saveptr;
+    char *name;
+    backend_t *b;
+
+    snprintf(list, sizeof(list), "%s", backend_list);
+
+    for (name = strtok_r(list, ", ", &saveptr); name != NULL;
+         name = strtok_r(NULL, ", ", &saveptr)) {
+
+        b = find_backend(name, BACKEND_DISPLAY);
+        if (b == NULL) {
+            LV_LOG_WARN("Unsupported display backend: %s", name);
+            continue;
+        }
+
+        if (init_display(b, idx) == 0) {
+            return 0;
+        }
+    }
+
+    LV_LOG_ERROR("None of the display backends %s could be initialized", backend_list);
+    return -1;
+#endif
+}
+
+/**
+ * Initialize an input device on a display
+ *
+ * @description the settings read by the backend are the ones of the
+ * display, i.e LV_LINUX_EVDEV_POINTER_DEVICE_1 for the second display
+ * @param b the indev backend
+ * @param disp the display receiving the input
+ * @return 0 on success, -1 on error
+ */
+static int init_indev(backend_t *b, lv_display_t *disp)
+{
+    indev_backend_t *indevb = b->handle->indev;
+    lv_indev_t *indev;
+    uint64_t start;
+    uint32_t i;
+
+    LV_ASSERT_NULL(indevb->init_indev);
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (displays[i].display == disp) {
+            init_index = i;
+        }
+    }
+
+    /* Includes the discovery of the device */
+    start = frame_stats_now_us();
+    indev = indevb->init_indev(disp);
+    init_index = 0;
+
+    boot_timing_add("indev", b->name, start);
+
+    if (indev == NULL) {
+        LV_LOG_ERROR("Failed to init indev backend: %s", b->name);
+        return -1;
+    }
+
+    /* Created once the device is plugged, i.e. a board booting without its touchscreen */
+    if (indev == BACKEND_INDEV_PENDING) {
+        LV_LOG_INFO("The %s indev backend waits for its device", b->name);
+        return 0;
+    }
+
+    LV_LOG_INFO("Initialized %s indev backend", b->name);
+    return 0;
+}
+
+/**
+ * Move the screens and the input devices of a display to another one
+ *
+ * @description the screens are exchanged, src is left with the screens
+ * of dst and is meant to be deleted. The screens are resized if the
+ * resolution differs, the layout of the objects is then updated
+ * @param dst the display receiving the screens
+ * @param src the display giving its screens
+ */
+static void move_screens(lv_display_t *dst, lv_display_t *src)
+{
+    lv_display_t tmp;
+    lv_obj_t *layers[3];
+    lv_obj_t *scr;
+    lv_area_t prev_coords;
+    lv_indev_t *indev;
+    uint32_t i;
+
+    tmp.screens = dst->screens;
+    tmp.screen_cnt = dst->screen_cnt;
+    tmp.act_scr = dst->act_scr;
+    tmp.prev_scr = dst->prev_scr;
+    tmp.scr_to_load = dst->scr_to_load;
+    tmp.sys_layer = dst->sys_layer;
+    tmp.top_layer = dst->top_layer;
+    tmp.bottom_layer = dst->bottom_layer;
+    tmp.theme = dst->theme;
+
+    dst->screens = src->screens;
+    dst->screen_cnt = src->screen_cnt;
+    dst->act_scr = src->act_scr;
+    dst->prev_scr = src->prev_scr;
+    dst->scr_to_load = src->scr_to_load;
+    dst->sys_layer = src->sys_layer;
+    dst->top_layer = src->top_layer;
+    dst->bottom_layer = src->bottom_layer;
+    dst->theme = src->theme;
+
+    src->screens = tmp.screens;
+    src->screen_cnt = tmp.screen_cnt;
+    src->act_scr = tmp.act_scr;
+    src->prev_scr = tmp.prev_scr;
+    src->scr_to_load = tmp.scr_to_load;
+    src->sys_layer = tmp.sys_layer;
+    src->top_layer = tmp.top_layer;
+    src->bottom_layer = tmp.bottom_layer;
+    src->theme = tmp.theme;
+
+    if (dst->hor_res != src->hor_res || dst->ver_res != src->ver_res) {
+        layers[0] = dst->sys_layer;
+        layers[1] = dst->top_layer;
+        layers[2] = dst->bottom_layer;
+
+        for (i = 0; i < dst->screen_cnt + 3; i++) {
+            scr = i < dst->screen_cnt ? dst->screens[i] : layers[i - dst->screen_cnt];
+
+            if (scr == NULL) {
+                continue;
+            }
+
+            prev_coords = scr->coords;
+            lv_area_set(&scr->coords, 0, 0, dst->hor_res - 1, dst->ver_res - 1);
+            lv_obj_send_event(scr, LV_EVENT_SIZE_CHANGED, &prev_coords);
+            lv_obj_mark_layout_as_dirty(scr);
+        }
+    }
+
+    for (indev = lv_indev_get_next(NULL); indev != NULL; indev = lv_indev_get_next(indev)) {
+        if (lv_indev_get_display(indev) == src) {
+            lv_indev_set_display(indev, dst);
+        }
+    }
+
+    /* The new display starts with an empty frame buffer */
+    if (dst->act_scr != NULL) {
+        lv_obj_invalidate(dst->act_scr);
+    }
+}
+
+/**
+ * Release the slot of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void display_delete_cb(lv_event_t *e)
+{
+    display_slot_t *slot = lv_event_get_user_data(e);
+    display_backend_t *dispb = slot->backend->handle->display;
+
+    if (dispb->display == slot->display) {
+        dispb->display = NULL;
+    }
+
+    slot->backend = NULL;
+    slot->display = NULL;
+}
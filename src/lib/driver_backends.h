@@ -26,6 +26,7 @@ extern "C" {
 /*********************
  *      INCLUDES
  *********************/
+#include <stdint.h>
 
 /*********************
  *      DEFINES
@@ -42,21 +43,69 @@ extern "C" {
 /*
  * Register all available backends
  * This function must be called first before any other
- * function
+ * function, the descriptor of a backend is only initialized
+ * when the backend is first used. Starts the startup report
  */
 void driver_backends_register(void);
 
 /**
  * Initialize the specified backend
  * @description in case of a display driver backend
- * - create the lv_display, in case of a indev driver backend
- * create an input device
+ * - create the lv_display, each call adds a display, in case of a indev driver backend
+ * create an input device on the display selected with LV_SIM_<NAME>_DISPLAY (default 0).
+ * The static build only accepts the name of its display backend and of its input devices
  *
  * @param backend_name the name of the backend to initialize FBDEV,DRM etc
  * @return 0 on success, -1 on error
  */
 int driver_backends_init_backend(char *backend_name);
 
+/**
+ * @brief Initialize the first display backend of a list that succeeds
+ * @description the backends are tried in order and the time taken by each
+ * one is logged. LV_SIM_BACKENDS overrides the list when set.
+ * Each call adds a display, up to BACKEND_MAX_DISPLAYS. The first one is
+ * the default display, its backend provides the run loop and refreshes
+ * every display, there is no render thread per display. The backends of
+ * the display n read their settings from NAME_<n> first, i.e
+ * LV_SIM_BACKENDS_1 or LV_LINUX_DRM_CONNECTOR_1, see backend_getenv
+ *
+ * @param backend_list comma separated names, i.e DRM,FBDEV,HEADLESS,
+ * NULL for the default backend
+ * @return 0 on success, -1 if none could be initialized
+ */
+int driver_backends_init_display(const char *backend_list);
+
+/**
+ * @brief Get an active display
+ * @param index the index of the display, in the order of initialization
+ * @return the display or NULL
+ */
+lv_display_t *driver_backends_get_display(uint32_t index);
+
+/**
+ * @brief Initialize an input device on a display
+ * @param backend_name the name of the indev backend, i.e EVDEV
+ * @param disp the display receiving the input, NULL for the first display
+ * @return 0 on success, -1 on error
+ */
+int driver_backends_init_indev(const char *backend_name, lv_display_t *disp);
+
+/**
+ * @brief Re-initialize a display backend at runtime
+ * @description the current display backend is torn down and the first
+ * backend of the list that succeeds is initialized. The screens, the
+ * objects and the caches are kept, the input devices are moved to the
+ * new display. If none succeeds, the screens are kept until the next call.
+ * Must not be called while rendering, i.e from lv_async_call
+ *
+ * @param index the index of the display
+ * @param backend_list comma separated names, NULL for LV_SIM_BACKENDS
+ * or the current backend if not set
+ * @return 0 on success, -1 on error
+ */
+int driver_backends_reinit_display(uint32_t index, const char *backend_list);
+
 /**
  * @brief Checks if a backend exists and is supported
  * @param backend_name the backend name to check
@@ -0,0 +1,79 @@
+/**
+ * @file drm_export.h
+ *
+ * DMA-BUF export of the draw buffers of the DRM page flip mode
+ *
+ * In page flip mode LVGL renders directly into dumb buffers that are
+ * scanned out as is. Each of them is also exported as a DMA-BUF, the
+ * frame export hands them to its consumers instead of copying the
+ * frames, see frame_export.h. The port itself doesn't import them into
+ * the GPU, an out of process consumer can with EGL_EXT_image_dma_buf_import.
+ * The EGL path of the LVGL DRM driver (LV_LINUX_DRM_USE_EGL) doesn't
+ * use these buffers and still uploads each frame
+ */
+
+#ifndef DRM_EXPORT_H
+#define DRM_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Description of an exported draw buffer, a single linear plane */
+typedef struct {
+    int fd;             /* The DMA-BUF file descriptor, owned by the backend */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t offset;
+    uint32_t fourcc;    /* DRM_FORMAT_* */
+    uint64_t modifier;  /* DRM_FORMAT_MOD_LINEAR */
+} drm_dmabuf_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Get the exported draw buffers of a display
+ * @param disp a display created by the DRM backend in page flip mode
+ * @param bufs where to store the buffers
+ * @param max the size of the bufs array
+ * @return the number of buffers, -1 if the display doesn't export its buffers
+ */
+int drm_export_get_buffers(lv_display_t *disp, drm_dmabuf_t *bufs, int max);
+
+/**
+ * @brief Get the buffer holding the latest frame
+ * @description the frame is committed or already scanned out, LVGL
+ * renders into this buffer again once the next frame was flipped
+ * @param disp a display created by the DRM backend in page flip mode
+ * @return the index of the buffer in the array returned by
+ * drm_export_get_buffers, -1 on error
+ */
+int drm_export_get_front(lv_display_t *disp);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*DRM_EXPORT_H*/
@@ -0,0 +1,571 @@
+/**
+ * @file evdev_thread.c
+ *
+ * Threaded evdev pointer input
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/input.h>
+
+#include "lvgl/lvgl.h"
+#if LV_USE_EVDEV
+
+#include "event_loop.h"
+#include "spsc_ring.h"
+#include "frame_stats.h"
+#include "rt_sched.h"
+#include "simulator_settings.h"
+#include "evdev_thread.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of samples the ring can hold - about 1 second at 1 kHz */
+#define EVDEV_THREAD_RING_SIZE 1024
+
+/* Samples kept while the ring is full, presses and releases are never dropped */
+#define EVDEV_THREAD_BACKLOG_LEN 8
+
+/* Retry period of the backlog, the LVGL thread doesn't signal when it emptied the ring */
+#define EVDEV_THREAD_BACKLOG_RETRY_MS 5
+
+/* Maximum number of samples handed to LVGL per read */
+#define EVDEV_THREAD_BATCH_MAX 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    int fd;                     /* The input device */
+    int notify_fd;              /* Signaled by the input thread when samples are available */
+    int stop_fd;                /* Signaled to stop the input thread */
+    pthread_t thread;
+    spsc_ring_t ring;
+    uint32_t dropped;
+
+    /* Calibration */
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+    touch_calibration_t matrix;
+    bool use_matrix;
+
+    /* State of the input thread */
+    evdev_sample_t cur;
+    bool mt_slots;              /* Multi-touch protocol B, the contacts are reported per slot */
+    int32_t mt_slot;            /* The slot the ABS_MT_* events apply to */
+    int32_t mt_tracked;         /* The slot of the contact that started the press, -1 if none */
+    evdev_sample_t backlog[EVDEV_THREAD_BACKLOG_LEN];
+    uint32_t backlog_cnt;
+
+    /* State of the LVGL thread */
+    evdev_sample_t last;
+    uint32_t batch;
+} evdev_thread_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void *input_thread(void *arg);
+static void handle_event(evdev_thread_t *ctx, const struct input_event *ev);
+static void handle_mt_event(evdev_thread_t *ctx, const struct input_event *ev);
+static void publish_sample(evdev_thread_t *ctx, const evdev_sample_t *s);
+static bool flush_backlog(evdev_thread_t *ctx);
+static void notify(evdev_thread_t *ctx);
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void notify_cb(int fd, uint32_t events, void *user_data);
+static void indev_delete_cb(lv_event_t *e);
+static int32_t map_coord(int32_t v, int32_t min, int32_t max, int32_t res);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *  GLOBAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_indev_t *evdev_thread_create(const char *path, lv_display_t *display)
+{
+    evdev_thread_t *ctx;
+    struct input_absinfo abs_x;
+    struct input_absinfo abs_y;
+    struct input_absinfo abs_slot;
+    int clk = CLOCK_MONOTONIC;
+    lv_indev_t *indev;
+
+    ctx = calloc(1, sizeof(evdev_thread_t));
+    LV_ASSERT_NULL(ctx);
+
+    ctx->notify_fd = -1;
+    ctx->stop_fd = -1;
+    ctx->fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (ctx->fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", path, strerror(errno));
+        free(ctx);
+        return NULL;
+    }
+
+    if (ioctl(ctx->fd, EVIOCGABS(ABS_X), &abs_x) < 0 ||
+        ioctl(ctx->fd, EVIOCGABS(ABS_Y), &abs_y) < 0) {
+        LV_LOG_WARN("%s is not an absolute pointer device", path);
+        goto err;
+    }
+
+    ctx->min_x = abs_x.minimum;
+    ctx->max_x = abs_x.maximum;
+    ctx->min_y = abs_y.minimum;
+    ctx->max_y = abs_y.maximum;
+
+    /* Only the first contact drives the pointer, the other fingers are ignored */
+    ctx->mt_tracked = -1;
+    if (ioctl(ctx->fd, EVIOCGABS(ABS_MT_SLOT), &abs_slot) == 0 && abs_slot.maximum > 0) {
+        ctx->mt_slots = true;
+        ctx->mt_slot = abs_slot.value;
+    }
+
+    /* Report the timestamps in the same clock as the LVGL tick */
+    ioctl(ctx->fd, EVIOCSCLOCKID, &clk);
+
+    if (spsc_ring_init(&ctx->ring, EVDEV_THREAD_RING_SIZE, sizeof(evdev_sample_t)) < 0) {
+        goto err;
+    }
+
+    ctx->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ctx->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (ctx->notify_fd < 0 || ctx->stop_fd < 0) {
+        goto err_ring;
+    }
+
+    indev = lv_indev_create();
+    if (indev == NULL) {
+        goto err_ring;
+    }
+
+    lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(indev, read_cb);
+    lv_indev_set_driver_data(indev, ctx);
+    lv_indev_set_display(indev, display);
+
+    if (pthread_create(&ctx->thread, NULL, input_thread, ctx) != 0) {
+        LV_LOG_ERROR("Failed to create the input thread");
+        lv_indev_delete(indev);
+        goto err_ring;
+    }
+
+    /* Stops the thread, only registered once it runs */
+    lv_indev_add_event_cb(indev, indev_delete_cb, LV_EVENT_DELETE, ctx);
+
+    /* Read the input device as soon as the thread received a report */
+    event_loop_add_fd(ctx->notify_fd, EPOLLIN, notify_cb, indev);
+
+    LV_LOG_USER("Reading %s from a dedicated thread", path);
+    return indev;
+
+err_ring:
+    spsc_ring_deinit(&ctx->ring);
+err:
+    if (ctx->notify_fd >= 0) {
+        close(ctx->notify_fd);
+    }
+
+    if (ctx->stop_fd >= 0) {
+        close(ctx->stop_fd);
+    }
+
+    close(ctx->fd);
+    free(ctx);
+    return NULL;
+}
+
+void evdev_thread_set_calibration(lv_indev_t *indev, int32_t min_x, int32_t min_y,
+                                  int32_t max_x, int32_t max_y)
+{
+    evdev_thread_t *ctx = lv_indev_get_driver_data(indev);
+
+    LV_ASSERT_NULL(ctx);
+
+    ctx->min_x = min_x;
+    ctx->min_y = min_y;
+    ctx->max_x = max_x;
+    ctx->max_y = max_y;
+    ctx->use_matrix = false;
+}
+
+void evdev_thread_set_calibration_matrix(lv_indev_t *indev, const touch_calibration_t *cal)
+{
+    evdev_thread_t *ctx = lv_indev_get_driver_data(indev);
+
+    LV_ASSERT_NULL(ctx);
+
+    ctx->matrix = *cal;
+    ctx->use_matrix = true;
+}
+
+const evdev_sample_t *evdev_thread_get_last_sample(lv_indev_t *indev)
+{
+    evdev_thread_t *ctx = lv_indev_get_driver_data(indev);
+
+    LV_ASSERT_NULL(ctx);
+    return &ctx->last;
+}
+
+uint64_t evdev_thread_get_timestamp(lv_indev_t *indev)
+{
+    return evdev_thread_get_last_sample(indev)->timestamp_us;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Input thread
+ *
+ * @description blocks on the input device and assembles the
+ * events into samples, until the stop eventfd is signaled. The thread is
+ * scheduled with LV_SIM_INPUT_SCHED or settings.input_sched and restricted
+ * to the CPUs of LV_SIM_INPUT_CPUS
+ */
+static void *input_thread(void *arg)
+{
+    evdev_thread_t *ctx = arg;
+    const char *sched = getenv("LV_SIM_INPUT_SCHED");
+    struct input_event evs[64];
+    struct pollfd pfd[2];
+    ssize_t len;
+    size_t i;
+
+    /* Applied from the thread itself, a nice level is per thread */
+    rt_sched_set(pthread_self(), sched != NULL ? sched : settings.input_sched);
+    rt_sched_set_affinity(pthread_self(), getenv("LV_SIM_INPUT_CPUS"));
+
+    pfd[0].fd = ctx->fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = ctx->stop_fd;
+    pfd[1].events = POLLIN;
+
+    while (true) {
+        if (poll(pfd, 2, ctx->backlog_cnt > 0 ? EVDEV_THREAD_BACKLOG_RETRY_MS : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (flush_backlog(ctx)) {
+            notify(ctx);
+        }
+
+        if (pfd[1].revents) {
+            break;
+        }
+
+        if (pfd[0].revents & (POLLERR | POLLHUP)) {
+            LV_LOG_WARN("Input device removed");
+            break;
+        }
+
+        while ((len = read(ctx->fd, evs, sizeof(evs))) > 0) {
+            for (i = 0; i < (size_t)len / sizeof(evs[0]); i++) {
+                handle_event(ctx, &evs[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Update the current sample and publish it on SYN_REPORT
+ *
+ * @note runs in the input thread
+ */
+static void handle_event(evdev_thread_t *ctx, const struct input_event *ev)
+{
+    switch (ev->type) {
+    case EV_ABS:
+        if (ctx->mt_slots) {
+            handle_mt_event(ctx, ev);
+        } else if (ev->code == ABS_X || ev->code == ABS_MT_POSITION_X) {
+            ctx->cur.x = ev->value;
+        } else if (ev->code == ABS_Y || ev->code == ABS_MT_POSITION_Y) {
+            ctx->cur.y = ev->value;
+        }
+        break;
+
+    case EV_KEY:
+        /* With slots the press follows the tracked contact, BTN_TOUCH is held by any finger */
+        if ((ev->code == BTN_TOUCH && !ctx->mt_slots) || ev->code == BTN_LEFT) {
+            ctx->cur.pressed = ev->value != 0;
+        }
+        break;
+
+    case EV_SYN:
+        if (ev->code != SYN_REPORT) {
+            break;
+        }
+
+        ctx->cur.timestamp_us = (uint64_t)ev->input_event_sec * 1000000ULL +
+                                (uint64_t)ev->input_event_usec;
+
+        publish_sample(ctx, &ctx->cur);
+        notify(ctx);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Queue a sample for the LVGL thread
+ *
+ * @description while the ring is full the samples wait in the backlog,
+ * a move replaces the last waiting sample of the same state so that only
+ * intermediate positions are lost, never a press or a release
+ * @note runs in the input thread
+ */
+static void publish_sample(evdev_thread_t *ctx, const evdev_sample_t *s)
+{
+    evdev_sample_t *last;
+
+    /* The waiting samples go first, the order is kept */
+    flush_backlog(ctx);
+
+    if (ctx->backlog_cnt == 0 && spsc_ring_push(&ctx->ring, s)) {
+        return;
+    }
+
+    last = ctx->backlog_cnt > 0 ? &ctx->backlog[ctx->backlog_cnt - 1] : NULL;
+
+    if (last != NULL && last->pressed == s->pressed) {
+        *last = *s;
+        ctx->dropped++;
+    } else if (ctx->backlog_cnt < EVDEV_THREAD_BACKLOG_LEN) {
+        ctx->backlog[ctx->backlog_cnt++] = *s;
+    } else {
+        /* The last transition and this one cancel out, the state stays the one of s */
+        ctx->backlog_cnt--;
+        ctx->backlog[ctx->backlog_cnt - 1] = *s;
+        ctx->dropped += 2;
+    }
+}
+
+/**
+ * Move the waiting samples into the ring
+ *
+ * @note runs in the input thread
+ * @return true if a sample was moved
+ */
+static bool flush_backlog(evdev_thread_t *ctx)
+{
+    uint32_t n = 0;
+
+    while (n < ctx->backlog_cnt && spsc_ring_push(&ctx->ring, &ctx->backlog[n])) {
+        n++;
+    }
+
+    if (n == 0) {
+        return false;
+    }
+
+    ctx->backlog_cnt -= n;
+    memmove(ctx->backlog, ctx->backlog + n, ctx->backlog_cnt * sizeof(evdev_sample_t));
+    return true;
+}
+
+/**
+ * Signal the LVGL thread that samples are queued
+ *
+ * @note runs in the input thread
+ */
+static void notify(evdev_thread_t *ctx)
+{
+    uint64_t one = 1;
+
+    if (write(ctx->notify_fd, &one, sizeof(one)) < 0) {
+        /* The counter is already non-zero */
+    }
+}
+
+/**
+ * Update the current sample from the contact that started the press
+ *
+ * @description the ABS_MT_* events apply to the slot selected by the last
+ * ABS_MT_SLOT. The first contact is tracked until its tracking ID is
+ * released, the positions of the other slots and the single touch
+ * ABS_X/ABS_Y emulation are ignored
+ * @note runs in the input thread
+ */
+static void handle_mt_event(evdev_thread_t *ctx, const struct input_event *ev)
+{
+    switch (ev->code) {
+    case ABS_MT_SLOT:
+        ctx->mt_slot = ev->value;
+        break;
+
+    case ABS_MT_TRACKING_ID:
+        if (ev->value >= 0 && ctx->mt_tracked < 0) {
+            ctx->mt_tracked = ctx->mt_slot;
+            ctx->cur.pressed = true;
+        } else if (ev->value < 0 && ctx->mt_slot == ctx->mt_tracked) {
+            ctx->mt_tracked = -1;
+            ctx->cur.pressed = false;
+        }
+        break;
+
+    case ABS_MT_POSITION_X:
+        if (ctx->mt_slot == ctx->mt_tracked) {
+            ctx->cur.x = ev->value;
+        }
+        break;
+
+    case ABS_MT_POSITION_Y:
+        if (ctx->mt_slot == ctx->mt_tracked) {
+            ctx->cur.y = ev->value;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Read callback of the LVGL input device
+ *
+ * @description hands the queued samples to LVGL one by one,
+ * with continue_reading set while more are pending so that
+ * intermediate positions of a drag are not coalesced
+ */
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    evdev_thread_t *ctx = lv_indev_get_driver_data(indev);
+    lv_display_t *disp = lv_indev_get_display(indev);
+    evdev_sample_t s;
+
+    if (spsc_ring_pop(&ctx->ring, &s)) {
+        ctx->last = s;
+        frame_stats_input(s.timestamp_us);
+        ctx->batch++;
+
+        if (ctx->batch < EVDEV_THREAD_BATCH_MAX && spsc_ring_count(&ctx->ring) > 0) {
+            data->continue_reading = true;
+        } else {
+            ctx->batch = 0;
+        }
+    }
+
+    if (ctx->use_matrix) {
+        touch_calibration_apply(&ctx->matrix, ctx->last.x, ctx->last.y,
+                                lv_display_get_horizontal_resolution(disp),
+                                lv_display_get_vertical_resolution(disp), &data->point);
+    } else {
+        data->point.x = map_coord(ctx->last.x, ctx->min_x, ctx->max_x,
+                                  lv_display_get_horizontal_resolution(disp));
+        data->point.y = map_coord(ctx->last.y, ctx->min_y, ctx->max_y,
+                                  lv_display_get_vertical_resolution(disp));
+    }
+    data->state = ctx->last.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+/**
+ * Read the input device right away
+ *
+ * @note called from the event loop when the input thread signals new samples
+ */
+static void notify_cb(int fd, uint32_t events, void *user_data)
+{
+    uint64_t cnt;
+
+    LV_UNUSED(events);
+
+    if (read(fd, &cnt, sizeof(cnt)) > 0) {
+        lv_indev_read(user_data);
+    }
+}
+
+/**
+ * Stop the input thread and release the resources
+ *
+ * @param e the deletion event
+ */
+static void indev_delete_cb(lv_event_t *e)
+{
+    evdev_thread_t *ctx = lv_event_get_user_data(e);
+    uint64_t one = 1;
+    ssize_t ret;
+
+    do {
+        ret = write(ctx->stop_fd, &one, sizeof(one));
+    } while (ret < 0 && errno == EINTR);
+
+    /* The context is freed below, the thread must be gone whatever happens, poll is a cancellation point */
+    if (ret != sizeof(one)) {
+        LV_LOG_WARN("Failed to signal the input thread, cancelling it");
+        pthread_cancel(ctx->thread);
+    }
+
+    pthread_join(ctx->thread, NULL);
+
+    if (ctx->dropped != 0) {
+        LV_LOG_WARN("%u input samples were dropped", ctx->dropped);
+    }
+
+    event_loop_remove_fd(ctx->notify_fd);
+    close(ctx->notify_fd);
+    close(ctx->stop_fd);
+    close(ctx->fd);
+    spsc_ring_deinit(&ctx->ring);
+    free(ctx);
+}
+
+/**
+ * Map a raw coordinate to the display resolution
+ *
+ * @description min can be greater than max to invert the axis
+ */
+static int32_t map_coord(int32_t v, int32_t min, int32_t max, int32_t res)
+{
+    int32_t r;
+
+    if (max == min) {
+        return v;
+    }
+
+    r = (int32_t)(((int64_t)(v - min) * res) / (max - min));
+    return LV_CLAMP(0, r, res - 1);
+}
+
+#endif /*LV_USE_EVDEV*/
@@ -0,0 +1,98 @@
+/**
+ * @file evdev_thread.h
+ *
+ * Threaded evdev pointer input
+ *
+ * A dedicated thread blocks on the input device and pushes
+ * timestamped samples into a lock-free ring, the read callback
+ * of the LVGL input device drains the ring in batches so that no
+ * sample is lost while the LVGL thread is busy rendering
+ */
+
+#ifndef EVDEV_THREAD_H
+#define EVDEV_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+#include "touch_filter.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A complete pointer report, assembled on SYN_REPORT */
+typedef struct {
+    int32_t x;              /* Raw coordinates of the device */
+    int32_t y;
+    bool pressed;
+    uint64_t timestamp_us;  /* Kernel timestamp of the report, CLOCK_MONOTONIC */
+} evdev_sample_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Create a pointer input device read by a dedicated thread
+ * @param path the path of the input device
+ * @param display the display the input device is bound to
+ * @return the LVGL input device or NULL on failure
+ */
+lv_indev_t *evdev_thread_create(const char *path, lv_display_t *display);
+
+/**
+ * @brief Set the raw coordinates mapped to the edges of the display
+ * @description same semantics as lv_evdev_set_calibration, by default
+ * the range reported by the device is used
+ * @param indev the input device created by evdev_thread_create
+ */
+void evdev_thread_set_calibration(lv_indev_t *indev, int32_t min_x, int32_t min_y,
+                                  int32_t max_x, int32_t max_y);
+
+/**
+ * @brief Map the raw coordinates with a calibration matrix
+ * @description replaces the calibration set with evdev_thread_set_calibration
+ * @param indev the input device created by evdev_thread_create
+ * @param cal the calibration, copied
+ */
+void evdev_thread_set_calibration_matrix(lv_indev_t *indev, const touch_calibration_t *cal);
+
+/**
+ * @brief Get the sample last reported to LVGL
+ * @description gives access to the kernel timestamp of the sample,
+ * i.e. from an LV_EVENT_PRESSING handler to compute the velocity
+ * @param indev the input device created by evdev_thread_create
+ * @return the sample
+ */
+const evdev_sample_t *evdev_thread_get_last_sample(lv_indev_t *indev);
+
+/**
+ * @brief Get the kernel timestamp of the sample last reported to LVGL
+ * @description the timestamp source of the touch filter, see touch_filter_attach
+ * @param indev the input device created by evdev_thread_create
+ * @return the timestamp in us, CLOCK_MONOTONIC
+ */
+uint64_t evdev_thread_get_timestamp(lv_indev_t *indev);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*EVDEV_THREAD_H*/
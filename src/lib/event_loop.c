@@ -0,0 +1,477 @@
+/**
+ * @file event_loop.c
+ *
+ * Event driven run loop shared by the driver backends
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "lvgl/lvgl.h"
+
+#include "frame_stats.h"
+#include "event_loop.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Maximum number of file descriptors that can be watched at the same time */
+#define EVENT_LOOP_MAX_FDS 16
+
+/* Maximum number of events retrieved per call to epoll_wait */
+#define EVENT_LOOP_MAX_EVENTS 8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    int fd;
+    event_loop_fd_cb_t cb;
+    void *user_data;
+    uint32_t generation;        /* Incremented when the slot is freed */
+} event_source_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static event_source_t *find_source(int fd);
+static void drain_fd_cb(int fd, uint32_t events, void *user_data);
+static void arm_timer(uint32_t idle_time);
+static void watch_start(void);
+static void watch_stop(void);
+static void watch_arm(void);
+static void *watch_thread_cb(void *arg);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int wakeup_fd = -1;
+static volatile bool quit_requested;
+static event_loop_wait_cb_t wait_cb;
+static event_loop_wake_cb_t wake_cb;
+
+static event_source_t sources[EVENT_LOOP_MAX_FDS];
+
+/* Interrupts wait_cb when a watched file descriptor becomes ready */
+static pthread_t watch_thread;
+static bool watch_running;
+static int watch_stop_fd = -1;
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t watch_cond = PTHREAD_COND_INITIALIZER;
+static bool watch_armed;        /* The loop dispatched the ready descriptors, poll again */
+static bool watch_quit;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int event_loop_init(void)
+{
+    int i;
+
+    if (epoll_fd >= 0) {
+        /* Already initialized */
+        return 0;
+    }
+
+    for (i = 0; i < EVENT_LOOP_MAX_FDS; i++) {
+        sources[i].fd = -1;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        LV_LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+        return -1;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (timer_fd < 0 || wakeup_fd < 0) {
+        LV_LOG_ERROR("Failed to create the timerfd/eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (event_loop_add_fd(timer_fd, EPOLLIN, drain_fd_cb, NULL) < 0 ||
+        event_loop_add_fd(wakeup_fd, EPOLLIN, drain_fd_cb, NULL) < 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    if (timer_fd >= 0) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+
+    if (wakeup_fd >= 0) {
+        close(wakeup_fd);
+        wakeup_fd = -1;
+    }
+
+    close(epoll_fd);
+    epoll_fd = -1;
+    return -1;
+}
+
+int event_loop_add_fd(int fd, uint32_t events, event_loop_fd_cb_t cb, void *user_data)
+{
+    struct epoll_event ev;
+    event_source_t *src;
+
+    if (event_loop_init() < 0) {
+        return -1;
+    }
+
+    src = find_source(-1);
+    if (src == NULL) {
+        LV_LOG_ERROR("Too many watched file descriptors");
+        return -1;
+    }
+
+    /* The events of a previous user of the slot are told apart by the generation */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)src->generation << 32) | (uint32_t)(src - sources);
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LV_LOG_ERROR("Failed to watch fd %d: %s", fd, strerror(errno));
+        return -1;
+    }
+
+    src->fd = fd;
+    src->cb = cb;
+    src->user_data = user_data;
+
+    return 0;
+}
+
+int event_loop_remove_fd(int fd)
+{
+    event_source_t *src;
+
+    if (fd < 0 || (src = find_source(fd)) == NULL) {
+        return -1;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    /* The slot might still be referenced by pending events of the current iteration */
+    src->fd = -1;
+    src->cb = NULL;
+    src->user_data = NULL;
+    src->generation++;
+
+    return 0;
+}
+
+void event_loop_wakeup(void)
+{
+    uint64_t one = 1;
+
+    if (wake_cb != NULL) {
+        wake_cb();
+    }
+
+    if (wakeup_fd >= 0) {
+        /* Can only fail if the counter overflows - the loop is awake in that case */
+        if (write(wakeup_fd, &one, sizeof(one)) < 0) {
+            return;
+        }
+    }
+}
+
+void event_loop_quit(void)
+{
+    quit_requested = true;
+    event_loop_wakeup();
+}
+
+void event_loop_set_wait_cb(event_loop_wait_cb_t wait, event_loop_wake_cb_t wake)
+{
+    watch_stop();
+
+    wait_cb = wait;
+    wake_cb = wake;
+
+    if (wait_cb != NULL && wake_cb != NULL) {
+        watch_start();
+    }
+}
+
+void event_loop_run(event_loop_handler_t handler)
+{
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    event_source_t *src;
+    uint32_t idle_time;
+    uint64_t start;
+    uint64_t end;
+    int n;
+    int i;
+
+    if (event_loop_init() < 0) {
+        LV_LOG_ERROR("Event loop unavailable");
+        return;
+    }
+
+    if (handler == NULL) {
+        handler = lv_timer_handler;
+    }
+
+    quit_requested = false;
+
+    /* Handle LVGL tasks */
+    while (!quit_requested) {
+
+        /* Returns the time to the next timer execution
+         * The lock is recursive, it's a no-op without LV_USE_OS */
+        start = frame_stats_now_us();
+        lv_lock();
+        idle_time = handler();
+        lv_unlock();
+        end = frame_stats_now_us();
+        frame_stats_record(FRAME_STATS_TIMER, start, end);
+
+        if (quit_requested) {
+            break;
+        }
+
+        if (wait_cb != NULL) {
+            /* The timeout of wait_cb replaces the timerfd, the watcher would wake it for nothing */
+            watch_arm();
+            wait_cb(idle_time == LV_NO_TIMER_READY ? -1 : (int32_t)LV_MIN(idle_time, INT32_MAX));
+            n = epoll_wait(epoll_fd, events, EVENT_LOOP_MAX_EVENTS, 0);
+        } else {
+            arm_timer(idle_time);
+            n = epoll_wait(epoll_fd, events, EVENT_LOOP_MAX_EVENTS, -1);
+        }
+        frame_stats_record(FRAME_STATS_IDLE, end, frame_stats_now_us());
+
+        if (n < 0) {
+            if (errno != EINTR) {
+                LV_LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            src = &sources[(uint32_t)events[i].data.u64];
+
+            /* Skip sources removed by a previous callback, even if the slot was reused since */
+            if (src->cb != NULL && src->generation == (uint32_t)(events[i].data.u64 >> 32)) {
+                /* Callbacks can call LVGL - i.e to read an input device */
+                lv_lock();
+                src->cb(src->fd, events[i].events, src->user_data);
+                lv_unlock();
+            }
+        }
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Find the slot of a watched file descriptor
+ *
+ * @param fd the file descriptor, -1 to find a free slot
+ * @return the slot or NULL
+ */
+static event_source_t *find_source(int fd)
+{
+    int i;
+
+    for (i = 0; i < EVENT_LOOP_MAX_FDS; i++) {
+        if (sources[i].fd == fd) {
+            return &sources[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Consume the counter of the timerfd or the eventfd
+ *
+ * @note the LVGL timers are processed on the next iteration
+ * of the loop, nothing else needs to be done here
+ */
+static void drain_fd_cb(int fd, uint32_t events, void *user_data)
+{
+    uint64_t cnt;
+
+    LV_UNUSED(events);
+    LV_UNUSED(user_data);
+
+    if (read(fd, &cnt, sizeof(cnt)) < 0) {
+        return;
+    }
+}
+
+/**
+ * Arm the timerfd with the delay to the next LVGL timer
+ *
+ * @param idle_time the value returned by the LVGL timer handler in ms
+ */
+static void arm_timer(uint32_t idle_time)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    if (idle_time == LV_NO_TIMER_READY) {
+        /* No timer pending - disarm and sleep until an fd becomes ready */
+        timerfd_settime(timer_fd, 0, &its, NULL);
+        return;
+    }
+
+    /* A zero value would disarm the timer, the tick has a 1ms resolution anyway */
+    if (idle_time == 0) {
+        idle_time = 1;
+    }
+
+    its.it_value.tv_sec = idle_time / 1000;
+    its.it_value.tv_nsec = (long)(idle_time % 1000) * 1000000L;
+
+    timerfd_settime(timer_fd, 0, &its, NULL);
+}
+
+/**
+ * Start the thread waking up wait_cb
+ *
+ * @description without it the watched file descriptors are only
+ * dispatched when wait_cb returns on its own
+ */
+static void watch_start(void)
+{
+    if (event_loop_init() < 0) {
+        return;
+    }
+
+    watch_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    watch_armed = false;
+    watch_quit = false;
+
+    if (watch_stop_fd < 0 || pthread_create(&watch_thread, NULL, watch_thread_cb, NULL) != 0) {
+        LV_LOG_WARN("The file descriptors are dispatched when the wait times out");
+
+        if (watch_stop_fd >= 0) {
+            close(watch_stop_fd);
+            watch_stop_fd = -1;
+        }
+        return;
+    }
+
+    watch_running = true;
+}
+
+/**
+ * Stop the thread waking up wait_cb
+ */
+static void watch_stop(void)
+{
+    uint64_t one = 1;
+
+    if (!watch_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&watch_lock);
+    watch_quit = true;
+    pthread_cond_signal(&watch_cond);
+    pthread_mutex_unlock(&watch_lock);
+
+    /* Interrupts the poll */
+    if (write(watch_stop_fd, &one, sizeof(one)) < 0) {
+        LV_LOG_WARN("Failed to stop the watcher: %s", strerror(errno));
+    }
+
+    pthread_join(watch_thread, NULL);
+    close(watch_stop_fd);
+    watch_stop_fd = -1;
+    watch_running = false;
+}
+
+/**
+ * Let the watcher poll the file descriptors again
+ *
+ * @note the descriptors are level triggered, the watcher waits for the
+ * loop to dispatch them before polling again instead of spinning
+ */
+static void watch_arm(void)
+{
+    if (!watch_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&watch_lock);
+    watch_armed = true;
+    pthread_cond_signal(&watch_cond);
+    pthread_mutex_unlock(&watch_lock);
+}
+
+/**
+ * Wake up wait_cb when a watched file descriptor becomes ready
+ *
+ * @note runs in its own thread, the epoll descriptor is itself pollable
+ */
+static void *watch_thread_cb(void *arg)
+{
+    struct pollfd pfds[2];
+    int n;
+
+    LV_UNUSED(arg);
+
+    pfds[0].fd = epoll_fd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = watch_stop_fd;
+    pfds[1].events = POLLIN;
+
+    while (true) {
+        pthread_mutex_lock(&watch_lock);
+        while (!watch_armed && !watch_quit) {
+            pthread_cond_wait(&watch_cond, &watch_lock);
+        }
+        watch_armed = false;
+        pthread_mutex_unlock(&watch_lock);
+
+        do {
+            n = poll(pfds, 2, -1);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 || pfds[1].revents != 0) {
+            break;
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            wake_cb();
+        }
+    }
+
+    return NULL;
+}
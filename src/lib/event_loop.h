@@ -0,0 +1,116 @@
+/**
+ * @file event_loop.h
+ *
+ * Event driven run loop shared by the driver backends
+ *
+ * Instead of polling with usleep(), the run loop sleeps in epoll_wait(2)
+ * on the following sources:
+ *
+ * - a timerfd armed with the delay to the next LVGL timer
+ * - an eventfd used to wake up the loop from another thread
+ * - any file descriptor registered by a backend (evdev, DRM, etc)
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Called from the run loop when a registered file descriptor is ready */
+typedef void (*event_loop_fd_cb_t)(int fd, uint32_t events, void *user_data);
+
+/* Runs the LVGL tasks and returns the time in ms until it has to be called again */
+typedef uint32_t (*event_loop_handler_t)(void);
+
+/* Sleeps until an event of another event source or the timeout in ms, -1 for none */
+typedef void (*event_loop_wait_cb_t)(int32_t timeout);
+
+/* Interrupts the wait of event_loop_wait_cb_t, called from any thread */
+typedef void (*event_loop_wake_cb_t)(void);
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Initialize the event loop
+ * @description creates the epoll instance, the timerfd and the eventfd
+ * it is safe to call this function multiple times
+ * @return 0 on success, -1 on error
+ */
+int event_loop_init(void);
+
+/**
+ * @brief Watch a file descriptor
+ * @param fd the file descriptor to watch
+ * @param events the epoll events to wait for (EPOLLIN etc)
+ * @param cb the callback invoked from the run loop when the fd is ready
+ * @param user_data passed to the callback
+ * @return 0 on success, -1 on error
+ */
+int event_loop_add_fd(int fd, uint32_t events, event_loop_fd_cb_t cb, void *user_data);
+
+/**
+ * @brief Stop watching a file descriptor
+ * @param fd the file descriptor previously passed to event_loop_add_fd
+ * @return 0 on success, -1 on error
+ */
+int event_loop_remove_fd(int fd);
+
+/**
+ * @brief Wake up the run loop
+ * @description can be called from any thread, causes the LVGL
+ * timers to be processed immediately
+ */
+void event_loop_wakeup(void);
+
+/**
+ * @brief Leave the run loop
+ * @description event_loop_run returns after the current iteration
+ */
+void event_loop_quit(void);
+
+/**
+ * @brief Sleep in another event source
+ * @description for toolkits that can't be waited for with a fd, i.e SDL.
+ * The loop sleeps in wait_cb instead of epoll_wait, the watched file
+ * descriptors are then dispatched without waiting when it returns.
+ * A watcher thread polls the descriptors meanwhile and calls wake_cb
+ * when one becomes ready, wake_cb must be thread safe
+ * @param wait_cb the wait function, NULL to sleep in epoll_wait again
+ * @param wake_cb called by event_loop_wakeup to interrupt wait_cb
+ */
+void event_loop_set_wait_cb(event_loop_wait_cb_t wait_cb, event_loop_wake_cb_t wake_cb);
+
+/**
+ * @brief Enter the run loop
+ * @description does not return until event_loop_quit is called
+ * @param handler the function that runs the LVGL tasks,
+ * lv_timer_handler is used if NULL
+ */
+void event_loop_run(event_loop_handler_t handler);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*EVENT_LOOP_H*/
@@ -0,0 +1,550 @@
+/**
+ * @file frame_export.c
+ *
+ * Export of the frames of a display through shared memory
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/display/lv_display_private.h"
+
+#include "backends.h"
+#include "damage.h"
+#include "event_loop.h"
+#include "frame_stats.h"
+#include "simulator_settings.h"
+#include "frame_export.h"
+#if LV_USE_LINUX_DRM
+#include "drm_export.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define FRAME_EXPORT_PAGE 4096
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_display_t *disp;
+    lv_display_flush_cb_t flush_cb;     /* The flush callback of the backend */
+    int memfd;
+    int listen_fd;
+    char socket_path[108];
+    uint8_t *map;
+    size_t map_size;
+    frame_export_header_t *header;
+    int dmabuf_fds[FRAME_EXPORT_MAX_DMABUFS];   /* Owned by the DRM backend */
+    uint32_t dmabuf_cnt;                /* 0 if the frames are copied into the slots */
+    uint32_t dmabuf_stride;
+    uint32_t dmabuf_fourcc;
+    uint64_t dmabuf_modifier;
+    uint32_t px_size;
+    uint32_t slot;                      /* Slot written by the current frame */
+    bool writing;                       /* The first area of the frame was flushed */
+    damage_t frame_damage;              /* Areas of the current frame */
+    damage_t stale[FRAME_EXPORT_SLOTS]; /* Areas of each slot older than the latest frame */
+} frame_export_ctx_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static frame_export_ctx_t *get_ctx(lv_display_t *disp);
+static int create_memfd(frame_export_ctx_t *ctx);
+static void share_dmabufs(frame_export_ctx_t *ctx);
+static int create_socket(frame_export_ctx_t *ctx, const char *path);
+static void accept_cb(int fd, uint32_t events, void *user_data);
+static void export_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void dmabuf_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+static void copy_area(frame_export_ctx_t *ctx, uint8_t *dst, const uint8_t *src,
+                      uint32_t src_stride, const lv_area_t *area);
+static void publish(frame_export_ctx_t *ctx);
+static void release(frame_export_ctx_t *ctx);
+static void delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static frame_export_ctx_t *ctxs[BACKEND_MAX_DISPLAYS];
+
+/**********************
+ *  GLOBAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *      MACROS
+ **********************/
+
+#define SLOT_DATA(ctx, i) ((ctx)->map + (ctx)->header->slot_offset[i])
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int frame_export_attach(lv_display_t *disp, const char *socket_path)
+{
+    frame_export_ctx_t *ctx;
+    lv_area_t full;
+    int slot;
+    int i;
+
+    if (socket_path == NULL || socket_path[0] == '\0') {
+        return 0;
+    }
+
+    if (lv_display_get_rotation(disp) != LV_DISPLAY_ROTATION_0) {
+        LV_LOG_ERROR("Frames rotated by LVGL can't be exported");
+        return -1;
+    }
+
+    for (slot = 0; slot < BACKEND_MAX_DISPLAYS && ctxs[slot] != NULL; slot++);
+
+    if (slot == BACKEND_MAX_DISPLAYS) {
+        return -1;
+    }
+
+    ctx = calloc(1, sizeof(frame_export_ctx_t));
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    ctx->disp = disp;
+    ctx->flush_cb = disp->flush_cb;
+    ctx->px_size = lv_color_format_get_size(lv_display_get_color_format(disp));
+    ctx->memfd = -1;
+    ctx->listen_fd = -1;
+
+    share_dmabufs(ctx);
+
+    if (create_memfd(ctx) < 0 || create_socket(ctx, socket_path) < 0) {
+        release(ctx);
+        return -1;
+    }
+
+    /* The slots that were never written are missing everything */
+    lv_area_set(&full, 0, 0, ctx->header->width - 1, ctx->header->height - 1);
+    for (i = 0; i < FRAME_EXPORT_SLOTS; i++) {
+        damage_add(&ctx->stale[i], &full);
+    }
+
+    ctxs[slot] = ctx;
+
+    lv_display_set_flush_cb(disp, ctx->dmabuf_cnt != 0 ? dmabuf_flush_cb : export_flush_cb);
+    lv_display_add_event_cb(disp, delete_cb, LV_EVENT_DELETE, ctx);
+
+    LV_LOG_USER("Exporting %ux%u frames on %s%s", ctx->header->width, ctx->header->height,
+                socket_path, ctx->dmabuf_cnt != 0 ? " as DMA-BUFs" : "");
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the context of a display
+ *
+ * @param disp the display
+ * @return the context or NULL
+ */
+static frame_export_ctx_t *get_ctx(lv_display_t *disp)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (ctxs[i] != NULL && ctxs[i]->disp == disp) {
+            return ctxs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Create and map the shared memory
+ *
+ * @description the size is sealed, the consumers can map it
+ * without fearing a SIGBUS
+ * @param ctx the context
+ * @return 0 on success, -1 on error
+ */
+static int create_memfd(frame_export_ctx_t *ctx)
+{
+    frame_export_header_t *h;
+    uint32_t w = lv_display_get_horizontal_resolution(ctx->disp);
+    uint32_t hres = lv_display_get_vertical_resolution(ctx->disp);
+    size_t header_size = (sizeof(frame_export_header_t) + FRAME_EXPORT_PAGE - 1) &
+                         ~(size_t)(FRAME_EXPORT_PAGE - 1);
+    size_t slot_size = ((size_t)w * ctx->px_size * hres + FRAME_EXPORT_PAGE - 1) &
+                       ~(size_t)(FRAME_EXPORT_PAGE - 1);
+    uint32_t slot_cnt = FRAME_EXPORT_SLOTS;
+    uint32_t i;
+
+    /* The frames are in the DMA-BUFs, only the header is shared */
+    if (ctx->dmabuf_cnt != 0) {
+        slot_cnt = 0;
+        slot_size = 0;
+    }
+
+    ctx->memfd = memfd_create("lvgl-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (ctx->memfd < 0) {
+        LV_LOG_ERROR("memfd_create failed: %s", strerror(errno));
+        return -1;
+    }
+
+    ctx->map_size = header_size + slot_cnt * slot_size;
+
+    if (ftruncate(ctx->memfd, (off_t)ctx->map_size) < 0) {
+        LV_LOG_ERROR("Failed to size the frame export memory: %s", strerror(errno));
+        return -1;
+    }
+
+    fcntl(ctx->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    ctx->map = mmap(NULL, ctx->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->memfd, 0);
+    if (ctx->map == MAP_FAILED) {
+        ctx->map = NULL;
+        LV_LOG_ERROR("Failed to map the frame export memory: %s", strerror(errno));
+        return -1;
+    }
+
+    h = (frame_export_header_t *)ctx->map;
+    h->magic = FRAME_EXPORT_MAGIC;
+    h->version = FRAME_EXPORT_VERSION;
+    h->width = w;
+    h->height = hres;
+    h->cf = lv_display_get_color_format(ctx->disp);
+    h->slot_cnt = slot_cnt;
+    h->slot_size = (uint32_t)slot_size;
+    h->stride = slot_cnt != 0 ? w * ctx->px_size : ctx->dmabuf_stride;
+    h->dmabuf_cnt = ctx->dmabuf_cnt;
+    h->dmabuf_fourcc = ctx->dmabuf_fourcc;
+    h->dmabuf_modifier = ctx->dmabuf_modifier;
+
+    for (i = 0; i < slot_cnt; i++) {
+        h->slot_offset[i] = header_size + (size_t)i * slot_size;
+    }
+
+    ctx->header = h;
+    return 0;
+}
+
+/**
+ * Share the scanout buffers of a DRM display
+ *
+ * @description only when they hold the frames as rendered by LVGL, the
+ * port rotation would need the rectangles to be rotated too
+ * @param ctx the context
+ */
+static void share_dmabufs(frame_export_ctx_t *ctx)
+{
+#if LV_USE_LINUX_DRM
+    drm_dmabuf_t bufs[FRAME_EXPORT_MAX_DMABUFS];
+    int cnt = drm_export_get_buffers(ctx->disp, bufs, FRAME_EXPORT_MAX_DMABUFS);
+    int i;
+
+    if (cnt <= 0 || settings.rotation != 0 ||
+        bufs[0].width != (uint32_t)lv_display_get_horizontal_resolution(ctx->disp) ||
+        bufs[0].height != (uint32_t)lv_display_get_vertical_resolution(ctx->disp)) {
+        return;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        ctx->dmabuf_fds[i] = bufs[i].fd;
+    }
+
+    ctx->dmabuf_cnt = (uint32_t)cnt;
+    ctx->dmabuf_stride = bufs[0].stride;
+    ctx->dmabuf_fourcc = bufs[0].fourcc;
+    ctx->dmabuf_modifier = bufs[0].modifier;
+#else
+    LV_UNUSED(ctx);
+#endif
+}
+
+/**
+ * Listen for the consumers
+ *
+ * @param ctx the context
+ * @param path the path of the unix socket, replaced if it exists
+ * @return 0 on success, -1 on error
+ */
+static int create_socket(frame_export_ctx_t *ctx, const char *path)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        LV_LOG_ERROR("Socket path too long: %s", path);
+        return -1;
+    }
+
+    ctx->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (ctx->listen_fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+
+    if (bind(ctx->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(ctx->listen_fd, 4) < 0) {
+        LV_LOG_ERROR("Failed to listen on %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    snprintf(ctx->socket_path, sizeof(ctx->socket_path), "%s", path);
+
+    return event_loop_add_fd(ctx->listen_fd, EPOLLIN, accept_cb, ctx);
+}
+
+/**
+ * Send the shared memory to a consumer
+ *
+ * @description the connection is closed once the fd was sent
+ */
+static void accept_cb(int fd, uint32_t events, void *user_data)
+{
+    frame_export_ctx_t *ctx = user_data;
+    char ctrl[CMSG_SPACE(sizeof(int) * (1 + FRAME_EXPORT_MAX_DMABUFS))];
+    size_t fd_cnt = 1 + ctx->dmabuf_cnt;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    char byte = 0;
+    int client;
+
+    LV_UNUSED(events);
+
+    while ((client = accept4(fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+        memset(&msg, 0, sizeof(msg));
+        memset(ctrl, 0, sizeof(ctrl));
+        iov.iov_base = &byte;
+        iov.iov_len = 1;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_cnt);
+
+        /* The memfd, then the DMA-BUFs */
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_cnt);
+        memcpy(CMSG_DATA(cmsg), &ctx->memfd, sizeof(int));
+        memcpy(CMSG_DATA(cmsg) + sizeof(int), ctx->dmabuf_fds, sizeof(int) * (fd_cnt - 1));
+
+        if (sendmsg(client, &msg, MSG_NOSIGNAL) < 0) {
+            LV_LOG_WARN("Failed to send the frame export memory: %s", strerror(errno));
+        }
+
+        close(client);
+    }
+}
+
+/**
+ * Copy the area into the slot of the frame, then flush it
+ *
+ * @description the slot is first brought up to date with the latest
+ * frame. The last area publishes the frame
+ */
+static void export_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    frame_export_ctx_t *ctx = get_ctx(disp);
+    frame_export_header_t *h = ctx->header;
+    lv_draw_buf_t *buf = lv_display_get_buf_active(disp);
+    const uint8_t *src = px_map;
+    const lv_area_t *a;
+    uint32_t i;
+
+    if (!ctx->writing) {
+        ctx->slot = h->frame == 0 ? 0 : (h->slot + 1) % FRAME_EXPORT_SLOTS;
+
+        if (h->frame != 0) {
+            for (i = 0; i < ctx->stale[ctx->slot].count; i++) {
+                a = &ctx->stale[ctx->slot].rects[i];
+                copy_area(ctx, SLOT_DATA(ctx, ctx->slot),
+                          SLOT_DATA(ctx, h->slot) + (size_t)a->y1 * h->stride + (size_t)a->x1 * ctx->px_size,
+                          h->stride, a);
+            }
+            damage_reset(&ctx->stale[ctx->slot]);
+        }
+
+        ctx->writing = true;
+    }
+
+    /* In partial mode the buffer only holds the area */
+    if (disp->render_mode != LV_DISPLAY_RENDER_MODE_PARTIAL) {
+        src += (size_t)area->y1 * buf->header.stride + (size_t)area->x1 * ctx->px_size;
+    }
+
+    copy_area(ctx, SLOT_DATA(ctx, ctx->slot), src, buf->header.stride, area);
+    damage_add(&ctx->frame_damage, area);
+
+    if (lv_display_flush_is_last(disp)) {
+        publish(ctx);
+    }
+
+    ctx->flush_cb(disp, area, px_map);
+}
+
+/**
+ * Publish the frames of a display sharing its DMA-BUFs
+ *
+ * @description nothing is copied, the frame is published once its
+ * buffer was committed by the DRM backend
+ */
+static void dmabuf_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    frame_export_ctx_t *ctx = get_ctx(disp);
+    bool last = lv_display_flush_is_last(disp);
+
+    damage_add(&ctx->frame_damage, area);
+    ctx->flush_cb(disp, area, px_map);
+
+#if LV_USE_LINUX_DRM
+    if (last) {
+        ctx->slot = (uint32_t)drm_export_get_front(disp);
+        publish(ctx);
+    }
+#else
+    LV_UNUSED(last);
+#endif
+}
+
+/**
+ * Copy an area into a slot
+ *
+ * @param ctx the context
+ * @param dst the slot
+ * @param src the first pixel of the area
+ * @param src_stride the stride of the source
+ * @param area the area in display coordinates
+ */
+static void copy_area(frame_export_ctx_t *ctx, uint8_t *dst, const uint8_t *src,
+                      uint32_t src_stride, const lv_area_t *area)
+{
+    uint32_t stride = ctx->header->stride;
+    uint32_t len = (uint32_t)lv_area_get_width(area) * ctx->px_size;
+    int32_t y;
+
+    dst += (size_t)area->y1 * stride + (size_t)area->x1 * ctx->px_size;
+
+    for (y = area->y1; y <= area->y2; y++) {
+        memcpy(dst, src, len);
+        dst += stride;
+        src += src_stride;
+    }
+}
+
+/**
+ * Publish the frame under the sequence lock
+ *
+ * @description the areas of the frame are now missing from the other slots
+ * @param ctx the context
+ */
+static void publish(frame_export_ctx_t *ctx)
+{
+    frame_export_header_t *h = ctx->header;
+    uint32_t seq = h->seq;
+    uint32_t i;
+
+    __atomic_store_n(&h->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    h->slot = ctx->slot;
+    h->frame++;
+    h->time_us = frame_stats_now_us();
+    h->rect_cnt = ctx->frame_damage.count;
+
+    for (i = 0; i < ctx->frame_damage.count; i++) {
+        h->rects[i].x1 = ctx->frame_damage.rects[i].x1;
+        h->rects[i].y1 = ctx->frame_damage.rects[i].y1;
+        h->rects[i].x2 = ctx->frame_damage.rects[i].x2;
+        h->rects[i].y2 = ctx->frame_damage.rects[i].y2;
+    }
+
+    __atomic_store_n(&h->seq, seq + 2, __ATOMIC_RELEASE);
+
+    for (i = 0; i < h->slot_cnt; i++) {
+        if (i != ctx->slot) {
+            damage_add_all(&ctx->stale[i], &ctx->frame_damage);
+        }
+    }
+
+    damage_reset(&ctx->frame_damage);
+    ctx->writing = false;
+}
+
+/**
+ * Release the resources of a context
+ *
+ * @param ctx the context
+ */
+static void release(frame_export_ctx_t *ctx)
+{
+    if (ctx->listen_fd >= 0) {
+        event_loop_remove_fd(ctx->listen_fd);
+        close(ctx->listen_fd);
+    }
+
+    if (ctx->socket_path[0] != '\0') {
+        unlink(ctx->socket_path);
+    }
+
+    if (ctx->map != NULL) {
+        munmap(ctx->map, ctx->map_size);
+    }
+
+    if (ctx->memfd >= 0) {
+        close(ctx->memfd);
+    }
+
+    free(ctx);
+}
+
+/**
+ * Stop the export when the display is deleted
+ *
+ * @description the consumers keep their mapping of the last frames
+ * @param e the delete event of the display
+ */
+static void delete_cb(lv_event_t *e)
+{
+    frame_export_ctx_t *ctx = lv_event_get_user_data(e);
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (ctxs[i] == ctx) {
+            ctxs[i] = NULL;
+        }
+    }
+
+    release(ctx);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file frame_export.h
+ *
+ * Export of the frames of a display through shared memory
+ *
+ * Enabled with LV_SIM_FRAME_EXPORT=<socket path> (LV_SIM_FRAME_EXPORT_<n>
+ * for the additional displays), the frames are published into a memfd
+ * holding a header and FRAME_EXPORT_SLOTS frame slots, as a secondary
+ * sink of any display backend or the only one of the HEADLESS backend.
+ *
+ * A consumer (VNC server, video encoder) connects to the unix socket,
+ * receives the memfd with SCM_RIGHTS and maps it read only. Only the
+ * damaged areas are copied into the slots, the writer never waits for
+ * the consumers.
+ *
+ * The latest frame is described by the fields of the header following
+ * seq, written under a sequence lock. A consumer reads them with:
+ *
+ *     do {
+ *         s = atomic load acquire of seq, retried while it is odd
+ *         copy slot, frame and the rectangles
+ *         acquire fence
+ *     } while (seq != s);
+ *
+ * The slot holds the complete frame, the rectangles are the areas that
+ * changed since the previous frame. A slot is rewritten when the frame
+ * frame + FRAME_EXPORT_SLOTS starts, the pixels read from it are intact
+ * if the frame number in the header is still at most frame + 1 once
+ * the consumer is done
+ *
+ * A display of the DRM page flip mode shares its scanout buffers instead,
+ * nothing is copied: slot_cnt is 0 and the dmabuf_cnt DMA-BUFs follow the
+ * memfd in the same message. slot is then the index of the DMA-BUF
+ * holding the latest frame, LVGL renders into it again once the frame
+ * frame + 1 was flipped
+ */
+
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define FRAME_EXPORT_MAGIC 0x5846564cU      /* "LVFX" */
+#define FRAME_EXPORT_VERSION 2
+
+/* Number of frame slots, the consumers read one while the next is written */
+#define FRAME_EXPORT_SLOTS 3
+
+#define FRAME_EXPORT_MAX_RECTS 16
+
+#define FRAME_EXPORT_MAX_DMABUFS 2
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* A rectangle, the coordinates are inclusive */
+typedef struct {
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+} frame_export_rect_t;
+
+/* Start of the shared memory, the slots follow at page aligned offsets */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;        /* Bytes per line of a slot or a DMA-BUF */
+    uint32_t cf;            /* lv_color_format_t of the pixels */
+    uint32_t slot_cnt;      /* 0 if the frames are in DMA-BUFs */
+    uint32_t slot_size;
+    uint64_t slot_offset[FRAME_EXPORT_SLOTS];
+    uint32_t dmabuf_cnt;
+    uint32_t dmabuf_fourcc; /* DRM_FORMAT_* of the DMA-BUFs */
+    uint64_t dmabuf_modifier;
+
+    /* Odd while the fields below are updated */
+    uint32_t seq;
+    uint32_t slot;          /* Slot or DMA-BUF of the latest frame */
+    uint64_t frame;         /* Number of the latest frame, 0 until the first one */
+    uint64_t time_us;       /* CLOCK_MONOTONIC time of the end of the frame */
+    uint32_t rect_cnt;
+    frame_export_rect_t rects[FRAME_EXPORT_MAX_RECTS];
+} frame_export_header_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Export the frames of a display
+ * @description the flush callback of the display is wrapped, call after
+ * the backend set it up. Displays rotated by LVGL are not supported
+ * @param disp the display
+ * @param socket_path where the consumers connect, NULL to do nothing
+ * @return 0 on success or if disabled, -1 on error
+ */
+int frame_export_attach(lv_display_t *disp, const char *socket_path);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FRAME_EXPORT_H*/
@@ -0,0 +1,317 @@
+/**
+ * @file frame_governor.c
+ *
+ * Adaptive refresh rate and display blanking
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+
+#include "simulator_util.h"
+#include "backends.h"
+#include "frame_governor.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Period of the evaluation of the idle time */
+#define FRAME_GOVERNOR_TICK_MS 200
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_display_t *disp;
+    lv_timer_t *refr_timer;
+    lv_timer_t *tick_timer;
+    frame_governor_blank_cb_t blank_cb;
+    uint32_t full_period;   /* Period of the refresh timer when active */
+    uint32_t idle_period;   /* Period of the refresh timer when idle */
+    uint32_t idle_ms;       /* Time without input before slowing down */
+    uint32_t blank_ms;      /* Time without input before blanking, 0 to never blank */
+    uint32_t period;        /* Current period of the refresh timer */
+    const char *backlight;  /* Backlight sysfs directory, i.e /sys/class/backlight/backlight */
+    bool dirty;             /* Invalidated since the start of the last refresh */
+    bool blanked;
+} governor_ctx_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static governor_ctx_t *get_ctx(lv_display_t *disp, bool create);
+static bool is_active(governor_ctx_t *ctx);
+static void set_period(governor_ctx_t *ctx, uint32_t period);
+static void set_blank(governor_ctx_t *ctx, bool blank);
+static void tick_timer_cb(lv_timer_t *timer);
+static void display_event_cb(lv_event_t *e);
+static void delete_event_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static governor_ctx_t contexts[BACKEND_MAX_DISPLAYS];
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void frame_governor_attach(lv_display_t *disp)
+{
+    governor_ctx_t *ctx;
+
+    if (backend_getenv("LV_SIM_REFR_GOVERNOR", "0")[0] != '1') {
+        return;
+    }
+
+    ctx = get_ctx(disp, true);
+    if (ctx == NULL || ctx->tick_timer != NULL) {
+        return;
+    }
+
+    ctx->refr_timer = lv_display_get_refr_timer(disp);
+    if (ctx->refr_timer == NULL) {
+        LV_LOG_WARN("The display has no refresh timer");
+        return;
+    }
+
+    ctx->full_period = lv_timer_get_period(ctx->refr_timer);
+    ctx->idle_period = atoi(backend_getenv("LV_SIM_REFR_IDLE_PERIOD", "100"));
+    ctx->idle_ms = atoi(backend_getenv("LV_SIM_REFR_IDLE_MS", "3000"));
+    ctx->blank_ms = atoi(backend_getenv("LV_SIM_BLANK_MS", "0"));
+    ctx->backlight = backend_getenv("LV_SIM_BACKLIGHT", NULL);
+    ctx->period = ctx->full_period;
+    ctx->dirty = true;
+
+    if (ctx->idle_period < ctx->full_period) {
+        ctx->idle_period = ctx->full_period;
+    }
+
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_INVALIDATE_AREA, ctx);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_REFR_START, ctx);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_REFR_READY, ctx);
+
+    ctx->tick_timer = lv_timer_create(tick_timer_cb, FRAME_GOVERNOR_TICK_MS, ctx);
+
+    LV_LOG_USER("Refresh governor: %u ms active, %u ms after %u ms idle, blank after %u ms",
+                ctx->full_period, ctx->idle_period, ctx->idle_ms, ctx->blank_ms);
+}
+
+void frame_governor_set_blank_cb(lv_display_t *disp, frame_governor_blank_cb_t cb)
+{
+    governor_ctx_t *ctx = get_ctx(disp, true);
+
+    if (ctx != NULL) {
+        ctx->blank_cb = cb;
+    }
+}
+
+void frame_governor_resume(lv_display_t *disp)
+{
+    governor_ctx_t *ctx = get_ctx(disp, false);
+    lv_timer_t *refr_timer = lv_display_get_refr_timer(disp);
+
+    /* The governor pauses the timer itself, an empty refresh would follow */
+    if (ctx != NULL && ctx->tick_timer != NULL && (!ctx->dirty || ctx->blanked)) {
+        return;
+    }
+
+    lv_timer_resume(refr_timer);
+    lv_timer_ready(refr_timer);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the state of a display
+ *
+ * @param disp the display
+ * @param create allocate a slot if the display has none
+ * @return the state or NULL
+ */
+static governor_ctx_t *get_ctx(lv_display_t *disp, bool create)
+{
+    int i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (contexts[i].disp == disp) {
+            return &contexts[i];
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (contexts[i].disp == NULL) {
+            contexts[i].disp = disp;
+
+            /* The slot is released with the display, i.e when the backend is re-initialized */
+            lv_display_add_event_cb(disp, delete_event_cb, LV_EVENT_DELETE, &contexts[i]);
+            return &contexts[i];
+        }
+    }
+
+    LV_LOG_WARN("Too many displays");
+    return NULL;
+}
+
+/**
+ * Check whether the display needs the full refresh rate
+ *
+ * @param ctx the governor state
+ * @return true during animations or while the user interacts
+ */
+static bool is_active(governor_ctx_t *ctx)
+{
+    return lv_anim_count_running() > 0 ||
+           lv_display_get_inactive_time(ctx->disp) < ctx->idle_ms;
+}
+
+/**
+ * Change the period of the refresh timer
+ */
+static void set_period(governor_ctx_t *ctx, uint32_t period)
+{
+    if (period != ctx->period) {
+        ctx->period = period;
+        lv_timer_set_period(ctx->refr_timer, period);
+    }
+}
+
+/**
+ * Blank or unblank the display
+ *
+ * @param ctx the governor state
+ * @param blank true to turn the display off
+ */
+static void set_blank(governor_ctx_t *ctx, bool blank)
+{
+    char path[256];
+    FILE *f;
+
+    ctx->blanked = blank;
+
+    if (ctx->blank_cb != NULL && ctx->blank_cb(ctx->disp, blank) < 0) {
+        LV_LOG_WARN("Failed to %s the display", blank ? "blank" : "unblank");
+    }
+
+    if (ctx->backlight != NULL) {
+        /* Takes the FB_BLANK_* values, 4 is FB_BLANK_POWERDOWN */
+        snprintf(path, sizeof(path), "%s/bl_power", ctx->backlight);
+        f = fopen(path, "w");
+
+        if (f == NULL) {
+            LV_LOG_WARN("Failed to open %s", path);
+        } else {
+            fputs(blank ? "4" : "0", f);
+            fclose(f);
+        }
+    }
+
+    if (blank) {
+        /* Nothing is rendered while blanked */
+        lv_timer_pause(ctx->refr_timer);
+    } else {
+        /* Show the changes made while blanked right away */
+        lv_timer_resume(ctx->refr_timer);
+        lv_timer_ready(ctx->refr_timer);
+    }
+
+    LV_LOG_INFO("Display %s", blank ? "blanked" : "unblanked");
+}
+
+/**
+ * Adjust the refresh rate to the activity
+ *
+ * @description the period doubles on each tick once the display is idle
+ * @param timer the governor timer
+ */
+static void tick_timer_cb(lv_timer_t *timer)
+{
+    governor_ctx_t *ctx = lv_timer_get_user_data(timer);
+    uint32_t inactive = lv_display_get_inactive_time(ctx->disp);
+
+    if (ctx->blank_ms > 0 && (inactive >= ctx->blank_ms) != ctx->blanked) {
+        set_blank(ctx, !ctx->blanked);
+    }
+
+    if (is_active(ctx)) {
+        set_period(ctx, ctx->full_period);
+    } else if (ctx->period < ctx->idle_period) {
+        set_period(ctx, LV_MIN(ctx->period * 2, ctx->idle_period));
+    }
+}
+
+/**
+ * Pause the refresh timer while nothing is invalidated
+ *
+ * @param e the display event
+ */
+static void display_event_cb(lv_event_t *e)
+{
+    governor_ctx_t *ctx = lv_event_get_user_data(e);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_INVALIDATE_AREA:
+        ctx->dirty = true;
+
+        /* Input causes invalidations, don't wait for the next tick to speed up */
+        if (ctx->period != ctx->full_period && is_active(ctx)) {
+            set_period(ctx, ctx->full_period);
+        }
+
+        if (!ctx->blanked) {
+            lv_timer_resume(ctx->refr_timer);
+        }
+        break;
+
+    case LV_EVENT_REFR_START:
+        /* The invalidated areas are rendered by this refresh */
+        ctx->dirty = false;
+        break;
+
+    case LV_EVENT_REFR_READY:
+        if (!ctx->dirty) {
+            lv_timer_pause(ctx->refr_timer);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Release the state of a deleted display
+ *
+ * @param e the delete event of the display
+ */
+static void delete_event_cb(lv_event_t *e)
+{
+    governor_ctx_t *ctx = lv_event_get_user_data(e);
+
+    if (ctx->tick_timer != NULL) {
+        lv_timer_delete(ctx->tick_timer);
+    }
+
+    memset(ctx, 0, sizeof(governor_ctx_t));
+}
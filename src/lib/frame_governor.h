@@ -0,0 +1,83 @@
+/**
+ * @file frame_governor.h
+ *
+ * Adaptive refresh rate and display blanking
+ *
+ * Enabled with LV_SIM_REFR_GOVERNOR=1, the refresh timer of the display is:
+ *
+ * - paused while nothing is invalidated, the run loop then only wakes
+ *   up for input events and the other LVGL timers
+ * - run at the full rate (LV_DEF_REFR_PERIOD) during animations and
+ *   while the user interacts with the display
+ * - slowed down progressively to LV_SIM_REFR_IDLE_PERIOD once there was
+ *   no input for LV_SIM_REFR_IDLE_MS
+ *
+ * After LV_SIM_BLANK_MS without input the display is blanked, through
+ * the callback of the backend (DPMS, FBIOBLANK) and/or the backlight
+ * set with LV_SIM_BACKLIGHT, and unblanked on the next input.
+ * The variables are read per display, see backend_getenv
+ */
+
+#ifndef FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Turns the display off (blank = true) or back on, returns 0 on success */
+typedef int (*frame_governor_blank_cb_t)(lv_display_t *disp, bool blank);
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Govern the refresh rate of a display
+ * @description does nothing unless LV_SIM_REFR_GOVERNOR is set to 1, must be
+ * called while the display is initialized so that its settings are read
+ * @param disp the display
+ */
+void frame_governor_attach(lv_display_t *disp);
+
+/**
+ * @brief Set the blanking callback of a display
+ * @description called by the display backends, before or after frame_governor_attach
+ * @param disp the display
+ * @param cb the callback
+ */
+void frame_governor_set_blank_cb(lv_display_t *disp, frame_governor_blank_cb_t cb);
+
+/**
+ * @brief Resume the refresh timer paused by a display backend
+ * @description i.e once a page flip completed, the next refresh starts
+ * right away. If governed, the timer stays paused while nothing is
+ * invalidated or the display is blanked
+ * @param disp the display
+ */
+void frame_governor_resume(lv_display_t *disp);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FRAME_GOVERNOR_H*/
@@ -0,0 +1,388 @@
+/**
+ * @file frame_stats.c
+ *
+ * Frame time and flush latency instrumentation
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "lvgl/lvgl.h"
+
+#include "simulator_util.h"
+#include "frame_stats.h"
+#include "slab_alloc.h"
+#include "image_cache.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Size of the stdio buffer of the trace file */
+#define FRAME_STATS_TRACE_BUF_SIZE (64 * 1024)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint32_t buckets[FRAME_STATS_BUCKET_CNT];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} histogram_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void display_event_cb(lv_event_t *e);
+static void print_timer_cb(lv_timer_t *timer);
+static void histogram_add(histogram_t *h, uint32_t v);
+static uint32_t histogram_percentile(const histogram_t *h, uint32_t percent);
+static void trace_event(frame_stats_metric_t metric, uint64_t start_us, uint64_t dur_us);
+static void trace_close(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const char *metric_names[FRAME_STATS_METRIC_CNT] = {
+    "frame",
+    "render",
+    "flush",
+    "idle",
+    "timer",
+    "input_latency"
+};
+
+static histogram_t histograms[FRAME_STATS_METRIC_CNT];
+
+/* State of the frame being rendered */
+static uint64_t frame_start;
+static uint64_t flush_start;
+static uint64_t flush_time;
+
+/* Time of the oldest input event not yet followed by a frame, 0 if none */
+static uint64_t pending_input;
+
+static FILE *trace_file;
+static uint64_t trace_origin;
+static bool trace_first;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void frame_stats_init(void)
+{
+    const char *path = getenv("LV_SIM_STATS_TRACE");
+    uint32_t interval = atoi(getenv_default("LV_SIM_STATS_INTERVAL", "0"));
+    static bool initialized;
+
+    if (initialized) {
+        return;
+    }
+
+    initialized = true;
+    frame_stats_reset();
+
+    if (interval > 0) {
+        lv_timer_create(print_timer_cb, interval, NULL);
+    }
+
+    if (path == NULL) {
+        return;
+    }
+
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL) {
+        LV_LOG_ERROR("Failed to open the trace file %s: %s", path, strerror(errno));
+        return;
+    }
+
+    setvbuf(trace_file, NULL, _IOFBF, FRAME_STATS_TRACE_BUF_SIZE);
+
+    /* The closing bracket is optional in the trace event format,
+     * the trace remains valid if the process is killed */
+    fputs("[\n", trace_file);
+    trace_origin = frame_stats_now_us();
+    trace_first = true;
+    atexit(trace_close);
+
+    LV_LOG_USER("Writing a Chrome trace to %s", path);
+}
+
+void frame_stats_attach(lv_display_t *disp)
+{
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_READY, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_FINISH, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_WAIT_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_FLUSH_WAIT_FINISH, NULL);
+}
+
+uint64_t frame_stats_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void frame_stats_record(frame_stats_metric_t metric, uint64_t start_us, uint64_t end_us)
+{
+    uint64_t dur = end_us > start_us ? end_us - start_us : 0;
+
+    histogram_add(&histograms[metric], dur > UINT32_MAX ? UINT32_MAX : (uint32_t)dur);
+
+    if (trace_file != NULL) {
+        trace_event(metric, start_us, dur);
+    }
+}
+
+void frame_stats_input(uint64_t timestamp_us)
+{
+    if (pending_input == 0 || timestamp_us < pending_input) {
+        pending_input = timestamp_us;
+    }
+}
+
+void frame_stats_get(frame_stats_metric_t metric, frame_stats_summary_t *summary)
+{
+    const histogram_t *h = &histograms[metric];
+
+    memset(summary, 0, sizeof(frame_stats_summary_t));
+
+    if (h->count == 0) {
+        return;
+    }
+
+    summary->count = h->count;
+    summary->min_us = h->min;
+    summary->max_us = h->max;
+    summary->avg_us = (uint32_t)(h->sum / h->count);
+    summary->p50_us = histogram_percentile(h, 50);
+    summary->p90_us = histogram_percentile(h, 90);
+    summary->p99_us = histogram_percentile(h, 99);
+}
+
+const char *frame_stats_metric_name(frame_stats_metric_t metric)
+{
+    return metric < FRAME_STATS_METRIC_CNT ? metric_names[metric] : "unknown";
+}
+
+void frame_stats_print(void)
+{
+    frame_stats_summary_t s;
+    int i;
+
+    fprintf(stdout, "frame_stats frames=%u", histograms[FRAME_STATS_FRAME].count);
+
+    for (i = 0; i < FRAME_STATS_METRIC_CNT; i++) {
+        frame_stats_get(i, &s);
+        fprintf(stdout, " %s_avg=%u %s_p50=%u %s_p99=%u %s_max=%u",
+                metric_names[i], s.avg_us, metric_names[i], s.p50_us,
+                metric_names[i], s.p99_us, metric_names[i], s.max_us);
+    }
+
+    fprintf(stdout, "\n");
+    fflush(stdout);
+}
+
+void frame_stats_reset(void)
+{
+    int i;
+
+    memset(histograms, 0, sizeof(histograms));
+
+    for (i = 0; i < FRAME_STATS_METRIC_CNT; i++) {
+        histograms[i].min = UINT32_MAX;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Track the stages of a frame
+ *
+ * @description in partial render mode the areas are rendered and flushed
+ * one after the other between RENDER_START and RENDER_READY, the flush
+ * time is accumulated and subtracted from the frame time
+ * @param e the display event
+ */
+static void display_event_cb(lv_event_t *e)
+{
+    uint64_t now = frame_stats_now_us();
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_RENDER_START:
+        frame_start = now;
+        flush_time = 0;
+        break;
+
+    case LV_EVENT_FLUSH_START:
+    case LV_EVENT_FLUSH_WAIT_START:
+        flush_start = now;
+        break;
+
+    case LV_EVENT_FLUSH_FINISH:
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        if (flush_start != 0) {
+            flush_time += now - flush_start;
+
+            if (trace_file != NULL) {
+                trace_event(FRAME_STATS_FLUSH, flush_start, now - flush_start);
+            }
+
+            flush_start = 0;
+        }
+        break;
+
+    case LV_EVENT_RENDER_READY:
+        if (frame_start == 0) {
+            break;
+        }
+
+        /* The flushes were traced individually */
+        histogram_add(&histograms[FRAME_STATS_FLUSH], (uint32_t)flush_time);
+        histogram_add(&histograms[FRAME_STATS_RENDER], (uint32_t)(now - frame_start - flush_time));
+        frame_stats_record(FRAME_STATS_FRAME, frame_start, now);
+
+        if (pending_input != 0) {
+            frame_stats_record(FRAME_STATS_INPUT_LATENCY, pending_input, now);
+            pending_input = 0;
+        }
+
+        frame_start = 0;
+
+        if (trace_file != NULL) {
+            fflush(trace_file);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Print and clear the statistics of the last interval
+ *
+ * @param timer the LVGL timer
+ */
+static void print_timer_cb(lv_timer_t *timer)
+{
+    LV_UNUSED(timer);
+
+    frame_stats_print();
+    frame_stats_reset();
+    image_cache_print();
+
+    /* Only prints if the slab allocator is enabled */
+    slab_alloc_print();
+}
+
+/**
+ * Add a value to a histogram
+ *
+ * @description bucket 0 holds 0, bucket n holds [2^(n-1), 2^n)
+ * @param h the histogram
+ * @param v the value in microseconds
+ */
+static void histogram_add(histogram_t *h, uint32_t v)
+{
+    uint32_t idx = v == 0 ? 0 : 32 - __builtin_clz(v);
+
+    if (idx >= FRAME_STATS_BUCKET_CNT) {
+        idx = FRAME_STATS_BUCKET_CNT - 1;
+    }
+
+    h->buckets[idx]++;
+    h->count++;
+    h->sum += v;
+
+    if (v < h->min) {
+        h->min = v;
+    }
+
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/**
+ * Estimate a percentile
+ *
+ * @param h the histogram
+ * @param percent the percentile
+ * @return the upper bound of the bucket holding the percentile, at most the maximum
+ */
+static uint32_t histogram_percentile(const histogram_t *h, uint32_t percent)
+{
+    uint64_t rank = ((uint64_t)h->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    uint32_t bound;
+    int i;
+
+    for (i = 0; i < FRAME_STATS_BUCKET_CNT; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            bound = (uint32_t)((1ULL << i) - 1);
+            return bound < h->max ? bound : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+/**
+ * Append a complete event to the trace file
+ *
+ * @param metric the stage
+ * @param start_us the start time
+ * @param dur_us the duration
+ */
+static void trace_event(frame_stats_metric_t metric, uint64_t start_us, uint64_t dur_us)
+{
+    /* The frames are nested in the timer handler, the latencies overlap them */
+    int tid = metric == FRAME_STATS_INPUT_LATENCY ? 2 : 1;
+
+    fprintf(trace_file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%llu,\"dur\":%llu}",
+            trace_first ? "" : ",\n", metric_names[metric], tid,
+            (unsigned long long)(start_us > trace_origin ? start_us - trace_origin : 0),
+            (unsigned long long)dur_us);
+
+    trace_first = false;
+}
+
+/**
+ * Terminate the trace file
+ */
+static void trace_close(void)
+{
+    if (trace_file == NULL) {
+        return;
+    }
+
+    fputs("\n]\n", trace_file);
+    fclose(trace_file);
+    trace_file = NULL;
+}
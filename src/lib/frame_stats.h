@@ -0,0 +1,133 @@
+/**
+ * @file frame_stats.h
+ *
+ * Frame time and flush latency instrumentation
+ *
+ * The durations of each stage of a frame are collected in histograms
+ * without drawing anything on the display. The statistics can be
+ * queried, printed periodically as a key=value line by setting
+ * LV_SIM_STATS_INTERVAL (ms), or streamed to a Chrome trace file
+ * (chrome://tracing or ui.perfetto.dev) by setting LV_SIM_STATS_TRACE
+ */
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of power of two buckets of the histograms, the last one holds everything above 4s */
+#define FRAME_STATS_BUCKET_CNT 24
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef enum {
+    FRAME_STATS_FRAME,          /* Start of the rendering to the end of the last flush */
+    FRAME_STATS_RENDER,         /* Frame time minus the flush time */
+    FRAME_STATS_FLUSH,          /* Time spent in the flush callback and waiting for the flush */
+    FRAME_STATS_IDLE,           /* Time spent sleeping in the run loop */
+    FRAME_STATS_TIMER,          /* Duration of a call to the LVGL timer handler */
+    FRAME_STATS_INPUT_LATENCY,  /* Input event to the end of the next frame */
+    FRAME_STATS_METRIC_CNT
+} frame_stats_metric_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t p50_us;    /* The percentiles are the upper bound of the bucket */
+    uint32_t p90_us;
+    uint32_t p99_us;
+} frame_stats_summary_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Initialize the instrumentation
+ * @description reads LV_SIM_STATS_INTERVAL and LV_SIM_STATS_TRACE,
+ * must be called after lv_init
+ */
+void frame_stats_init(void);
+
+/**
+ * @brief Collect the frame statistics of a display
+ * @param disp the display
+ */
+void frame_stats_attach(lv_display_t *disp);
+
+/**
+ * @brief Get the current time
+ * @return the CLOCK_MONOTONIC time in microseconds
+ */
+uint64_t frame_stats_now_us(void);
+
+/**
+ * @brief Record the duration of a stage
+ * @param metric the stage
+ * @param start_us the start time returned by frame_stats_now_us
+ * @param end_us the end time returned by frame_stats_now_us
+ */
+void frame_stats_record(frame_stats_metric_t metric, uint64_t start_us, uint64_t end_us);
+
+/**
+ * @brief Signal an input event
+ * @description the latency is measured from the first input event
+ * to the end of the next rendered frame
+ * @param timestamp_us the CLOCK_MONOTONIC time of the event in microseconds
+ */
+void frame_stats_input(uint64_t timestamp_us);
+
+/**
+ * @brief Get the summary of a metric
+ * @param metric the metric
+ * @param summary where to store the summary
+ */
+void frame_stats_get(frame_stats_metric_t metric, frame_stats_summary_t *summary);
+
+/**
+ * @brief Get the name of a metric
+ * @param metric the metric
+ * @return the name i.e "render"
+ */
+const char *frame_stats_metric_name(frame_stats_metric_t metric);
+
+/**
+ * @brief Print the statistics on stdout
+ * @description one line of space separated key=value pairs
+ * i.e "frame_stats frames=60 render_avg=2100 render_p99=4095 ..."
+ * in microseconds
+ */
+void frame_stats_print(void);
+
+/**
+ * @brief Clear the collected statistics
+ */
+void frame_stats_reset(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*FRAME_STATS_H*/
@@ -0,0 +1,415 @@
+/**
+ * @file image_cache.c
+ *
+ * Configuration, prewarming and counters of the LVGL image cache
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/core/lv_global.h"
+#include "lvgl/src/misc/cache/lv_cache_private.h"
+
+#include "simulator_util.h"
+#include "image_cache.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct image_cache_item {
+    struct image_cache_item *next;
+    char *src;
+    bool pin;
+    lv_image_decoder_dsc_t dsc;     /* Kept open while the image is pinned */
+} image_cache_item_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void queue_list(const char *list, bool pin);
+static image_cache_item_t *queue_pop(void);
+static void prewarm_item(image_cache_item_t *item);
+#if LV_USE_OS == LV_OS_NONE
+static void prewarm_timer_cb(lv_timer_t *timer);
+#else
+static void *prewarm_thread(void *arg);
+#endif
+static lv_cache_entry_t *counting_get_cb(lv_cache_t *cache, const void *key, void *user_data);
+static lv_cache_entry_t *counting_get_victim_cb(lv_cache_t *cache, void *user_data);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* Protects the queue, the pinned list and the prewarm counters */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static image_cache_item_t *queue_head;
+static image_cache_item_t *queue_tail;
+static image_cache_item_t *pinned;
+static bool prewarm_running;
+
+/* The lists are queued once, by the first display */
+static bool lists_queued;
+
+static image_cache_stats_t stats;
+
+/* The class of the LVGL image cache, wrapped to count the lookups */
+static const lv_cache_class_t *image_cache_class;
+static lv_cache_class_t counting_class;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void image_cache_init(void)
+{
+    lv_cache_t *cache = LV_GLOBAL_DEFAULT()->img_cache;
+    uint32_t size = parse_size(getenv_default("LV_SIM_IMAGE_CACHE_SIZE", "4M"));
+    uint32_t header_cnt = atoi(getenv_default("LV_SIM_IMAGE_HEADER_CACHE_CNT", "32"));
+
+    lv_image_cache_resize(size, true);
+    lv_image_header_cache_resize(header_cnt, true);
+
+    if (cache != NULL && image_cache_class == NULL) {
+        /* Lookups and evictions are called with the lock of the cache held */
+        image_cache_class = cache->clz;
+        counting_class = *cache->clz;
+        counting_class.get_cb = counting_get_cb;
+        counting_class.get_victim_cb = counting_get_victim_cb;
+        cache->clz = &counting_class;
+    }
+
+    LV_LOG_INFO("Image cache of %u bytes, %u image headers", size, header_cnt);
+}
+
+void image_cache_start_prewarm(void)
+{
+    if (lists_queued) {
+        return;
+    }
+
+    lists_queued = true;
+    queue_list(getenv("LV_SIM_IMAGE_PIN"), true);
+    queue_list(getenv("LV_SIM_IMAGE_PREWARM"), false);
+}
+
+int image_cache_prewarm(const char *const *srcs, int cnt, bool pin)
+{
+    image_cache_item_t *item;
+    bool start;
+    int i;
+#if LV_USE_OS != LV_OS_NONE
+    pthread_t thread;
+#endif
+
+    if (cnt <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0; i < cnt; i++) {
+        item = calloc(1, sizeof(image_cache_item_t));
+        if (item == NULL || (item->src = strdup(srcs[i])) == NULL) {
+            free(item);
+            pthread_mutex_unlock(&lock);
+            return -1;
+        }
+
+        item->pin = pin;
+
+        if (queue_tail != NULL) {
+            queue_tail->next = item;
+        } else {
+            queue_head = item;
+        }
+
+        queue_tail = item;
+        stats.pending++;
+    }
+
+    start = !prewarm_running;
+    prewarm_running = true;
+
+    pthread_mutex_unlock(&lock);
+
+    if (!start) {
+        return 0;
+    }
+
+#if LV_USE_OS == LV_OS_NONE
+    /* Without an OS the decoders can only be used by the LVGL thread */
+    lv_timer_create(prewarm_timer_cb, 0, NULL);
+#else
+    if (pthread_create(&thread, NULL, prewarm_thread, NULL) != 0) {
+        LV_LOG_ERROR("Failed to create the image prewarm thread");
+        pthread_mutex_lock(&lock);
+        prewarm_running = false;
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+
+    pthread_detach(thread);
+#endif
+
+    return 0;
+}
+
+void image_cache_unpin_all(void)
+{
+    image_cache_item_t *item;
+
+    pthread_mutex_lock(&lock);
+    item = pinned;
+    pinned = NULL;
+    stats.pinned = 0;
+    pthread_mutex_unlock(&lock);
+
+    lv_lock();
+
+    while (item != NULL) {
+        image_cache_item_t *next = item->next;
+
+        lv_image_decoder_close(&item->dsc);
+        free(item->src);
+        free(item);
+        item = next;
+    }
+
+    lv_unlock();
+}
+
+void image_cache_get_stats(image_cache_stats_t *s)
+{
+    lv_cache_t *cache = LV_GLOBAL_DEFAULT()->img_cache;
+
+    memset(s, 0, sizeof(*s));
+
+    /* Counted by the draw threads under the lock of the LVGL cache */
+    s->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    s->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    s->evictions = __atomic_load_n(&stats.evictions, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&lock);
+    s->pinned = stats.pinned;
+    s->prewarmed = stats.prewarmed;
+    s->pending = stats.pending;
+    s->failed = stats.failed;
+    pthread_mutex_unlock(&lock);
+
+    if (cache != NULL) {
+        s->size = lv_cache_get_size(cache, NULL);
+        s->max_size = lv_cache_get_max_size(cache, NULL);
+    }
+}
+
+void image_cache_print(void)
+{
+    image_cache_stats_t s;
+
+    image_cache_get_stats(&s);
+
+    fprintf(stdout, "image_cache hits=%llu misses=%llu evictions=%llu size=%u max_size=%u "
+            "pinned=%u prewarmed=%u pending=%u failed=%u\n",
+            (unsigned long long)s.hits, (unsigned long long)s.misses,
+            (unsigned long long)s.evictions, s.size, s.max_size,
+            s.pinned, s.prewarmed, s.pending, s.failed);
+    fflush(stdout);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Queue a comma separated list of images
+ *
+ * @param list the list, can be NULL
+ * @param pin pin the images
+ */
+static void queue_list(const char *list, bool pin)
+{
+    char *copy;
+    char *saveptr;
+    char *src;
+
+    if (list == NULL || (copy = strdup(list)) == NULL) {
+        return;
+    }
+
+    for (src = strtok_r(copy, ",", &saveptr); src != NULL; src = strtok_r(NULL, ",", &saveptr)) {
+        if (image_cache_prewarm((const char *const *)&src, 1, pin) < 0) {
+            LV_LOG_ERROR("Failed to queue %s", src);
+        }
+    }
+
+    free(copy);
+}
+
+/**
+ * Take the next image to prewarm
+ *
+ * @description clears prewarm_running when the queue is empty
+ * @return the image or NULL
+ */
+static image_cache_item_t *queue_pop(void)
+{
+    image_cache_item_t *item;
+
+    pthread_mutex_lock(&lock);
+
+    item = queue_head;
+    if (item != NULL) {
+        queue_head = item->next;
+        if (queue_head == NULL) {
+            queue_tail = NULL;
+        }
+        item->next = NULL;
+    } else {
+        prewarm_running = false;
+    }
+
+    pthread_mutex_unlock(&lock);
+    return item;
+}
+
+/**
+ * Decode an image into the cache
+ *
+ * @param item the image, released unless it is pinned
+ */
+static void prewarm_item(image_cache_item_t *item)
+{
+    lv_result_t res;
+
+    lv_lock();
+
+    res = lv_image_decoder_open(&item->dsc, item->src, NULL);
+    if (res == LV_RESULT_OK && !item->pin) {
+        /* The decoded image stays in the cache */
+        lv_image_decoder_close(&item->dsc);
+    }
+
+    lv_unlock();
+
+    pthread_mutex_lock(&lock);
+
+    stats.pending--;
+
+    if (res != LV_RESULT_OK) {
+        LV_LOG_WARN("Failed to decode %s", item->src);
+        stats.failed++;
+    } else {
+        stats.prewarmed++;
+    }
+
+    if (res == LV_RESULT_OK && item->pin) {
+        item->next = pinned;
+        pinned = item;
+        stats.pinned++;
+        item = NULL;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    if (item != NULL) {
+        free(item->src);
+        free(item);
+    }
+}
+
+#if LV_USE_OS == LV_OS_NONE
+
+/**
+ * Prewarm one image per timer period
+ *
+ * @param timer the LVGL timer, deleted once the queue is empty
+ */
+static void prewarm_timer_cb(lv_timer_t *timer)
+{
+    image_cache_item_t *item = queue_pop();
+
+    if (item == NULL) {
+        lv_timer_delete(timer);
+        return;
+    }
+
+    prewarm_item(item);
+}
+
+#else
+
+/**
+ * Prewarm the queued images
+ *
+ * @description the LVGL lock is only held while an image is decoded,
+ * rendering continues in between
+ * @param arg unused
+ * @return NULL
+ */
+static void *prewarm_thread(void *arg)
+{
+    image_cache_item_t *item;
+    uint32_t start = lv_tick_get();
+
+    LV_UNUSED(arg);
+
+    while ((item = queue_pop()) != NULL) {
+        prewarm_item(item);
+    }
+
+    LV_LOG_INFO("Image prewarm done in %u ms", lv_tick_elaps(start));
+    return NULL;
+}
+
+#endif /*LV_USE_OS == LV_OS_NONE*/
+
+/**
+ * Count the lookups of the image cache
+ */
+static lv_cache_entry_t *counting_get_cb(lv_cache_t *cache, const void *key, void *user_data)
+{
+    lv_cache_entry_t *entry = image_cache_class->get_cb(cache, key, user_data);
+
+    /* Under the lock of the LVGL cache, not the one of the module */
+    if (entry != NULL) {
+        __atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+    }
+
+    return entry;
+}
+
+/**
+ * Count the evictions of the image cache
+ */
+static lv_cache_entry_t *counting_get_victim_cb(lv_cache_t *cache, void *user_data)
+{
+    lv_cache_entry_t *entry = image_cache_class->get_victim_cb(cache, user_data);
+
+    if (entry != NULL) {
+        __atomic_fetch_add(&stats.evictions, 1, __ATOMIC_RELAXED);
+    }
+
+    return entry;
+}
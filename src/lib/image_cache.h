@@ -0,0 +1,101 @@
+/**
+ * @file image_cache.h
+ *
+ * Configuration, prewarming and counters of the LVGL image cache
+ *
+ * The decoded images are kept in the LRU image cache of LVGL, bounded
+ * by a byte budget set with LV_SIM_IMAGE_CACHE_SIZE. The images listed
+ * in LV_SIM_IMAGE_PREWARM are decoded in the background when the
+ * display backend is initialized, the ones of LV_SIM_IMAGE_PIN are
+ * also kept open so that they are never evicted
+ */
+
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint64_t hits;          /* Lookups served by the cache */
+    uint64_t misses;        /* Lookups that required a decode */
+    uint64_t evictions;
+    uint32_t size;          /* Bytes of decoded images in the cache */
+    uint32_t max_size;      /* The budget */
+    uint32_t pinned;
+    uint32_t prewarmed;     /* Images decoded ahead of time */
+    uint32_t pending;       /* Images waiting to be prewarmed */
+    uint32_t failed;        /* Images that could not be decoded */
+} image_cache_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Configure the image cache
+ * @description must be called after lv_init, the budget is set with
+ * LV_SIM_IMAGE_CACHE_SIZE in bytes, with an optional K or M suffix,
+ * and the number of cached image headers with LV_SIM_IMAGE_HEADER_CACHE_CNT
+ */
+void image_cache_init(void);
+
+/**
+ * @brief Queue the images of LV_SIM_IMAGE_PREWARM and LV_SIM_IMAGE_PIN
+ * @description comma separated LVGL paths, i.e "A:icons/wifi.png,A:icons/bt.png",
+ * only the first call queues them
+ */
+void image_cache_start_prewarm(void);
+
+/**
+ * @brief Decode images ahead of time
+ * @description the images are decoded by a background thread if LVGL
+ * is built with an OS, otherwise one image per LVGL timer period
+ * @param srcs the paths of the images, copied
+ * @param cnt the number of paths
+ * @param pin keep the images in the cache until image_cache_unpin_all is called
+ * @return 0 on success, -1 on error
+ */
+int image_cache_prewarm(const char *const *srcs, int cnt, bool pin);
+
+/**
+ * @brief Release the pinned images, they can be evicted again
+ */
+void image_cache_unpin_all(void);
+
+/**
+ * @brief Get the image cache counters
+ * @param stats where to store the counters
+ */
+void image_cache_get_stats(image_cache_stats_t *stats);
+
+/**
+ * @brief Print the image cache counters on stdout
+ * @description a single line of space separated key=value pairs
+ */
+void image_cache_print(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*IMAGE_CACHE_H*/
@@ -10,6 +10,14 @@
  *   compilation
  *   Author: EDGEMTech Ltd, Erik Tagirov (erik.tagirov@edgemtech.ch)
  *
+ * - Read the settings of the display the device is routed to,
+ *   LV_LINUX_EVDEV_POINTER_DEVICE_1 for the second display
+ *
+ * - Read the calibration from a file and filter the samples
+ *
+ * - Discover the device by its capabilities, cache the choice and
+ *   follow the hotplugs
+ *
  * Copyright (c) 2025 EDGEMTech Ltd.
  *
  */
@@ -18,35 +26,79 @@
  *      INCLUDES
  *********************/
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/ioctl.h>
+#include <limits.h>
 #include <linux/input.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/epoll.h>
 
 #include "lvgl/lvgl.h"
 #if LV_USE_EVDEV
 #include "lvgl/src/core/lv_global.h"
+#include "../simulator_util.h"
 #include "../backends.h"
+#include "../event_loop.h"
+#include "../evdev_thread.h"
+#include "../frame_stats.h"
+#include "../input_discovery.h"
+#include "../input_record.h"
+#include "../touch_filter.h"
 
 /*********************
  *      DEFINES
  *********************/
 
+/* Touch calibration for ADS7846, used without LV_LINUX_EVDEV_CALIBRATION */
+#define EVDEV_CAL_MIN_X 0
+#define EVDEV_CAL_MIN_Y 4095
+#define EVDEV_CAL_MAX_X 4095
+#define EVDEV_CAL_MAX_Y 0
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+/* A pointer device of a display, kept while the device is unplugged */
+typedef struct {
+    bool used;
+    bool unplugged;                 /* Set while the device is deleted on removal */
+    lv_indev_t *indev;              /* NULL while waiting for the device */
+    lv_display_t *display;
+    char device[PATH_MAX];          /* The configured device, empty if discovered */
+    char path[PATH_MAX];            /* Resolved path of the opened device */
+    bool threaded;
+    const char *record_file;
+    const char *calibration_file;
+} pointer_slot_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 
 static void indev_deleted_cb(lv_event_t *e);
-static void discovery_cb(lv_indev_t *indev, lv_evdev_type_t type, void *user_data);
 static void set_mouse_cursor_icon(lv_indev_t *indev, lv_display_t *display);
 static lv_indev_t *init_pointer_evdev(lv_display_t *display);
-static const char* find_touch_device_fallback(void);
+static lv_indev_t *create_pointer(pointer_slot_t *slot, const char *path,
+                                  input_discovery_class_t cls);
+static void release_slot(pointer_slot_t *slot);
+static void pointer_deleted_cb(lv_event_t *e);
+static void display_deleted_cb(lv_event_t *e);
+static void hotplug_cb(const char *path, bool added, void *user_data);
+static pointer_slot_t *find_waiting_slot(const char *path);
+static bool slot_is_waiting(const pointer_slot_t *slot);
+static bool slot_is_configured_with(const pointer_slot_t *slot, const char *path);
+static void watch_input_device(lv_indev_t *indev, const char *path);
+static void input_ready_cb(int fd, uint32_t events, void *user_data);
+static void unwatch_input_device_cb(lv_event_t *e);
+static void calibrate_pointer(lv_indev_t *indev, lv_display_t *display, bool threaded,
+                              const char *file, lv_point_t *min, lv_point_t *max);
+static void record_input_device(lv_indev_t *indev, const char *path, const char *file,
+                                const lv_point_t *min, const lv_point_t *max);
+static void stop_recording_cb(lv_event_t *e);
 
 /**********************
  *  STATIC VARIABLES
@@ -54,6 +106,9 @@ static const char* find_touch_device_fallback(void);
 
 static char *backend_name = "EVDEV";
 
+static pointer_slot_t pointers[BACKEND_MAX_DISPLAYS];
+static bool hotplug_watched;
+
 /**********************
  *      MACROS
  **********************/
@@ -100,32 +155,6 @@ static void indev_deleted_cb(lv_event_t *e)
 }
 
 
-/*
- * Set cursor icon
- *
- * @description Once the input device is discovered set the mouse cursor icon
- * @note called by the LVGL evdev driver
- * @param indev the input device
- * @param type the type of the input device
- * @param user_data the user data
- */
-#if LV_USE_EVEDV_DISCOVER
-static void discovery_cb(lv_indev_t *indev, lv_evdev_type_t type, void *user_data)
-{
-    LV_LOG_USER("new '%s' device discovered", type == LV_EVDEV_TYPE_REL ? "REL" :
-                                              type == LV_EVDEV_TYPE_ABS ? "ABS" :
-                                              type == LV_EVDEV_TYPE_KEY ? "KEY" :
-                                              "unknown");
-
-    lv_display_t *disp = user_data;
-    lv_indev_set_display(indev, disp);
-
-    if(type == LV_EVDEV_TYPE_REL) {
-        set_mouse_cursor_icon(indev, disp);
-    }
-}
-#endif
-
 /*
  * Set cursor icon
  *
@@ -146,40 +175,151 @@ static void set_mouse_cursor_icon(lv_indev_t *indev, lv_display_t *display)
 }
 
 /*
- * Fallback: Auto-detect touch device
+ * Wake up the run loop on input
  *
- * @description Searches for touch device if symlink not found
- * @return device path or NULL
+ * @description Opens a second file descriptor on the input device and
+ * registers it with the event loop, each opened fd receives a copy
+ * of the events, so the one of the LVGL evdev driver is left untouched
+ * @param indev the input device
+ * @param path the path of the input device
  */
-static const char* find_touch_device_fallback(void)
+static void watch_input_device(lv_indev_t *indev, const char *path)
 {
-    static char device_path[64];
-    char name[256];
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
 
-    LV_LOG_WARN("Touchscreen symlink not found, auto-detecting...");
+    if (fd < 0) {
+        LV_LOG_WARN("Unable to watch %s, input is polled", path);
+        return;
+    }
 
-    for (int i = 0; i < 32; i++) {
-        snprintf(device_path, sizeof(device_path), "/dev/input/event%d", i);
+    if (event_loop_add_fd(fd, EPOLLIN, input_ready_cb, indev) < 0) {
+        close(fd);
+        return;
+    }
 
-        int fd = open(device_path, O_RDONLY);
-        if (fd < 0) continue;
+    lv_indev_add_event_cb(indev, unwatch_input_device_cb, LV_EVENT_DELETE,
+                          (void *)(intptr_t)fd);
+}
 
-        if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) >= 0) {
-            // Search for ADS7846 or generic touch devices
-            if (strstr(name, "ADS7846") ||
-                strstr(name, "Touchscreen") ||
-                strstr(name, "Touch") ||
-                strstr(name, "touch")) {
-                LV_LOG_USER("Auto-detected: %s (%s)", device_path, name);
-                close(fd);
-                return device_path;
-            }
+/*
+ * Read the input device as soon as events are available
+ *
+ * @note called from the event loop
+ * @param fd the watched file descriptor
+ * @param events the epoll events
+ * @param user_data the input device
+ */
+static void input_ready_cb(int fd, uint32_t events, void *user_data)
+{
+    struct input_event in[16];
+
+    LV_UNUSED(events);
+
+    /* Only used as a notification - discard the events */
+    while (read(fd, in, sizeof(in)) > 0);
+
+    frame_stats_input(frame_stats_now_us());
+
+    lv_indev_read(user_data);
+}
+
+/*
+ * Stop watching the input device
+ *
+ * @param e the deletion event
+ */
+static void unwatch_input_device_cb(lv_event_t *e)
+{
+    int fd = (int)(intptr_t)lv_event_get_user_data(e);
+
+    event_loop_remove_fd(fd);
+    close(fd);
+}
+
+/*
+ * Calibrate a pointer device
+ *
+ * @description the matrix of the file set with LV_LINUX_EVDEV_CALIBRATION
+ * is used if set, i.e /etc/pointercal, otherwise the ADS7846 calibration.
+ * The LVGL evdev driver only maps ranges, a matrix with a rotation requires
+ * the threaded reader
+ * @param indev the input device
+ * @param display the display of the input device
+ * @param threaded true if the device was created by evdev_thread_create
+ * @param file the calibration file, NULL to use the ADS7846 calibration
+ * @param min where to store the raw coordinates mapped to the origin
+ * @param max where to store the raw coordinates mapped to the resolution
+ */
+static void calibrate_pointer(lv_indev_t *indev, lv_display_t *display, bool threaded,
+                              const char *file, lv_point_t *min, lv_point_t *max)
+{
+    touch_calibration_t cal;
+    bool swap_axes = false;
+
+    min->x = EVDEV_CAL_MIN_X;
+    min->y = EVDEV_CAL_MIN_Y;
+    max->x = EVDEV_CAL_MAX_X;
+    max->y = EVDEV_CAL_MAX_Y;
+
+    if (file != NULL && touch_calibration_load(file, &cal) == 0) {
+        if (threaded) {
+            evdev_thread_set_calibration_matrix(indev, &cal);
+            LV_LOG_USER("Calibrated with %s", file);
+            return;
+        }
+
+        if (touch_calibration_to_range(&cal, lv_display_get_horizontal_resolution(display),
+                                       lv_display_get_vertical_resolution(display),
+                                       min, max, &swap_axes) < 0) {
+            LV_LOG_WARN("%s is rotated, set LV_LINUX_EVDEV_THREAD=1 to apply it", file);
+        } else {
+            LV_LOG_USER("Calibrated with %s", file);
         }
-        close(fd);
     }
 
-    LV_LOG_ERROR("No touch device found in /dev/input/event*");
-    return NULL;
+    if (threaded) {
+        evdev_thread_set_calibration(indev, min->x, min->y, max->x, max->y);
+    } else {
+        lv_evdev_set_swap_axes(indev, swap_axes);
+        lv_evdev_set_calibration(indev, min->x, min->y, max->x, max->y);
+    }
+}
+
+/*
+ * Record the raw events of the input device
+ *
+ * @description the recording can be replayed with the REPLAY backend
+ * @param indev the input device
+ * @param path the path of the input device
+ * @param file the path of the recording, nothing is recorded if NULL
+ * @param min the calibration of the device, stored in the recording
+ * @param max
+ */
+static void record_input_device(lv_indev_t *indev, const char *path, const char *file,
+                                const lv_point_t *min, const lv_point_t *max)
+{
+    input_recorder_t *rec;
+
+    if (file == NULL) {
+        return;
+    }
+
+    rec = input_record_start(path, file, min->x, min->y, max->x, max->y);
+    if (rec == NULL) {
+        return;
+    }
+
+    lv_indev_add_event_cb(indev, stop_recording_cb, LV_EVENT_DELETE, rec);
+}
+
+/*
+ * Stop recording the input device
+ *
+ * @param e the deletion event
+ */
+static void stop_recording_cb(lv_event_t *e)
+{
+    input_record_stop(lv_event_get_user_data(e));
 }
 
 /*
@@ -189,54 +329,323 @@ static const char* find_touch_device_fallback(void)
  * Priority:
  * 1. Environment variable LV_LINUX_EVDEV_POINTER_DEVICE
  * 2. udev symlink /dev/input/touchscreen
- * 3. Auto-detection by device name
+ * 3. Discovery by capabilities, see input_discovery.h
+ *
+ * If LV_LINUX_EVDEV_THREAD is set to 1, the device is read
+ * by a dedicated thread instead of the LVGL indev timer
+ *
+ * If LV_LINUX_EVDEV_RECORD is set, the raw events are recorded to that file
+ *
+ * The samples go through the filter of touch_filter.h, see the
+ * LV_LINUX_EVDEV_MEDIAN, _SMOOTHING, _DEADBAND, _COALESCE and _PREDICT_MS variables
+ *
+ * Unless LV_LINUX_EVDEV_HOTPLUG is set to 0, the device is deleted when
+ * unplugged and created again when it comes back. Without a device
+ * the display waits for one to be plugged
+ *
+ * For the display n, added after the first one, the variables suffixed
+ * with _<n> take precedence, see backend_getenv
  *
  * @param display the LVGL display
  *
- * @return input device or NULL on failure
+ * @return input device, NULL on failure or BACKEND_INDEV_PENDING while waiting for the device
  */
 static lv_indev_t *init_pointer_evdev(lv_display_t *display)
 {
-    const char *input_device = getenv("LV_LINUX_EVDEV_POINTER_DEVICE");
+    const char *input_device = backend_getenv("LV_LINUX_EVDEV_POINTER_DEVICE", NULL);
+    bool hotplug = backend_getenv("LV_LINUX_EVDEV_HOTPLUG", "1")[0] == '1';
+    char discovered[INPUT_DISCOVERY_PATH_MAX];
+    input_discovery_class_t cls = INPUT_DISCOVERY_NONE;
+    pointer_slot_t *slot = NULL;
+    lv_indev_t *indev;
+    uint32_t i;
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS && slot == NULL; i++) {
+        if (!pointers[i].used) {
+            slot = &pointers[i];
+        }
+    }
+
+    if (slot == NULL) {
+        LV_LOG_ERROR("Too many pointer devices, at most %d", BACKEND_MAX_DISPLAYS);
+        return NULL;
+    }
+
+    if (input_device != NULL) {
+        LV_LOG_USER("Using env device: %s", input_device);
+    } else if (access("/dev/input/touchscreen", F_OK) == 0) {
+        // Stable udev symlink
+        input_device = "/dev/input/touchscreen";
+        LV_LOG_USER("Using udev symlink: %s", input_device);
+    } else if (access("/dev/input/touchscreen-spi", F_OK) == 0) {
+        // SPI-specific symlink
+        input_device = "/dev/input/touchscreen-spi";
+        LV_LOG_USER("Using SPI symlink: %s", input_device);
+    } else {
+        cls = input_discovery_find_pointer(discovered, sizeof(discovered));
+        if (cls != INPUT_DISCOVERY_NONE) {
+            input_device = discovered;
+        }
+    }
+
+    slot->used = true;
+    slot->display = display;
+    slot->threaded = backend_getenv("LV_LINUX_EVDEV_THREAD", "0")[0] == '1';
+    slot->record_file = backend_getenv("LV_LINUX_EVDEV_RECORD", NULL);
+    slot->calibration_file = backend_getenv("LV_LINUX_EVDEV_CALIBRATION", NULL);
+
+    /* A discovered device can be replaced by any other pointer device */
+    if (input_device != NULL && input_device != discovered) {
+        snprintf(slot->device, sizeof(slot->device), "%s", input_device);
+    }
+
+    if (hotplug && !hotplug_watched) {
+        hotplug_watched = input_discovery_watch(hotplug_cb, NULL) == 0;
+    }
+
+    lv_display_add_event_cb(display, display_deleted_cb, LV_EVENT_DELETE, slot);
 
     if (input_device == NULL) {
-        // Priority 1: Try stable udev symlink
-        if (access("/dev/input/touchscreen", F_OK) == 0) {
-            input_device = "/dev/input/touchscreen";
-            LV_LOG_USER("Using udev symlink: %s", input_device);
+        if (hotplug && hotplug_watched) {
+            LV_LOG_WARN("No pointer device found, waiting for one to be plugged");
+            return BACKEND_INDEV_PENDING;
         }
-        // Priority 2: Try SPI-specific symlink
-        else if (access("/dev/input/touchscreen-spi", F_OK) == 0) {
-            input_device = "/dev/input/touchscreen-spi";
-            LV_LOG_USER("Using SPI symlink: %s", input_device);
+
+        LV_LOG_ERROR("No pointer device found! Check udev rules.");
+        release_slot(slot);
+        return NULL;
+    }
+
+    if (cls == INPUT_DISCOVERY_NONE) {
+        cls = input_discovery_classify(input_device);
+    }
+
+    indev = create_pointer(slot, input_device, cls);
+
+    /* The configured device might be plugged later */
+    if (indev == NULL && hotplug && hotplug_watched) {
+        return BACKEND_INDEV_PENDING;
+    }
+
+    if (indev == NULL) {
+        release_slot(slot);
+    }
+
+    return indev;
+}
+
+/*
+ * Create the input device of a slot
+ *
+ * @param slot the slot of the pointer device
+ * @param path the path of the device node
+ * @param cls the class of the device, a mouse gets a cursor
+ * @return input device or NULL on failure
+ */
+static lv_indev_t *create_pointer(pointer_slot_t *slot, const char *path,
+                                  input_discovery_class_t cls)
+{
+    lv_indev_t *indev = NULL;
+    bool threaded = slot->threaded;
+    lv_point_t cal_min;
+    lv_point_t cal_max;
+
+    if (threaded) {
+        indev = evdev_thread_create(path, slot->display);
+
+        if (indev == NULL) {
+            LV_LOG_WARN("Input thread unavailable, falling back to polling");
+            threaded = false;
         }
-        // Priority 3: Auto-detect
-        else {
-            input_device = find_touch_device_fallback();
-            if (input_device == NULL) {
-                LV_LOG_ERROR("Touch device not found! Check udev rules.");
-                return NULL;
+    }
+
+    if (indev == NULL) {
+        indev = lv_evdev_create(LV_INDEV_TYPE_POINTER, path);
+
+        if (indev == NULL) {
+            LV_LOG_ERROR("Failed to open: %s", path);
+            return NULL;
+        }
+
+        lv_indev_set_display(indev, slot->display);
+        watch_input_device(indev, path);
+    }
+
+    calibrate_pointer(indev, slot->display, threaded, slot->calibration_file, &cal_min, &cal_max);
+    /* The samples of the input thread carry the time of the kernel event */
+    touch_filter_attach(indev, threaded ? evdev_thread_get_timestamp : NULL);
+    record_input_device(indev, path, slot->record_file, &cal_min, &cal_max);
+
+    if (cls == INPUT_DISCOVERY_MOUSE) {
+        set_mouse_cursor_icon(indev, slot->display);
+    }
+
+    if (realpath(path, slot->path) == NULL) {
+        snprintf(slot->path, sizeof(slot->path), "%s", path);
+    }
+
+    slot->indev = indev;
+    lv_indev_add_event_cb(indev, pointer_deleted_cb, LV_EVENT_DELETE, slot);
+
+    LV_LOG_USER("Touch device initialized: %s", path);
+    return indev;
+}
+
+/*
+ * Release a slot
+ *
+ * @param slot the slot of the pointer device
+ */
+static void release_slot(pointer_slot_t *slot)
+{
+    if (slot->display != NULL) {
+        lv_display_remove_event_cb_with_user_data(slot->display, display_deleted_cb, slot);
+    }
+
+    memset(slot, 0, sizeof(pointer_slot_t));
+}
+
+/*
+ * Release the slot of a deleted input device
+ *
+ * @description the slot is kept if the device was unplugged
+ * @param e the deletion event
+ */
+static void pointer_deleted_cb(lv_event_t *e)
+{
+    pointer_slot_t *slot = lv_event_get_user_data(e);
+
+    if (LV_GLOBAL_DEFAULT()->deinit_in_progress) return;
+
+    slot->indev = NULL;
+
+    if (!slot->unplugged || slot->display == NULL) {
+        release_slot(slot);
+    }
+
+    slot->unplugged = false;
+}
+
+/*
+ * Stop waiting for the device of a deleted display
+ *
+ * @description LVGL keeps the input devices of a deleted display
+ * @param e the deletion event
+ */
+static void display_deleted_cb(lv_event_t *e)
+{
+    pointer_slot_t *slot = lv_event_get_user_data(e);
+
+    slot->display = NULL;
+
+    if (slot->indev == NULL) {
+        release_slot(slot);
+    }
+}
+
+/*
+ * Follow the hotplugs of the pointer devices
+ *
+ * @description a removed device is deleted and its slot waits, an added
+ * device is given to the waiting slot configured with it, otherwise to
+ * the first waiting slot without configured device
+ * @note called from the event loop
+ * @param path the path of the device node
+ * @param added true if the node was added, false if removed
+ * @param user_data unused
+ */
+static void hotplug_cb(const char *path, bool added, void *user_data)
+{
+    input_discovery_class_t cls;
+    pointer_slot_t *slot;
+    uint32_t i;
+
+    LV_UNUSED(user_data);
+
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        slot = &pointers[i];
+
+        if (slot->used && slot->indev != NULL && strcmp(slot->path, path) == 0) {
+            if (added) {
+                /* The permissions of a device in use changed */
+                return;
             }
+
+            LV_LOG_USER("Pointer device %s removed", path);
+            slot->unplugged = true;
+            lv_indev_delete(slot->indev);
+            return;
         }
-    } else {
-        LV_LOG_USER("Using env device: %s", input_device);
     }
 
-    lv_indev_t *indev = lv_evdev_create(LV_INDEV_TYPE_POINTER, input_device);
+    if (!added) {
+        return;
+    }
 
-    if (indev == NULL) {
-        LV_LOG_ERROR("Failed to open: %s", input_device);
-        return NULL;
+    slot = find_waiting_slot(path);
+    if (slot == NULL) {
+        return;
+    }
+
+    cls = input_discovery_classify(path);
+    if (cls == INPUT_DISCOVERY_NONE) {
+        /* Not a pointer device, or still being set up by udev */
+        return;
     }
 
-    lv_indev_set_display(indev, display);
+    create_pointer(slot, path, cls);
+}
 
-    // Touch calibration for ADS7846
-    lv_evdev_set_calibration(indev, 0, 4095, 4095, 0);
+/*
+ * Find the slot an added device is given to
+ *
+ * @param path the path of the device node
+ * @return the waiting slot configured with the device, otherwise
+ * the first waiting slot without configured device, NULL if none
+ */
+static pointer_slot_t *find_waiting_slot(const char *path)
+{
+    uint32_t i;
 
-    LV_LOG_USER("Touch device initialized: %s", input_device);
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (slot_is_waiting(&pointers[i]) && slot_is_configured_with(&pointers[i], path)) {
+            return &pointers[i];
+        }
+    }
 
-    return indev;
+    for (i = 0; i < BACKEND_MAX_DISPLAYS; i++) {
+        if (slot_is_waiting(&pointers[i]) && pointers[i].device[0] == '\0') {
+            return &pointers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Check if a slot waits for a device
+ *
+ * @param slot the slot
+ * @return true if the slot is used by a display and has no input device
+ */
+static bool slot_is_waiting(const pointer_slot_t *slot)
+{
+    return slot->used && slot->indev == NULL && slot->display != NULL;
+}
+
+/*
+ * Check if a slot is configured with a device
+ *
+ * @param slot the slot
+ * @param path the path of the device node
+ * @return true if the configured device resolves to path
+ */
+static bool slot_is_configured_with(const pointer_slot_t *slot, const char *path)
+{
+    char real[PATH_MAX];
+
+    return slot->device[0] != '\0' && realpath(slot->device, real) != NULL &&
+           strcmp(real, path) == 0;
 }
 
 #endif /*#if LV_USE_EVDEV*/
\ No newline at end of file
@@ -0,0 +1,350 @@
+/**
+ * @file replay.c
+ *
+ * Replay of recorded evdev events as a pointer input device
+ *
+ * The events recorded with LV_LINUX_EVDEV_RECORD are replayed
+ * with their original timing, following the LVGL tick, or one report
+ * per read as fast as possible if LV_SIM_REPLAY_FAST is set to 1
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <linux/input.h>
+
+#include "lvgl/lvgl.h"
+#include "../simulator_util.h"
+#include "../backends.h"
+#include "../event_loop.h"
+#include "../frame_stats.h"
+#include "../input_record.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    input_recording_t rec;
+    uint32_t pos;           /* Next event to replay */
+    uint64_t pos_us;        /* Time of the last replayed event since the start */
+    uint32_t start_tick;
+    bool started;
+    bool fast;
+    bool loop;
+    bool done;
+
+    /* Pointer state */
+    int32_t x;
+    int32_t y;
+    bool rel;               /* Relative device, x and y are display coordinates */
+    bool pressed;
+    bool mt_slots;          /* Multi-touch protocol B, seen from the first ABS_MT_SLOT or tracking ID */
+    int32_t mt_slot;        /* The slot the ABS_MT_* events apply to */
+    int32_t mt_tracked;     /* The slot of the contact that started the press, -1 if none */
+} replay_ctx_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static lv_indev_t *init_replay(lv_display_t *display);
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void apply_event(replay_ctx_t *ctx, const input_record_event_t *ev, lv_display_t *disp);
+static void apply_mt_event(replay_ctx_t *ctx, const input_record_event_t *ev);
+static int32_t map_coord(int32_t v, int32_t min, int32_t max, int32_t res);
+static void indev_delete_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static char *backend_name = "REPLAY";
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/*
+ * Register the replay backend
+ *
+ * @param backend the backend descriptor
+ */
+int backend_init_replay(backend_t *backend)
+{
+    LV_ASSERT_NULL(backend);
+    backend->handle->indev = malloc(sizeof(indev_backend_t));
+    LV_ASSERT_NULL(backend->handle->indev);
+
+    backend->handle->indev->init_indev = init_replay;
+
+    backend->name = backend_name;
+    backend->type = BACKEND_INDEV;
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/*
+ * Create the replay input device
+ *
+ * @description the recording is set with LV_SIM_REPLAY_FILE,
+ * it restarts from the beginning if LV_SIM_REPLAY_LOOP is set to 1,
+ * otherwise the run loop is stopped once all the events were replayed
+ * @param display the LVGL display
+ * @return input device or NULL on failure
+ */
+static lv_indev_t *init_replay(lv_display_t *display)
+{
+    const char *file = getenv("LV_SIM_REPLAY_FILE");
+    replay_ctx_t *ctx;
+    lv_indev_t *indev;
+
+    if (file == NULL) {
+        LV_LOG_ERROR("LV_SIM_REPLAY_FILE is not set");
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(replay_ctx_t));
+    LV_ASSERT_NULL(ctx);
+
+    if (input_recording_load(file, &ctx->rec) < 0) {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->mt_tracked = -1;
+    ctx->fast = getenv_default("LV_SIM_REPLAY_FAST", "0")[0] == '1';
+    ctx->loop = getenv_default("LV_SIM_REPLAY_LOOP", "0")[0] == '1';
+
+    indev = lv_indev_create();
+    if (indev == NULL) {
+        input_recording_free(&ctx->rec);
+        free(ctx);
+        return NULL;
+    }
+
+    lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(indev, read_cb);
+    lv_indev_set_driver_data(indev, ctx);
+    lv_indev_set_display(indev, display);
+    lv_indev_add_event_cb(indev, indev_delete_cb, LV_EVENT_DELETE, ctx);
+
+    if (ctx->fast) {
+        /* One report per iteration of the run loop */
+        lv_timer_set_period(lv_indev_get_read_timer(indev), 1);
+    }
+
+    LV_LOG_USER("Replaying %u events (%u reports, %u ms) from %s",
+                ctx->rec.count, ctx->rec.report_cnt,
+                (uint32_t)(ctx->rec.duration_us / 1000), file);
+
+    return indev;
+}
+
+/**
+ * Read callback of the LVGL input device
+ *
+ * @description replays the events up to the next report,
+ * continue_reading is set while more reports are due
+ */
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    replay_ctx_t *ctx = lv_indev_get_driver_data(indev);
+    lv_display_t *disp = lv_indev_get_display(indev);
+    const input_record_event_t *ev;
+    const input_record_header_t *h = &ctx->rec.header;
+    uint64_t now_us;
+
+    if (!ctx->started) {
+        /* Start when LVGL starts reading, not when the device is created */
+        ctx->start_tick = lv_tick_get();
+        ctx->started = true;
+    }
+
+    now_us = (uint64_t)lv_tick_elaps(ctx->start_tick) * 1000;
+
+    while (!ctx->done && ctx->pos < ctx->rec.count) {
+        ev = &ctx->rec.events[ctx->pos];
+
+        if (!ctx->fast && ctx->pos_us + ev->delta_us > now_us) {
+            break;
+        }
+
+        ctx->pos_us += ev->delta_us;
+        ctx->pos++;
+
+        if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+            frame_stats_input(frame_stats_now_us());
+
+            ev = &ctx->rec.events[ctx->pos];
+            data->continue_reading = !ctx->fast && ctx->pos < ctx->rec.count &&
+                                     ctx->pos_us + ev->delta_us <= now_us;
+            break;
+        }
+
+        apply_event(ctx, ev, disp);
+    }
+
+    if (!ctx->done && ctx->pos == ctx->rec.count) {
+        if (ctx->loop) {
+            ctx->pos = 0;
+            ctx->pos_us = 0;
+            ctx->mt_slot = 0;
+            ctx->mt_tracked = -1;
+            ctx->pressed = false;
+            ctx->start_tick = lv_tick_get();
+        } else {
+            LV_LOG_USER("Replay finished");
+            ctx->done = true;
+            event_loop_quit();
+        }
+    }
+
+    if (ctx->rel) {
+        data->point.x = ctx->x;
+        data->point.y = ctx->y;
+    } else {
+        data->point.x = map_coord(ctx->x, h->min_x, h->max_x,
+                                  lv_display_get_horizontal_resolution(disp));
+        data->point.y = map_coord(ctx->y, h->min_y, h->max_y,
+                                  lv_display_get_vertical_resolution(disp));
+    }
+
+    data->state = ctx->pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+/**
+ * Update the pointer state
+ *
+ * @param ctx the replay context
+ * @param ev the recorded event
+ * @param disp the display, bounds the relative motion
+ */
+static void apply_event(replay_ctx_t *ctx, const input_record_event_t *ev, lv_display_t *disp)
+{
+    switch (ev->type) {
+    case EV_ABS:
+        if (ev->code == ABS_MT_SLOT || ev->code == ABS_MT_TRACKING_ID) {
+            ctx->mt_slots = true;
+        }
+
+        if (ctx->mt_slots) {
+            apply_mt_event(ctx, ev);
+        } else if (ev->code == ABS_X || ev->code == ABS_MT_POSITION_X) {
+            ctx->x = ev->value;
+        } else if (ev->code == ABS_Y || ev->code == ABS_MT_POSITION_Y) {
+            ctx->y = ev->value;
+        }
+        break;
+
+    case EV_REL:
+        ctx->rel = true;
+
+        if (ev->code == REL_X) {
+            ctx->x = LV_CLAMP(0, ctx->x + ev->value,
+                              lv_display_get_horizontal_resolution(disp) - 1);
+        } else if (ev->code == REL_Y) {
+            ctx->y = LV_CLAMP(0, ctx->y + ev->value,
+                              lv_display_get_vertical_resolution(disp) - 1);
+        }
+        break;
+
+    case EV_KEY:
+        /* With slots the press follows the tracked contact, BTN_TOUCH is held by any finger */
+        if ((ev->code == BTN_TOUCH && !ctx->mt_slots) || ev->code == BTN_LEFT) {
+            ctx->pressed = ev->value != 0;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Follow the contact that started the press
+ *
+ * @description same as the threaded evdev reader, the ABS_MT_* events
+ * apply to the slot selected by the last ABS_MT_SLOT, the other slots
+ * and the single touch ABS_X/ABS_Y emulation are ignored
+ * @param ctx the replay context
+ * @param ev the recorded event
+ */
+static void apply_mt_event(replay_ctx_t *ctx, const input_record_event_t *ev)
+{
+    switch (ev->code) {
+    case ABS_MT_SLOT:
+        ctx->mt_slot = ev->value;
+        break;
+
+    case ABS_MT_TRACKING_ID:
+        if (ev->value >= 0 && ctx->mt_tracked < 0) {
+            ctx->mt_tracked = ctx->mt_slot;
+            ctx->pressed = true;
+        } else if (ev->value < 0 && ctx->mt_slot == ctx->mt_tracked) {
+            ctx->mt_tracked = -1;
+            ctx->pressed = false;
+        }
+        break;
+
+    case ABS_MT_POSITION_X:
+        if (ctx->mt_slot == ctx->mt_tracked) {
+            ctx->x = ev->value;
+        }
+        break;
+
+    case ABS_MT_POSITION_Y:
+        if (ctx->mt_slot == ctx->mt_tracked) {
+            ctx->y = ev->value;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Map a raw coordinate to the display resolution
+ *
+ * @description min can be greater than max to invert the axis
+ */
+static int32_t map_coord(int32_t v, int32_t min, int32_t max, int32_t res)
+{
+    int32_t r;
+
+    if (max == min) {
+        return v;
+    }
+
+    r = (int32_t)(((int64_t)(v - min) * res) / (max - min));
+    return LV_CLAMP(0, r, res - 1);
+}
+
+/**
+ * Release the recording
+ *
+ * @param e the deletion event
+ */
+static void indev_delete_cb(lv_event_t *e)
+{
+    replay_ctx_t *ctx = lv_event_get_user_data(e);
+
+    input_recording_free(&ctx->rec);
+    free(ctx);
+}
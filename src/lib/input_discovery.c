@@ -0,0 +1,633 @@
+/**
+ * @file input_discovery.c
+ *
+ * Discovery of the pointer input devices
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+
+#include "lvgl/lvgl.h"
+
+#include "simulator_util.h"
+#include "event_loop.h"
+#include "frame_stats.h"
+#include "input_discovery.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of event nodes considered */
+#define INPUT_DISCOVERY_MAX_NODES 32
+
+/* Time given to the probes of the devices, the late ones are ignored */
+#define INPUT_DISCOVERY_PROBE_MS 500
+
+#define LONG_BITS (sizeof(unsigned long) * 8)
+#define NLONGS(n) (((n) + LONG_BITS - 1) / LONG_BITS)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* The capabilities used to classify a device */
+typedef struct {
+    unsigned long abs[NLONGS(ABS_CNT)];
+    unsigned long rel[NLONGS(REL_CNT)];
+    unsigned long key[NLONGS(KEY_CNT)];
+    unsigned long prop[NLONGS(INPUT_PROP_CNT)];
+} input_caps_t;
+
+/* A device probed by a thread when sysfs is unavailable, guarded by probe_lock */
+typedef struct {
+    char path[INPUT_DISCOVERY_PATH_MAX];
+    input_discovery_class_t cls;
+    bool done;
+    int refs;                   /* The scan and the thread, the last one frees the probe */
+} probe_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static input_discovery_class_t classify_caps(const input_caps_t *caps);
+static bool test_bit(const unsigned long *bits, unsigned int bit);
+static bool read_sysfs_caps(const char *node, input_caps_t *caps);
+static int read_sysfs_bitmap(const char *node, const char *name, unsigned long *bits, size_t nlongs);
+static bool read_sysfs_name(const char *node, char *name, size_t size);
+static bool read_ioctl_caps(const char *path, input_caps_t *caps);
+static input_discovery_class_t scan_sysfs(char *path, size_t size);
+static input_discovery_class_t scan_parallel(char *path, size_t size);
+static void *probe_thread(void *arg);
+static void probe_unref(probe_t *probe);
+static int event_number(const char *name);
+static bool read_cache(const char *cache, char *path, size_t size);
+static void write_cache(const char *cache, const char *path);
+static void inotify_cb(int fd, uint32_t events, void *user_data);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static input_discovery_cb_t watch_cb;
+static void *watch_user_data;
+
+/* A thread stuck in a driver outlives the scan, its probe stays allocated */
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_cond = PTHREAD_COND_INITIALIZER;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+input_discovery_class_t input_discovery_find_pointer(char *path, size_t size)
+{
+    const char *cache = getenv_default("LV_LINUX_EVDEV_CACHE", "/var/tmp/lvgl_pointer_device");
+    uint64_t start = frame_stats_now_us();
+    input_discovery_class_t cls;
+
+    if (cache[0] != '\0' && read_cache(cache, path, size)) {
+        cls = input_discovery_classify(path);
+
+        if (cls != INPUT_DISCOVERY_NONE) {
+            LV_LOG_USER("Using the cached pointer device %s", path);
+            return cls;
+        }
+    }
+
+    if (access("/sys/class/input", F_OK) == 0) {
+        cls = scan_sysfs(path, size);
+    } else {
+        cls = scan_parallel(path, size);
+    }
+
+    if (cls == INPUT_DISCOVERY_NONE) {
+        LV_LOG_WARN("No pointer device found");
+        return cls;
+    }
+
+    LV_LOG_USER("Discovered the %s %s in %.1f ms",
+                cls == INPUT_DISCOVERY_TOUCHSCREEN ? "touchscreen" : "mouse", path,
+                (double)(frame_stats_now_us() - start) / 1000.0);
+
+    if (cache[0] != '\0') {
+        write_cache(cache, path);
+    }
+
+    return cls;
+}
+
+input_discovery_class_t input_discovery_classify(const char *path)
+{
+    char real[PATH_MAX];
+    const char *node;
+    input_caps_t caps;
+
+    if (realpath(path, real) == NULL) {
+        return INPUT_DISCOVERY_NONE;
+    }
+
+    node = strrchr(real, '/');
+    node = node != NULL ? node + 1 : real;
+
+    if (!read_sysfs_caps(node, &caps) && !read_ioctl_caps(real, &caps)) {
+        return INPUT_DISCOVERY_NONE;
+    }
+
+    return classify_caps(&caps);
+}
+
+int input_discovery_watch(input_discovery_cb_t cb, void *user_data)
+{
+    int fd;
+
+    if (watch_cb != NULL) {
+        return -1;
+    }
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* udev creates the node then sets its permissions, both are reported */
+    if (inotify_add_watch(fd, "/dev/input", IN_CREATE | IN_ATTRIB | IN_DELETE) < 0 ||
+        event_loop_add_fd(fd, EPOLLIN, inotify_cb, NULL) < 0) {
+        LV_LOG_WARN("Input hotplugs are not monitored");
+        close(fd);
+        return -1;
+    }
+
+    watch_cb = cb;
+    watch_user_data = user_data;
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Classify a device by its capabilities
+ *
+ * @param caps the capabilities
+ * @return the class of the device
+ */
+static input_discovery_class_t classify_caps(const input_caps_t *caps)
+{
+    bool abs_xy = (test_bit(caps->abs, ABS_X) && test_bit(caps->abs, ABS_Y)) ||
+                  (test_bit(caps->abs, ABS_MT_POSITION_X) && test_bit(caps->abs, ABS_MT_POSITION_Y));
+
+    /* Touchpads report absolute axes too, but move a cursor */
+    if (abs_xy && test_bit(caps->key, BTN_TOUCH) && !test_bit(caps->prop, INPUT_PROP_POINTER)) {
+        return INPUT_DISCOVERY_TOUCHSCREEN;
+    }
+
+    if (test_bit(caps->rel, REL_X) && test_bit(caps->rel, REL_Y) && test_bit(caps->key, BTN_LEFT)) {
+        return INPUT_DISCOVERY_MOUSE;
+    }
+
+    return INPUT_DISCOVERY_NONE;
+}
+
+static bool test_bit(const unsigned long *bits, unsigned int bit)
+{
+    return (bits[bit / LONG_BITS] >> (bit % LONG_BITS)) & 1;
+}
+
+/**
+ * Read the capabilities of a device from sysfs
+ *
+ * @description the device isn't opened
+ * @param node the name of the node, i.e event0
+ * @param caps where to store the capabilities
+ * @return true on success
+ */
+static bool read_sysfs_caps(const char *node, input_caps_t *caps)
+{
+    memset(caps, 0, sizeof(input_caps_t));
+
+    if (read_sysfs_bitmap(node, "capabilities/key", caps->key, NLONGS(KEY_CNT)) < 0) {
+        return false;
+    }
+
+    /* Missing if the device has none */
+    read_sysfs_bitmap(node, "capabilities/abs", caps->abs, NLONGS(ABS_CNT));
+    read_sysfs_bitmap(node, "capabilities/rel", caps->rel, NLONGS(REL_CNT));
+    read_sysfs_bitmap(node, "properties", caps->prop, NLONGS(INPUT_PROP_CNT));
+    return true;
+}
+
+/**
+ * Parse a bitmap of sysfs
+ *
+ * @description the words are written in hexadecimal, the most significant first
+ * @param node the name of the node, i.e event0
+ * @param name the attribute of the device
+ * @param bits where to store the bitmap
+ * @param nlongs the size of bits
+ * @return 0 on success, -1 on error
+ */
+static int read_sysfs_bitmap(const char *node, const char *name, unsigned long *bits, size_t nlongs)
+{
+    char path[128];
+    char line[512];
+    char *words[64];
+    char *saveptr;
+    char *word;
+    size_t cnt = 0;
+    size_t i;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/%s", node, name);
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    for (word = strtok_r(line, " \n", &saveptr); word != NULL && cnt < 64;
+         word = strtok_r(NULL, " \n", &saveptr)) {
+        words[cnt++] = word;
+    }
+
+    for (i = 0; i < cnt && i < nlongs; i++) {
+        bits[i] = strtoul(words[cnt - 1 - i], NULL, 16);
+    }
+
+    return 0;
+}
+
+/**
+ * Read the name of a device from sysfs
+ *
+ * @return true on success
+ */
+static bool read_sysfs_name(const char *node, char *name, size_t size)
+{
+    char path[128];
+    FILE *f;
+    bool ok;
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/name", node);
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    ok = fgets(name, size, f) != NULL;
+    fclose(f);
+
+    if (ok) {
+        name[strcspn(name, "\n")] = '\0';
+    }
+
+    return ok;
+}
+
+/**
+ * Query the capabilities of a device
+ *
+ * @param path the path of the device node
+ * @param caps where to store the capabilities
+ * @return true on success
+ */
+static bool read_ioctl_caps(const char *path, input_caps_t *caps)
+{
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    bool ok;
+
+    if (fd < 0) {
+        return false;
+    }
+
+    memset(caps, 0, sizeof(input_caps_t));
+
+    ok = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(caps->key)), caps->key) >= 0;
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(caps->abs)), caps->abs);
+    ioctl(fd, EVIOCGBIT(EV_REL, sizeof(caps->rel)), caps->rel);
+    ioctl(fd, EVIOCGPROP(sizeof(caps->prop)), caps->prop);
+
+    close(fd);
+    return ok;
+}
+
+/**
+ * Find the preferred pointer device from sysfs
+ *
+ * @description on a tie the lowest event number wins
+ * @param path where to store the path of the device node
+ * @param size the size of path
+ * @return the class of the device
+ */
+static input_discovery_class_t scan_sysfs(char *path, size_t size)
+{
+    input_discovery_class_t best = INPUT_DISCOVERY_NONE;
+    input_discovery_class_t cls;
+    input_caps_t caps;
+    struct dirent *ent;
+    int best_num = INT_MAX;
+    int num;
+    DIR *dir;
+
+    dir = opendir("/sys/class/input");
+    if (dir == NULL) {
+        return INPUT_DISCOVERY_NONE;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        num = event_number(ent->d_name);
+
+        if (num < 0 || !read_sysfs_caps(ent->d_name, &caps)) {
+            continue;
+        }
+
+        cls = classify_caps(&caps);
+        if (cls > best || (cls == best && cls != INPUT_DISCOVERY_NONE && num < best_num)) {
+            best = cls;
+            best_num = num;
+        }
+    }
+
+    closedir(dir);
+
+    if (best != INPUT_DISCOVERY_NONE) {
+        snprintf(path, size, "/dev/input/event%d", best_num);
+    }
+
+    return best;
+}
+
+/**
+ * Find the preferred pointer device by opening the devices
+ *
+ * @description the devices are probed in parallel, a device whose probe
+ * doesn't complete within INPUT_DISCOVERY_PROBE_MS is ignored and its
+ * thread left to finish on its own
+ * @param path where to store the path of the device node
+ * @param size the size of path
+ * @return the class of the device
+ */
+static input_discovery_class_t scan_parallel(char *path, size_t size)
+{
+    probe_t *probes[INPUT_DISCOVERY_MAX_NODES];
+    input_discovery_class_t best = INPUT_DISCOVERY_NONE;
+    int best_num = INT_MAX;
+    pthread_attr_t attr;
+    pthread_t thread;
+    struct timespec deadline;
+    bool pending;
+    int i;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (i = 0; i < INPUT_DISCOVERY_MAX_NODES; i++) {
+        probes[i] = calloc(1, sizeof(probe_t));
+        if (probes[i] == NULL) {
+            continue;
+        }
+
+        snprintf(probes[i]->path, sizeof(probes[i]->path), "/dev/input/event%d", i);
+        probes[i]->refs = 2;
+
+        if (access(probes[i]->path, F_OK) < 0 ||
+            pthread_create(&thread, &attr, probe_thread, probes[i]) != 0) {
+            free(probes[i]);
+            probes[i] = NULL;
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += INPUT_DISCOVERY_PROBE_MS / 1000;
+    deadline.tv_nsec += (INPUT_DISCOVERY_PROBE_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&probe_lock);
+
+    do {
+        pending = false;
+
+        for (i = 0; i < INPUT_DISCOVERY_MAX_NODES; i++) {
+            if (probes[i] != NULL && !probes[i]->done) {
+                pending = true;
+                break;
+            }
+        }
+    } while (pending && pthread_cond_timedwait(&probe_cond, &probe_lock, &deadline) != ETIMEDOUT);
+
+    for (i = 0; i < INPUT_DISCOVERY_MAX_NODES; i++) {
+        if (probes[i] == NULL) {
+            continue;
+        }
+
+        if (!probes[i]->done) {
+            LV_LOG_WARN("Ignoring %s, not probed within %d ms", probes[i]->path,
+                        INPUT_DISCOVERY_PROBE_MS);
+        } else if (probes[i]->cls > best || (probes[i]->cls == best && i < best_num)) {
+            best = probes[i]->cls;
+            best_num = i;
+        }
+
+        probe_unref(probes[i]);
+    }
+
+    pthread_mutex_unlock(&probe_lock);
+
+    if (best != INPUT_DISCOVERY_NONE) {
+        snprintf(path, size, "/dev/input/event%d", best_num);
+    }
+
+    return best;
+}
+
+/**
+ * Probe a device
+ *
+ * @note runs in its own thread
+ */
+static void *probe_thread(void *arg)
+{
+    probe_t *probe = arg;
+    input_discovery_class_t cls = INPUT_DISCOVERY_NONE;
+    input_caps_t caps;
+
+    if (read_ioctl_caps(probe->path, &caps)) {
+        cls = classify_caps(&caps);
+    }
+
+    pthread_mutex_lock(&probe_lock);
+    probe->cls = cls;
+    probe->done = true;
+    pthread_cond_broadcast(&probe_cond);
+    probe_unref(probe);
+    pthread_mutex_unlock(&probe_lock);
+
+    return NULL;
+}
+
+/**
+ * Drop a reference to a probe
+ *
+ * @note called with probe_lock held
+ * @param probe the probe, freed with its last reference
+ */
+static void probe_unref(probe_t *probe)
+{
+    if (--probe->refs == 0) {
+        free(probe);
+    }
+}
+
+/**
+ * Get the number of an event node
+ *
+ * @param name the name of the node, i.e event3
+ * @return the number or -1 if it isn't an event node
+ */
+static int event_number(const char *name)
+{
+    char *end;
+    long num;
+
+    if (strncmp(name, "event", 5) != 0) {
+        return -1;
+    }
+
+    num = strtol(name + 5, &end, 10);
+    return (*end != '\0' || end == name + 5 || num < 0) ? -1 : (int)num;
+}
+
+/**
+ * Read the cached device
+ *
+ * @description the cache holds the path and the name of the device,
+ * the entry is stale if the node now belongs to another device
+ * @param cache the path of the state file
+ * @param path where to store the path of the device node
+ * @param size the size of path
+ * @return true if the cached device is still present
+ */
+static bool read_cache(const char *cache, char *path, size_t size)
+{
+    char cached_name[256];
+    char name[256];
+    const char *node;
+    FILE *f;
+    bool ok;
+
+    f = fopen(cache, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    ok = fgets(path, size, f) != NULL && fgets(cached_name, sizeof(cached_name), f) != NULL;
+    fclose(f);
+
+    if (!ok) {
+        return false;
+    }
+
+    path[strcspn(path, "\n")] = '\0';
+    cached_name[strcspn(cached_name, "\n")] = '\0';
+
+    node = strrchr(path, '/');
+    node = node != NULL ? node + 1 : path;
+
+    /* Without sysfs the classification of the device validates the entry */
+    if (read_sysfs_name(node, name, sizeof(name))) {
+        return strcmp(name, cached_name) == 0;
+    }
+
+    return access(path, F_OK) == 0;
+}
+
+/**
+ * Cache the chosen device
+ *
+ * @param cache the path of the state file
+ * @param path the path of the device node
+ */
+static void write_cache(const char *cache, const char *path)
+{
+    char name[256] = "";
+    const char *node;
+    FILE *f;
+
+    node = strrchr(path, '/');
+    node = node != NULL ? node + 1 : path;
+    read_sysfs_name(node, name, sizeof(name));
+
+    f = fopen(cache, "w");
+    if (f == NULL) {
+        LV_LOG_INFO("Failed to write the device cache %s", cache);
+        return;
+    }
+
+    fprintf(f, "%s\n%s\n", path, name);
+    fclose(f);
+}
+
+/**
+ * Dispatch the changes of /dev/input
+ *
+ * @note called from the event loop
+ */
+static void inotify_cb(int fd, uint32_t events, void *user_data)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    char path[INPUT_DISCOVERY_PATH_MAX];
+    ssize_t len;
+    ssize_t i;
+
+    LV_UNUSED(events);
+    LV_UNUSED(user_data);
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < len; i += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)(buf + i);
+
+            if (ev->len == 0 || event_number(ev->name) < 0) {
+                continue;
+            }
+
+            snprintf(path, sizeof(path), "/dev/input/%s", ev->name);
+            watch_cb(path, (ev->mask & IN_DELETE) == 0, watch_user_data);
+        }
+    }
+}
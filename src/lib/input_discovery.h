@@ -0,0 +1,92 @@
+/**
+ * @file input_discovery.h
+ *
+ * Discovery of the pointer input devices
+ *
+ * The devices are classified by their capabilities, read from sysfs
+ * (/sys/class/input/eventN/device/capabilities) without opening the
+ * devices, so that slow SPI/I2C drivers aren't probed at boot. Without
+ * sysfs the devices are opened and queried in parallel, the devices not
+ * answering within half a second are ignored.
+ *
+ * The device that was chosen is cached in a state file
+ * (LV_LINUX_EVDEV_CACHE, /var/tmp/lvgl_pointer_device by default) and
+ * checked first on the next start. The hotplugs are monitored with
+ * inotify on /dev/input from the event loop
+ */
+
+#ifndef INPUT_DISCOVERY_H
+#define INPUT_DISCOVERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdbool.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Longest path of an input device node */
+#define INPUT_DISCOVERY_PATH_MAX 64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* In order of preference */
+typedef enum {
+    INPUT_DISCOVERY_NONE = 0,
+    INPUT_DISCOVERY_MOUSE,          /* Relative axes and a left button */
+    INPUT_DISCOVERY_TOUCHSCREEN,    /* Absolute axes and BTN_TOUCH, not a touchpad */
+} input_discovery_class_t;
+
+/* Called when a device node is added (or its permissions change) or removed */
+typedef void (*input_discovery_cb_t)(const char *path, bool added, void *user_data);
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Find the preferred pointer device
+ * @description the cached device is returned if it still exists
+ * with the same name, otherwise the devices are classified and the
+ * cache is updated. A touchscreen is preferred over a mouse
+ * @param path where to store the path of the device node
+ * @param size the size of path
+ * @return the class of the device, INPUT_DISCOVERY_NONE if none was found
+ */
+input_discovery_class_t input_discovery_find_pointer(char *path, size_t size);
+
+/**
+ * @brief Classify an input device
+ * @param path the path of the device node, symbolic links are resolved
+ * @return the class of the device
+ */
+input_discovery_class_t input_discovery_classify(const char *path);
+
+/**
+ * @brief Monitor the hotplugs of the input devices
+ * @description the callback is called from the event loop,
+ * only one callback can be registered
+ * @param cb the callback
+ * @param user_data passed to the callback
+ * @return 0 on success, -1 on error
+ */
+int input_discovery_watch(input_discovery_cb_t cb, void *user_data);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*INPUT_DISCOVERY_H*/
@@ -0,0 +1,229 @@
+/**
+ * @file input_record.c
+ *
+ * Recording of raw evdev events
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/input.h>
+
+#include "lvgl/lvgl.h"
+
+#include "event_loop.h"
+#include "input_record.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+struct _input_recorder_t {
+    int fd;
+    FILE *file;
+    uint64_t last_us;   /* Timestamp of the previous event, 0 before the first one */
+    uint32_t count;
+};
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void record_cb(int fd, uint32_t events, void *user_data);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+input_recorder_t *input_record_start(const char *device, const char *file,
+                                     int32_t min_x, int32_t min_y,
+                                     int32_t max_x, int32_t max_y)
+{
+    input_record_header_t header;
+    input_recorder_t *rec;
+    int clk = CLOCK_MONOTONIC;
+
+    rec = calloc(1, sizeof(input_recorder_t));
+    LV_ASSERT_NULL(rec);
+
+    rec->fd = open(device, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (rec->fd < 0) {
+        LV_LOG_ERROR("Failed to open %s: %s", device, strerror(errno));
+        free(rec);
+        return NULL;
+    }
+
+    ioctl(rec->fd, EVIOCSCLOCKID, &clk);
+
+    rec->file = fopen(file, "wb");
+    if (rec->file == NULL) {
+        LV_LOG_ERROR("Failed to create %s: %s", file, strerror(errno));
+        goto err;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INPUT_RECORD_MAGIC, sizeof(header.magic));
+    header.version = INPUT_RECORD_VERSION;
+    header.min_x = min_x;
+    header.min_y = min_y;
+    header.max_x = max_x;
+    header.max_y = max_y;
+
+    if (fwrite(&header, sizeof(header), 1, rec->file) != 1 ||
+        event_loop_add_fd(rec->fd, EPOLLIN, record_cb, rec) < 0) {
+        fclose(rec->file);
+        goto err;
+    }
+
+    LV_LOG_USER("Recording %s to %s", device, file);
+    return rec;
+
+err:
+    close(rec->fd);
+    free(rec);
+    return NULL;
+}
+
+void input_record_stop(input_recorder_t *rec)
+{
+    if (rec == NULL) {
+        return;
+    }
+
+    event_loop_remove_fd(rec->fd);
+    close(rec->fd);
+    fclose(rec->file);
+
+    LV_LOG_USER("%u input events recorded", rec->count);
+    free(rec);
+}
+
+int input_recording_load(const char *file, input_recording_t *rec)
+{
+    FILE *f;
+    long size;
+    uint32_t i;
+
+    memset(rec, 0, sizeof(input_recording_t));
+
+    f = fopen(file, "rb");
+    if (f == NULL) {
+        LV_LOG_ERROR("Failed to open %s: %s", file, strerror(errno));
+        return -1;
+    }
+
+    if (fread(&rec->header, sizeof(rec->header), 1, f) != 1 ||
+        memcmp(rec->header.magic, INPUT_RECORD_MAGIC, sizeof(rec->header.magic)) != 0 ||
+        rec->header.version != INPUT_RECORD_VERSION) {
+        LV_LOG_ERROR("%s is not an input recording", file);
+        goto err;
+    }
+
+    if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 ||
+        fseek(f, sizeof(rec->header), SEEK_SET) < 0) {
+        goto err;
+    }
+
+    /* A truncated last event is ignored */
+    rec->count = (uint32_t)((size - (long)sizeof(rec->header)) / sizeof(input_record_event_t));
+
+    if (rec->count == 0) {
+        LV_LOG_WARN("%s contains no events", file);
+        goto err;
+    }
+
+    rec->events = malloc(rec->count * sizeof(input_record_event_t));
+    if (rec->events == NULL ||
+        fread(rec->events, sizeof(input_record_event_t), rec->count, f) != rec->count) {
+        free(rec->events);
+        rec->events = NULL;
+        goto err;
+    }
+
+    fclose(f);
+
+    for (i = 0; i < rec->count; i++) {
+        rec->duration_us += rec->events[i].delta_us;
+
+        if (rec->events[i].type == EV_SYN && rec->events[i].code == SYN_REPORT) {
+            rec->report_cnt++;
+        }
+    }
+
+    return 0;
+
+err:
+    fclose(f);
+    rec->count = 0;
+    return -1;
+}
+
+void input_recording_free(input_recording_t *rec)
+{
+    free(rec->events);
+    memset(rec, 0, sizeof(input_recording_t));
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Append the pending events of the device to the recording
+ *
+ * @note called from the event loop
+ */
+static void record_cb(int fd, uint32_t events, void *user_data)
+{
+    input_recorder_t *rec = user_data;
+    struct input_event in[16];
+    input_record_event_t out;
+    uint64_t ts;
+    ssize_t len;
+    size_t i;
+
+    LV_UNUSED(events);
+
+    while ((len = read(fd, in, sizeof(in))) > 0) {
+        for (i = 0; i < (size_t)len / sizeof(in[0]); i++) {
+            ts = (uint64_t)in[i].input_event_sec * 1000000ULL + (uint64_t)in[i].input_event_usec;
+
+            out.delta_us = rec->last_us == 0 || ts < rec->last_us ? 0 :
+                           (ts - rec->last_us > UINT32_MAX ? UINT32_MAX : (uint32_t)(ts - rec->last_us));
+            out.type = in[i].type;
+            out.code = in[i].code;
+            out.value = in[i].value;
+            rec->last_us = ts;
+
+            if (fwrite(&out, sizeof(out), 1, rec->file) == 1) {
+                rec->count++;
+            }
+        }
+    }
+
+    /* Keep the recording usable if the application is killed */
+    fflush(rec->file);
+}
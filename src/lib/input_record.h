@@ -0,0 +1,111 @@
+/**
+ * @file input_record.h
+ *
+ * Recording of raw evdev events
+ *
+ * A recording starts with an input_record_header_t followed by
+ * input_record_event_t entries, in the byte order of the host.
+ * The timestamps of the events are stored as the delta to the
+ * previous event, which keeps a record at 12 bytes
+ */
+
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define INPUT_RECORD_MAGIC "LVIR"
+#define INPUT_RECORD_VERSION 1
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    int32_t min_x;      /* Calibration of the recorded device, */
+    int32_t min_y;      /* same semantics as lv_evdev_set_calibration */
+    int32_t max_x;
+    int32_t max_y;
+} input_record_header_t;
+
+typedef struct {
+    uint32_t delta_us;  /* Time since the previous event */
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+} input_record_event_t;
+
+/* A recording loaded in memory */
+typedef struct {
+    input_record_header_t header;
+    input_record_event_t *events;
+    uint32_t count;
+    uint32_t report_cnt;    /* Number of SYN_REPORT events */
+    uint64_t duration_us;
+} input_recording_t;
+
+typedef struct _input_recorder_t input_recorder_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Start recording an input device
+ * @description the device is opened a second time and read from the
+ * event loop, so recording works with any driver reading the device
+ * @param device the path of the input device
+ * @param file the path of the recording
+ * @param min_x the raw value mapped to the left edge of the display
+ * @param min_y the raw value mapped to the top edge of the display
+ * @param max_x the raw value mapped to the right edge of the display
+ * @param max_y the raw value mapped to the bottom edge of the display
+ * @return the recorder or NULL on failure
+ */
+input_recorder_t *input_record_start(const char *device, const char *file,
+                                     int32_t min_x, int32_t min_y,
+                                     int32_t max_x, int32_t max_y);
+
+/**
+ * @brief Stop recording
+ * @param rec the recorder
+ */
+void input_record_stop(input_recorder_t *rec);
+
+/**
+ * @brief Load a recording
+ * @param file the path of the recording
+ * @param rec where to store the recording
+ * @return 0 on success, -1 on error
+ */
+int input_recording_load(const char *file, input_recording_t *rec);
+
+/**
+ * @brief Release a recording loaded with input_recording_load
+ * @param rec the recording
+ */
+void input_recording_free(input_recording_t *rec);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*INPUT_RECORD_H*/
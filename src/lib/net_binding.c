@@ -0,0 +1,619 @@
+/**
+ * @file net_binding.c
+ *
+ * Binding of REST endpoints to observer subjects
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "lvgl/lvgl.h"
+#if LV_USE_OBSERVER
+#include <curl/curl.h>
+#include <cjson/cJSON.h>
+
+#include "simulator_util.h"
+#include "event_loop.h"
+#include "frame_stats.h"
+#include "spsc_ring.h"
+#include "net_binding.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define NET_BINDING_MAX_ENDPOINTS 16
+#define NET_BINDING_MAX_BINDINGS 64
+#define NET_BINDING_MAX_WORKERS 8
+#define NET_BINDING_PATH_MAX 128
+
+/* Deltas waiting to be drained per worker */
+#define NET_BINDING_RING_SIZE 256
+
+/* Largest response body accepted */
+#define NET_BINDING_RESPONSE_MAX (1024 * 1024)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_subject_t *subject;
+    uint32_t type;                      /* LV_SUBJECT_TYPE_INT or LV_SUBJECT_TYPE_STRING */
+    char path[NET_BINDING_PATH_MAX];
+    uint32_t endpoint;
+
+    /* The last value pushed, owned by the worker of the endpoint */
+    bool has_last;
+    int32_t last_int;
+    char last_str[NET_BINDING_STR_MAX];
+} binding_t;
+
+typedef struct {
+    char *url;
+    uint32_t period_ms;
+    uint64_t next_us;                   /* Time of the next request */
+} endpoint_t;
+
+/* A value that changed, pushed by a worker */
+typedef struct {
+    uint32_t binding;
+    int32_t value;
+    char str[NET_BINDING_STR_MAX];
+} delta_t;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t index;
+    spsc_ring_t ring;
+} worker_t;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} response_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void stop_workers(void);
+static void *worker_thread(void *arg);
+static void poll_endpoint(worker_t *w, CURL *curl, uint32_t e);
+static bool fetch(CURL *curl, const char *url, response_t *res);
+static size_t write_cb(char *ptr, size_t size, size_t nmemb, void *user_data);
+static const cJSON *find_field(const cJSON *root, const char *path);
+static bool read_value(binding_t *b, const cJSON *field, delta_t *d);
+static void notify_cb(int fd, uint32_t events, void *user_data);
+static void apply_delta(const delta_t *d);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static binding_t bindings[NET_BINDING_MAX_BINDINGS];
+static uint32_t binding_cnt;
+
+static endpoint_t endpoints[NET_BINDING_MAX_ENDPOINTS];
+static uint32_t endpoint_cnt;
+
+static worker_t workers[NET_BINDING_MAX_WORKERS];
+static uint32_t worker_cnt;
+
+static long timeout_ms;
+
+/* Signaled by the workers after pushing deltas */
+static int notify_fd = -1;
+
+/* Protects the schedule of the endpoints and quit */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+static bool running;
+static bool quit;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int net_binding_add(const char *url, const char *path, lv_subject_t *subject, uint32_t period_ms)
+{
+    binding_t *b;
+    uint32_t e;
+
+    if (running || binding_cnt == NET_BINDING_MAX_BINDINGS) {
+        return -1;
+    }
+
+    if (subject->type != LV_SUBJECT_TYPE_INT && subject->type != LV_SUBJECT_TYPE_STRING) {
+        LV_LOG_ERROR("Only integer and string subjects can be bound to %s", url);
+        return -1;
+    }
+
+    for (e = 0; e < endpoint_cnt && strcmp(endpoints[e].url, url) != 0; e++);
+
+    if (e == endpoint_cnt) {
+        if (endpoint_cnt == NET_BINDING_MAX_ENDPOINTS) {
+            return -1;
+        }
+
+        endpoints[e].url = strdup(url);
+        if (endpoints[e].url == NULL) {
+            return -1;
+        }
+
+        endpoints[e].period_ms = period_ms > 0 ? period_ms : 1;
+        endpoints[e].next_us = 0;
+        endpoint_cnt++;
+    }
+
+    b = &bindings[binding_cnt++];
+    memset(b, 0, sizeof(*b));
+    b->subject = subject;
+    b->type = subject->type;
+    b->endpoint = e;
+    snprintf(b->path, sizeof(b->path), "%s", path);
+
+    return 0;
+}
+
+int net_binding_start(void)
+{
+    pthread_condattr_t attr;
+    uint32_t i;
+
+    if (running || endpoint_cnt == 0) {
+        return running ? 0 : -1;
+    }
+
+    worker_cnt = atoi(getenv_default("LV_SIM_NET_WORKERS", "2"));
+    worker_cnt = LV_CLAMP(1, worker_cnt, NET_BINDING_MAX_WORKERS);
+    worker_cnt = LV_MIN(worker_cnt, endpoint_cnt);
+    timeout_ms = atol(getenv_default("LV_SIM_NET_TIMEOUT_MS", "5000"));
+
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        LV_LOG_ERROR("Failed to initialize curl");
+        return -1;
+    }
+
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_fd < 0 || event_loop_add_fd(notify_fd, EPOLLIN, notify_cb, NULL) < 0) {
+        LV_LOG_ERROR("Failed to watch the network updates");
+        if (notify_fd >= 0) {
+            close(notify_fd);
+            notify_fd = -1;
+        }
+        curl_global_cleanup();
+        return -1;
+    }
+
+    /* The schedule follows the clock of frame_stats_now_us */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    quit = false;
+    running = true;
+
+    for (i = 0; i < worker_cnt; i++) {
+        workers[i].index = i;
+
+        if (spsc_ring_init(&workers[i].ring, NET_BINDING_RING_SIZE, sizeof(delta_t)) < 0 ||
+            pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]) != 0) {
+            LV_LOG_ERROR("Failed to start the network worker %u", i);
+            spsc_ring_deinit(&workers[i].ring);
+
+            /* The stride of the workers already running */
+            pthread_mutex_lock(&lock);
+            worker_cnt = i;
+            pthread_mutex_unlock(&lock);
+
+            /* The bindings stay registered, net_binding_start can be called again */
+            stop_workers();
+            return -1;
+        }
+    }
+
+    LV_LOG_INFO("Polling %u endpoints with %u workers", endpoint_cnt, worker_cnt);
+    return 0;
+}
+
+void net_binding_stop(void)
+{
+    uint32_t i;
+
+    if (!running) {
+        return;
+    }
+
+    stop_workers();
+
+    for (i = 0; i < endpoint_cnt; i++) {
+        free(endpoints[i].url);
+    }
+
+    endpoint_cnt = 0;
+    binding_cnt = 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Stop the running workers and release what net_binding_start created
+ *
+ * @description the endpoints and the bindings are kept
+ */
+static void stop_workers(void)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&lock);
+    quit = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    for (i = 0; i < worker_cnt; i++) {
+        pthread_join(workers[i].thread, NULL);
+        spsc_ring_deinit(&workers[i].ring);
+    }
+
+    event_loop_remove_fd(notify_fd);
+    close(notify_fd);
+    notify_fd = -1;
+
+    pthread_cond_destroy(&cond);
+    curl_global_cleanup();
+
+    worker_cnt = 0;
+    running = false;
+}
+
+/**
+ * Poll the endpoints of a worker
+ *
+ * @description the endpoints are distributed round robin, a worker
+ * sleeps until its next request is due or the workers are stopped
+ * @param arg the worker
+ * @return NULL
+ */
+static void *worker_thread(void *arg)
+{
+    worker_t *w = arg;
+    struct timespec ts;
+    uint64_t now;
+    uint64_t next;
+    uint32_t e;
+    CURL *curl;
+
+    curl = curl_easy_init();
+    if (curl == NULL) {
+        LV_LOG_ERROR("Failed to create a curl handle");
+        return NULL;
+    }
+
+    /* The connections are kept alive between the requests of the handle */
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+
+    pthread_mutex_lock(&lock);
+
+    while (!quit) {
+        next = UINT64_MAX;
+
+        for (e = w->index; e < endpoint_cnt; e += worker_cnt) {
+            now = frame_stats_now_us();
+
+            if (endpoints[e].next_us <= now) {
+                pthread_mutex_unlock(&lock);
+                poll_endpoint(w, curl, e);
+                pthread_mutex_lock(&lock);
+
+                endpoints[e].next_us = now + (uint64_t)endpoints[e].period_ms * 1000;
+            }
+
+            next = LV_MIN(next, endpoints[e].next_us);
+        }
+
+        if (quit) {
+            break;
+        }
+
+        ts.tv_sec = (time_t)(next / 1000000);
+        ts.tv_nsec = (long)(next % 1000000) * 1000;
+        pthread_cond_timedwait(&cond, &lock, &ts);
+    }
+
+    pthread_mutex_unlock(&lock);
+    curl_easy_cleanup(curl);
+
+    return NULL;
+}
+
+/**
+ * Fetch an endpoint and push the values of its bindings that changed
+ *
+ * @param w the worker
+ * @param curl the curl handle of the worker
+ * @param e the index of the endpoint
+ */
+static void poll_endpoint(worker_t *w, CURL *curl, uint32_t e)
+{
+    response_t res = { 0 };
+    const cJSON *field;
+    cJSON *root;
+    binding_t *b;
+    bool pushed = false;
+    uint64_t one = 1;
+    delta_t d;
+    uint32_t i;
+
+    if (!fetch(curl, endpoints[e].url, &res)) {
+        free(res.data);
+        return;
+    }
+
+    root = cJSON_ParseWithLength(res.data, res.len);
+    free(res.data);
+
+    if (root == NULL) {
+        LV_LOG_WARN("Invalid JSON from %s", endpoints[e].url);
+        return;
+    }
+
+    for (i = 0; i < binding_cnt; i++) {
+        b = &bindings[i];
+
+        if (b->endpoint != e) {
+            continue;
+        }
+
+        field = find_field(root, b->path);
+        if (field == NULL || !read_value(b, field, &d)) {
+            continue;
+        }
+
+        d.binding = i;
+
+        if (!spsc_ring_push(&w->ring, &d)) {
+            /* Pushed again with the next response */
+            b->has_last = false;
+            continue;
+        }
+
+        pushed = true;
+    }
+
+    cJSON_Delete(root);
+
+    if (pushed && write(notify_fd, &one, sizeof(one)) < 0) {
+        LV_LOG_WARN("Failed to signal the network updates: %s", strerror(errno));
+    }
+}
+
+/**
+ * Perform a GET request
+ *
+ * @param curl the curl handle
+ * @param url the URL
+ * @param res where to store the body, to be freed by the caller
+ * @return true if the request succeeded with a 2xx status
+ */
+static bool fetch(CURL *curl, const char *url, response_t *res)
+{
+    CURLcode ret;
+    long status = 0;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, res);
+
+    ret = curl_easy_perform(curl);
+    if (ret != CURLE_OK) {
+        LV_LOG_WARN("GET %s failed: %s", url, curl_easy_strerror(ret));
+        return false;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status < 200 || status >= 300) {
+        LV_LOG_WARN("GET %s returned %ld", url, status);
+        return false;
+    }
+
+    return res->data != NULL;
+}
+
+/**
+ * Append a chunk of the body to the response
+ *
+ * @return the number of bytes consumed, less aborts the transfer
+ */
+static size_t write_cb(char *ptr, size_t size, size_t nmemb, void *user_data)
+{
+    response_t *res = user_data;
+    size_t n = size * nmemb;
+    size_t cap;
+    char *data;
+
+    if (res->len + n > NET_BINDING_RESPONSE_MAX) {
+        return 0;
+    }
+
+    if (res->len + n > res->cap) {
+        cap = LV_MAX(res->cap * 2, res->len + n);
+        data = realloc(res->data, cap);
+
+        if (data == NULL) {
+            return 0;
+        }
+
+        res->data = data;
+        res->cap = cap;
+    }
+
+    memcpy(res->data + res->len, ptr, n);
+    res->len += n;
+
+    return n;
+}
+
+/**
+ * Find a field by its path
+ *
+ * @param root the parsed response
+ * @param path object keys and array indices separated by dots
+ * @return the field or NULL
+ */
+static const cJSON *find_field(const cJSON *root, const char *path)
+{
+    char key[NET_BINDING_PATH_MAX];
+    const cJSON *node = root;
+    const char *end;
+    size_t len;
+    char *num_end;
+    long idx;
+
+    while (node != NULL && *path != '\0') {
+        end = strchr(path, '.');
+        len = end != NULL ? (size_t)(end - path) : strlen(path);
+
+        snprintf(key, sizeof(key), "%.*s", (int)len, path);
+
+        idx = strtol(key, &num_end, 10);
+        if (cJSON_IsArray(node) && *num_end == '\0' && num_end != key) {
+            node = cJSON_GetArrayItem(node, (int)idx);
+        } else {
+            node = cJSON_GetObjectItemCaseSensitive(node, key);
+        }
+
+        path += len;
+        if (*path == '.') {
+            path++;
+        }
+    }
+
+    return node;
+}
+
+/**
+ * Read the value of a field if it changed since the last push
+ *
+ * @param b the binding
+ * @param field the field
+ * @param d where to store the delta
+ * @return true if the value changed
+ */
+static bool read_value(binding_t *b, const cJSON *field, delta_t *d)
+{
+    double num;
+    int32_t v;
+
+    if (b->type == LV_SUBJECT_TYPE_INT) {
+        if (cJSON_IsNumber(field)) {
+            /* Saturated, the responses are not trusted */
+            num = field->valuedouble;
+            if (num != num) {
+                v = 0;
+            } else if (num >= (double)INT32_MAX) {
+                v = INT32_MAX;
+            } else if (num <= (double)INT32_MIN) {
+                v = INT32_MIN;
+            } else {
+                v = (int32_t)num;
+            }
+        } else if (cJSON_IsBool(field)) {
+            v = cJSON_IsTrue(field) ? 1 : 0;
+        } else {
+            return false;
+        }
+
+        if (b->has_last && b->last_int == v) {
+            return false;
+        }
+
+        b->last_int = v;
+        d->value = v;
+    } else {
+        if (!cJSON_IsString(field)) {
+            return false;
+        }
+
+        if (b->has_last && strncmp(b->last_str, field->valuestring, sizeof(b->last_str) - 1) == 0) {
+            return false;
+        }
+
+        snprintf(b->last_str, sizeof(b->last_str), "%s", field->valuestring);
+        snprintf(d->str, sizeof(d->str), "%s", field->valuestring);
+    }
+
+    b->has_last = true;
+    return true;
+}
+
+/**
+ * Drain the deltas of all the workers
+ *
+ * @description called from the event loop with the LVGL lock held, the
+ * widgets are invalidated once and redrawn by the next refresh
+ */
+static void notify_cb(int fd, uint32_t events, void *user_data)
+{
+    uint64_t cnt;
+    delta_t d;
+    uint32_t i;
+
+    LV_UNUSED(events);
+    LV_UNUSED(user_data);
+
+    if (read(fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) {
+        return;
+    }
+
+    for (i = 0; i < worker_cnt; i++) {
+        while (spsc_ring_pop(&workers[i].ring, &d)) {
+            apply_delta(&d);
+        }
+    }
+}
+
+/**
+ * Set the subject of a delta
+ *
+ * @description the observers are only notified if the value differs
+ * @param d the delta
+ */
+static void apply_delta(const delta_t *d)
+{
+    binding_t *b = &bindings[d->binding];
+
+    if (b->type == LV_SUBJECT_TYPE_INT) {
+        if (lv_subject_get_int(b->subject) != d->value) {
+            lv_subject_set_int(b->subject, d->value);
+        }
+    } else if (strcmp(lv_subject_get_string(b->subject), d->str) != 0) {
+        lv_subject_copy_string(b->subject, d->str);
+    }
+}
+
+#endif /*LV_USE_OBSERVER*/
@@ -0,0 +1,83 @@
+/**
+ * @file net_binding.h
+ *
+ * Binding of REST endpoints to observer subjects
+ *
+ * The endpoints are polled by a pool of worker threads
+ * (LV_SIM_NET_WORKERS, 2 by default) that fetch them with curl and parse
+ * the responses with cJSON, off the LVGL thread. The values of the bound
+ * fields that changed are pushed as deltas into a lock-free ring per
+ * worker. The LVGL thread drains the rings in one batch when woken up by
+ * the event loop, before the next refresh, so that a burst of updates
+ * costs a single redraw. A value equal to the one of the subject doesn't
+ * notify the observers
+ */
+
+#ifndef NET_BINDING_H
+#define NET_BINDING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Longest string value, the longer ones are truncated */
+#define NET_BINDING_STR_MAX 128
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Bind a field of the JSON response of an endpoint to a subject
+ * @description the field is selected by a path of object keys and array
+ * indices separated by dots, i.e "sensors.0.temperature". A number or
+ * a boolean sets an integer subject, a string sets a string subject.
+ * The bindings of the same URL share one request, polled with the
+ * period of the first binding. Must be called before net_binding_start
+ * @param url the URL of the endpoint, copied
+ * @param path the path of the field, copied
+ * @param subject an integer or string subject
+ * @param period_ms the polling period
+ * @return 0 on success, -1 on error
+ */
+int net_binding_add(const char *url, const char *path, lv_subject_t *subject, uint32_t period_ms);
+
+/**
+ * @brief Start polling the endpoints
+ * @description the event loop must be initialized. On error the workers
+ * already started are stopped, the bindings stay registered
+ * @return 0 on success, -1 on error
+ */
+int net_binding_start(void);
+
+/**
+ * @brief Stop the workers
+ * @description the pending requests are completed first,
+ * the deltas that were not drained yet are dropped
+ */
+void net_binding_stop(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*NET_BINDING_H*/
@@ -0,0 +1,717 @@
+/**
+ * @file pixel_convert.c
+ *
+ * Pixel format conversion and rotation kernels used by the flush paths
+ *
+ * @note this file doesn't depend on LVGL so that it
+ * can be built in the microbenchmark
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#include "pixel_convert.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Side in pixels of the tiles of the transpose, the source
+ * and the destination tiles fit together in the L1 cache */
+#define TRANSPOSE_TILE 32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Transposes a block of one 128-bit vector per row: 4x4 at 32 bpp, 8x8 at 16 bpp */
+typedef void (*transpose_block_t)(uint8_t *dst, ptrdiff_t dst_stride,
+                                  const uint8_t *src, ptrdiff_t src_stride);
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void scalar_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                      uint32_t flags, uint32_t x, uint32_t y);
+static void scalar_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n);
+static void scalar_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                             uint32_t w, uint32_t h, uint32_t px_size);
+
+#if PIXEL_CONVERT_X86
+static void sse2_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y);
+static void sse2_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n);
+static void sse2_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                           uint32_t w, uint32_t h, uint32_t px_size);
+static void avx2_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y);
+static void avx2_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n);
+#endif
+
+#if PIXEL_CONVERT_NEON
+static void neon_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y);
+static void neon_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n);
+static void neon_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                           uint32_t w, uint32_t h, uint32_t px_size);
+#endif
+
+static void detect_cpu(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/* 4x4 Bayer matrix */
+static const uint8_t bayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+static const pixel_convert_ops_t scalar_ops = {
+    .name = "scalar",
+    .xrgb8888_to_rgb565 = scalar_xrgb8888_to_rgb565,
+    .rgb565_swap = scalar_rgb565_swap,
+    .transpose = scalar_transpose,
+};
+
+#if PIXEL_CONVERT_X86
+static const pixel_convert_ops_t sse2_ops = {
+    .name = "sse2",
+    .xrgb8888_to_rgb565 = sse2_xrgb8888_to_rgb565,
+    .rgb565_swap = sse2_rgb565_swap,
+    .transpose = sse2_transpose,
+};
+
+static const pixel_convert_ops_t avx2_ops = {
+    .name = "avx2",
+    .xrgb8888_to_rgb565 = avx2_xrgb8888_to_rgb565,
+    .rgb565_swap = avx2_rgb565_swap,
+    /* A 256-bit transpose needs cross-lane permutes, the SSE2 one is as fast */
+    .transpose = sse2_transpose,
+};
+#endif
+
+#if PIXEL_CONVERT_NEON
+static const pixel_convert_ops_t neon_ops = {
+    .name = "neon",
+    .xrgb8888_to_rgb565 = neon_xrgb8888_to_rgb565,
+    .rgb565_swap = neon_rgb565_swap,
+    .transpose = neon_transpose,
+};
+#endif
+
+/* Supported implementations, the fastest one last */
+static const pixel_convert_ops_t *supported_ops[4];
+static uint32_t supported_cnt;
+
+/**********************
+ *      MACROS
+ **********************/
+
+#define PIXEL_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Dither thresholds for the 3 bits dropped from R/B and the 2 bits dropped from G */
+#define DITHER_RB(y, x) (bayer4[(y) & 3][(x) & 3] >> 1)
+#define DITHER_G(y, x)  (bayer4[(y) & 3][(x) & 3] >> 2)
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+const pixel_convert_ops_t *pixel_convert_get_ops(void)
+{
+    const char *force_scalar;
+
+    detect_cpu();
+
+    force_scalar = getenv("PIXEL_CONVERT_SCALAR");
+    if (force_scalar != NULL && force_scalar[0] == '1') {
+        return &scalar_ops;
+    }
+
+    return supported_ops[supported_cnt - 1];
+}
+
+const pixel_convert_ops_t *pixel_convert_get_ops_by_index(uint32_t idx)
+{
+    detect_cpu();
+
+    if (idx >= supported_cnt) {
+        return NULL;
+    }
+
+    return supported_ops[idx];
+}
+
+void pixel_convert_rotate(const pixel_convert_ops_t *ops, uint8_t *dst, uint32_t dst_stride,
+                          const uint8_t *src, uint32_t src_stride, uint32_t px_size,
+                          uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                          uint32_t scr_w, uint32_t scr_h, uint32_t rotation)
+{
+    ptrdiff_t ds = dst_stride;
+    ptrdiff_t ss = src_stride;
+    uint32_t i, j;
+
+    switch (rotation) {
+    case 90:
+        /* (x, y) goes to (scr_h - 1 - y, x): transpose the rows bottom to top */
+        dst += (size_t)x * ds + (size_t)(scr_h - y - h) * px_size;
+        ops->transpose(dst, ds, src + (ptrdiff_t)(h - 1) * ss, -ss, w, h, px_size);
+        break;
+
+    case 270:
+        /* (x, y) goes to (y, scr_w - 1 - x): transpose into the rows bottom to top */
+        dst += (size_t)(scr_w - x - 1) * ds + (size_t)y * px_size;
+        ops->transpose(dst, -ds, src, ss, w, h, px_size);
+        break;
+
+    case 180:
+        /* Sequential on both sides, bound by the memory bandwidth */
+        dst += (size_t)(scr_h - y - 1) * ds + (size_t)(scr_w - x - w) * px_size;
+
+        for (j = 0; j < h; j++) {
+            if (px_size == 4) {
+                for (i = 0; i < w; i++) {
+                    ((uint32_t *)dst)[i] = ((const uint32_t *)src)[w - 1 - i];
+                }
+            } else {
+                for (i = 0; i < w; i++) {
+                    ((uint16_t *)dst)[i] = ((const uint16_t *)src)[w - 1 - i];
+                }
+            }
+            src += ss;
+            dst -= ds;
+        }
+        break;
+
+    default:
+        dst += (size_t)y * ds + (size_t)x * px_size;
+
+        for (j = 0; j < h; j++) {
+            memcpy(dst, src, (size_t)w * px_size);
+            src += ss;
+            dst += ds;
+        }
+        break;
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Fill the table of implementations supported by the CPU
+ */
+static void detect_cpu(void)
+{
+    if (supported_cnt != 0) {
+        return;
+    }
+
+    supported_ops[supported_cnt++] = &scalar_ops;
+
+#if PIXEL_CONVERT_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2")) {
+        supported_ops[supported_cnt++] = &sse2_ops;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        supported_ops[supported_cnt++] = &avx2_ops;
+    }
+#endif
+
+#if PIXEL_CONVERT_NEON
+#if defined(__arm__)
+    /* NEON is optional on 32-bit ARM */
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+        supported_ops[supported_cnt++] = &neon_ops;
+    }
+#else
+    supported_ops[supported_cnt++] = &neon_ops;
+#endif
+#endif
+}
+
+static inline uint16_t pack_rgb565(uint32_t px, uint32_t flags, uint32_t x, uint32_t y)
+{
+    uint32_t r = (px >> 16) & 0xFF;
+    uint32_t g = (px >> 8) & 0xFF;
+    uint32_t b = px & 0xFF;
+    uint16_t out;
+
+    if (flags & PIXEL_CONVERT_DITHER) {
+        /* Saturating like the SIMD implementations */
+        r = PIXEL_MIN(r + DITHER_RB(y, x), 255U);
+        g = PIXEL_MIN(g + DITHER_G(y, x), 255U);
+        b = PIXEL_MIN(b + DITHER_RB(y, x), 255U);
+    }
+
+    out = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+
+    if (flags & PIXEL_CONVERT_SWAP) {
+        out = (uint16_t)((out << 8) | (out >> 8));
+    }
+
+    return out;
+}
+
+static void scalar_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                      uint32_t flags, uint32_t x, uint32_t y)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        dst[i] = pack_rgb565(src[i], flags, x + i, y);
+    }
+}
+
+static void scalar_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        dst[i] = (uint16_t)((src[i] << 8) | (src[i] >> 8));
+    }
+}
+
+/**
+ * Transpose pixel by pixel, used for the edges of the tiles
+ */
+static void transpose_pixels(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *src,
+                             ptrdiff_t src_stride, uint32_t w, uint32_t h, uint32_t px_size)
+{
+    const uint8_t *s;
+    uint8_t *d;
+    uint32_t x, y;
+
+    for (y = 0; y < h; y++) {
+        s = src + (ptrdiff_t)y * src_stride;
+        d = dst + (size_t)y * px_size;
+
+        if (px_size == 4) {
+            for (x = 0; x < w; x++) {
+                *(uint32_t *)(d + (ptrdiff_t)x * dst_stride) = ((const uint32_t *)s)[x];
+            }
+        } else {
+            for (x = 0; x < w; x++) {
+                *(uint16_t *)(d + (ptrdiff_t)x * dst_stride) = ((const uint16_t *)s)[x];
+            }
+        }
+    }
+}
+
+/**
+ * Transpose a rectangle tile by tile
+ *
+ * @description within a tile, the full blocks are transposed with the
+ * vector kernel and the remaining columns and rows pixel by pixel.
+ * Inlined in each implementation so that the kernel call is direct
+ * @param kernel the block kernel or NULL to only transpose pixel by pixel
+ */
+static inline void transpose_tiled(uint8_t *dst, ptrdiff_t dst_stride, const uint8_t *src,
+                                   ptrdiff_t src_stride, uint32_t w, uint32_t h, uint32_t px_size,
+                                   transpose_block_t kernel)
+{
+    uint32_t bs = 16 / px_size;
+    uint32_t tx, ty, tw, th;
+    uint32_t bw, bh;
+    uint32_t x, y;
+    const uint8_t *s;
+    uint8_t *d;
+
+    for (ty = 0; ty < h; ty += TRANSPOSE_TILE) {
+        th = PIXEL_MIN(TRANSPOSE_TILE, h - ty);
+
+        for (tx = 0; tx < w; tx += TRANSPOSE_TILE) {
+            tw = PIXEL_MIN(TRANSPOSE_TILE, w - tx);
+            s = src + (ptrdiff_t)ty * src_stride + (size_t)tx * px_size;
+            d = dst + (ptrdiff_t)tx * dst_stride + (size_t)ty * px_size;
+            bw = 0;
+            bh = 0;
+
+            if (kernel != NULL) {
+                bw = tw - tw % bs;
+                bh = th - th % bs;
+
+                for (y = 0; y < bh; y += bs) {
+                    for (x = 0; x < bw; x += bs) {
+                        kernel(d + (ptrdiff_t)x * dst_stride + (size_t)y * px_size, dst_stride,
+                               s + (ptrdiff_t)y * src_stride + (size_t)x * px_size, src_stride);
+                    }
+                }
+            }
+
+            /* The columns right of the blocks, then the rows below them */
+            transpose_pixels(d + (ptrdiff_t)bw * dst_stride, dst_stride, s + (size_t)bw * px_size,
+                             src_stride, tw - bw, th, px_size);
+            transpose_pixels(d + (size_t)bh * px_size, dst_stride, s + (ptrdiff_t)bh * src_stride,
+                             src_stride, bw, th - bh, px_size);
+        }
+    }
+}
+
+static void scalar_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                             uint32_t w, uint32_t h, uint32_t px_size)
+{
+    transpose_tiled(dst, dst_stride, src, src_stride, w, h, px_size, NULL);
+}
+
+#if PIXEL_CONVERT_X86
+
+/**
+ * Build the dither thresholds of 4 consecutive XRGB8888 pixels
+ *
+ * @description the pattern repeats every 4 columns, so the same
+ * vector is valid for every group of 4 pixels of the row
+ */
+static inline uint32_t dither_word(uint32_t x, uint32_t y)
+{
+    return ((uint32_t)DITHER_RB(y, x) << 16) | ((uint32_t)DITHER_G(y, x) << 8) |
+           (uint32_t)DITHER_RB(y, x);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_pack4(__m128i px)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(px, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(px, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(px, 3), _mm_set1_epi32(0x001F));
+    __m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+
+    /* Sign extend the low half so that packs doesn't saturate */
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("sse2")))
+static void sse2_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y)
+{
+    __m128i dv = _mm_setr_epi32(dither_word(x, y), dither_word(x + 1, y),
+                                dither_word(x + 2, y), dither_word(x + 3, y));
+    bool dither = (flags & PIXEL_CONVERT_DITHER) != 0;
+    bool swap = (flags & PIXEL_CONVERT_SWAP) != 0;
+    __m128i p0, p1, out;
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        p0 = _mm_loadu_si128((const __m128i *)(src + i));
+        p1 = _mm_loadu_si128((const __m128i *)(src + i + 4));
+
+        if (dither) {
+            p0 = _mm_adds_epu8(p0, dv);
+            p1 = _mm_adds_epu8(p1, dv);
+        }
+
+        out = _mm_packs_epi32(sse2_pack4(p0), sse2_pack4(p1));
+
+        if (swap) {
+            out = _mm_or_si128(_mm_slli_epi16(out, 8), _mm_srli_epi16(out, 8));
+        }
+
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+
+    scalar_xrgb8888_to_rgb565(dst + i, src + i, n - i, flags, x + i, y);
+}
+
+__attribute__((target("sse2")))
+static void sse2_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n)
+{
+    __m128i v;
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(src + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+
+    scalar_rgb565_swap(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static inline void sse2_transpose_block32(uint8_t *dst, ptrdiff_t dst_stride,
+                                          const uint8_t *src, ptrdiff_t src_stride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)src);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + src_stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * src_stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * src_stride));
+
+    /* a0 b0 a1 b1, a2 b2 a3 b3, c0 d0 c1 d1, c2 d2 c3 d3 */
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)(dst + dst_stride), _mm_unpackhi_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dst_stride), _mm_unpacklo_epi64(t1, t3));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dst_stride), _mm_unpackhi_epi64(t1, t3));
+}
+
+__attribute__((target("sse2")))
+static inline void sse2_transpose_block16(uint8_t *dst, ptrdiff_t dst_stride,
+                                          const uint8_t *src, ptrdiff_t src_stride)
+{
+    __m128i r[8];
+    __m128i a[8];
+    __m128i b[8];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_stride));
+    }
+
+    /* Interleave the pixels of row pairs, then pairs of pixels, then quads */
+    for (i = 0; i < 4; i++) {
+        a[2 * i] = _mm_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+        a[2 * i + 1] = _mm_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        b[4 * i] = _mm_unpacklo_epi32(a[4 * i], a[4 * i + 2]);
+        b[4 * i + 1] = _mm_unpackhi_epi32(a[4 * i], a[4 * i + 2]);
+        b[4 * i + 2] = _mm_unpacklo_epi32(a[4 * i + 1], a[4 * i + 3]);
+        b[4 * i + 3] = _mm_unpackhi_epi32(a[4 * i + 1], a[4 * i + 3]);
+    }
+
+    for (i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *)(dst + 2 * i * dst_stride), _mm_unpacklo_epi64(b[i], b[i + 4]));
+        _mm_storeu_si128((__m128i *)(dst + (2 * i + 1) * dst_stride),
+                         _mm_unpackhi_epi64(b[i], b[i + 4]));
+    }
+}
+
+__attribute__((target("sse2")))
+static void sse2_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                           uint32_t w, uint32_t h, uint32_t px_size)
+{
+    if (px_size == 4) {
+        transpose_tiled(dst, dst_stride, src, src_stride, w, h, 4, sse2_transpose_block32);
+    } else {
+        transpose_tiled(dst, dst_stride, src, src_stride, w, h, 2, sse2_transpose_block16);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_pack8(__m256i px)
+{
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 8), _mm256_set1_epi32(0xF800));
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 5), _mm256_set1_epi32(0x07E0));
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(px, 3), _mm256_set1_epi32(0x001F));
+    __m256i v = _mm256_or_si256(_mm256_or_si256(r, g), b);
+
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("avx2")))
+static void avx2_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y)
+{
+    __m256i dv = _mm256_setr_epi32(dither_word(x, y), dither_word(x + 1, y),
+                                   dither_word(x + 2, y), dither_word(x + 3, y),
+                                   dither_word(x, y), dither_word(x + 1, y),
+                                   dither_word(x + 2, y), dither_word(x + 3, y));
+    bool dither = (flags & PIXEL_CONVERT_DITHER) != 0;
+    bool swap = (flags & PIXEL_CONVERT_SWAP) != 0;
+    __m256i p0, p1, out;
+    uint32_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        p0 = _mm256_loadu_si256((const __m256i *)(src + i));
+        p1 = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+
+        if (dither) {
+            p0 = _mm256_adds_epu8(p0, dv);
+            p1 = _mm256_adds_epu8(p1, dv);
+        }
+
+        /* packs works per 128-bit lane - restore the order of the quadwords */
+        out = _mm256_packs_epi32(avx2_pack8(p0), avx2_pack8(p1));
+        out = _mm256_permute4x64_epi64(out, 0xD8);
+
+        if (swap) {
+            out = _mm256_or_si256(_mm256_slli_epi16(out, 8), _mm256_srli_epi16(out, 8));
+        }
+
+        _mm256_storeu_si256((__m256i *)(dst + i), out);
+    }
+
+    sse2_xrgb8888_to_rgb565(dst + i, src + i, n - i, flags, x + i, y);
+}
+
+__attribute__((target("avx2")))
+static void avx2_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n)
+{
+    __m256i v;
+    uint32_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        v = _mm256_loadu_si256((const __m256i *)(src + i));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+
+    sse2_rgb565_swap(dst + i, src + i, n - i);
+}
+
+#endif /*PIXEL_CONVERT_X86*/
+
+#if PIXEL_CONVERT_NEON
+
+static void neon_xrgb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint32_t n,
+                                    uint32_t flags, uint32_t x, uint32_t y)
+{
+    uint8_t rb[8];
+    uint8_t g[8];
+    uint8x8_t drb, dg;
+    uint8x8x4_t p;
+    uint16x8_t out;
+    bool dither = (flags & PIXEL_CONVERT_DITHER) != 0;
+    bool swap = (flags & PIXEL_CONVERT_SWAP) != 0;
+    uint32_t i;
+
+    for (i = 0; i < 8; i++) {
+        rb[i] = DITHER_RB(y, x + i);
+        g[i] = DITHER_G(y, x + i);
+    }
+
+    drb = vld1_u8(rb);
+    dg = vld1_u8(g);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        /* De-interleave into B, G, R, X planes */
+        p = vld4_u8((const uint8_t *)(src + i));
+
+        if (dither) {
+            p.val[0] = vqadd_u8(p.val[0], drb);
+            p.val[1] = vqadd_u8(p.val[1], dg);
+            p.val[2] = vqadd_u8(p.val[2], drb);
+        }
+
+        out = vshll_n_u8(p.val[2], 8);
+        out = vsriq_n_u16(out, vshll_n_u8(p.val[1], 8), 5);
+        out = vsriq_n_u16(out, vshll_n_u8(p.val[0], 8), 11);
+
+        if (swap) {
+            out = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(out)));
+        }
+
+        vst1q_u16(dst + i, out);
+    }
+
+    scalar_xrgb8888_to_rgb565(dst + i, src + i, n - i, flags, x + i, y);
+}
+
+static void neon_rgb565_swap(uint16_t *dst, const uint16_t *src, uint32_t n)
+{
+    uint8x16_t v;
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        v = vld1q_u8((const uint8_t *)(src + i));
+        vst1q_u8((uint8_t *)(dst + i), vrev16q_u8(v));
+    }
+
+    scalar_rgb565_swap(dst + i, src + i, n - i);
+}
+
+static inline void neon_transpose_block32(uint8_t *dst, ptrdiff_t dst_stride,
+                                          const uint8_t *src, ptrdiff_t src_stride)
+{
+    uint32x4_t r0 = vld1q_u32((const uint32_t *)src);
+    uint32x4_t r1 = vld1q_u32((const uint32_t *)(src + src_stride));
+    uint32x4_t r2 = vld1q_u32((const uint32_t *)(src + 2 * src_stride));
+    uint32x4_t r3 = vld1q_u32((const uint32_t *)(src + 3 * src_stride));
+
+    /* a0 b0 a2 b2 / a1 b1 a3 b3 and c0 d0 c2 d2 / c1 d1 c3 d3 */
+    uint32x4x2_t t01 = vtrnq_u32(r0, r1);
+    uint32x4x2_t t23 = vtrnq_u32(r2, r3);
+
+    vst1q_u32((uint32_t *)dst, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+    vst1q_u32((uint32_t *)(dst + dst_stride),
+              vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+    vst1q_u32((uint32_t *)(dst + 2 * dst_stride),
+              vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+    vst1q_u32((uint32_t *)(dst + 3 * dst_stride),
+              vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+}
+
+static inline void neon_transpose_block16(uint8_t *dst, ptrdiff_t dst_stride,
+                                          const uint8_t *src, ptrdiff_t src_stride)
+{
+    uint16x8_t r[8];
+    uint16x8x2_t t[4];
+    uint32x4x2_t u[4];
+    uint32x4_t lo;
+    uint32x4_t hi;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r[i] = vld1q_u16((const uint16_t *)(src + i * src_stride));
+    }
+
+    /* Transpose the 2x2 blocks of pixels, then the 2x2 blocks of pixel pairs */
+    for (i = 0; i < 4; i++) {
+        t[i] = vtrnq_u16(r[2 * i], r[2 * i + 1]);
+    }
+
+    u[0] = vtrnq_u32(vreinterpretq_u32_u16(t[0].val[0]), vreinterpretq_u32_u16(t[1].val[0]));
+    u[1] = vtrnq_u32(vreinterpretq_u32_u16(t[0].val[1]), vreinterpretq_u32_u16(t[1].val[1]));
+    u[2] = vtrnq_u32(vreinterpretq_u32_u16(t[2].val[0]), vreinterpretq_u32_u16(t[3].val[0]));
+    u[3] = vtrnq_u32(vreinterpretq_u32_u16(t[2].val[1]), vreinterpretq_u32_u16(t[3].val[1]));
+
+    /* Column c is in u[c & 1].val[(c >> 1) & 1] of rows 0-3 and 4-7, low half for c < 4 */
+    for (i = 0; i < 8; i++) {
+        lo = u[i & 1].val[(i >> 1) & 1];
+        hi = u[2 + (i & 1)].val[(i >> 1) & 1];
+
+        if (i < 4) {
+            lo = vcombine_u32(vget_low_u32(lo), vget_low_u32(hi));
+        } else {
+            lo = vcombine_u32(vget_high_u32(lo), vget_high_u32(hi));
+        }
+
+        vst1q_u16((uint16_t *)(dst + i * dst_stride), vreinterpretq_u16_u32(lo));
+    }
+}
+
+static void neon_transpose(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                           uint32_t w, uint32_t h, uint32_t px_size)
+{
+    if (px_size == 4) {
+        transpose_tiled(dst, dst_stride, src, src_stride, w, h, 4, neon_transpose_block32);
+    } else {
+        transpose_tiled(dst, dst_stride, src, src_stride, w, h, 2, neon_transpose_block16);
+    }
+}
+
+#endif /*PIXEL_CONVERT_NEON*/
@@ -0,0 +1,126 @@
+/**
+ * @file pixel_convert.h
+ *
+ * Pixel format conversion and rotation kernels used by the flush paths
+ *
+ * Scalar, SSE2, AVX2 and NEON implementations are compiled
+ * depending on the target, the fastest one supported by the CPU
+ * is selected at runtime
+ */
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Apply a 4x4 ordered dither before truncating to RGB565 */
+#define PIXEL_CONVERT_DITHER (1U << 0)
+
+/* Swap the bytes of the RGB565 output (RGB565_SWAPPED panels) */
+#define PIXEL_CONVERT_SWAP   (1U << 1)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    const char *name;
+
+    /**
+     * Convert a row of XRGB8888 pixels to RGB565
+     * @param dst the destination row
+     * @param src the source row
+     * @param n the number of pixels
+     * @param flags PIXEL_CONVERT_DITHER and/or PIXEL_CONVERT_SWAP
+     * @param x the screen column of the first pixel, selects the dither pattern
+     * @param y the screen row, selects the dither pattern
+     */
+    void (*xrgb8888_to_rgb565)(uint16_t *dst, const uint32_t *src, uint32_t n,
+                               uint32_t flags, uint32_t x, uint32_t y);
+
+    /**
+     * Swap the bytes of a row of RGB565 pixels
+     * @param dst the destination row, can be the same as src
+     * @param src the source row
+     * @param n the number of pixels
+     */
+    void (*rgb565_swap)(uint16_t *dst, const uint16_t *src, uint32_t n);
+
+    /**
+     * Transpose a rectangle of 16 or 32 bpp pixels, dst[x][y] = src[y][x]
+     * @param dst the first pixel of the destination, w rows of h pixels
+     * @param dst_stride the distance between two rows of dst in bytes, can be negative
+     * @param src the first pixel of the source, h rows of w pixels
+     * @param src_stride the distance between two rows of src in bytes, can be negative
+     * @param w the width of the source
+     * @param h the height of the source
+     * @param px_size the size of a pixel in bytes, 2 or 4
+     */
+    void (*transpose)(void *dst, ptrdiff_t dst_stride, const void *src, ptrdiff_t src_stride,
+                      uint32_t w, uint32_t h, uint32_t px_size);
+} pixel_convert_ops_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Get the fastest kernels supported by the CPU
+ * @description the CPU features are detected on the first call,
+ * the selection can be forced to scalar with PIXEL_CONVERT_SCALAR=1
+ * @return the conversion kernels
+ */
+const pixel_convert_ops_t *pixel_convert_get_ops(void);
+
+/**
+ * @brief Enumerate the kernels supported by the CPU
+ * @description index 0 is always the scalar implementation
+ * @param idx the index of the implementation
+ * @return the conversion kernels or NULL past the last one
+ */
+const pixel_convert_ops_t *pixel_convert_get_ops_by_index(uint32_t idx);
+
+/**
+ * @brief Copy a rectangle into a rotated screen buffer
+ * @description 90 and 270 degrees are done with the transpose kernel,
+ * the rectangle is processed in tiles that fit in the L1 cache
+ * @param ops the kernels
+ * @param dst the first pixel of the rotated screen buffer
+ * @param dst_stride the stride of the rotated screen buffer in bytes
+ * @param src the first pixel of the rectangle
+ * @param src_stride the stride of the rectangle in bytes
+ * @param px_size the size of a pixel in bytes, 2 or 4
+ * @param x the column of the rectangle on the unrotated screen
+ * @param y the row of the rectangle on the unrotated screen
+ * @param w the width of the rectangle
+ * @param h the height of the rectangle
+ * @param scr_w the width of the unrotated screen
+ * @param scr_h the height of the unrotated screen
+ * @param rotation the clockwise rotation in degrees: 0, 90, 180 or 270
+ */
+void pixel_convert_rotate(const pixel_convert_ops_t *ops, uint8_t *dst, uint32_t dst_stride,
+                          const uint8_t *src, uint32_t src_stride, uint32_t px_size,
+                          uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                          uint32_t scr_w, uint32_t scr_h, uint32_t rotation);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*PIXEL_CONVERT_H*/
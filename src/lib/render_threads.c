@@ -0,0 +1,223 @@
+/**
+ * @file render_threads.c
+ *
+ * Setup of the software render threads
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/core/lv_global.h"
+#if LV_USE_OS == LV_OS_PTHREAD && LV_USE_DRAW_SW
+#include "lvgl/src/draw/lv_draw_private.h"
+#include "lvgl/src/draw/sw/lv_draw_sw_private.h"
+#endif
+
+#include "simulator_util.h"
+#include "simulator_settings.h"
+#include "rt_sched.h"
+#include "render_threads.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define RENDER_THREADS_MAX_CPUS 64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static int set_render_affinity(const char *list);
+static int set_render_sched(const char *spec);
+#if LV_USE_OS == LV_OS_PTHREAD && LV_USE_DRAW_SW
+static int pin_draw_threads(const int *cpus, int cpu_cnt);
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *  GLOBAL VARIABLES
+ **********************/
+extern simulator_settings_t settings;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int render_threads_init(void)
+{
+    const char *list = getenv("LV_SIM_RENDER_CPUS");
+    const char *sched = getenv("LV_SIM_RENDER_SCHED");
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int ret = 0;
+
+#if LV_USE_OS == LV_OS_NONE
+    LV_UNUSED(online);
+
+    if (LV_DRAW_SW_DRAW_UNIT_CNT > 1) {
+        LV_LOG_WARN("Multiple draw units require LV_USE_OS, build with -DLV_PORT_THREADS=ON");
+    }
+#else
+    LV_LOG_USER("%d software draw unit(s), %ld CPU(s) online",
+                LV_DRAW_SW_DRAW_UNIT_CNT, online);
+
+    if (online > 0 && LV_DRAW_SW_DRAW_UNIT_CNT > online) {
+        LV_LOG_WARN("More draw units than CPUs, consider -DLV_PORT_DRAW_UNITS=%ld", online);
+    }
+#endif
+
+    if (sched == NULL) {
+        sched = settings.render_sched;
+    }
+
+    if (list != NULL && set_render_affinity(list) < 0) {
+        ret = -1;
+    }
+
+    if (sched != NULL && set_render_sched(sched) < 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Restrict the render threads to a list of CPUs
+ *
+ * @param list the value of LV_SIM_RENDER_CPUS
+ * @return 0 on success, -1 on error
+ */
+static int set_render_affinity(const char *list)
+{
+    int cpus[RENDER_THREADS_MAX_CPUS];
+    int cpu_cnt;
+    cpu_set_t set;
+    int i;
+
+    cpu_cnt = rt_sched_parse_cpus(list, cpus, RENDER_THREADS_MAX_CPUS);
+    if (cpu_cnt <= 0) {
+        LV_LOG_ERROR("Invalid LV_SIM_RENDER_CPUS: %s", list);
+        return -1;
+    }
+
+    /* The LVGL thread renders too when a draw unit is idle */
+    CPU_ZERO(&set);
+    for (i = 0; i < cpu_cnt; i++) {
+        CPU_SET(cpus[i], &set);
+    }
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        LV_LOG_WARN("Failed to set the affinity of the LVGL thread");
+    }
+
+#if LV_USE_OS == LV_OS_PTHREAD && LV_USE_DRAW_SW
+    return pin_draw_threads(cpus, cpu_cnt);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Set the scheduling policy of the render threads
+ *
+ * @description the LVGL thread waits for the draw threads to finish
+ * a frame, a real-time policy is given to both or it would be held
+ * back by draw threads preempted by the other processes. A nice level
+ * only applies to the LVGL thread
+ * @param spec the policy
+ * @return 0 on success, -1 on error
+ */
+static int set_render_sched(const char *spec)
+{
+    int ret = rt_sched_set(pthread_self(), spec);
+
+#if LV_USE_OS == LV_OS_PTHREAD && LV_USE_DRAW_SW
+    lv_draw_unit_t *unit = LV_GLOBAL_DEFAULT()->draw_info.unit_head;
+    lv_draw_sw_unit_t *sw_unit;
+
+    if (ret < 0 || !rt_sched_is_realtime(spec)) {
+        return ret;
+    }
+
+    for (; unit != NULL; unit = unit->next) {
+        if (unit->name == NULL || strcmp(unit->name, "SW") != 0) {
+            continue;
+        }
+
+        sw_unit = (lv_draw_sw_unit_t *)unit;
+
+        if (rt_sched_set(sw_unit->thread.thread, spec) < 0) {
+            ret = -1;
+        }
+    }
+#endif
+
+    return ret;
+}
+
+#if LV_USE_OS == LV_OS_PTHREAD && LV_USE_DRAW_SW
+/**
+ * Pin each software draw thread to a CPU
+ *
+ * @param cpus the CPUs to use
+ * @param cpu_cnt the number of CPUs
+ * @return 0 on success, -1 on error
+ */
+static int pin_draw_threads(const int *cpus, int cpu_cnt)
+{
+    lv_draw_unit_t *unit = LV_GLOBAL_DEFAULT()->draw_info.unit_head;
+    lv_draw_sw_unit_t *sw_unit;
+    cpu_set_t set;
+    int idx = 0;
+    int ret = 0;
+
+    for (; unit != NULL; unit = unit->next) {
+        if (unit->name == NULL || strcmp(unit->name, "SW") != 0) {
+            continue;
+        }
+
+        sw_unit = (lv_draw_sw_unit_t *)unit;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpus[idx % cpu_cnt], &set);
+
+        if (pthread_setaffinity_np(sw_unit->thread.thread, sizeof(set), &set) != 0) {
+            LV_LOG_WARN("Failed to pin draw thread %d to CPU %d", idx, cpus[idx % cpu_cnt]);
+            ret = -1;
+        } else {
+            LV_LOG_USER("Draw thread %d pinned to CPU %d", idx, cpus[idx % cpu_cnt]);
+        }
+
+        idx++;
+    }
+
+    return ret;
+}
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file render_threads.h
+ *
+ * Setup of the software render threads
+ *
+ * When LVGL is built with LV_USE_OS == LV_OS_PTHREAD each software
+ * draw unit renders in its own thread, this module reports the
+ * configuration and pins the threads to the CPUs selected with
+ * the LV_SIM_RENDER_CPUS environment variable
+ */
+
+#ifndef RENDER_THREADS_H
+#define RENDER_THREADS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Configure the render threads
+ * @description must be called after lv_init, the draw threads
+ * are distributed round-robin over the CPUs of LV_SIM_RENDER_CPUS
+ * i.e "2,3" or "1-3", the calling thread is restricted to the same set.
+ * LV_SIM_RENDER_SCHED or settings.render_sched sets the scheduling policy
+ * of the calling thread and of the draw threads, see rt_sched.h
+ * @return 0 on success, -1 if the CPU list or the policy can't be applied
+ */
+int render_threads_init(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*RENDER_THREADS_H*/
@@ -0,0 +1,297 @@
+/**
+ * @file rt_sched.c
+ *
+ * Scheduling controls of the render and input threads
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "lvgl/lvgl.h"
+
+#include "rt_sched.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define RT_SCHED_MAX_CPUS 64
+
+/* Linux 5.14, populates the page tables without touching the pages */
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static int parse_spec(const char *spec, int *policy, long *value, bool *nice);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int rt_sched_set(pthread_t thread, const char *spec)
+{
+    struct sched_param param;
+    int policy;
+    long value;
+    bool nice;
+    int err;
+
+    if (spec == NULL) {
+        return 0;
+    }
+
+    if (parse_spec(spec, &policy, &value, &nice) < 0) {
+        LV_LOG_ERROR("Invalid scheduling policy: %s, expected fifo:<prio>, rr:<prio>, nice:<n> or other",
+                     spec);
+        return -1;
+    }
+
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (value < sched_get_priority_min(policy) || value > sched_get_priority_max(policy)) {
+            LV_LOG_ERROR("Priority out of range: %s", spec);
+            return -1;
+        }
+        param.sched_priority = (int)value;
+    } else {
+        param.sched_priority = 0;
+    }
+
+    err = pthread_setschedparam(thread, policy, &param);
+    if (err != 0) {
+        LV_LOG_WARN("Failed to set the scheduling policy %s: %s%s", spec, strerror(err),
+                    err == EPERM ? ", requires CAP_SYS_NICE or RLIMIT_RTPRIO" : "");
+        return -1;
+    }
+
+    if (nice) {
+
+        /* The nice level is per thread on Linux, set through its TID */
+        if (!pthread_equal(thread, pthread_self())) {
+            LV_LOG_WARN("A nice level can't be applied to this thread: %s", spec);
+            return -1;
+        }
+
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), (int)value) < 0) {
+            LV_LOG_WARN("Failed to set the nice level %ld: %s", value, strerror(errno));
+            return -1;
+        }
+    }
+
+    LV_LOG_USER("Scheduling policy set to %s", spec);
+    return 0;
+}
+
+bool rt_sched_is_realtime(const char *spec)
+{
+    int policy;
+    long value;
+    bool nice;
+
+    if (spec == NULL || parse_spec(spec, &policy, &value, &nice) < 0) {
+        return false;
+    }
+
+    return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+int rt_sched_set_affinity(pthread_t thread, const char *list)
+{
+    int cpus[RT_SCHED_MAX_CPUS];
+    cpu_set_t set;
+    int cpu_cnt;
+    int i;
+
+    if (list == NULL) {
+        return 0;
+    }
+
+    cpu_cnt = rt_sched_parse_cpus(list, cpus, RT_SCHED_MAX_CPUS);
+    if (cpu_cnt <= 0) {
+        LV_LOG_ERROR("Invalid CPU list: %s", list);
+        return -1;
+    }
+
+    CPU_ZERO(&set);
+    for (i = 0; i < cpu_cnt; i++) {
+        CPU_SET(cpus[i], &set);
+    }
+
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        LV_LOG_WARN("Failed to restrict the thread to CPUs %s", list);
+        return -1;
+    }
+
+    return 0;
+}
+
+int rt_sched_parse_cpus(const char *list, int *cpus, int max)
+{
+    const char *p = list;
+    char *end;
+    long first;
+    long last;
+    int cnt = 0;
+
+    while (*p != '\0') {
+        first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) {
+            return -1;
+        }
+
+        last = first;
+        p = end;
+
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first || last >= CPU_SETSIZE) {
+                return -1;
+            }
+            p = end;
+        }
+
+        for (; first <= last; first++) {
+            if (cnt == max) {
+                return -1;
+            }
+            cpus[cnt++] = (int)first;
+        }
+
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+
+    return cnt;
+}
+
+void rt_sched_lock_memory(void)
+{
+    const char *env = getenv("LV_SIM_MLOCK");
+
+    if (env == NULL || env[0] != '1') {
+        return;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        LV_LOG_WARN("Failed to lock the memory: %s%s", strerror(errno),
+                    errno == ENOMEM || errno == EPERM ? ", check RLIMIT_MEMLOCK" : "");
+        return;
+    }
+
+    LV_LOG_USER("Memory locked");
+}
+
+void rt_sched_prefault(void *addr, size_t len)
+{
+    const char *env = getenv("LV_SIM_PREFAULT");
+    long page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t *p;
+    size_t off;
+
+    if (env == NULL || env[0] != '1' || addr == NULL || len == 0) {
+        return;
+    }
+
+    if (madvise(addr, len, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+
+    /*
+     * Older kernels and the PFN mappings of the framebuffer devices,
+     * each page is faulted in by writing back its first byte
+     */
+    if (page <= 0) {
+        page = 4096;
+    }
+
+    p = addr;
+    for (off = 0; off < len; off += (size_t)page) {
+        p[off] = p[off];
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Parse a scheduling policy
+ *
+ * @param spec the policy i.e "fifo:50"
+ * @param policy where to store the policy, SCHED_OTHER for a nice level
+ * @param value where to store the priority or the nice level
+ * @param nice where to store whether a nice level is given
+ * @return 0 on success, -1 if the policy is invalid
+ */
+static int parse_spec(const char *spec, int *policy, long *value, bool *nice)
+{
+    const char *arg;
+    char *end;
+
+    *value = 0;
+    *nice = false;
+
+    if (strcmp(spec, "other") == 0) {
+        *policy = SCHED_OTHER;
+        return 0;
+    }
+
+    if (strncmp(spec, "fifo:", 5) == 0) {
+        *policy = SCHED_FIFO;
+        arg = spec + 5;
+    } else if (strncmp(spec, "rr:", 3) == 0) {
+        *policy = SCHED_RR;
+        arg = spec + 3;
+    } else if (strncmp(spec, "nice:", 5) == 0) {
+        *policy = SCHED_OTHER;
+        *nice = true;
+        arg = spec + 5;
+    } else {
+        return -1;
+    }
+
+    *value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0') {
+        return -1;
+    }
+
+    if (*nice && (*value < -20 || *value > 19)) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file rt_sched.h
+ *
+ * Scheduling controls of the render and input threads
+ *
+ * A scheduling policy is given as "fifo:<priority>", "rr:<priority>",
+ * "nice:<level>" or "other". The real-time policies require
+ * CAP_SYS_NICE or an RLIMIT_RTPRIO large enough, a failure is logged
+ * and the thread keeps its policy.
+ *
+ * The pages of the process can be locked in memory with LV_SIM_MLOCK=1
+ * so that the draw buffers never fault while rendering, and the mapped
+ * framebuffers are prefaulted at init with LV_SIM_PREFAULT=1 instead
+ * of on the first flush
+ */
+
+#ifndef RT_SCHED_H
+#define RT_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Set the scheduling policy of a thread
+ * @description a nice level can only be applied to the calling thread
+ * @param thread the thread
+ * @param spec the policy, NULL to do nothing
+ * @return 0 on success or if spec is NULL, -1 on error
+ */
+int rt_sched_set(pthread_t thread, const char *spec);
+
+/**
+ * @brief Check if a policy is real-time
+ * @param spec the policy, can be NULL
+ * @return true for the fifo and rr policies
+ */
+bool rt_sched_is_realtime(const char *spec);
+
+/**
+ * @brief Restrict a thread to a list of CPUs
+ * @param thread the thread
+ * @param list comma separated CPU numbers or ranges i.e "0,2-3", NULL to do nothing
+ * @return 0 on success or if list is NULL, -1 on error
+ */
+int rt_sched_set_affinity(pthread_t thread, const char *list);
+
+/**
+ * @brief Parse a list of CPUs
+ * @param list the list, comma separated CPU numbers or ranges i.e "0,2-3"
+ * @param cpus where to store the CPU numbers
+ * @param max the size of the cpus array
+ * @return the number of CPUs, -1 if the list is invalid
+ */
+int rt_sched_parse_cpus(const char *list, int *cpus, int max);
+
+/**
+ * @brief Lock the current and future pages of the process in memory
+ * @description does nothing unless LV_SIM_MLOCK is 1, must be called
+ * before the draw buffers are allocated
+ */
+void rt_sched_lock_memory(void);
+
+/**
+ * @brief Fault in the pages of a writable mapping
+ * @description does nothing unless LV_SIM_PREFAULT is 1, the content of
+ * the mapping is preserved
+ * @param addr the start of the mapping, page aligned
+ * @param len the size of the mapping
+ */
+void rt_sched_prefault(void *addr, size_t len);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*RT_SCHED_H*/
@@ -36,6 +36,9 @@ typedef struct {
     uint32_t window_height;
     bool maximize;
     bool fullscreen;
+    uint32_t rotation;      /* Clockwise rotation of the panel: 0, 90, 180 or 270 */
+    const char *render_sched;   /* Scheduling policy of the render threads i.e "fifo:50", NULL to keep it */
+    const char *input_sched;    /* Scheduling policy of the input threads i.e "nice:-5", NULL to keep it */
 } simulator_settings_t;
 
 /**********************
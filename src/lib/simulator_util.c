@@ -17,6 +17,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "simulator_util.h"
 
 /*********************
  *      DEFINES
@@ -48,6 +52,41 @@ const char *getenv_default(const char *name, const char *default_val)
     return value ? value : default_val;
 }
 
+uint32_t parse_size(const char *str)
+{
+    char *end;
+    uint64_t size;
+
+    /* strtoull accepts a sign and wraps the negative values */
+    if (*str < '0' || *str > '9') {
+        goto invalid;
+    }
+
+    errno = 0;
+    size = strtoull(str, &end, 10);
+    if (errno != 0 || size > UINT32_MAX) {
+        goto invalid;
+    }
+
+    if (*end == 'K' || *end == 'k') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        size *= 1024 * 1024;
+        end++;
+    }
+
+    if (*end != '\0' || size > UINT32_MAX) {
+        goto invalid;
+    }
+
+    return (uint32_t)size;
+
+invalid:
+    fprintf(stderr, "Invalid size: %s, ignored\n", str);
+    return 0;
+}
+
 
 void die(const char *msg, ...)
 {
@@ -20,6 +20,7 @@ extern "C" {
  *      INCLUDES
  *********************/
 #include <stdarg.h>
+#include <stdint.h>
 
 
 /**********************
@@ -34,6 +35,13 @@ extern "C" {
  */
 const char *getenv_default(const char *name, const char *default_val);
 
+/**
+ * @description Parse a size in bytes
+ * @param str the size, with an optional K or M suffix
+ * @return the size in bytes, 0 if it is not a number or above 4 GiB
+ */
+uint32_t parse_size(const char *str);
+
 
 /**
  * @description Centralized exit point, called due to an error
@@ -0,0 +1,852 @@
+/**
+ * @file slab_alloc.c
+ *
+ * Size class allocator for the LVGL heap
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "lvgl/lvgl.h"
+
+#include "slab_alloc.h"
+
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Size of a slab, a multiple of the page size */
+#define SLAB_SIZE (64 * 1024)
+
+/* Address space reserved for the slabs, only the touched pages use memory */
+#define SLAB_REGION_SIZE (128 * 1024 * 1024)
+#define SLAB_CNT (SLAB_REGION_SIZE / SLAB_SIZE)
+
+/* The frame arena, chunks pinned by a long lived block only keep the pages of their blocks */
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_CHUNK_CNT 64
+#define ARENA_REGION_SIZE ((size_t)ARENA_CHUNK_SIZE * ARENA_CHUNK_CNT)
+
+/* Pages of a chunk with the smallest supported page size */
+#define ARENA_PAGE_MAX (ARENA_CHUNK_SIZE / 4096)
+
+/* Alignment of the blocks, and size of the header of the arena blocks */
+#define SLAB_ALIGN 16
+
+#define SLAB_MAX_SIZE 1024
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    void *free_list;        /* Freed blocks, linked through their first word */
+    uint32_t bump;          /* Offset of the first block never allocated */
+    uint32_t used;
+    int32_t cls;            /* Size class, -1 if the slab is free */
+    int32_t prev;           /* Partial list of the class, or list of free slabs */
+    int32_t next;
+    bool partial;           /* In the partial list of the class */
+} slab_t;
+
+typedef struct {
+    int32_t partial;        /* First slab with free blocks, -1 if none */
+    slab_alloc_class_stats_t stats;
+} slab_class_t;
+
+typedef struct {
+    uint32_t bump;
+    uint32_t live;
+    bool trimmed;                       /* The pages without block were returned to the system */
+    uint16_t page_live[ARENA_PAGE_MAX]; /* Blocks overlapping each page */
+} arena_chunk_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static bool slab_init(void);
+static void *slab_alloc(size_t size);
+static void slab_free(void *p);
+static size_t slab_block_size(const void *p);
+static int32_t slab_get(void);
+static void slab_release(slab_class_t *c, int32_t idx);
+static void partial_insert(slab_class_t *c, int32_t idx);
+static void partial_remove(slab_class_t *c, int32_t idx);
+static void *arena_alloc(size_t size);
+static void arena_free(void *p);
+static bool arena_select(void);
+static void arena_count_pages(uint32_t idx, const uint8_t *p, size_t need, int delta);
+static void arena_trim(uint32_t idx);
+static size_t arena_committed(void);
+static size_t slab_biggest_free(void);
+static void *core_alloc(size_t size);
+static void core_free(void *p);
+static void display_event_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static const uint32_t class_sizes[SLAB_ALLOC_CLASS_CNT] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+/* Size class of each multiple of SLAB_ALIGN */
+static uint8_t class_lookup[SLAB_MAX_SIZE / SLAB_ALIGN + 1];
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t *slab_base;
+static slab_t slabs[SLAB_CNT];
+static slab_class_t classes[SLAB_ALLOC_CLASS_CNT];
+static int32_t free_slabs;      /* Released slabs, ready to be reused */
+static int32_t fresh_slab;      /* First slab never used */
+static uint32_t slab_cnt;
+
+static uint8_t *arena_base;
+static arena_chunk_t chunks[ARENA_CHUNK_CNT];
+static int32_t arena_cur;       /* Chunk in use, -1 if none */
+static uint32_t arena_page_size;
+static bool arena_frame;        /* A frame is being rendered */
+
+static slab_alloc_class_stats_t large_stats;
+static slab_alloc_class_stats_t arena_stats;
+static uint64_t arena_resets;
+static uint64_t arena_fallbacks;
+static size_t large_bytes;
+static size_t max_used;
+
+/**********************
+ *      MACROS
+ **********************/
+
+#define ALIGN_UP(v) (((v) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+#define IN_SLABS(p) ((uint8_t *)(p) >= slab_base && (uint8_t *)(p) < slab_base + SLAB_REGION_SIZE)
+#define IN_ARENA(p) ((uint8_t *)(p) >= arena_base && \
+                     (uint8_t *)(p) < arena_base + ARENA_REGION_SIZE)
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void lv_mem_init(void)
+{
+    pthread_mutex_lock(&lock);
+    slab_init();
+    pthread_mutex_unlock(&lock);
+}
+
+void lv_mem_deinit(void)
+{
+    pthread_mutex_lock(&lock);
+
+    if (slab_base != NULL) {
+        munmap(slab_base, SLAB_REGION_SIZE);
+        munmap(arena_base, ARENA_REGION_SIZE);
+        slab_base = NULL;
+        arena_base = NULL;
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+lv_mem_pool_t lv_mem_add_pool(void *mem, size_t bytes)
+{
+    LV_UNUSED(mem);
+    LV_UNUSED(bytes);
+
+    /* The slabs are allocated on demand */
+    return NULL;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t pool)
+{
+    LV_UNUSED(pool);
+}
+
+void *lv_malloc_core(size_t size)
+{
+    void *p;
+
+    pthread_mutex_lock(&lock);
+    p = core_alloc(size);
+    pthread_mutex_unlock(&lock);
+
+    return p;
+}
+
+void *lv_realloc_core(void *p, size_t new_size)
+{
+    size_t old_size;
+    void *new_p;
+
+    if (p == NULL) {
+        return lv_malloc_core(new_size);
+    }
+
+    if (new_size == 0) {
+        lv_free_core(p);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    if (!IN_SLABS(p) && !IN_ARENA(p)) {
+        /* Stays in malloc even if it shrinks */
+        large_bytes -= malloc_usable_size(p);
+        new_p = realloc(p, new_size);
+        large_bytes += malloc_usable_size(new_p != NULL ? new_p : p);
+
+        pthread_mutex_unlock(&lock);
+        return new_p;
+    }
+
+    old_size = slab_block_size(p);
+
+    if (new_size <= old_size) {
+        pthread_mutex_unlock(&lock);
+        return p;
+    }
+
+    new_p = core_alloc(new_size);
+    if (new_p != NULL) {
+        memcpy(new_p, p, LV_MIN(old_size, new_size));
+        core_free(p);
+    }
+
+    pthread_mutex_unlock(&lock);
+    return new_p;
+}
+
+void lv_free_core(void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    core_free(p);
+    pthread_mutex_unlock(&lock);
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t *mon_p)
+{
+    size_t slab_free = 0;
+    size_t used;
+    uint32_t live = 0;
+    int i;
+
+    memset(mon_p, 0, sizeof(lv_mem_monitor_t));
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0; i < SLAB_ALLOC_CLASS_CNT; i++) {
+        slab_free += (size_t)classes[i].stats.slabs * SLAB_SIZE -
+                     (size_t)classes[i].stats.live * class_sizes[i];
+        live += classes[i].stats.live;
+    }
+
+    mon_p->total_size = (size_t)slab_cnt * SLAB_SIZE + arena_committed() + large_bytes;
+    mon_p->free_size = slab_free;
+    mon_p->free_biggest_size = slab_biggest_free();
+    mon_p->used_cnt = live + large_stats.live + arena_stats.live;
+
+    used = mon_p->total_size - mon_p->free_size;
+    if (used > max_used) {
+        max_used = used;
+    }
+
+    mon_p->max_used = max_used;
+    mon_p->used_pct = mon_p->total_size ? (uint8_t)(used * 100 / mon_p->total_size) : 0;
+
+    pthread_mutex_unlock(&lock);
+}
+
+lv_result_t lv_mem_test_core(void)
+{
+    return LV_RESULT_OK;
+}
+
+void slab_alloc_attach(lv_display_t *disp)
+{
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, display_event_cb, LV_EVENT_RENDER_READY, NULL);
+}
+
+void slab_alloc_get_stats(slab_alloc_stats_t *stats)
+{
+    int i;
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0; i < SLAB_ALLOC_CLASS_CNT; i++) {
+        stats->classes[i] = classes[i].stats;
+        stats->classes[i].size = class_sizes[i];
+    }
+
+    stats->large = large_stats;
+    stats->arena = arena_stats;
+    stats->arena_resets = arena_resets;
+    stats->arena_fallbacks = arena_fallbacks;
+    stats->committed = (size_t)slab_cnt * SLAB_SIZE + arena_committed();
+
+    pthread_mutex_unlock(&lock);
+}
+
+void slab_alloc_print(void)
+{
+    slab_alloc_stats_t s;
+    int i;
+
+    slab_alloc_get_stats(&s);
+
+    for (i = 0; i < SLAB_ALLOC_CLASS_CNT; i++) {
+        fprintf(stdout, "slab_alloc class=%u live=%u slabs=%u allocs=%llu frees=%llu\n",
+                s.classes[i].size, s.classes[i].live, s.classes[i].slabs,
+                (unsigned long long)s.classes[i].allocs, (unsigned long long)s.classes[i].frees);
+    }
+
+    fprintf(stdout, "slab_alloc committed=%zu large_live=%u large_allocs=%llu "
+            "arena_live=%u arena_allocs=%llu arena_resets=%llu arena_fallbacks=%llu\n",
+            s.committed, s.large.live, (unsigned long long)s.large.allocs,
+            s.arena.live, (unsigned long long)s.arena.allocs,
+            (unsigned long long)s.arena_resets, (unsigned long long)s.arena_fallbacks);
+    fflush(stdout);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Reserve the address space of the slabs and of the arena
+ *
+ * @note called with the lock held
+ * @return true on success
+ */
+static bool slab_init(void)
+{
+    uint32_t i;
+    uint32_t cls = 0;
+
+    if (slab_base != NULL) {
+        return true;
+    }
+
+    slab_base = mmap(NULL, SLAB_REGION_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    arena_base = mmap(NULL, ARENA_REGION_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (slab_base == MAP_FAILED || arena_base == MAP_FAILED) {
+        /* Everything goes to malloc */
+        if (slab_base != MAP_FAILED) {
+            munmap(slab_base, SLAB_REGION_SIZE);
+        }
+        if (arena_base != MAP_FAILED) {
+            munmap(arena_base, ARENA_REGION_SIZE);
+        }
+        slab_base = NULL;
+        arena_base = NULL;
+        return false;
+    }
+
+    for (i = 0; i <= SLAB_MAX_SIZE / SLAB_ALIGN; i++) {
+        while (class_sizes[cls] < i * SLAB_ALIGN) {
+            cls++;
+        }
+        class_lookup[i] = (uint8_t)cls;
+    }
+
+    for (i = 0; i < SLAB_ALLOC_CLASS_CNT; i++) {
+        memset(&classes[i], 0, sizeof(slab_class_t));
+        classes[i].partial = -1;
+    }
+
+    memset(chunks, 0, sizeof(chunks));
+    arena_page_size = (uint32_t)sysconf(_SC_PAGESIZE);
+    if (arena_page_size < ARENA_CHUNK_SIZE / ARENA_PAGE_MAX) {
+        arena_page_size = ARENA_CHUNK_SIZE / ARENA_PAGE_MAX;
+    }
+    free_slabs = -1;
+    fresh_slab = 0;
+    slab_cnt = 0;
+    arena_cur = -1;
+    arena_frame = false;
+
+    return true;
+}
+
+/**
+ * Allocate a block from the arena during a frame, from the slabs or from malloc
+ *
+ * @note called with the lock held
+ */
+static void *core_alloc(size_t size)
+{
+    void *p;
+
+    if (slab_base == NULL && !slab_init()) {
+        p = malloc(size);
+    } else if (size > SLAB_MAX_SIZE) {
+        p = malloc(size);
+    } else {
+        if (arena_frame) {
+            p = arena_alloc(size);
+            if (p != NULL) {
+                return p;
+            }
+            arena_fallbacks++;
+        }
+
+        p = slab_alloc(size);
+        if (p != NULL) {
+            return p;
+        }
+
+        /* Out of slabs */
+        p = malloc(size);
+    }
+
+    if (p != NULL) {
+        large_stats.allocs++;
+        large_stats.live++;
+        large_bytes += malloc_usable_size(p);
+    }
+
+    return p;
+}
+
+/**
+ * Release a block
+ *
+ * @note called with the lock held
+ */
+static void core_free(void *p)
+{
+    if (slab_base != NULL && IN_SLABS(p)) {
+        slab_free(p);
+    } else if (arena_base != NULL && IN_ARENA(p)) {
+        arena_free(p);
+    } else {
+        large_stats.frees++;
+        large_stats.live--;
+        large_bytes -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+/**
+ * Allocate a block from the slabs of its size class
+ *
+ * @return the block or NULL if no slab is available
+ */
+static void *slab_alloc(size_t size)
+{
+    uint32_t cls = class_lookup[ALIGN_UP(size) / SLAB_ALIGN];
+    uint32_t bsize = class_sizes[cls];
+    slab_class_t *c = &classes[cls];
+    slab_t *s;
+    int32_t idx;
+    void *p;
+
+    idx = c->partial;
+
+    if (idx < 0) {
+        idx = slab_get();
+        if (idx < 0) {
+            return NULL;
+        }
+
+        slabs[idx].cls = (int32_t)cls;
+        c->stats.slabs++;
+        partial_insert(c, idx);
+    }
+
+    s = &slabs[idx];
+
+    if (s->free_list != NULL) {
+        p = s->free_list;
+        s->free_list = *(void **)p;
+    } else {
+        p = slab_base + (size_t)idx * SLAB_SIZE + s->bump;
+        s->bump += bsize;
+    }
+
+    s->used++;
+
+    if (s->free_list == NULL && s->bump + bsize > SLAB_SIZE) {
+        partial_remove(c, idx);
+    }
+
+    c->stats.allocs++;
+    c->stats.live++;
+    return p;
+}
+
+/**
+ * Return a block to its slab
+ */
+static void slab_free(void *p)
+{
+    int32_t idx = (int32_t)(((uint8_t *)p - slab_base) / SLAB_SIZE);
+    slab_t *s = &slabs[idx];
+    slab_class_t *c = &classes[s->cls];
+
+    *(void **)p = s->free_list;
+    s->free_list = p;
+    s->used--;
+
+    c->stats.frees++;
+    c->stats.live--;
+
+    if (!s->partial) {
+        partial_insert(c, idx);
+    }
+
+    /* Keep the last slab of the class to avoid releasing and faulting it in again */
+    if (s->used == 0 && (c->partial != idx || s->next >= 0)) {
+        slab_release(c, idx);
+    }
+}
+
+/**
+ * Get the size of a block
+ */
+static size_t slab_block_size(const void *p)
+{
+    if (IN_ARENA(p)) {
+        return *(const size_t *)((const uint8_t *)p - SLAB_ALIGN);
+    }
+
+    return class_sizes[slabs[((const uint8_t *)p - slab_base) / SLAB_SIZE].cls];
+}
+
+/**
+ * Get an unused slab
+ *
+ * @return the index of the slab or -1 if the region is exhausted
+ */
+static int32_t slab_get(void)
+{
+    int32_t idx;
+
+    if (free_slabs >= 0) {
+        idx = free_slabs;
+        free_slabs = slabs[idx].next;
+    } else if (fresh_slab < SLAB_CNT) {
+        idx = fresh_slab++;
+    } else {
+        return -1;
+    }
+
+    memset(&slabs[idx], 0, sizeof(slab_t));
+    slabs[idx].prev = -1;
+    slabs[idx].next = -1;
+    slab_cnt++;
+    return idx;
+}
+
+/**
+ * Return an empty slab to the system
+ */
+static void slab_release(slab_class_t *c, int32_t idx)
+{
+    partial_remove(c, idx);
+    c->stats.slabs--;
+    slab_cnt--;
+
+    /* The pages are zero filled on the next access */
+    madvise(slab_base + (size_t)idx * SLAB_SIZE, SLAB_SIZE, MADV_DONTNEED);
+
+    slabs[idx].cls = -1;
+    slabs[idx].next = free_slabs;
+    free_slabs = idx;
+}
+
+/**
+ * Add a slab to the partial list of its class
+ */
+static void partial_insert(slab_class_t *c, int32_t idx)
+{
+    slab_t *s = &slabs[idx];
+
+    s->prev = -1;
+    s->next = c->partial;
+
+    if (c->partial >= 0) {
+        slabs[c->partial].prev = idx;
+    }
+
+    c->partial = idx;
+    s->partial = true;
+}
+
+/**
+ * Remove a slab from the partial list of its class
+ */
+static void partial_remove(slab_class_t *c, int32_t idx)
+{
+    slab_t *s = &slabs[idx];
+
+    if (!s->partial) {
+        return;
+    }
+
+    if (s->prev >= 0) {
+        slabs[s->prev].next = s->next;
+    } else {
+        c->partial = s->next;
+    }
+
+    if (s->next >= 0) {
+        slabs[s->next].prev = s->prev;
+    }
+
+    s->prev = -1;
+    s->next = -1;
+    s->partial = false;
+}
+
+/**
+ * Allocate a block from the current arena chunk
+ *
+ * @description the size of the block is stored in front of it for realloc
+ * @return the block or NULL if no chunk has room
+ */
+static void *arena_alloc(size_t size)
+{
+    size_t need = SLAB_ALIGN + ALIGN_UP(size);
+    arena_chunk_t *chunk;
+    uint8_t *p;
+
+    if (arena_cur < 0 || chunks[arena_cur].bump + need > ARENA_CHUNK_SIZE) {
+        if (!arena_select()) {
+            return NULL;
+        }
+    }
+
+    chunk = &chunks[arena_cur];
+
+    p = arena_base + (size_t)arena_cur * ARENA_CHUNK_SIZE + chunk->bump;
+    *(size_t *)p = size;
+    chunk->bump += need;
+    chunk->live++;
+    arena_count_pages((uint32_t)arena_cur, p, need, 1);
+
+    arena_stats.allocs++;
+    arena_stats.live++;
+    return p + SLAB_ALIGN;
+}
+
+/**
+ * Release an arena block
+ *
+ * @description the chunk is reset as soon as it holds no block,
+ * the pages of a trimmed chunk are released as soon as they hold no block
+ */
+static void arena_free(void *p)
+{
+    uint8_t *block = (uint8_t *)p - SLAB_ALIGN;
+    uint32_t idx = (uint32_t)((block - arena_base) / ARENA_CHUNK_SIZE);
+    arena_chunk_t *chunk = &chunks[idx];
+
+    arena_count_pages(idx, block, SLAB_ALIGN + ALIGN_UP(*(size_t *)block), -1);
+
+    chunk->live--;
+    arena_stats.frees++;
+    arena_stats.live--;
+
+    if (chunk->live == 0) {
+        chunk->bump = 0;
+        chunk->trimmed = false;
+        arena_resets++;
+    }
+}
+
+/**
+ * Select an empty chunk
+ *
+ * @description chunks still holding blocks of a previous frame are skipped
+ * @return true if a chunk was found
+ */
+static bool arena_select(void)
+{
+    int32_t i;
+
+    for (i = 0; i < ARENA_CHUNK_CNT; i++) {
+        if (i != arena_cur && chunks[i].live == 0) {
+            chunks[i].bump = 0;
+            chunks[i].trimmed = false;
+            arena_cur = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Update the block counters of the pages overlapped by a block
+ *
+ * @param idx the chunk of the block
+ * @param p the header of the block
+ * @param need the size of the block with its header
+ * @param delta 1 when the block is allocated, -1 when it is freed
+ */
+static void arena_count_pages(uint32_t idx, const uint8_t *p, size_t need, int delta)
+{
+    arena_chunk_t *chunk = &chunks[idx];
+    uint8_t *chunk_base = arena_base + (size_t)idx * ARENA_CHUNK_SIZE;
+    uint32_t first = (uint32_t)(p - chunk_base) / arena_page_size;
+    uint32_t last = (uint32_t)(p - chunk_base + need - 1) / arena_page_size;
+    uint32_t i;
+
+    for (i = first; i <= last; i++) {
+        chunk->page_live[i] = (uint16_t)(chunk->page_live[i] + delta);
+
+        /* The block keeping the page of a trimmed chunk is gone, unless it was the last one
+         * of the chunk: the chunk is then reset and its pages are reused */
+        if (chunk->trimmed && chunk->page_live[i] == 0 && chunk->live > 1) {
+            madvise(chunk_base + (size_t)i * arena_page_size, arena_page_size, MADV_DONTNEED);
+        }
+    }
+}
+
+/**
+ * Return the pages of a chunk holding no block to the system
+ *
+ * @description a chunk still holding blocks once the frame is rendered is pinned by
+ * long lived objects, only the pages of these blocks stay committed until it is released.
+ * The bump offset is kept, the blocks allocated later in the chunk fault the pages in again
+ * @param idx the chunk
+ */
+static void arena_trim(uint32_t idx)
+{
+    arena_chunk_t *chunk = &chunks[idx];
+    uint8_t *chunk_base = arena_base + (size_t)idx * ARENA_CHUNK_SIZE;
+    uint32_t pages = (chunk->bump + arena_page_size - 1) / arena_page_size;
+    uint32_t i;
+
+    for (i = 0; i < pages; i++) {
+        if (chunk->page_live[i] == 0) {
+            madvise(chunk_base + (size_t)i * arena_page_size, arena_page_size, MADV_DONTNEED);
+        }
+    }
+
+    chunk->trimmed = true;
+}
+
+/**
+ * Get the size of the arena pages holding blocks
+ */
+static size_t arena_committed(void)
+{
+    size_t bytes = 0;
+    uint32_t pages;
+    uint32_t j;
+    int i;
+
+    for (i = 0; i < ARENA_CHUNK_CNT; i++) {
+        if (chunks[i].bump == 0) {
+            continue;
+        }
+
+        if (!chunks[i].trimmed) {
+            bytes += ARENA_CHUNK_SIZE;
+            continue;
+        }
+
+        pages = (chunks[i].bump + arena_page_size - 1) / arena_page_size;
+        for (j = 0; j < pages; j++) {
+            if (chunks[i].page_live[j] != 0) {
+                bytes += arena_page_size;
+            }
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * Get the biggest block the slabs in use can serve without taking another slab
+ *
+ * @note called with the lock held
+ */
+static size_t slab_biggest_free(void)
+{
+    const slab_t *s;
+    int32_t idx;
+    int i;
+
+    for (i = SLAB_ALLOC_CLASS_CNT - 1; i >= 0; i--) {
+        for (idx = classes[i].partial; idx >= 0; idx = s->next) {
+            s = &slabs[idx];
+            if (s->free_list != NULL || s->bump + class_sizes[i] <= SLAB_SIZE) {
+                return class_sizes[i];
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Enable the arena while the display renders
+ *
+ * @param e the display event
+ */
+static void display_event_cb(lv_event_t *e)
+{
+    pthread_mutex_lock(&lock);
+
+    int32_t i;
+
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        arena_frame = arena_base != NULL;
+    } else {
+        /* The blocks still alive are not draw tasks, don't keep whole chunks for them */
+        for (i = 0; arena_base != NULL && i < ARENA_CHUNK_CNT; i++) {
+            if (chunks[i].live != 0 && !chunks[i].trimmed) {
+                arena_trim((uint32_t)i);
+            }
+        }
+
+        /* The current chunk is kept for the next frame */
+        arena_frame = false;
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+#else
+
+void slab_alloc_attach(lv_display_t *disp)
+{
+    LV_UNUSED(disp);
+}
+
+void slab_alloc_get_stats(slab_alloc_stats_t *stats)
+{
+    memset(stats, 0, sizeof(slab_alloc_stats_t));
+}
+
+void slab_alloc_print(void)
+{
+    /* LVGL uses another allocator */
+}
+
+#endif /*LV_USE_STDLIB_MALLOC == LV_STDLIB_CUSTOM*/
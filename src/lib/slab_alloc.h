@@ -0,0 +1,92 @@
+/**
+ * @file slab_alloc.h
+ *
+ * Size class allocator for the LVGL heap
+ *
+ * Implements the LV_STDLIB_CUSTOM memory core of LVGL, enabled
+ * with -DLV_PORT_SLAB_ALLOC=ON
+ *
+ * - Small blocks are served from slabs of 64 KiB,
+ *   each slab holds blocks of a single size class, empty slabs are
+ *   returned to the system
+ * - Blocks allocated while a frame is rendered, i.e. draw tasks, are
+ *   served from arena chunks that are reset once all their blocks were
+ *   freed, a chunk still holding a block once the frame is rendered only
+ *   keeps the pages of its blocks and is skipped until it is released
+ * - Anything bigger than the largest class goes to malloc
+ */
+
+#ifndef SLAB_ALLOC_H
+#define SLAB_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/* Number of size classes, the largest is 1024 bytes */
+#define SLAB_ALLOC_CLASS_CNT 12
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint32_t size;          /* Block size of the class, 0 for the malloc and arena counters */
+    uint32_t live;          /* Blocks currently allocated */
+    uint32_t slabs;         /* Slabs owned by the class */
+    uint64_t allocs;
+    uint64_t frees;
+} slab_alloc_class_stats_t;
+
+typedef struct {
+    slab_alloc_class_stats_t classes[SLAB_ALLOC_CLASS_CNT];
+    slab_alloc_class_stats_t large;     /* Blocks served by malloc */
+    slab_alloc_class_stats_t arena;     /* Blocks served by the frame arena */
+    uint64_t arena_resets;              /* Number of times a chunk was reset */
+    uint64_t arena_fallbacks;           /* Frame allocations served by the slabs */
+    size_t committed;                   /* Bytes of slabs and arena chunks in use */
+} slab_alloc_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Route the allocations made while rendering to the frame arena
+ * @param disp the display
+ */
+void slab_alloc_attach(lv_display_t *disp);
+
+/**
+ * @brief Get the allocator counters
+ * @param stats where to store the counters
+ */
+void slab_alloc_get_stats(slab_alloc_stats_t *stats);
+
+/**
+ * @brief Print the allocator counters on stdout
+ * @description one line of space separated key=value pairs per size class
+ */
+void slab_alloc_print(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*SLAB_ALLOC_H*/
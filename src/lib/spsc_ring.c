@@ -0,0 +1,110 @@
+/**
+ * @file spsc_ring.c
+ *
+ * Lock-free single producer single consumer ring buffer
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int spsc_ring_init(spsc_ring_t *ring, uint32_t capacity, uint32_t elem_size)
+{
+    uint32_t size = 1;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    ring->buf = malloc((size_t)size * elem_size);
+    if (ring->buf == NULL) {
+        return -1;
+    }
+
+    ring->mask = size - 1;
+    ring->elem_size = elem_size;
+
+    return 0;
+}
+
+void spsc_ring_deinit(spsc_ring_t *ring)
+{
+    free(ring->buf);
+    ring->buf = NULL;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail > ring->mask) {
+        return false;
+    }
+
+    memcpy(ring->buf + (size_t)(head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+
+    /* Publish the element once it is completely written */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *elem)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(elem, ring->buf + (size_t)(tail & ring->mask) * ring->elem_size, ring->elem_size);
+
+    /* Release the slot to the producer */
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t spsc_ring_count(const spsc_ring_t *ring)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    return head - tail;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
@@ -0,0 +1,97 @@
+/**
+ * @file spsc_ring.h
+ *
+ * Lock-free single producer single consumer ring buffer
+ *
+ * Used to hand data from a worker thread to the LVGL thread
+ * without taking a lock, one thread may push and one thread may pop
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define SPSC_RING_CACHE_LINE 64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    /* Written by the producer only */
+    uint32_t head __attribute__((aligned(SPSC_RING_CACHE_LINE)));
+
+    /* Written by the consumer only */
+    uint32_t tail __attribute__((aligned(SPSC_RING_CACHE_LINE)));
+
+    uint8_t *buf __attribute__((aligned(SPSC_RING_CACHE_LINE)));
+    uint32_t mask;
+    uint32_t elem_size;
+} spsc_ring_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Initialize a ring buffer
+ * @param ring the ring buffer
+ * @param capacity the number of elements, rounded up to a power of 2
+ * @param elem_size the size of an element in bytes
+ * @return 0 on success, -1 on error
+ */
+int spsc_ring_init(spsc_ring_t *ring, uint32_t capacity, uint32_t elem_size);
+
+/**
+ * @brief Release the memory of a ring buffer
+ * @param ring the ring buffer
+ */
+void spsc_ring_deinit(spsc_ring_t *ring);
+
+/**
+ * @brief Append an element
+ * @note must only be called by the producer thread
+ * @param ring the ring buffer
+ * @param elem the element to copy into the ring
+ * @return false if the ring is full
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem);
+
+/**
+ * @brief Remove the oldest element
+ * @note must only be called by the consumer thread
+ * @param ring the ring buffer
+ * @param elem where to copy the element
+ * @return false if the ring is empty
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void *elem);
+
+/**
+ * @brief Get the number of elements waiting in the ring
+ * @param ring the ring buffer
+ * @return the number of elements
+ */
+uint32_t spsc_ring_count(const spsc_ring_t *ring);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*SPSC_RING_H*/
@@ -0,0 +1,441 @@
+/**
+ * @file touch_filter.c
+ *
+ * Filtering of the pointer samples and touch calibration
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/indev/lv_indev_private.h"
+
+#include "simulator_util.h"
+#include "frame_stats.h"
+#include "touch_filter.h"
+#include "backends.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define TOUCH_FILTER_MAX_INDEVS 4
+
+/* Largest window of the median filter */
+#define TOUCH_FILTER_MEDIAN_MAX 5
+
+/* Fractional bits of the positions filtered by the IIR */
+#define TOUCH_FILTER_FRAC 8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    lv_indev_t *indev;
+    lv_indev_read_cb_t read_cb; /* The read callback of the driver */
+    touch_filter_timestamp_cb_t timestamp_cb;   /* NULL if the samples have no timestamp */
+
+    /* Configuration */
+    uint32_t median;            /* Window of the median filter, 0 if disabled */
+    uint32_t smoothing;         /* Weight of the previous position in percent */
+    int32_t deadband;           /* Smallest move reported in pixels */
+    uint32_t predict_ms;        /* Prediction horizon, 0 if disabled */
+    bool coalesce;
+
+    /* State of the current press */
+    bool pressed;
+    lv_point_t history[TOUCH_FILTER_MEDIAN_MAX];
+    uint32_t history_cnt;
+    uint32_t history_idx;
+    int32_t iir_x;              /* In 1/2^TOUCH_FILTER_FRAC pixels */
+    int32_t iir_y;
+    lv_point_t filtered;        /* Position before the prediction */
+    lv_point_t reported;        /* Position last handed to LVGL */
+    lv_point_t prev;            /* Filtered position of the last velocity update */
+    uint64_t prev_us;
+    int32_t vx;                 /* Velocity in pixels per second */
+    int32_t vy;
+} touch_filter_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static touch_filter_t *get_filter(lv_indev_t *indev);
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data);
+static void filter_sample(touch_filter_t *f, lv_indev_data_t *data);
+static void start_press(touch_filter_t *f, lv_point_t p, uint64_t now);
+static lv_point_t median(const touch_filter_t *f);
+static int32_t median_of(int32_t *v, uint32_t n);
+static void update_velocity(touch_filter_t *f, uint64_t now);
+static void delete_event_cb(lv_event_t *e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static touch_filter_t filters[TOUCH_FILTER_MAX_INDEVS];
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void touch_filter_attach(lv_indev_t *indev, touch_filter_timestamp_cb_t timestamp_cb)
+{
+    touch_filter_t *f;
+    uint32_t median = atoi(backend_getenv("LV_LINUX_EVDEV_MEDIAN", "0"));
+    uint32_t smoothing = atoi(backend_getenv("LV_LINUX_EVDEV_SMOOTHING", "0"));
+    int32_t deadband = atoi(backend_getenv("LV_LINUX_EVDEV_DEADBAND", "0"));
+    uint32_t predict_ms = atoi(backend_getenv("LV_LINUX_EVDEV_PREDICT_MS", "0"));
+    bool coalesce = backend_getenv("LV_LINUX_EVDEV_COALESCE", "0")[0] == '1';
+    int i;
+
+    if (median < 2 && smoothing == 0 && deadband <= 0 && predict_ms == 0 && !coalesce) {
+        return;
+    }
+
+    f = NULL;
+    for (i = 0; i < TOUCH_FILTER_MAX_INDEVS && f == NULL; i++) {
+        if (filters[i].indev == NULL) {
+            f = &filters[i];
+        }
+    }
+
+    if (f == NULL) {
+        LV_LOG_WARN("Too many filtered input devices");
+        return;
+    }
+
+    f->indev = indev;
+    f->read_cb = indev->read_cb;
+    f->timestamp_cb = timestamp_cb;
+    f->median = median < 2 ? 0 : LV_MIN(median, TOUCH_FILTER_MEDIAN_MAX);
+    f->smoothing = LV_MIN(smoothing, 95);
+    f->deadband = LV_MAX(deadband, 0);
+    f->predict_ms = predict_ms;
+    f->coalesce = coalesce;
+
+    lv_indev_set_read_cb(indev, read_cb);
+    lv_indev_add_event_cb(indev, delete_event_cb, LV_EVENT_DELETE, f);
+
+    LV_LOG_USER("Touch filter: median %u, smoothing %u%%, dead-band %d px, prediction %u ms%s",
+                f->median, f->smoothing, f->deadband, f->predict_ms,
+                f->coalesce ? ", coalesced" : "");
+}
+
+int touch_calibration_load(const char *path, touch_calibration_t *cal)
+{
+    long long v[9];
+    FILE *f;
+    int n;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        LV_LOG_ERROR("Failed to open the calibration %s", path);
+        return -1;
+    }
+
+    n = fscanf(f, "%lld %lld %lld %lld %lld %lld %lld %lld %lld",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]);
+    fclose(f);
+
+    if (n < 7 || v[6] == 0) {
+        LV_LOG_ERROR("%s is not a calibration matrix", path);
+        return -1;
+    }
+
+    cal->a = v[0];
+    cal->b = v[1];
+    cal->c = v[2];
+    cal->d = v[3];
+    cal->e = v[4];
+    cal->f = v[5];
+    cal->s = v[6];
+    cal->xres = n == 9 ? (int32_t)v[7] : 0;
+    cal->yres = n == 9 ? (int32_t)v[8] : 0;
+
+    LV_LOG_INFO("Loaded the calibration %s", path);
+    return 0;
+}
+
+void touch_calibration_apply(const touch_calibration_t *cal, int32_t raw_x, int32_t raw_y,
+                             int32_t hor_res, int32_t ver_res, lv_point_t *point)
+{
+    int64_t x = (cal->a * raw_x + cal->b * raw_y + cal->c) / cal->s;
+    int64_t y = (cal->d * raw_x + cal->e * raw_y + cal->f) / cal->s;
+
+    if (cal->xres > 0 && cal->yres > 0) {
+        x = x * hor_res / cal->xres;
+        y = y * ver_res / cal->yres;
+    }
+
+    point->x = (int32_t)LV_CLAMP(0, x, hor_res - 1);
+    point->y = (int32_t)LV_CLAMP(0, y, ver_res - 1);
+}
+
+int touch_calibration_to_range(const touch_calibration_t *cal, int32_t hor_res, int32_t ver_res,
+                               lv_point_t *min, lv_point_t *max, bool *swap_axes)
+{
+    /* The edges of the display in the coordinates of the matrix */
+    int64_t w = cal->xres > 0 ? cal->xres : hor_res;
+    int64_t h = cal->yres > 0 ? cal->yres : ver_res;
+    int64_t kx;
+    int64_t ky;
+
+    if (cal->b == 0 && cal->d == 0 && cal->a != 0 && cal->e != 0) {
+        *swap_axes = false;
+        kx = cal->a;
+        ky = cal->e;
+    } else if (cal->a == 0 && cal->e == 0 && cal->b != 0 && cal->d != 0) {
+        /* The display x is the raw y, lv_evdev swaps before mapping */
+        *swap_axes = true;
+        kx = cal->b;
+        ky = cal->d;
+    } else {
+        return -1;
+    }
+
+    min->x = (int32_t)(-cal->c / kx);
+    max->x = (int32_t)((w * cal->s - cal->c) / kx);
+    min->y = (int32_t)(-cal->f / ky);
+    max->y = (int32_t)((h * cal->s - cal->f) / ky);
+
+    return 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the filter of an input device
+ *
+ * @param indev the input device
+ * @return the filter or NULL
+ */
+static touch_filter_t *get_filter(lv_indev_t *indev)
+{
+    int i;
+
+    for (i = 0; i < TOUCH_FILTER_MAX_INDEVS; i++) {
+        if (filters[i].indev == indev) {
+            return &filters[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Read callback wrapping the one of the driver
+ *
+ * @description when coalescing, the queued samples are read and filtered
+ * until a press or a release, only the last one is handed to LVGL.
+ * The driver keeps its own data, see lv_indev_get_driver_data
+ */
+static void read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    touch_filter_t *f = get_filter(indev);
+    lv_indev_data_t sample = *data;
+    lv_indev_state_t prev = LV_INDEV_STATE_RELEASED;
+    bool first = true;
+
+    /* The read callback of the driver is lost with the filter */
+    if (f == NULL) {
+        LV_LOG_WARN("The filter of the input device was released");
+        return;
+    }
+
+    while (true) {
+        sample.continue_reading = false;
+        f->read_cb(indev, &sample);
+        filter_sample(f, &sample);
+
+        /* A press or a release is never merged with the next samples,
+         * data is zeroed by LVGL so the state is compared to the previous sample */
+        if (!f->coalesce || !sample.continue_reading || (!first && sample.state != prev)) {
+            break;
+        }
+
+        prev = sample.state;
+        first = false;
+    }
+
+    *data = sample;
+}
+
+/**
+ * Apply the stages of the filter to a sample
+ *
+ * @param f the filter
+ * @param data the sample, in display coordinates, updated in place
+ */
+static void filter_sample(touch_filter_t *f, lv_indev_data_t *data)
+{
+    lv_display_t *disp = lv_indev_get_display(f->indev);
+    uint64_t now = f->timestamp_cb != NULL ? f->timestamp_cb(f->indev) : frame_stats_now_us();
+    lv_point_t p = data->point;
+    lv_point_t out;
+    int32_t w = 100 - f->smoothing;
+
+    if (data->state != LV_INDEV_STATE_PRESSED) {
+        /* The release is reported where the finger was, the last raw
+         * sample of a resistive panel is taken while the pressure drops */
+        if (f->pressed) {
+            data->point = f->filtered;
+            f->pressed = false;
+        }
+        return;
+    }
+
+    if (!f->pressed) {
+        start_press(f, p, now);
+        data->point = p;
+        return;
+    }
+
+    if (f->median > 0) {
+        f->history[f->history_idx] = p;
+        f->history_idx = (f->history_idx + 1) % f->median;
+        f->history_cnt = LV_MIN(f->history_cnt + 1, f->median);
+        p = median(f);
+    }
+
+    if (f->smoothing > 0) {
+        f->iir_x += (int32_t)(((int64_t)((p.x << TOUCH_FILTER_FRAC) - f->iir_x) * w) / 100);
+        f->iir_y += (int32_t)(((int64_t)((p.y << TOUCH_FILTER_FRAC) - f->iir_y) * w) / 100);
+        p.x = (f->iir_x + (1 << (TOUCH_FILTER_FRAC - 1))) >> TOUCH_FILTER_FRAC;
+        p.y = (f->iir_y + (1 << (TOUCH_FILTER_FRAC - 1))) >> TOUCH_FILTER_FRAC;
+    }
+
+    f->filtered = p;
+    out = p;
+
+    if (f->predict_ms > 0) {
+        update_velocity(f, now);
+        out.x += (int32_t)((int64_t)f->vx * f->predict_ms / 1000);
+        out.y += (int32_t)((int64_t)f->vy * f->predict_ms / 1000);
+        out.x = LV_CLAMP(0, out.x, lv_display_get_horizontal_resolution(disp) - 1);
+        out.y = LV_CLAMP(0, out.y, lv_display_get_vertical_resolution(disp) - 1);
+    }
+
+    /* Nothing moves, nothing is invalidated */
+    if (LV_ABS(out.x - f->reported.x) < f->deadband &&
+        LV_ABS(out.y - f->reported.y) < f->deadband) {
+        out = f->reported;
+    }
+
+    f->reported = out;
+    data->point = out;
+}
+
+/**
+ * Reset the state of the filter on a press
+ *
+ * @param f the filter
+ * @param p the position of the press
+ * @param now the time of the sample in us
+ */
+static void start_press(touch_filter_t *f, lv_point_t p, uint64_t now)
+{
+    f->pressed = true;
+    f->history[0] = p;
+    f->history_cnt = 1;
+    f->history_idx = f->median > 1 ? 1 : 0;
+    f->iir_x = p.x << TOUCH_FILTER_FRAC;
+    f->iir_y = p.y << TOUCH_FILTER_FRAC;
+    f->filtered = p;
+    f->reported = p;
+    f->prev = p;
+    f->prev_us = now;
+    f->vx = 0;
+    f->vy = 0;
+}
+
+/**
+ * Median of the recent samples, per axis
+ */
+static lv_point_t median(const touch_filter_t *f)
+{
+    int32_t xs[TOUCH_FILTER_MEDIAN_MAX];
+    int32_t ys[TOUCH_FILTER_MEDIAN_MAX];
+    lv_point_t p;
+    uint32_t i;
+
+    for (i = 0; i < f->history_cnt; i++) {
+        xs[i] = f->history[i].x;
+        ys[i] = f->history[i].y;
+    }
+
+    p.x = median_of(xs, f->history_cnt);
+    p.y = median_of(ys, f->history_cnt);
+    return p;
+}
+
+/**
+ * Median of a few values
+ *
+ * @param v the values, sorted in place
+ * @param n the number of values
+ * @return the median
+ */
+static int32_t median_of(int32_t *v, uint32_t n)
+{
+    uint32_t i, j;
+    int32_t t;
+
+    for (i = 1; i < n; i++) {
+        t = v[i];
+        for (j = i; j > 0 && v[j - 1] > t; j--) {
+            v[j] = v[j - 1];
+        }
+        v[j] = t;
+    }
+
+    return v[n / 2];
+}
+
+/**
+ * Estimate the velocity of a drag from the filtered positions
+ *
+ * @description the estimate is averaged with the previous one. With the
+ * timestamps of the samples, the samples read in one burst each count,
+ * without them the burst shares the time of the read and only its
+ * first sample updates the velocity
+ * @param f the filter
+ * @param now the time of the sample in us
+ */
+static void update_velocity(touch_filter_t *f, uint64_t now)
+{
+    uint64_t dt = now - f->prev_us;
+
+    if (now <= f->prev_us) {
+        return;
+    }
+
+    f->vx = (f->vx + (int32_t)((int64_t)(f->filtered.x - f->prev.x) * 1000000 / (int64_t)dt)) / 2;
+    f->vy = (f->vy + (int32_t)((int64_t)(f->filtered.y - f->prev.y) * 1000000 / (int64_t)dt)) / 2;
+    f->prev = f->filtered;
+    f->prev_us = now;
+}
+
+/**
+ * Release the filter of a deleted input device
+ *
+ * @param e the delete event of the input device
+ */
+static void delete_event_cb(lv_event_t *e)
+{
+    memset(lv_event_get_user_data(e), 0, sizeof(touch_filter_t));
+}
@@ -0,0 +1,118 @@
+/**
+ * @file touch_filter.h
+ *
+ * Filtering of the pointer samples and touch calibration
+ *
+ * The filter is inserted between the read callback of a pointer input
+ * device and LVGL, it works in display coordinates and each stage is
+ * enabled by an environment variable:
+ *
+ * - LV_LINUX_EVDEV_MEDIAN: median of the last n samples (3 or 5),
+ *   rejects the spikes of resistive panels
+ * - LV_LINUX_EVDEV_SMOOTHING: weight in percent of the previous position
+ *   in an IIR low-pass, removes the jitter
+ * - LV_LINUX_EVDEV_DEADBAND: moves of less than n pixels are not reported,
+ *   so the noise of a finger at rest doesn't invalidate anything
+ * - LV_LINUX_EVDEV_COALESCE: 1 to hand a single sample per read to LVGL,
+ *   the queued samples still go through the filter
+ * - LV_LINUX_EVDEV_PREDICT_MS: during drags, the position is extrapolated
+ *   n ms ahead with the velocity, to hide the latency of the pipeline
+ *
+ * The calibration is read from a file in the format of the tslib
+ * pointercal: "a b c d e f s [xres yres]", mapping the raw coordinates:
+ * x = (a * raw_x + b * raw_y + c) / s, y = (d * raw_x + e * raw_y + f) / s
+ */
+
+#ifndef TOUCH_FILTER_H
+#define TOUCH_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/* Get the time of the sample just read, in us on CLOCK_MONOTONIC */
+typedef uint64_t (*touch_filter_timestamp_cb_t)(lv_indev_t *indev);
+
+typedef struct {
+    int64_t a, b, c;        /* x = (a * raw_x + b * raw_y + c) / s */
+    int64_t d, e, f;        /* y = (d * raw_x + e * raw_y + f) / s */
+    int64_t s;
+    int32_t xres;           /* Resolution the matrix was computed for, 0 if unknown */
+    int32_t yres;
+} touch_calibration_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * @brief Filter the samples of a pointer input device
+ * @description the read callback of the device is wrapped, does nothing
+ * if no stage is enabled
+ * @param indev the input device
+ * @param timestamp_cb the time of each sample, i.e. the kernel timestamp of
+ * evdev_thread_get_timestamp, NULL to use the time of the read
+ */
+void touch_filter_attach(lv_indev_t *indev, touch_filter_timestamp_cb_t timestamp_cb);
+
+/**
+ * @brief Load a calibration matrix
+ * @param path the path of the file, i.e /etc/pointercal
+ * @param cal where to store the matrix
+ * @return 0 on success, -1 on error
+ */
+int touch_calibration_load(const char *path, touch_calibration_t *cal);
+
+/**
+ * @brief Map raw coordinates to the display
+ * @param cal the calibration
+ * @param raw_x the raw coordinates
+ * @param raw_y
+ * @param hor_res the resolution of the display, the matrix is scaled if it
+ * was computed for another one
+ * @param ver_res
+ * @param point where to store the display coordinates
+ */
+void touch_calibration_apply(const touch_calibration_t *cal, int32_t raw_x, int32_t raw_y,
+                             int32_t hor_res, int32_t ver_res, lv_point_t *point);
+
+/**
+ * @brief Convert a calibration to the raw range of lv_evdev_set_calibration
+ * @description only matrices without rotation or shear can be converted,
+ * the axes are possibly swapped
+ * @param cal the calibration
+ * @param hor_res the resolution of the display
+ * @param ver_res
+ * @param min the raw coordinates mapped to the origin of the display
+ * @param max the raw coordinates mapped to the resolution of the display
+ * @param swap_axes set if the raw x axis is the y axis of the display
+ * @return 0 on success, -1 if the matrix can't be converted
+ */
+int touch_calibration_to_range(const touch_calibration_t *cal, int32_t hor_res, int32_t ver_res,
+                               lv_point_t *min, lv_point_t *max, bool *swap_axes);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*TOUCH_FILTER_H*/
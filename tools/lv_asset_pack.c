@@ -0,0 +1,429 @@
+/**
+ * @file lv_asset_pack.c
+ *
+ * Packer of the asset bundles mapped by src/lib/asset_bundle.c
+ *
+ * The images are decoded with the decoders enabled in lv_conf.h and
+ * converted to the color format of the display, opaque images to
+ * XRGB8888 or RGB565, images with transparency to ARGB8888 or RGB565A8.
+ * The fonts are LVGL binary fonts, stored as is
+ *
+ * usage: lv_asset_pack [-d depth] [-a stride_align] -o bundle.lvab
+ *        [-i name=image.png ...] [-f name=font.bin ...]
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "lvgl/lvgl.h"
+
+#include "asset_bundle.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define PACK_MAX_ENTRIES 1024
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    asset_bundle_entry_t entry;
+    const char *path;
+    uint8_t *data;
+} pack_item_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static int add_item(const char *arg, asset_bundle_type_t type);
+static int load_image(pack_item_t *item, uint32_t depth, uint32_t align);
+static int load_font(pack_item_t *item);
+static bool read_pixel(const lv_draw_buf_t *buf, uint32_t x, uint32_t y, lv_color32_t *c);
+static int write_bundle(const char *path, uint32_t depth, uint32_t align);
+static int compare_items(const void *a, const void *b);
+static void usage(const char *prog);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+static pack_item_t items[PACK_MAX_ENTRIES];
+static uint32_t item_cnt;
+
+/**********************
+ *      MACROS
+ **********************/
+
+#define ALIGN_UP(v, a) (((v) + (a) - 1) / (a) * (a))
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(int argc, char **argv)
+{
+    const char *out = NULL;
+    uint32_t depth = LV_COLOR_DEPTH;
+    uint32_t align = LV_DRAW_BUF_STRIDE_ALIGN;
+    uint32_t i;
+    int opt;
+    int ret;
+
+    while ((opt = getopt(argc, argv, "d:a:o:i:f:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            depth = atoi(optarg);
+            break;
+        case 'a':
+            align = atoi(optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'i':
+        case 'f':
+            if (add_item(optarg, opt == 'i' ? ASSET_BUNDLE_IMAGE : ASSET_BUNDLE_FONT) < 0) {
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (out == NULL || (depth != 16 && depth != 32) || align == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Only the image decoders and the file system drivers are used */
+    lv_init();
+
+    for (i = 0; i < item_cnt; i++) {
+        if (items[i].entry.type == ASSET_BUNDLE_IMAGE) {
+            ret = load_image(&items[i], depth, align);
+        } else {
+            ret = load_font(&items[i]);
+        }
+
+        if (ret < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Looked up with a binary search */
+    qsort(items, item_cnt, sizeof(pack_item_t), compare_items);
+
+    for (i = 1; i < item_cnt; i++) {
+        if (strcmp(items[i - 1].entry.name, items[i].entry.name) == 0) {
+            fprintf(stderr, "Duplicate asset name: %s\n", items[i].entry.name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (write_bundle(out, depth, align) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Add an asset
+ *
+ * @param arg name=path
+ * @param type the type of the asset
+ * @return 0 on success, -1 on error
+ */
+static int add_item(const char *arg, asset_bundle_type_t type)
+{
+    const char *sep = strchr(arg, '=');
+    pack_item_t *item;
+    size_t len;
+
+    if (sep == NULL || sep == arg) {
+        fprintf(stderr, "Expected name=path, got %s\n", arg);
+        return -1;
+    }
+
+    len = sep - arg;
+    if (len >= ASSET_BUNDLE_NAME_MAX) {
+        fprintf(stderr, "Name too long: %.*s\n", (int)len, arg);
+        return -1;
+    }
+
+    if (item_cnt == PACK_MAX_ENTRIES) {
+        fprintf(stderr, "Too many assets\n");
+        return -1;
+    }
+
+    item = &items[item_cnt++];
+    memcpy(item->entry.name, arg, len);
+    item->entry.type = type;
+    item->path = sep + 1;
+    return 0;
+}
+
+/**
+ * Decode and convert an image
+ *
+ * @param item the asset
+ * @param depth the color depth of the display
+ * @param align the stride alignment
+ * @return 0 on success, -1 on error
+ */
+static int load_image(pack_item_t *item, uint32_t depth, uint32_t align)
+{
+    lv_image_decoder_dsc_t dsc;
+    const lv_draw_buf_t *buf;
+    lv_color32_t c;
+    char src[PATH_MAX + 3];
+    uint32_t w, h, x, y;
+    uint32_t stride;
+    bool alpha = false;
+    uint8_t *row;
+    uint8_t *a8;
+    uint16_t v;
+
+    snprintf(src, sizeof(src), "%c:%s", LV_FS_STDIO_LETTER, item->path);
+
+    if (lv_image_decoder_open(&dsc, src, NULL) != LV_RESULT_OK || dsc.decoded == NULL) {
+        fprintf(stderr, "Failed to decode %s\n", item->path);
+        return -1;
+    }
+
+    buf = dsc.decoded;
+    w = buf->header.w;
+    h = buf->header.h;
+
+    for (y = 0; y < h && !alpha; y++) {
+        for (x = 0; x < w; x++) {
+            if (!read_pixel(buf, x, y, &c)) {
+                fprintf(stderr, "%s: unsupported decoded format %d\n", item->path, buf->header.cf);
+                lv_image_decoder_close(&dsc);
+                return -1;
+            }
+
+            if (c.alpha != 0xFF) {
+                alpha = true;
+                break;
+            }
+        }
+    }
+
+    if (depth == 32) {
+        item->entry.cf = alpha ? LV_COLOR_FORMAT_ARGB8888 : LV_COLOR_FORMAT_XRGB8888;
+        stride = ALIGN_UP(w * 4, align);
+        item->entry.size = (uint64_t)stride * h;
+    } else {
+        item->entry.cf = alpha ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565;
+        stride = ALIGN_UP(w * 2, align);
+
+        /* The alpha plane follows the color plane, with half its stride */
+        item->entry.size = (uint64_t)stride * h + (alpha ? (uint64_t)stride / 2 * h : 0);
+    }
+
+    item->entry.width = w;
+    item->entry.height = h;
+    item->entry.stride = stride;
+    item->data = calloc(1, item->entry.size);
+    if (item->data == NULL) {
+        lv_image_decoder_close(&dsc);
+        return -1;
+    }
+
+    for (y = 0; y < h; y++) {
+        row = item->data + (size_t)y * stride;
+        a8 = item->data + (size_t)stride * h + (size_t)y * (stride / 2);
+
+        for (x = 0; x < w; x++) {
+            read_pixel(buf, x, y, &c);
+
+            if (depth == 32) {
+                row[x * 4 + 0] = c.blue;
+                row[x * 4 + 1] = c.green;
+                row[x * 4 + 2] = c.red;
+                row[x * 4 + 3] = alpha ? c.alpha : 0xFF;
+            } else {
+                v = (uint16_t)(((c.red & 0xF8) << 8) | ((c.green & 0xFC) << 3) | (c.blue >> 3));
+                row[x * 2 + 0] = v & 0xFF;
+                row[x * 2 + 1] = v >> 8;
+
+                if (alpha) {
+                    a8[x] = c.alpha;
+                }
+            }
+        }
+    }
+
+    lv_image_decoder_close(&dsc);
+
+    fprintf(stdout, "image %s %ux%u stride=%u %s\n", item->entry.name, w, h, stride,
+            alpha ? "alpha" : "opaque");
+    return 0;
+}
+
+/**
+ * Read a font
+ *
+ * @param item the asset
+ * @return 0 on success, -1 on error
+ */
+static int load_font(pack_item_t *item)
+{
+    FILE *f = fopen(item->path, "rb");
+    long size;
+
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open %s\n", item->path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    item->data = malloc(size > 0 ? size : 1);
+    if (item->data == NULL || size <= 0 || fread(item->data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", item->path);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    item->entry.size = size;
+
+    fprintf(stdout, "font %s %ld bytes\n", item->entry.name, size);
+    return 0;
+}
+
+/**
+ * Read a pixel of a decoded image
+ *
+ * @return false if the color format is not supported
+ */
+static bool read_pixel(const lv_draw_buf_t *buf, uint32_t x, uint32_t y, lv_color32_t *c)
+{
+    const uint8_t *p = buf->data + (size_t)y * buf->header.stride;
+    uint16_t v;
+
+    switch (buf->header.cf) {
+    case LV_COLOR_FORMAT_ARGB8888:
+    case LV_COLOR_FORMAT_XRGB8888:
+        p += x * 4;
+        c->blue = p[0];
+        c->green = p[1];
+        c->red = p[2];
+        c->alpha = buf->header.cf == LV_COLOR_FORMAT_ARGB8888 ? p[3] : 0xFF;
+        return true;
+
+    case LV_COLOR_FORMAT_RGB888:
+        p += x * 3;
+        c->blue = p[0];
+        c->green = p[1];
+        c->red = p[2];
+        c->alpha = 0xFF;
+        return true;
+
+    case LV_COLOR_FORMAT_RGB565:
+        p += x * 2;
+        v = p[0] | (p[1] << 8);
+        c->red = ((v >> 11) & 0x1F) * 255 / 31;
+        c->green = ((v >> 5) & 0x3F) * 255 / 63;
+        c->blue = (v & 0x1F) * 255 / 31;
+        c->alpha = 0xFF;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * Write the bundle
+ *
+ * @param path the output file
+ * @return 0 on success, -1 on error
+ */
+static int write_bundle(const char *path, uint32_t depth, uint32_t align)
+{
+    static const uint8_t zero[ASSET_BUNDLE_DATA_ALIGN];
+    asset_bundle_header_t header;
+    uint64_t offset;
+    uint32_t i;
+    FILE *f;
+    bool ok = true;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_BUNDLE_MAGIC, 4);
+    header.version = ASSET_BUNDLE_VERSION;
+    header.entry_cnt = item_cnt;
+    header.color_depth = depth;
+    header.stride_align = align;
+
+    offset = sizeof(header) + (uint64_t)item_cnt * sizeof(asset_bundle_entry_t);
+    for (i = 0; i < item_cnt; i++) {
+        offset = ALIGN_UP(offset, ASSET_BUNDLE_DATA_ALIGN);
+        items[i].entry.offset = offset;
+        offset += items[i].entry.size;
+    }
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        return -1;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (i = 0; i < item_cnt && ok; i++) {
+        ok = fwrite(&items[i].entry, sizeof(asset_bundle_entry_t), 1, f) == 1;
+    }
+
+    for (i = 0; i < item_cnt && ok; i++) {
+        offset = items[i].entry.offset - ftell(f);
+        ok = fwrite(zero, 1, offset, f) == offset &&
+             fwrite(items[i].data, 1, items[i].entry.size, f) == items[i].entry.size;
+    }
+
+    if (fclose(f) != 0 || !ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return -1;
+    }
+
+    fprintf(stdout, "%u assets written to %s\n", item_cnt, path);
+    return 0;
+}
+
+/**
+ * Order the assets by name
+ */
+static int compare_items(const void *a, const void *b)
+{
+    return strcmp(((const pack_item_t *)a)->entry.name, ((const pack_item_t *)b)->entry.name);
+}
+
+/**
+ * Print the usage
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-d 16|32] [-a stride_align] -o bundle.lvab "
+            "[-i name=image.png ...] [-f name=font.bin ...]\n", prog);
+}